@@ -0,0 +1,197 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.example.android.lyra;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Streams audio through Lyra one 20 ms hop at a time, reading and writing
+ * buffers owned by the caller in place.
+ *
+ * <p>Direct {@link ByteBuffer}s are accessed through their address. Arrays are
+ * copied into and out of native buffers of the encoder or decoder, without
+ * pinning them while a hop is coded. No Java arrays are allocated per hop.
+ * Samples in direct buffers are 16 bit in native byte order, as returned by
+ * {@link #allocateSamples}, and are read and written from the start of the
+ * buffer regardless of its position; pass a {@link ByteBuffer#slice} to code
+ * elsewhere. The native library with the bindings has to be loaded by the
+ * caller. Encoders and decoders are not thread safe.
+ */
+public final class LyraCodec {
+  /**
+   * Size of the largest packet of any supported bitrate, in-band FEC included.
+   * The bindings check it against the codec at compile time.
+   */
+  // LINT.IfChange
+  public static final int MAX_PACKET_SIZE = 31;
+  // LINT.ThenChange(//lyra/android_example/lyra_codec_jni.cc)
+
+  private LyraCodec() {}
+
+  /** Returns the number of samples of one hop at {@code sampleRateHz}. */
+  public static int numSamplesPerHop(int sampleRateHz) {
+    return sampleRateHz / 50;
+  }
+
+  /** Allocates a direct buffer of {@code numSamples} native order samples. */
+  public static ByteBuffer allocateSamples(int numSamples) {
+    return ByteBuffer.allocateDirect(2 * numSamples).order(ByteOrder.nativeOrder());
+  }
+
+  /** Encodes hops of audio into packets. */
+  public static final class Encoder implements AutoCloseable {
+    private final int sampleRateHz;
+    private long handle;
+
+    private Encoder(int sampleRateHz, long handle) {
+      this.sampleRateHz = sampleRateHz;
+      this.handle = handle;
+    }
+
+    /** Returns null if the parameters are not supported by the codec. */
+    public static Encoder create(
+        int sampleRateHz, int bitrate, boolean enableDtx, String modelPath) {
+      long handle = nativeCreateEncoder(sampleRateHz, bitrate, enableDtx, modelPath);
+      return handle == 0 ? null : new Encoder(sampleRateHz, handle);
+    }
+
+    public int sampleRateHz() {
+      return sampleRateHz;
+    }
+
+    /**
+     * Encodes one hop from the direct buffer {@code samples} into the direct
+     * buffer {@code packet}. Returns the size of the packet, which is 0 if DTX
+     * left it out, or -1 on failure.
+     */
+    public int encode(ByteBuffer samples, ByteBuffer packet) {
+      return nativeEncodeBuffer(checkOpen(), samples, packet);
+    }
+
+    /**
+     * Encodes one hop from {@code samples} at {@code samplesOffset} into
+     * {@code packet} at {@code packetOffset}. Returns the size of the packet,
+     * which is 0 if DTX left it out, or -1 on failure.
+     */
+    public int encode(short[] samples, int samplesOffset, byte[] packet, int packetOffset) {
+      return nativeEncodeArray(checkOpen(), samples, samplesOffset, packet, packetOffset);
+    }
+
+    @Override
+    public void close() {
+      if (handle != 0) {
+        nativeDestroyEncoder(handle);
+        handle = 0;
+      }
+    }
+
+    private long checkOpen() {
+      if (handle == 0) {
+        throw new IllegalStateException("The encoder is closed.");
+      }
+      return handle;
+    }
+  }
+
+  /** Decodes packets into audio, concealing lost packets. */
+  public static final class Decoder implements AutoCloseable {
+    private final int sampleRateHz;
+    private long handle;
+
+    private Decoder(int sampleRateHz, long handle) {
+      this.sampleRateHz = sampleRateHz;
+      this.handle = handle;
+    }
+
+    /** Returns null if the parameters are not supported by the codec. */
+    public static Decoder create(int sampleRateHz, String modelPath) {
+      long handle = nativeCreateDecoder(sampleRateHz, modelPath);
+      return handle == 0 ? null : new Decoder(sampleRateHz, handle);
+    }
+
+    public int sampleRateHz() {
+      return sampleRateHz;
+    }
+
+    /**
+     * Decodes the first {@code packetSize} bytes of the direct buffer
+     * {@code packet} into {@code numSamples} samples of the direct buffer
+     * {@code samples}. A {@code packetSize} of 0 conceals a lost packet.
+     * Returns {@code numSamples}, or -1 on failure.
+     */
+    public int decode(ByteBuffer packet, int packetSize, ByteBuffer samples, int numSamples) {
+      return nativeDecodeBuffer(checkOpen(), packet, packetSize, samples, numSamples);
+    }
+
+    /**
+     * Decodes {@code packetSize} bytes of {@code packet} from
+     * {@code packetOffset} on into {@code numSamples} samples of
+     * {@code samples} from {@code samplesOffset} on. A {@code packetSize} of 0
+     * conceals a lost packet. Returns {@code numSamples}, or -1 on failure.
+     */
+    public int decode(
+        byte[] packet,
+        int packetOffset,
+        int packetSize,
+        short[] samples,
+        int samplesOffset,
+        int numSamples) {
+      return nativeDecodeArray(
+          checkOpen(), packet, packetOffset, packetSize, samples, samplesOffset, numSamples);
+    }
+
+    @Override
+    public void close() {
+      if (handle != 0) {
+        nativeDestroyDecoder(handle);
+        handle = 0;
+      }
+    }
+
+    private long checkOpen() {
+      if (handle == 0) {
+        throw new IllegalStateException("The decoder is closed.");
+      }
+      return handle;
+    }
+  }
+
+  private static native long nativeCreateEncoder(
+      int sampleRateHz, int bitrate, boolean enableDtx, String modelPath);
+
+  private static native void nativeDestroyEncoder(long handle);
+
+  private static native int nativeEncodeBuffer(long handle, ByteBuffer samples, ByteBuffer packet);
+
+  private static native int nativeEncodeArray(
+      long handle, short[] samples, int samplesOffset, byte[] packet, int packetOffset);
+
+  private static native long nativeCreateDecoder(int sampleRateHz, String modelPath);
+
+  private static native void nativeDestroyDecoder(long handle);
+
+  private static native int nativeDecodeBuffer(
+      long handle, ByteBuffer packet, int packetSize, ByteBuffer samples, int numSamples);
+
+  private static native int nativeDecodeArray(
+      long handle,
+      byte[] packet,
+      int packetOffset,
+      int packetSize,
+      short[] samples,
+      int samplesOffset,
+      int numSamples);
+}
@@ -0,0 +1,173 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.example.android.lyra;
+
+import static org.junit.Assert.assertArrayEquals;
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertNotNull;
+import static org.junit.Assert.assertNull;
+import static org.junit.Assert.assertThrows;
+import static org.junit.Assert.assertTrue;
+
+import java.nio.ByteBuffer;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+import org.junit.runners.JUnit4;
+
+/** Runs the JNI bindings of {@link LyraCodec} on a desktop JVM. */
+@RunWith(JUnit4.class)
+public final class LyraCodecTest {
+  static {
+    System.loadLibrary("lyra_codec_jni");
+  }
+
+  private static final String MODEL_PATH = "lyra/model_coeffs";
+  private static final int SAMPLE_RATE_HZ = 16000;
+  private static final int BITRATE = 6000;
+  private static final int PACKET_SIZE = 15;
+  private static final int NUM_SAMPLES_PER_HOP = LyraCodec.numSamplesPerHop(SAMPLE_RATE_HZ);
+  private static final int NUM_HOPS = 10;
+
+  private static short[] sineWave(int numSamples) {
+    short[] samples = new short[numSamples];
+    for (int i = 0; i < numSamples; ++i) {
+      samples[i] = (short) (8000 * Math.sin(2 * Math.PI * 440 * i / SAMPLE_RATE_HZ));
+    }
+    return samples;
+  }
+
+  @Test
+  public void directBuffersAreCodedInPlace() {
+    short[] input = sineWave(NUM_HOPS * NUM_SAMPLES_PER_HOP);
+    ByteBuffer samples = LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP);
+    ByteBuffer packet = ByteBuffer.allocateDirect(LyraCodec.MAX_PACKET_SIZE);
+    ByteBuffer decoded = LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP);
+    try (LyraCodec.Encoder encoder =
+            LyraCodec.Encoder.create(SAMPLE_RATE_HZ, BITRATE, false, MODEL_PATH);
+        LyraCodec.Decoder decoder = LyraCodec.Decoder.create(SAMPLE_RATE_HZ, MODEL_PATH)) {
+      assertNotNull(encoder);
+      assertNotNull(decoder);
+      boolean isSilent = true;
+      for (int hop = 0; hop < NUM_HOPS; ++hop) {
+        samples.asShortBuffer().put(input, hop * NUM_SAMPLES_PER_HOP, NUM_SAMPLES_PER_HOP);
+        assertEquals(PACKET_SIZE, encoder.encode(samples, packet));
+        assertEquals(
+            NUM_SAMPLES_PER_HOP,
+            decoder.decode(packet, PACKET_SIZE, decoded, NUM_SAMPLES_PER_HOP));
+        for (int i = 0; i < NUM_SAMPLES_PER_HOP; ++i) {
+          isSilent = isSilent && decoded.asShortBuffer().get(i) == 0;
+        }
+      }
+      assertTrue(!isSilent);
+    }
+  }
+
+  @Test
+  public void arraysMatchDirectBuffers() {
+    short[] input = sineWave(NUM_HOPS * NUM_SAMPLES_PER_HOP);
+    ByteBuffer samples = LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP);
+    ByteBuffer packet = ByteBuffer.allocateDirect(LyraCodec.MAX_PACKET_SIZE);
+    ByteBuffer decoded = LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP);
+    // Packets and samples are written at offsets into shared arrays.
+    byte[] packets = new byte[NUM_HOPS * PACKET_SIZE];
+    short[] output = new short[NUM_HOPS * NUM_SAMPLES_PER_HOP];
+    try (LyraCodec.Encoder bufferEncoder =
+            LyraCodec.Encoder.create(SAMPLE_RATE_HZ, BITRATE, false, MODEL_PATH);
+        LyraCodec.Encoder arrayEncoder =
+            LyraCodec.Encoder.create(SAMPLE_RATE_HZ, BITRATE, false, MODEL_PATH);
+        LyraCodec.Decoder bufferDecoder = LyraCodec.Decoder.create(SAMPLE_RATE_HZ, MODEL_PATH);
+        LyraCodec.Decoder arrayDecoder = LyraCodec.Decoder.create(SAMPLE_RATE_HZ, MODEL_PATH)) {
+      for (int hop = 0; hop < NUM_HOPS; ++hop) {
+        final int samplesOffset = hop * NUM_SAMPLES_PER_HOP;
+        final int packetOffset = hop * PACKET_SIZE;
+        samples.asShortBuffer().put(input, samplesOffset, NUM_SAMPLES_PER_HOP);
+        assertEquals(PACKET_SIZE, bufferEncoder.encode(samples, packet));
+        assertEquals(PACKET_SIZE, arrayEncoder.encode(input, samplesOffset, packets, packetOffset));
+        byte[] bufferPacket = new byte[PACKET_SIZE];
+        packet.duplicate().get(bufferPacket);
+        byte[] arrayPacket = new byte[PACKET_SIZE];
+        System.arraycopy(packets, packetOffset, arrayPacket, 0, PACKET_SIZE);
+        assertArrayEquals(bufferPacket, arrayPacket);
+
+        assertEquals(
+            NUM_SAMPLES_PER_HOP,
+            bufferDecoder.decode(packet, PACKET_SIZE, decoded, NUM_SAMPLES_PER_HOP));
+        assertEquals(
+            NUM_SAMPLES_PER_HOP,
+            arrayDecoder.decode(
+                packets, packetOffset, PACKET_SIZE, output, samplesOffset, NUM_SAMPLES_PER_HOP));
+        short[] bufferSamples = new short[NUM_SAMPLES_PER_HOP];
+        decoded.asShortBuffer().get(bufferSamples);
+        short[] arraySamples = new short[NUM_SAMPLES_PER_HOP];
+        System.arraycopy(output, samplesOffset, arraySamples, 0, NUM_SAMPLES_PER_HOP);
+        assertArrayEquals(bufferSamples, arraySamples);
+      }
+    }
+  }
+
+  @Test
+  public void lostPacketsAreConcealed() {
+    short[] output = new short[NUM_SAMPLES_PER_HOP];
+    try (LyraCodec.Decoder decoder = LyraCodec.Decoder.create(SAMPLE_RATE_HZ, MODEL_PATH)) {
+      for (int hop = 0; hop < NUM_HOPS; ++hop) {
+        assertEquals(
+            NUM_SAMPLES_PER_HOP, decoder.decode(null, 0, 0, output, 0, NUM_SAMPLES_PER_HOP));
+      }
+    }
+  }
+
+  @Test
+  public void invalidBuffersFail() {
+    try (LyraCodec.Encoder encoder =
+            LyraCodec.Encoder.create(SAMPLE_RATE_HZ, BITRATE, false, MODEL_PATH);
+        LyraCodec.Decoder decoder = LyraCodec.Decoder.create(SAMPLE_RATE_HZ, MODEL_PATH)) {
+      ByteBuffer packet = ByteBuffer.allocateDirect(LyraCodec.MAX_PACKET_SIZE);
+      // Heap buffers have no address.
+      assertEquals(-1, encoder.encode(ByteBuffer.allocate(2 * NUM_SAMPLES_PER_HOP), packet));
+      assertEquals(-1, encoder.encode(LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP - 1), packet));
+      assertEquals(
+          -1,
+          encoder.encode(
+              LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP), ByteBuffer.allocateDirect(1)));
+      assertEquals(
+          -1, encoder.encode(new short[NUM_SAMPLES_PER_HOP], 1, new byte[PACKET_SIZE], 0));
+      assertEquals(
+          -1,
+          decoder.decode(
+              new byte[PACKET_SIZE], 1, PACKET_SIZE, new short[NUM_SAMPLES_PER_HOP], 0,
+              NUM_SAMPLES_PER_HOP));
+      // Unsupported packet size.
+      assertEquals(
+          -1,
+          decoder.decode(
+              packet, PACKET_SIZE + 1, LyraCodec.allocateSamples(NUM_SAMPLES_PER_HOP),
+              NUM_SAMPLES_PER_HOP));
+    }
+  }
+
+  @Test
+  public void unsupportedParametersAndClosedCodecsFail() {
+    assertNull(LyraCodec.Encoder.create(44100, BITRATE, false, MODEL_PATH));
+    assertNull(LyraCodec.Decoder.create(SAMPLE_RATE_HZ, "invalid/model/path"));
+    LyraCodec.Encoder encoder =
+        LyraCodec.Encoder.create(SAMPLE_RATE_HZ, BITRATE, false, MODEL_PATH);
+    assertNotNull(encoder);
+    encoder.close();
+    encoder.close();
+    assertThrows(
+        IllegalStateException.class,
+        () -> encoder.encode(new short[NUM_SAMPLES_PER_HOP], 0, new byte[PACKET_SIZE], 0));
+  }
+}
@@ -0,0 +1,301 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// JNI bindings of com.example.android.lyra.LyraCodec, which code one hop at a
+// time into buffers owned by the caller. Direct ByteBuffers are read and
+// written in place. Java arrays are copied into and out of scratch buffers of
+// the handle with the Get/Set<Type>ArrayRegion functions, so the JVM is never
+// held in a critical region while a hop is coded. No Java arrays are
+// allocated per hop.
+
+#include <jni.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/in_place_coding.h"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+std::string ToString(JNIEnv* env, jstring java_string) {
+  if (java_string == nullptr) {
+    return "";
+  }
+  const char* chars = env->GetStringUTFChars(java_string, nullptr);
+  std::string result(chars);
+  env->ReleaseStringUTFChars(java_string, chars);
+  return result;
+}
+
+// Returns the address of |buffer| if it is a direct buffer of at least
+// |num_bytes| bytes, and nullptr otherwise.
+void* GetDirectBuffer(JNIEnv* env, jobject buffer, int64_t num_bytes) {
+  if (buffer == nullptr) {
+    LOG(ERROR) << "The buffer is null.";
+    return nullptr;
+  }
+  void* address = env->GetDirectBufferAddress(buffer);
+  if (address == nullptr) {
+    LOG(ERROR) << "Only direct buffers can be coded in place.";
+    return nullptr;
+  }
+  const int64_t capacity = env->GetDirectBufferCapacity(buffer);
+  if (capacity < num_bytes) {
+    LOG(ERROR) << "The buffer holds " << capacity << " bytes, but "
+               << num_bytes << " are needed.";
+    return nullptr;
+  }
+  return address;
+}
+
+// Returns true if |array| is not null and holds |count| elements from
+// |offset| on.
+bool IsRangeValid(JNIEnv* env, jarray array, jint offset, int64_t count) {
+  if (array == nullptr) {
+    LOG(ERROR) << "The array is null.";
+    return false;
+  }
+  const jsize length = env->GetArrayLength(array);
+  if (offset < 0 || count < 0 || offset + count > length) {
+    LOG(ERROR) << "The range of " << count << " elements from " << offset
+               << " does not fit an array of " << length << " elements.";
+    return false;
+  }
+  return true;
+}
+
+// LINT.IfChange
+constexpr int kJavaMaxPacketSize = 31;
+// LINT.ThenChange(//lyra/android_example/java/com/example/android/lyra/LyraCodec.java)
+static_assert(kJavaMaxPacketSize == kMaxPacketSize,
+              "LyraCodec.MAX_PACKET_SIZE has to match the largest packet.");
+
+// What a Java handle points to. The scratch buffers hold the hop and packet
+// of the array entry points, and are sized once, so that coding a hop does
+// not allocate them.
+struct EncoderHandle {
+  explicit EncoderHandle(std::unique_ptr<LyraEncoder> encoder)
+      : encoder(std::move(encoder)),
+        samples(GetNumSamplesPerHop(this->encoder->sample_rate_hz())),
+        packet(kMaxPacketSize) {}
+
+  const std::unique_ptr<LyraEncoder> encoder;
+  std::vector<jshort> samples;
+  std::vector<jbyte> packet;
+};
+
+struct DecoderHandle {
+  explicit DecoderHandle(std::unique_ptr<LyraDecoder> decoder)
+      : decoder(std::move(decoder)),
+        samples(GetNumSamplesPerHop(this->decoder->sample_rate_hz())),
+        packet(kMaxPacketSize) {}
+
+  const std::unique_ptr<LyraDecoder> decoder;
+  // Grows if more samples than a hop are requested.
+  std::vector<jshort> samples;
+  std::vector<jbyte> packet;
+};
+
+EncoderHandle* ToEncoder(jlong handle) {
+  return reinterpret_cast<EncoderHandle*>(handle);
+}
+
+DecoderHandle* ToDecoder(jlong handle) {
+  return reinterpret_cast<DecoderHandle*>(handle);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
+
+using chromemedia::codec::DecodeInto;
+using chromemedia::codec::DecoderHandle;
+using chromemedia::codec::EncodeInto;
+using chromemedia::codec::EncoderHandle;
+using chromemedia::codec::GetDirectBuffer;
+using chromemedia::codec::GetNumSamplesPerHop;
+using chromemedia::codec::IsRangeValid;
+using chromemedia::codec::kNumChannels;
+using chromemedia::codec::LyraDecoder;
+using chromemedia::codec::LyraEncoder;
+using chromemedia::codec::ToDecoder;
+using chromemedia::codec::ToEncoder;
+using chromemedia::codec::ToString;
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeCreateEncoder(
+    JNIEnv* env, jclass clazz, jint sample_rate_hz, jint bitrate,
+    jboolean enable_dtx, jstring model_path) {
+  auto encoder = LyraEncoder::Create(sample_rate_hz, kNumChannels, bitrate,
+                                     enable_dtx, ToString(env, model_path));
+  if (encoder == nullptr) {
+    return 0;
+  }
+  return reinterpret_cast<jlong>(new EncoderHandle(std::move(encoder)));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeDestroyEncoder(JNIEnv* env,
+                                                             jclass clazz,
+                                                             jlong handle) {
+  delete ToEncoder(handle);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeEncodeBuffer(
+    JNIEnv* env, jclass clazz, jlong handle, jobject samples, jobject packet) {
+  EncoderHandle* encoder = ToEncoder(handle);
+  if (encoder == nullptr) {
+    return -1;
+  }
+  const int num_samples = encoder->samples.size();
+  const auto* samples_data = static_cast<const int16_t*>(
+      GetDirectBuffer(env, samples, num_samples * sizeof(int16_t)));
+  auto* packet_data =
+      static_cast<uint8_t*>(GetDirectBuffer(env, packet, /*num_bytes=*/0));
+  if (samples_data == nullptr || packet_data == nullptr) {
+    return -1;
+  }
+  return EncodeInto(
+      encoder->encoder.get(), absl::MakeConstSpan(samples_data, num_samples),
+      absl::MakeSpan(packet_data, env->GetDirectBufferCapacity(packet)));
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeEncodeArray(
+    JNIEnv* env, jclass clazz, jlong handle, jshortArray samples,
+    jint samples_offset, jbyteArray packet, jint packet_offset) {
+  EncoderHandle* encoder = ToEncoder(handle);
+  if (encoder == nullptr) {
+    return -1;
+  }
+  const int num_samples = encoder->samples.size();
+  if (!IsRangeValid(env, samples, samples_offset, num_samples) ||
+      !IsRangeValid(env, packet, packet_offset, 0)) {
+    return -1;
+  }
+  const int64_t packet_capacity =
+      env->GetArrayLength(packet) - static_cast<int64_t>(packet_offset);
+  env->GetShortArrayRegion(samples, samples_offset, num_samples,
+                           encoder->samples.data());
+  const jint packet_size = EncodeInto(
+      encoder->encoder.get(),
+      absl::MakeConstSpan(
+          reinterpret_cast<const int16_t*>(encoder->samples.data()),
+          num_samples),
+      absl::MakeSpan(reinterpret_cast<uint8_t*>(encoder->packet.data()),
+                     std::min<int64_t>(packet_capacity,
+                                       encoder->packet.size())));
+  if (packet_size <= 0) {
+    return packet_size;
+  }
+  env->SetByteArrayRegion(packet, packet_offset, packet_size,
+                          encoder->packet.data());
+  return packet_size;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeCreateDecoder(
+    JNIEnv* env, jclass clazz, jint sample_rate_hz, jstring model_path) {
+  auto decoder = LyraDecoder::Create(sample_rate_hz, kNumChannels,
+                                     ToString(env, model_path));
+  if (decoder == nullptr) {
+    return 0;
+  }
+  return reinterpret_cast<jlong>(new DecoderHandle(std::move(decoder)));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeDestroyDecoder(JNIEnv* env,
+                                                             jclass clazz,
+                                                             jlong handle) {
+  delete ToDecoder(handle);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeDecodeBuffer(
+    JNIEnv* env, jclass clazz, jlong handle, jobject packet, jint packet_size,
+    jobject samples, jint num_samples) {
+  DecoderHandle* decoder = ToDecoder(handle);
+  if (decoder == nullptr || packet_size < 0 || num_samples < 0) {
+    return -1;
+  }
+  const uint8_t* packet_data = nullptr;
+  if (packet_size > 0) {
+    packet_data =
+        static_cast<const uint8_t*>(GetDirectBuffer(env, packet, packet_size));
+    if (packet_data == nullptr) {
+      return -1;
+    }
+  }
+  auto* samples_data = static_cast<int16_t*>(
+      GetDirectBuffer(env, samples, num_samples * sizeof(int16_t)));
+  if (samples_data == nullptr) {
+    return -1;
+  }
+  return DecodeInto(decoder->decoder.get(),
+                    absl::MakeConstSpan(packet_data, packet_size),
+                    absl::MakeSpan(samples_data, num_samples));
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_lyra_LyraCodec_nativeDecodeArray(
+    JNIEnv* env, jclass clazz, jlong handle, jbyteArray packet,
+    jint packet_offset, jint packet_size, jshortArray samples,
+    jint samples_offset, jint num_samples) {
+  DecoderHandle* decoder = ToDecoder(handle);
+  if (decoder == nullptr || packet_size < 0 ||
+      (packet_size > 0 &&
+       !IsRangeValid(env, packet, packet_offset, packet_size)) ||
+      !IsRangeValid(env, samples, samples_offset, num_samples)) {
+    return -1;
+  }
+  if (packet_size > decoder->packet.size()) {
+    LOG(ERROR) << "The packet of " << packet_size
+               << " bytes is larger than any supported packet.";
+    return -1;
+  }
+  if (num_samples > decoder->samples.size()) {
+    decoder->samples.resize(num_samples);
+  }
+  if (packet_size > 0) {
+    env->GetByteArrayRegion(packet, packet_offset, packet_size,
+                            decoder->packet.data());
+  }
+  const jint num_decoded = DecodeInto(
+      decoder->decoder.get(),
+      absl::MakeConstSpan(
+          reinterpret_cast<const uint8_t*>(decoder->packet.data()),
+          packet_size),
+      absl::MakeSpan(reinterpret_cast<int16_t*>(decoder->samples.data()),
+                     num_samples));
+  if (num_decoded < 0) {
+    return -1;
+  }
+  env->SetShortArrayRegion(samples, samples_offset, num_decoded,
+                           decoder->samples.data());
+  return num_decoded;
+}
@@ -0,0 +1,195 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/async_generative_model.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/generative_model_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+std::unique_ptr<AsyncGenerativeModel> AsyncGenerativeModel::Create(
+    std::unique_ptr<GenerativeModelInterface> model, int num_samples_per_hop,
+    absl::Duration max_wait) {
+  if (model == nullptr) {
+    LOG(ERROR) << "Generative model is null.";
+    return nullptr;
+  }
+  if (num_samples_per_hop <= 0) {
+    LOG(ERROR) << "The number of samples per hop has to be positive.";
+    return nullptr;
+  }
+  if (max_wait < absl::ZeroDuration()) {
+    LOG(ERROR) << "The maximum wait for a hop can not be negative.";
+    return nullptr;
+  }
+  return absl::WrapUnique(new AsyncGenerativeModel(
+      std::move(model), num_samples_per_hop, max_wait));
+}
+
+AsyncGenerativeModel::AsyncGenerativeModel(
+    std::unique_ptr<GenerativeModelInterface> model, int num_samples_per_hop,
+    absl::Duration max_wait)
+    : model_(std::move(model)),
+      num_samples_per_hop_(num_samples_per_hop),
+      max_wait_(max_wait),
+      num_hops_added_(0),
+      num_hops_played_(0),
+      next_sample_in_hop_(0),
+      num_late_hops_(0),
+      current_hop_(num_samples_per_hop, 0),
+      failed_(false),
+      stop_(false),
+      thread_(&AsyncGenerativeModel::RunModel, this) {}
+
+AsyncGenerativeModel::~AsyncGenerativeModel() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = true;
+    cond_var_.SignalAll();
+  }
+  thread_.join();
+}
+
+bool AsyncGenerativeModel::AddFeatures(const std::vector<float>& features) {
+  absl::MutexLock lock(&mutex_);
+  if (failed_) {
+    return false;
+  }
+  pending_features_.push_back(features);
+  ++num_hops_added_;
+  cond_var_.Signal();
+  return true;
+}
+
+std::optional<std::vector<int16_t>> AsyncGenerativeModel::GenerateSamples(
+    int num_samples) {
+  if (num_samples < 0) {
+    LOG(ERROR) << "Number of samples must be positive.";
+    return std::nullopt;
+  }
+  if (num_samples == 0) {
+    return std::vector<int16_t>(0);
+  }
+  if (num_samples > num_samples_available()) {
+    LOG(ERROR) << "Tried generating " << num_samples << " samples but only "
+               << num_samples_available() << " are available.";
+    return std::nullopt;
+  }
+  if (num_samples > num_samples_per_hop_ - next_sample_in_hop_) {
+    LOG(ERROR) << "Tried generating " << num_samples << " samples but only "
+               << num_samples_per_hop_ - next_sample_in_hop_
+               << " were available in current features.";
+    return std::nullopt;
+  }
+  if (next_sample_in_hop_ == 0 && !StartHop()) {
+    return std::nullopt;
+  }
+  const auto begin = current_hop_.begin() + next_sample_in_hop_;
+  std::vector<int16_t> samples(begin, begin + num_samples);
+  next_sample_in_hop_ += num_samples;
+  if (next_sample_in_hop_ == num_samples_per_hop_) {
+    next_sample_in_hop_ = 0;
+    ++num_hops_played_;
+  }
+  return samples;
+}
+
+int AsyncGenerativeModel::num_samples_available() const {
+  return static_cast<int>(num_hops_added_ - num_hops_played_) *
+             num_samples_per_hop_ -
+         next_sample_in_hop_;
+}
+
+bool AsyncGenerativeModel::StartHop() {
+  {
+    absl::MutexLock lock(&mutex_);
+    const absl::Time deadline = absl::Now() + max_wait_;
+    while (!failed_ && (synthesized_hops_.empty() ||
+                        synthesized_hops_.back().index < num_hops_played_)) {
+      if (hop_ready_.WaitWithDeadline(&mutex_, deadline)) {
+        break;
+      }
+    }
+    if (failed_) {
+      LOG(ERROR) << "Generative model failed on an earlier hop.";
+      return false;
+    }
+    // Drop hops that were concealed because they arrived too late.
+    while (!synthesized_hops_.empty() &&
+           synthesized_hops_.front().index < num_hops_played_) {
+      synthesized_hops_.pop_front();
+    }
+    if (!synthesized_hops_.empty()) {
+      current_hop_.swap(synthesized_hops_.front().samples);
+      synthesized_hops_.pop_front();
+      return true;
+    }
+  }
+  // Mirroring keeps the waveform continuous at the hop boundary, and halving
+  // the gain fades out runs of late hops.
+  ++num_late_hops_;
+  std::reverse(current_hop_.begin(), current_hop_.end());
+  for (int16_t& sample : current_hop_) {
+    sample /= 2;
+  }
+  return true;
+}
+
+void AsyncGenerativeModel::RunModel() {
+  int64_t hop_index = 0;
+  while (true) {
+    std::vector<float> features;
+    {
+      absl::MutexLock lock(&mutex_);
+      while (!stop_ && pending_features_.empty()) {
+        cond_var_.Wait(&mutex_);
+      }
+      if (stop_) {
+        return;
+      }
+      features = std::move(pending_features_.front());
+      pending_features_.pop_front();
+    }
+    std::optional<std::vector<int16_t>> samples;
+    if (model_->AddFeatures(features)) {
+      samples = model_->GenerateSamples(num_samples_per_hop_);
+    }
+    absl::MutexLock lock(&mutex_);
+    if (!samples.has_value() || samples->size() != num_samples_per_hop_) {
+      LOG(ERROR) << "Could not synthesize hop " << hop_index << ".";
+      failed_ = true;
+      hop_ready_.SignalAll();
+      return;
+    }
+    synthesized_hops_.push_back({hop_index++, std::move(*samples)});
+    hop_ready_.SignalAll();
+  }
+}
+
+}  // namespace codec
+}  // namespace chromemedia
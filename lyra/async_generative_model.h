@@ -0,0 +1,119 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_ASYNC_GENERATIVE_MODEL_H_
+#define LYRA_ASYNC_GENERATIVE_MODEL_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "lyra/generative_model_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Runs a generative model on a background thread, so that the thread pulling
+// audio out of it never invokes the model. Every hop of features is
+// synthesized as soon as it is added, and |GenerateSamples| copies samples of
+// hops that are already synthesized.
+//
+// The deadline of a hop is |max_wait| after playout reaches it. Hops added
+// ahead of playout are ready by then and cost no wait. Hops whose features
+// are only added when they are due, like the estimated features of lost
+// packets or a packet set right before decoding, are waited for, so they are
+// effectively synthesized synchronously as long as the model is faster than
+// |max_wait|. A hop that misses its deadline is concealed by repeating the
+// last hop mirrored in time at half the gain, and its late output is
+// discarded once it arrives.
+//
+// The wrapped model still receives every hop of features in order, so its
+// state is the same as if it had been run synchronously.
+//
+// All methods have to be called from the same thread.
+class AsyncGenerativeModel : public GenerativeModelInterface {
+ public:
+  // Returns a nullptr on failure.
+  static std::unique_ptr<AsyncGenerativeModel> Create(
+      std::unique_ptr<GenerativeModelInterface> model, int num_samples_per_hop,
+      absl::Duration max_wait);
+
+  // Waits for the hop being synthesized, if any, and stops the thread.
+  ~AsyncGenerativeModel() override;
+
+  // Schedules synthesis of a hop from |features|. Never blocks on the model.
+  bool AddFeatures(const std::vector<float>& features) override;
+
+  // Returns a nullopt if the model failed on an earlier hop.
+  std::optional<std::vector<int16_t>> GenerateSamples(int num_samples) override;
+
+  // Includes hops that are scheduled but not yet synthesized.
+  int num_samples_available() const override;
+
+  // Number of hops that were concealed because they missed their deadline.
+  int64_t num_late_hops() const { return num_late_hops_; }
+
+ private:
+  struct Hop {
+    int64_t index;
+    std::vector<int16_t> samples;
+  };
+
+  AsyncGenerativeModel(std::unique_ptr<GenerativeModelInterface> model,
+                       int num_samples_per_hop, absl::Duration max_wait);
+
+  void RunModel();
+
+  // Fills |current_hop_| with the synthesized hop |num_hops_played_|, waiting
+  // up to |max_wait_| for it, or with concealment if it is still not ready.
+  // Returns false if the model failed.
+  bool StartHop();
+
+  const std::unique_ptr<GenerativeModelInterface> model_;
+  const int num_samples_per_hop_;
+  const absl::Duration max_wait_;
+
+  // Only used by the playout thread.
+  int64_t num_hops_added_;
+  int64_t num_hops_played_;
+  int next_sample_in_hop_;
+  int64_t num_late_hops_;
+  std::vector<int16_t> current_hop_;
+
+  absl::Mutex mutex_;
+  // Signaled when features are added or the thread has to stop.
+  absl::CondVar cond_var_;
+  // Signaled when a hop is synthesized or the model failed.
+  absl::CondVar hop_ready_;
+  std::deque<std::vector<float>> pending_features_ ABSL_GUARDED_BY(mutex_);
+  std::deque<Hop> synthesized_hops_ ABSL_GUARDED_BY(mutex_);
+  bool failed_ ABSL_GUARDED_BY(mutex_);
+  bool stop_ ABSL_GUARDED_BY(mutex_);
+
+  // Started last and joined first, since it uses all of the above.
+  std::thread thread_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_ASYNC_GENERATIVE_MODEL_H_
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/async_generative_model.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lyra/generative_model_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kNumSamplesPerHop = 4;
+
+// Synthesizes hop [f, f + 1, ...] from feature f. Features of at least
+// |kSlowFeature| wait for |gate|, and negative features fail.
+constexpr float kSlowFeature = 1000;
+
+class FakeModel : public GenerativeModel {
+ public:
+  explicit FakeModel(absl::Notification* gate = nullptr)
+      : GenerativeModel(kNumSamplesPerHop, /*num_features=*/1), gate_(gate) {}
+
+ private:
+  bool RunConditioning(const std::vector<float>& features) override {
+    if (features[0] >= kSlowFeature && gate_ != nullptr) {
+      gate_->WaitForNotification();
+    }
+    first_sample_ = static_cast<int16_t>(features[0]);
+    return first_sample_ >= 0;
+  }
+
+  std::optional<std::vector<int16_t>> RunModel(int num_samples) override {
+    std::vector<int16_t> samples(num_samples);
+    for (int i = 0; i < num_samples; ++i) {
+      samples[i] = first_sample_ + next_sample_in_hop() + i;
+    }
+    return samples;
+  }
+
+  absl::Notification* const gate_;
+  int16_t first_sample_ = 0;
+};
+
+std::vector<int16_t> Hop(int16_t first_sample) {
+  std::vector<int16_t> hop(kNumSamplesPerHop);
+  for (int i = 0; i < kNumSamplesPerHop; ++i) {
+    hop[i] = first_sample + i;
+  }
+  return hop;
+}
+
+// Long enough for a slow hop to be certainly late, and for any other hop to be
+// certainly in time.
+constexpr absl::Duration kMaxWait = absl::Milliseconds(100);
+
+TEST(AsyncGenerativeModelTest, CreateFailsWithoutModel) {
+  EXPECT_EQ(AsyncGenerativeModel::Create(nullptr, kNumSamplesPerHop, kMaxWait),
+            nullptr);
+}
+
+TEST(AsyncGenerativeModelTest, CreateFailsWithNegativeWait) {
+  EXPECT_EQ(AsyncGenerativeModel::Create(std::make_unique<FakeModel>(),
+                                         kNumSamplesPerHop,
+                                         -absl::Milliseconds(1)),
+            nullptr);
+}
+
+// Hops are played even when they are added right before playout, like the
+// estimated features of a lost packet.
+TEST(AsyncGenerativeModelTest, PlaysSynthesizedHopsInOrder) {
+  auto model = AsyncGenerativeModel::Create(
+      std::make_unique<FakeModel>(), kNumSamplesPerHop,
+      absl::InfiniteDuration());
+  ASSERT_NE(model, nullptr);
+  ASSERT_TRUE(model->AddFeatures({100}));
+  ASSERT_TRUE(model->AddFeatures({200}));
+  EXPECT_EQ(model->num_samples_available(), 2 * kNumSamplesPerHop);
+
+  // Requests may split hops at arbitrary points.
+  EXPECT_EQ(model->GenerateSamples(3), std::vector<int16_t>({100, 101, 102}));
+  EXPECT_EQ(model->GenerateSamples(1), std::vector<int16_t>({103}));
+  EXPECT_EQ(model->num_samples_available(), kNumSamplesPerHop);
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop), Hop(200));
+  EXPECT_EQ(model->num_samples_available(), 0);
+  ASSERT_TRUE(model->AddFeatures({300}));
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop), Hop(300));
+  EXPECT_EQ(model->num_late_hops(), 0);
+}
+
+TEST(AsyncGenerativeModelTest, ConcealsHopsPastTheirDeadline) {
+  absl::Notification gate;
+  auto model = AsyncGenerativeModel::Create(
+      std::make_unique<FakeModel>(&gate), kNumSamplesPerHop, kMaxWait);
+  ASSERT_NE(model, nullptr);
+  ASSERT_TRUE(model->AddFeatures({100}));
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop), Hop(100));
+
+  // The model is blocked on the slow hop until after its deadline, so it is
+  // concealed by the previous hop mirrored at half the gain, and then by that
+  // mirrored again.
+  ASSERT_TRUE(model->AddFeatures({kSlowFeature}));
+  ASSERT_TRUE(model->AddFeatures({kSlowFeature}));
+  ASSERT_TRUE(model->AddFeatures({300}));
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop),
+            std::vector<int16_t>({51, 51, 50, 50}));
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop),
+            std::vector<int16_t>({25, 25, 25, 25}));
+  EXPECT_EQ(model->num_late_hops(), 2);
+
+  // The slow hops arrive late and are dropped.
+  gate.Notify();
+  EXPECT_EQ(model->GenerateSamples(kNumSamplesPerHop), Hop(300));
+  EXPECT_EQ(model->num_late_hops(), 2);
+}
+
+TEST(AsyncGenerativeModelTest, ReportsFailureOfTheModel) {
+  auto model = AsyncGenerativeModel::Create(
+      std::make_unique<FakeModel>(), kNumSamplesPerHop,
+      absl::InfiniteDuration());
+  ASSERT_NE(model, nullptr);
+  ASSERT_TRUE(model->AddFeatures({-1}));
+  EXPECT_FALSE(model->GenerateSamples(kNumSamplesPerHop).has_value());
+  EXPECT_FALSE(model->AddFeatures({100}));
+}
+
+TEST(AsyncGenerativeModelTest, RejectsRequestsBeyondAvailableSamples) {
+  auto model = AsyncGenerativeModel::Create(std::make_unique<FakeModel>(),
+                                            kNumSamplesPerHop, kMaxWait);
+  ASSERT_NE(model, nullptr);
+  EXPECT_FALSE(model->GenerateSamples(1).has_value());
+  ASSERT_TRUE(model->AddFeatures({100}));
+  ASSERT_TRUE(model->AddFeatures({200}));
+  EXPECT_FALSE(model->GenerateSamples(kNumSamplesPerHop + 1).has_value());
+  EXPECT_EQ(model->GenerateSamples(0), std::vector<int16_t>());
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -22,6 +22,11 @@
 #include <optional>
 #include <vector>
 
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
+
 namespace chromemedia {
 namespace codec {
 
@@ -34,6 +39,40 @@ class BufferedFilterInterface {
       const std::function<std::optional<std::vector<int16_t>>(int)>&
           sample_generator,
       int num_samples) = 0;
+
+  // Like |FilterAndBuffer| for audio in unit floats. Defaults to filtering the
+  // audio as int16.
+  virtual std::optional<std::vector<float>> FilterAndBufferFloat(
+      const std::function<std::optional<std::vector<float>>(int)>&
+          sample_generator,
+      int num_samples) {
+    const std::function<std::optional<std::vector<int16_t>>(int)>
+        int16_generator = [&sample_generator](int num_samples_to_generate)
+        -> std::optional<std::vector<int16_t>> {
+      auto generated = sample_generator(num_samples_to_generate);
+      if (!generated.has_value()) {
+        return std::nullopt;
+      }
+      return UnitToInt16(absl::MakeConstSpan(generated.value()));
+    };
+    auto samples = FilterAndBuffer(int16_generator, num_samples);
+    if (!samples.has_value()) {
+      return std::nullopt;
+    }
+    return Int16ToUnit<float>(samples.value());
+  }
+
+  // Saves the buffered samples and the state of the filter. Returns false if
+  // the filter does not support this.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This filter can not save its state.";
+    return false;
+  }
+
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This filter can not restore its state.";
+    return false;
+  }
 };
 
 }  // namespace codec
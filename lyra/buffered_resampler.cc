@@ -20,12 +20,16 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
 #include "lyra/resampler.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -60,15 +64,39 @@ BufferedResampler::BufferedResampler(
   }
 }
 
-std::optional<std::vector<int16_t>> BufferedResampler::FilterAndBuffer(
-    const std::function<std::optional<std::vector<int16_t>>(int)>&
-        sample_generator,
+template <>
+std::vector<int16_t>* BufferedResampler::MutableLeftoverSamples<int16_t>() {
+  if (!float_leftover_samples_.empty()) {
+    const std::vector<int16_t> converted =
+        UnitToInt16(absl::MakeConstSpan(float_leftover_samples_));
+    leftover_samples_.insert(leftover_samples_.begin(), converted.begin(),
+                             converted.end());
+    float_leftover_samples_.clear();
+  }
+  return &leftover_samples_;
+}
+
+template <>
+std::vector<float>* BufferedResampler::MutableLeftoverSamples<float>() {
+  if (!leftover_samples_.empty()) {
+    const std::vector<float> converted =
+        Int16ToUnit<float>(leftover_samples_);
+    float_leftover_samples_.insert(float_leftover_samples_.begin(),
+                                   converted.begin(), converted.end());
+    leftover_samples_.clear();
+  }
+  return &float_leftover_samples_;
+}
+
+template <typename T>
+std::optional<std::vector<T>> BufferedResampler::FilterAndBufferOfType(
+    const std::function<std::optional<std::vector<T>>(int)>& sample_generator,
     int num_external_samples_requested) {
   const int num_internal_samples_to_generate =
       GetInternalNumSamplesToGenerate(num_external_samples_requested);
 
   // 1. If we have any leftover samples from last time we must use them.
-  std::vector<int16_t> samples(num_external_samples_requested);
+  std::vector<T> samples(num_external_samples_requested);
   const int num_leftover_used =
       UseLeftoverSamples(num_external_samples_requested, &samples);
 
@@ -80,8 +108,7 @@ std::optional<std::vector<int16_t>> BufferedResampler::FilterAndBuffer(
   CHECK_EQ(internal_samples->size(), num_internal_samples_to_generate);
 
   // 3. Resample the internal samples to produce new samples.
-  const std::vector<int16_t> external_samples =
-      Resample(internal_samples.value());
+  const std::vector<T> external_samples = Resample(internal_samples.value());
 
   // 4. Copy the new samples to output and the leftover buffers.
   CopyNewSamples(external_samples, num_external_samples_requested,
@@ -89,13 +116,57 @@ std::optional<std::vector<int16_t>> BufferedResampler::FilterAndBuffer(
   return samples;
 }
 
+std::optional<std::vector<int16_t>> BufferedResampler::FilterAndBuffer(
+    const std::function<std::optional<std::vector<int16_t>>(int)>&
+        sample_generator,
+    int num_external_samples_requested) {
+  return FilterAndBufferOfType(sample_generator,
+                               num_external_samples_requested);
+}
+
+std::optional<std::vector<float>> BufferedResampler::FilterAndBufferFloat(
+    const std::function<std::optional<std::vector<float>>(int)>&
+        sample_generator,
+    int num_external_samples_requested) {
+  return FilterAndBufferOfType(sample_generator,
+                               num_external_samples_requested);
+}
+
+bool BufferedResampler::SaveState(StateWriter* writer) const {
+  writer->WriteVector<int16_t>(leftover_samples_);
+  writer->WriteVector<float>(float_leftover_samples_);
+  return resampler_->SaveState(writer);
+}
+
+bool BufferedResampler::RestoreState(StateReader* reader) {
+  if (!reader->ReadVector(&leftover_samples_) ||
+      !reader->ReadVector(&float_leftover_samples_)) {
+    return false;
+  }
+  const int max_num_leftover_samples =
+      std::max(0, resampler_->target_sample_rate_hz() /
+                          resampler_->input_sample_rate_hz() -
+                      1);
+  if (leftover_samples_.size() + float_leftover_samples_.size() >
+      max_num_leftover_samples) {
+    LOG(ERROR) << "Expected at most " << max_num_leftover_samples
+               << " leftover samples, but got "
+               << leftover_samples_.size() + float_leftover_samples_.size()
+               << ".";
+    return false;
+  }
+  return resampler_->RestoreState(reader);
+}
+
 int BufferedResampler::GetInternalNumSamplesToGenerate(
     int num_external_samples_requested) const {
-  if (num_external_samples_requested <= leftover_samples_.size()) {
+  const int num_leftover_samples =
+      leftover_samples_.size() + float_leftover_samples_.size();
+  if (num_external_samples_requested <= num_leftover_samples) {
     return 0;
   }
   const int new_external_samples_needed =
-      num_external_samples_requested - leftover_samples_.size();
+      num_external_samples_requested - num_leftover_samples;
   const float resample_ratio =
       static_cast<float>(resampler_->target_sample_rate_hz()) /
       static_cast<float>(resampler_->input_sample_rate_hz());
@@ -104,33 +175,41 @@ int BufferedResampler::GetInternalNumSamplesToGenerate(
       static_cast<float>(new_external_samples_needed) / resample_ratio));
 }
 
+template <typename T>
 int BufferedResampler::UseLeftoverSamples(int num_external_samples_requested,
-                                          std::vector<int16_t>* samples) {
+                                          std::vector<T>* samples) {
+  std::vector<T>* leftover_samples = MutableLeftoverSamples<T>();
   const int num_leftover_used =
-      std::min(static_cast<int>(leftover_samples_.size()),
+      std::min(static_cast<int>(leftover_samples->size()),
                num_external_samples_requested);
-  std::move(leftover_samples_.begin(),
-            leftover_samples_.begin() + num_leftover_used, samples->begin());
-  std::move(leftover_samples_.begin() + num_leftover_used,
-            leftover_samples_.end(), leftover_samples_.begin());
-  leftover_samples_.resize(leftover_samples_.size() - num_leftover_used);
+  std::move(leftover_samples->begin(),
+            leftover_samples->begin() + num_leftover_used, samples->begin());
+  std::move(leftover_samples->begin() + num_leftover_used,
+            leftover_samples->end(), leftover_samples->begin());
+  leftover_samples->resize(leftover_samples->size() - num_leftover_used);
   return num_leftover_used;
 }
 
-std::vector<int16_t> BufferedResampler::Resample(
-    const std::vector<int16_t>& internal_samples) {
+template <typename T>
+std::vector<T> BufferedResampler::Resample(
+    const std::vector<T>& internal_samples) {
   // If the internal and external sample rates match, no need to do anything.
   if (resampler_->target_sample_rate_hz() ==
       resampler_->input_sample_rate_hz()) {
     return internal_samples;
   }
-  return resampler_->Resample(internal_samples);
+  if constexpr (std::is_same_v<T, float>) {
+    return resampler_->ResampleFloat(internal_samples);
+  } else {
+    return resampler_->Resample(internal_samples);
+  }
 }
 
-void BufferedResampler::CopyNewSamples(
-    const std::vector<int16_t>& external_samples,
-    int num_external_samples_requested, int num_leftover_used,
-    std::vector<int16_t>* samples) {
+template <typename T>
+void BufferedResampler::CopyNewSamples(const std::vector<T>& external_samples,
+                                       int num_external_samples_requested,
+                                       int num_leftover_used,
+                                       std::vector<T>* samples) {
   // Copy the needed samples to the destination, which already has some
   // leftover samples from the last run.
   const int num_samples_to_copy =
@@ -140,8 +219,9 @@ void BufferedResampler::CopyNewSamples(
             external_samples.begin() + num_samples_to_copy,
             samples->begin() + num_leftover_used);
 
-  // Store the rest in the |leftover_samples_|.
-  leftover_samples_.insert(leftover_samples_.end(),
+  // Store the rest in the leftover samples.
+  std::vector<T>* leftover_samples = MutableLeftoverSamples<T>();
+  leftover_samples->insert(leftover_samples->end(),
                            external_samples.begin() + num_samples_to_copy,
                            external_samples.end());
 }
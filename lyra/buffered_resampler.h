@@ -25,6 +25,7 @@
 
 #include "lyra/buffered_filter_interface.h"
 #include "lyra/resampler_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -45,9 +46,31 @@ class BufferedResampler : public BufferedFilterInterface {
           sample_generator,
       int num_external_samples_requested) override;
 
+  std::optional<std::vector<float>> FilterAndBufferFloat(
+      const std::function<std::optional<std::vector<float>>(int)>&
+          sample_generator,
+      int num_external_samples_requested) override;
+
+  // Saves the leftover samples and the state of the resampler.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
  private:
   explicit BufferedResampler(std::unique_ptr<ResamplerInterface> resampler);
 
+  // Shared by |FilterAndBuffer| and |FilterAndBufferFloat|.
+  template <typename T>
+  std::optional<std::vector<T>> FilterAndBufferOfType(
+      const std::function<std::optional<std::vector<T>>(int)>&
+          sample_generator,
+      int num_external_samples_requested);
+
+  // Returns the leftover samples of type |T|, after converting any leftover
+  // samples of the other type, which precede them.
+  template <typename T>
+  std::vector<T>* MutableLeftoverSamples();
+
   // Helper function to inform the generative model how many samples need to
   // be generated if a total of |num_external_samples_requested| are requested
   // upstream. Computed based on the number of leftover samples from previous
@@ -56,19 +79,25 @@ class BufferedResampler : public BufferedFilterInterface {
 
   // Use at most |num_external_samples_requested| from |leftover_samples_| to
   // fill the beginning of |samples|.
+  template <typename T>
   int UseLeftoverSamples(int num_external_samples_requested,
-                         std::vector<int16_t>* samples);
+                         std::vector<T>* samples);
 
-  std::vector<int16_t> Resample(const std::vector<int16_t>& internal_samples);
+  template <typename T>
+  std::vector<T> Resample(const std::vector<T>& internal_samples);
 
-  void CopyNewSamples(const std::vector<int16_t>& external_samples,
+  template <typename T>
+  void CopyNewSamples(const std::vector<T>& external_samples,
                       int num_external_samples_requested, int num_leftover_used,
-                      std::vector<int16_t>* samples);
+                      std::vector<T>* samples);
 
   // If the resample ratio is greater than 1, buffer at most
   // |external_sample_rate| / |internal_sample_rate_hz|/ - 1 leftover samples
   // from the last run. Otherwise this is unused.
   std::vector<int16_t> leftover_samples_;
+  // Leftover samples of |FilterAndBufferFloat|. Only one of the leftover
+  // buffers holds samples at a time.
+  std::vector<float> float_leftover_samples_;
 
   std::unique_ptr<ResamplerInterface> resampler_;
 
@@ -48,6 +48,17 @@ class BufferedResamplerPeer {
                                                 num_external_samples_requested);
   }
 
+  std::optional<std::vector<float>> FilterAndBufferFloat(
+      std::optional<std::vector<float>> new_split_samples,
+      int num_external_samples_requested) {
+    std::function<std::optional<std::vector<float>>(int)> sample_generator =
+        [&new_split_samples](int num_samples_to_generate)
+        -> std::optional<std::vector<float>> { return new_split_samples; };
+
+    return buffered_resampler_->FilterAndBufferFloat(
+        sample_generator, num_external_samples_requested);
+  }
+
   int GetInternalNumSamplesToGenerate(int num_external_samples_requested) {
     return buffered_resampler_->GetInternalNumSamplesToGenerate(
         num_external_samples_requested);
@@ -203,6 +214,39 @@ TEST(BufferedResamplerTest, SubsequentFilterAndBufferUseLeftovers) {
   EXPECT_EQ(result_1, expected_results_1);
 }
 
+TEST(BufferedResamplerTest, FloatAndInt16CallsShareLeftovers) {
+  auto mock_resampler =
+      std::make_unique<MockResampler>(kInternalSampleRateHz, 48000);
+  const std::vector<int16_t> internal_samples_0({0, 16384, -16384});
+  const std::vector<int16_t> resampled_samples_0(
+      {0, 0, 0, 16384, 16384, 16384, -16384, -16384, -16384});
+  const std::vector<float> internal_samples_1({0.25f, -0.25f});
+  const std::vector<float> resampled_samples_1(
+      {0.25f, 0.25f, 0.25f, -0.25f, -0.25f, -0.25f});
+  const std::vector<float> expected_results_1(
+      {-0.5f, -0.5f, 0.25f, 0.25f, 0.25f, -0.25f, -0.25f, -0.25f});
+
+  {  // Enforce mocks are called in a specific order.
+    ::testing::InSequence in;
+    EXPECT_CALL(*mock_resampler,
+                Resample(absl::MakeConstSpan(internal_samples_0)))
+        .WillOnce(Return(resampled_samples_0));
+    EXPECT_CALL(*mock_resampler,
+                ResampleFloat(absl::MakeConstSpan(internal_samples_1)))
+        .WillOnce(Return(resampled_samples_1));
+  }
+  BufferedResamplerPeer buffered_resampler_peer(std::move(mock_resampler));
+
+  ASSERT_TRUE(
+      buffered_resampler_peer.FilterAndBuffer(internal_samples_0, 7)
+          .has_value());
+  // The two int16 leftovers count towards the samples of a float call.
+  EXPECT_EQ(2, buffered_resampler_peer.GetInternalNumSamplesToGenerate(8));
+  auto result_1 =
+      buffered_resampler_peer.FilterAndBufferFloat(internal_samples_1, 8);
+  EXPECT_EQ(result_1, expected_results_1);
+}
+
 class BufferedResamplerSampleRatesTest : public testing::TestWithParam<int> {
  protected:
   BufferedResamplerSampleRatesTest() : external_sample_rate_hz_(GetParam()) {}
@@ -50,6 +50,10 @@ ABSL_FLAG(chromemedia::codec::PacketLossPattern, fixed_packet_loss_pattern,
           "bursts will be rounded up to the nearest packet duration boundary. "
           "If this flag contains a nonzero number of values we ignore "
           "|packet_loss_rate| and |average_burst_length|.");
+ABSL_FLAG(int, num_segments, 1,
+          "Number of segments to split the packets into and decode in "
+          "parallel, one thread each. Output differs slightly from serial "
+          "decoding at the segment boundaries.");
 ABSL_FLAG(std::string, model_path, "lyra/model_coeffs",
           "Path to directory containing TFLite files. For mobile this is the "
           "absolute path, like "
@@ -102,7 +106,8 @@ int main(int argc, char** argv) {
   if (!chromemedia::codec::DecodeFile(encoded_path, output_path, sample_rate_hz,
                                       bitrate, randomize_num_samples_requested,
                                       packet_loss_rate, average_burst_length,
-                                      fixed_packet_loss_pattern, model_path)) {
+                                      fixed_packet_loss_pattern, model_path,
+                                      absl::GetFlag(FLAGS_num_segments))) {
     LOG(ERROR) << "Could not decode " << encoded_path;
     return -1;
   }
@@ -16,16 +16,15 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <fstream>
-#include <iterator>
 #include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
-#include <type_traits>
+#include <system_error>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "absl/flags/marshalling.h"
+#include "absl/functional/function_ref.h"
 #include "absl/random/bit_gen_ref.h"
 #include "absl/random/random.h"
 #include "absl/status/status.h"
@@ -38,7 +37,11 @@
 #include "lyra/fixed_packet_loss_model.h"
 #include "lyra/gilbert_model.h"
 #include "lyra/lyra_config.h"
+#include "lyra/lyra_container.h"
 #include "lyra/lyra_decoder.h"
+#include "lyra/packet_archive.h"
+#include "lyra/packet_stream.h"
+#include "lyra/segment_parallel_codec.h"
 #include "lyra/wav_utils.h"
 
 #ifdef __ANDROID__
@@ -172,54 +175,140 @@ bool decodeFeatures(const std::vector<uint8_t>& packet_stream, int packet_size,
   return true;
 }
 
+namespace {
+
+// Sets |encoded_packet|, unless |packet_loss_model| drops it, and appends the
+// hop it decodes to, or its concealment, to |decoded_audio|. An empty
+// |encoded_packet| stands for a hop that DTX did not send.
+bool DecodePacket(absl::Span<const uint8_t> encoded_packet, int frame_index,
+                  bool randomize_num_samples_requested, absl::BitGenRef gen,
+                  LyraDecoder* decoder,
+                  PacketLossModelInterface* packet_loss_model,
+                  std::vector<int16_t>* decoded_audio) {
+  const int num_samples_per_packet =
+      GetNumSamplesPerHop(decoder->sample_rate_hz());
+  const int64_t encoded_index =
+      static_cast<int64_t>(frame_index) * encoded_packet.size();
+  const float packet_start_seconds =
+      static_cast<float>(frame_index) / decoder->frame_rate();
+  // Losses are drawn for unsent hops too, so that they stay aligned in time.
+  const bool is_packet_received =
+      packet_loss_model == nullptr || packet_loss_model->IsPacketReceived();
+  if (encoded_packet.empty()) {
+    VLOG(1) << "No packet was sent at " << packet_start_seconds
+            << " seconds.";
+  } else if (is_packet_received) {
+    if (!decoder->SetEncodedPacket(encoded_packet)) {
+      LOG(ERROR) << "Unable to set encoded packet starting at byte "
+                 << encoded_index << " at time " << packet_start_seconds
+                 << "s.";
+      return false;
+    }
+  } else {
+    VLOG(1) << "Decoding packet starting at " << packet_start_seconds
+            << "seconds in PLC mode.";
+  }
+  int samples_decoded_so_far = 0;
+  while (samples_decoded_so_far < num_samples_per_packet) {
+    int samples_to_request =
+        randomize_num_samples_requested
+            ? std::min(absl::Uniform<int>(absl::IntervalOpenClosed, gen, 0,
+                                          num_samples_per_packet),
+                       num_samples_per_packet - samples_decoded_so_far)
+            : num_samples_per_packet;
+    VLOG(1) << "Requesting " << samples_to_request << " samples for decoding.";
+    const std::optional<std::vector<int16_t>> decoded =
+        decoder->DecodeSamples(samples_to_request);
+    if (!decoded.has_value()) {
+      LOG(ERROR) << "Unable to decode features starting at byte "
+                 << encoded_index;
+      return false;
+    }
+    samples_decoded_so_far += decoded->size();
+    decoded_audio->insert(decoded_audio->end(), decoded.value().begin(),
+                          decoded.value().end());
+  }
+  return true;
+}
+
+std::unique_ptr<PacketLossModelInterface> CreatePacketLossModel(
+    int sample_rate_hz, float packet_loss_rate, float average_burst_length,
+    const PacketLossPattern& fixed_packet_loss_pattern) {
+  if (fixed_packet_loss_pattern.starts_.empty()) {
+    return GilbertModel::Create(packet_loss_rate, average_burst_length);
+  }
+  return std::make_unique<FixedPacketLossModel>(
+      sample_rate_hz, GetNumSamplesPerHop(sample_rate_hz),
+      fixed_packet_loss_pattern.starts_, fixed_packet_loss_pattern.durations_);
+}
+
+// Segments are decoded in parallel into one buffer, so all packets and the
+// decoded audio are held in memory.
+bool DecodeFileInSegments(
+    absl::FunctionRef<std::optional<absl::Span<const uint8_t>>()> read_packet,
+    int64_t num_packets, const ghc::filesystem::path& output_path,
+    int sample_rate_hz, int packet_size, bool randomize_num_samples_requested,
+    PacketLossModelInterface* packet_loss_model,
+    const ghc::filesystem::path& model_path, int num_segments) {
+  if (randomize_num_samples_requested) {
+    LOG(WARNING) << "Segments are decoded one hop at a time, ignoring "
+                    "randomize_num_samples_requested.";
+  }
+  std::vector<uint8_t> packet_stream;
+  packet_stream.reserve(num_packets * packet_size);
+  // Losses are drawn in stream order, so that they do not depend on the
+  // number of segments.
+  std::vector<bool> is_packet_received;
+  is_packet_received.reserve(num_packets);
+  while (true) {
+    const auto packet = read_packet();
+    if (!packet.has_value()) {
+      return false;
+    }
+    if (packet->empty()) {
+      break;
+    }
+    packet_stream.insert(packet_stream.end(), packet->begin(), packet->end());
+    is_packet_received.push_back(packet_loss_model->IsPacketReceived());
+  }
+
+  const auto benchmark_start = absl::Now();
+  const auto decoded_audio =
+      DecodeInSegments(packet_stream, packet_size, sample_rate_hz, model_path,
+                       is_packet_received, num_segments);
+  if (!decoded_audio.has_value()) {
+    return false;
+  }
+  const auto elapsed = absl::Now() - benchmark_start;
+  LOG(INFO) << "Elapsed seconds : " << absl::ToInt64Seconds(elapsed);
+  LOG(INFO) << "Samples per second : "
+            << decoded_audio->size() / absl::ToDoubleSeconds(elapsed);
+
+  absl::Status write_status = Write16BitWavFileFromVector(
+      output_path.string(), kNumChannels, sample_rate_hz, *decoded_audio);
+  if (!write_status.ok()) {
+    LOG(ERROR) << write_status;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
 bool DecodeFeatures(const std::vector<uint8_t>& packet_stream, int packet_size,
                     bool randomize_num_samples_requested, absl::BitGenRef gen,
                     LyraDecoder* decoder,
                     PacketLossModelInterface* packet_loss_model,
                     std::vector<int16_t>* decoded_audio) {
-  const int num_samples_per_packet =
-      GetNumSamplesPerHop(decoder->sample_rate_hz());
-
   const auto benchmark_start = absl::Now();
   for (int encoded_index = 0; encoded_index < packet_stream.size();
        encoded_index += packet_size) {
     const absl::Span<const uint8_t> encoded_packet =
         absl::MakeConstSpan(packet_stream.data() + encoded_index, packet_size);
-
-    const int frame_index = encoded_index / packet_size;
-    const float packet_start_seconds =
-        static_cast<float>(frame_index) / decoder->frame_rate();
-    std::optional<std::vector<int16_t>> decoded;
-    if (packet_loss_model == nullptr || packet_loss_model->IsPacketReceived()) {
-      if (!decoder->SetEncodedPacket(encoded_packet)) {
-        LOG(ERROR) << "Unable to set encoded packet starting at byte "
-                   << encoded_index << " at time " << packet_start_seconds
-                   << "s.";
-        return false;
-      }
-    } else {
-      VLOG(1) << "Decoding packet starting at " << packet_start_seconds
-              << "seconds in PLC mode.";
-    }
-    int samples_decoded_so_far = 0;
-    while (samples_decoded_so_far < num_samples_per_packet) {
-      int samples_to_request =
-          randomize_num_samples_requested
-              ? std::min(absl::Uniform<int>(absl::IntervalOpenClosed, gen, 0,
-                                            num_samples_per_packet),
-                         num_samples_per_packet - samples_decoded_so_far)
-              : num_samples_per_packet;
-      VLOG(1) << "Requesting " << samples_to_request
-              << " samples for decoding.";
-      decoded = decoder->DecodeSamples(samples_to_request);
-      if (!decoded.has_value()) {
-        LOG(ERROR) << "Unable to decode features starting at byte "
-                   << encoded_index;
-        return false;
-      }
-      samples_decoded_so_far += decoded->size();
-      decoded_audio->insert(decoded_audio->end(), decoded.value().begin(),
-                            decoded.value().end());
+    if (!DecodePacket(encoded_packet, encoded_index / packet_size,
+                      randomize_num_samples_requested, gen, decoder,
+                      packet_loss_model, decoded_audio)) {
+      return false;
     }
   }
 
@@ -235,75 +324,136 @@ bool DecodeFile(const ghc::filesystem::path& encoded_path,
                 int bitrate, bool randomize_num_samples_requested,
                 float packet_loss_rate, float average_burst_length,
                 const PacketLossPattern& fixed_packet_loss_pattern,
-                const ghc::filesystem::path& model_path) {
+                const ghc::filesystem::path& model_path, int num_segments) {
   auto decoder = LyraDecoder::Create(sample_rate_hz, kNumChannels, model_path);
   if (decoder == nullptr) {
     LOG(ERROR) << "Could not create lyra decoder.";
     return false;
   }
-  std::unique_ptr<PacketLossModelInterface> packet_loss_model;
-  if (fixed_packet_loss_pattern.starts_.empty()) {
-    packet_loss_model =
-        GilbertModel::Create(packet_loss_rate, average_burst_length);
-
-  } else {
-    packet_loss_model = std::make_unique<FixedPacketLossModel>(
-        sample_rate_hz, GetNumSamplesPerHop(sample_rate_hz),
-        fixed_packet_loss_pattern.starts_,
-        fixed_packet_loss_pattern.durations_);
-  }
+  std::unique_ptr<PacketLossModelInterface> packet_loss_model =
+      CreatePacketLossModel(sample_rate_hz, packet_loss_rate,
+                            average_burst_length, fixed_packet_loss_pattern);
   if (packet_loss_model == nullptr) {
     LOG(ERROR) << "Could not create packet loss simulator model.";
     return false;
   }
-  std::ifstream encoded_stream(encoded_path.string(), std::ios_base::binary);
-  if (!encoded_stream.is_open()) {
-    LOG(ERROR) << "Open on file " << encoded_path << " failed.";
+
+  // Containers and archives record the size of packets, so |bitrate| only
+  // applies to raw packet files.
+  std::unique_ptr<LyraContainerReader> container_reader;
+  std::unique_ptr<PacketArchiveReader> archive_reader;
+  std::unique_ptr<PacketFileReader> packet_reader;
+  int packet_size = BitrateToPacketSize(bitrate);
+  int64_t num_frames;
+  if (IsPacketArchive(encoded_path)) {
+    archive_reader = PacketArchiveReader::Create(encoded_path);
+    if (archive_reader == nullptr) {
+      return false;
+    }
+    packet_size = archive_reader->packet_size();
+    num_frames = archive_reader->num_packets();
+  } else if (IsLyraContainer(encoded_path)) {
+    container_reader = LyraContainerReader::Create(encoded_path);
+    if (container_reader == nullptr) {
+      return false;
+    }
+    num_frames = container_reader->num_frames();
+    if (num_segments > 1) {
+      LOG(WARNING) << "Containers are decoded serially, ignoring "
+                      "num_segments.";
+      num_segments = 1;
+    }
+  } else {
+    packet_reader = PacketFileReader::Create(encoded_path, packet_size);
+    if (packet_reader == nullptr) {
+      return false;
+    }
+    if (packet_reader->num_trailing_bytes() != 0) {
+      LOG(WARNING)
+          << "Read " << packet_reader->num_trailing_bytes()
+          << " bytes from file beyond the last complete packet. Ignoring the "
+             "excess bytes at the end and attempting to decode.";
+    }
+    num_frames = packet_reader->num_packets();
+  }
+  if (num_frames == 0) {
+    LOG(ERROR) << "File was empty or incomplete and truncated to empty size.";
     return false;
   }
 
-  std::string packet_stream_string{
-      std::istreambuf_iterator<char>(encoded_stream),
-      std::istreambuf_iterator<char>()};
-
-  const int packet_size = BitrateToPacketSize(bitrate);
-  const int stream_size_remainder = packet_stream_string.size() % packet_size;
-  if (stream_size_remainder != 0) {
-    LOG(WARNING)
-        << "Read " << packet_stream_string.size()
-        << " bytes from file, which has a remainder when divided by packet "
-           "size. Removing the excess bytes from the end and attempting to "
-           "decode.";
-    packet_stream_string = packet_stream_string.substr(
-        0, packet_stream_string.size() - stream_size_remainder);
+  const auto read_packet = [&]() {
+    if (container_reader != nullptr) {
+      return container_reader->ReadFrame();
+    }
+    if (archive_reader != nullptr) {
+      return archive_reader->Read();
+    }
+    return packet_reader->Read();
+  };
+
+  if (num_segments > 1) {
+    if (!DecodeFileInSegments(read_packet, num_frames, output_path,
+                              sample_rate_hz, packet_size,
+                              randomize_num_samples_requested,
+                              packet_loss_model.get(), model_path,
+                              num_segments)) {
+      LOG(ERROR) << "Unable to decode features for file " << encoded_path;
+      return false;
+    }
+    return true;
   }
-  if (packet_stream_string.empty()) {
-    LOG(ERROR) << "File was empty or incomplete and truncated to empty size.";
+
+  // Packets are read, decoded and written one at a time, so that memory
+  // does not grow with the length of the file.
+  absl::StatusOr<std::unique_ptr<WavFileWriter>> wav_writer =
+      WavFileWriter::Open(output_path.string(), decoder->num_channels(),
+                          decoder->sample_rate_hz());
+  if (!wav_writer.ok()) {
+    LOG(ERROR) << wav_writer.status();
     return false;
   }
-  std::vector<uint8_t> packet_stream(packet_stream_string.size());
-  std::transform(packet_stream_string.begin(), packet_stream_string.end(),
-                 packet_stream.begin(),
-                 [](char packet) { return static_cast<uint8_t>(packet); });
+  // Leaves no partial output behind.
+  const auto fail = [&]() {
+    LOG(ERROR) << "Unable to decode features for file " << encoded_path;
+    wav_writer->reset();
+    std::error_code error_code;
+    ghc::filesystem::remove(output_path, error_code);
+    return false;
+  };
 
-  std::vector<int16_t> decoded_audio;
-  // Use one |gen| across each file. Creating |gen| inside |DecodeFeatures|
+  // Use one |gen| across each file. Creating |gen| inside |DecodePacket|
   // would use the same pattern for each hop.
   absl::BitGen gen;
-  if (!DecodeFeatures(packet_stream, packet_size,
+  std::vector<int16_t> decoded_audio;
+  const auto benchmark_start = absl::Now();
+  for (int frame_index = 0; frame_index < num_frames; ++frame_index) {
+    const auto packet = read_packet();
+    if (!packet.has_value()) {
+      return fail();
+    }
+    decoded_audio.clear();
+    if (!DecodePacket(packet.value(), frame_index,
                       randomize_num_samples_requested, gen, decoder.get(),
                       packet_loss_model.get(), &decoded_audio)) {
-    LOG(ERROR) << "Unable to decode features for file " << encoded_path;
-    return false;
+      return fail();
+    }
+    const absl::Status write_status = (*wav_writer)->Write(decoded_audio);
+    if (!write_status.ok()) {
+      LOG(ERROR) << write_status;
+      return fail();
+    }
   }
-
-  absl::Status write_status =
-      Write16BitWavFileFromVector(output_path.string(), decoder->num_channels(),
-                                  decoder->sample_rate_hz(), decoded_audio);
-  if (!write_status.ok()) {
-    LOG(ERROR) << write_status;
-    return false;
+  const absl::Status close_status = (*wav_writer)->Close();
+  if (!close_status.ok()) {
+    LOG(ERROR) << close_status;
+    return fail();
   }
+
+  const auto elapsed = absl::Now() - benchmark_start;
+  LOG(INFO) << "Elapsed seconds : " << absl::ToInt64Seconds(elapsed);
+  LOG(INFO) << "Samples per second : "
+            << (*wav_writer)->num_samples_written() /
+                   absl::ToDoubleSeconds(elapsed);
   return true;
 }
 
@@ -70,12 +70,18 @@ bool decodeFeatures(const std::vector<uint8_t>& packet_stream, int packet_size,
 // |output_path| = "/tmp/lyra/file1_decoded.lyra"
 // Then successful decoding will write out the file
 // /tmp/lyra/encoded/file1_decoded.wav
+// With more than one segment the packets are split into |num_segments|
+// segments decoded in parallel, which differs slightly from serial decoding
+// at the segment boundaries. Containers and archives written by |EncodeFile|
+// are detected by their header, and |bitrate| is ignored for them. Containers
+// are always decoded serially.
 bool DecodeFile(const ghc::filesystem::path& encoded_path,
                 const ghc::filesystem::path& output_path, int sample_rate_hz,
                 int bitrate, bool randomize_num_samples_requested,
                 float packet_loss_rate, float average_burst_length,
                 const PacketLossPattern& fixed_packet_loss_pattern,
-                const ghc::filesystem::path& model_path);
+                const ghc::filesystem::path& model_path,
+                int num_segments = 1);
 
 }  // namespace codec
 }  // namespace chromemedia
@@ -26,6 +26,9 @@
 #include "gtest/gtest.h"
 #include "include/ghc/filesystem.hpp"
 #include "lyra/lyra_config.h"
+#include "lyra/lyra_container.h"
+#include "lyra/packet_archive.h"
+#include "lyra/packet_stream.h"
 #include "lyra/wav_utils.h"
 
 namespace chromemedia {
@@ -164,6 +167,52 @@ TEST_P(DecoderMainLibTest, TwoEncodedPacketsWithFixedPacketLoss) {
   EXPECT_EQ(NumSamplesInWavFile(output_path_), expected_num_samples);
 }
 
+TEST_P(DecoderMainLibTest, ContainerWithDtxFrames) {
+  SetInputOutputPath("two_encoded_packets_16khz");
+  const int packet_size = BitrateToPacketSize(6000);
+  auto packet_reader = PacketFileReader::Create(input_path_, packet_size);
+  ASSERT_NE(packet_reader, nullptr);
+  input_path_ = output_dir_ / "two_encoded_packets_container.lyra";
+  auto container_writer = LyraContainerWriter::Create(input_path_);
+  ASSERT_NE(container_writer, nullptr);
+  ASSERT_TRUE(container_writer->WriteFrame(packet_reader->Read().value()));
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(container_writer->WriteFrame({}));
+  }
+  ASSERT_TRUE(container_writer->WriteFrame(packet_reader->Read().value()));
+  ASSERT_TRUE(container_writer->Close());
+
+  // The bitrate does not apply to containers.
+  EXPECT_TRUE(DecodeFile(
+      input_path_, output_path_, sample_rate_hz_,
+      /*bitrate=*/3200, /*randomize_num_samples_requested=*/false,
+      /*packet_loss_rate=*/0.f,
+      /*average_burst_length=*/1.f, PacketLossPattern({}, {}), model_path_));
+  EXPECT_EQ(NumSamplesInWavFile(output_path_), 5 * num_samples_in_packet_);
+}
+
+TEST_P(DecoderMainLibTest, Archive) {
+  SetInputOutputPath("two_encoded_packets_16khz");
+  const int packet_size = BitrateToPacketSize(6000);
+  auto packet_reader = PacketFileReader::Create(input_path_, packet_size);
+  ASSERT_NE(packet_reader, nullptr);
+  input_path_ = output_dir_ / "two_encoded_packets_archive.lyra";
+  auto archive_writer = PacketArchiveWriter::Create(input_path_, packet_size);
+  ASSERT_NE(archive_writer, nullptr);
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(archive_writer->Write(packet_reader->Read().value()));
+  }
+  ASSERT_TRUE(archive_writer->Close());
+
+  // The bitrate does not apply to archives.
+  EXPECT_TRUE(DecodeFile(
+      input_path_, output_path_, sample_rate_hz_,
+      /*bitrate=*/3200, /*randomize_num_samples_requested=*/false,
+      /*packet_loss_rate=*/0.f,
+      /*average_burst_length=*/1.f, PacketLossPattern({}, {}), model_path_));
+  EXPECT_EQ(NumSamplesInWavFile(output_path_), 2 * num_samples_in_packet_);
+}
+
 INSTANTIATE_TEST_SUITE_P(SampleRates, DecoderMainLibTest,
                          testing::ValuesIn(kSupportedSampleRates));
 
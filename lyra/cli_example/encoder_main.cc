@@ -40,6 +40,23 @@ ABSL_FLAG(bool, enable_preprocessing, false,
 ABSL_FLAG(bool, enable_dtx, false,
           "Enables discontinuous transmission (DTX). DTX does not send packets "
           "when noise is detected.");
+ABSL_FLAG(int, num_threads, 1,
+          "Number of threads to encode with. With more than one thread the "
+          "encoder stages run in a pipeline, which produces the same output.");
+ABSL_FLAG(int, num_segments, 1,
+          "Number of segments to split the input into and encode in "
+          "parallel, one thread each. Takes precedence over --num_threads. "
+          "Output differs slightly from serial encoding at the segment "
+          "boundaries.");
+ABSL_FLAG(bool, container, false,
+          "Writes a seekable container that records the size of every "
+          "packet, including the empty packets of DTX, instead of "
+          "concatenated packets. The decoder detects containers by their "
+          "header. Can not be combined with --num_segments.");
+ABSL_FLAG(bool, archive, false,
+          "Writes a losslessly compressed archive of the packets instead of "
+          "concatenated packets, for storage. The decoder detects archives "
+          "by their header. Can not be combined with --container.");
 ABSL_FLAG(std::string, model_path, "lyra/model_coeffs",
           "Path to directory containing TFLite files. For mobile this is the "
           "absolute path, like "
@@ -68,6 +85,17 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  if (absl::GetFlag(FLAGS_container) && absl::GetFlag(FLAGS_archive)) {
+    LOG(ERROR) << "Flags --container and --archive are exclusive.";
+    return -1;
+  }
+  auto format = chromemedia::codec::EncodedFileFormat::kPackets;
+  if (absl::GetFlag(FLAGS_container)) {
+    format = chromemedia::codec::EncodedFileFormat::kContainer;
+  } else if (absl::GetFlag(FLAGS_archive)) {
+    format = chromemedia::codec::EncodedFileFormat::kArchive;
+  }
+
   std::error_code error_code;
   if (!ghc::filesystem::is_directory(output_dir, error_code)) {
     LOG(INFO) << "Creating non existent output dir " << output_dir;
@@ -82,7 +110,10 @@ int main(int argc, char** argv) {
 
   if (!chromemedia::codec::EncodeFile(input_path, output_path, bitrate,
                                       enable_preprocessing, enable_dtx,
-                                      model_path)) {
+                                      model_path,
+                                      absl::GetFlag(FLAGS_num_threads),
+                                      absl::GetFlag(FLAGS_num_segments),
+                                      format)) {
     LOG(ERROR) << "Failed to encode " << input_path;
     return -1;
   }
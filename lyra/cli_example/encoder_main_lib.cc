@@ -14,25 +14,28 @@
 
 #include "lyra/cli_example/encoder_main_lib.h"
 
-#include <algorithm>
 #include <cstdint>
-#include <fstream>
-#include <iterator>
 #include <memory>
 #include <optional>
+#include <system_error>  // NOLINT(build/c++11)
+#include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
 #include "lyra/lyra_config.h"
+#include "lyra/lyra_container.h"
 #include "lyra/lyra_encoder.h"
 #include "lyra/no_op_preprocessor.h"
+#include "lyra/packet_archive.h"
+#include "lyra/packet_stream.h"
+#include "lyra/pipelined_encoder.h"
+#include "lyra/segment_parallel_codec.h"
 #include "lyra/wav_utils.h"
 
 #ifdef __ANDROID__
@@ -56,6 +59,9 @@ namespace codec {
 
 static std::unique_ptr<LyraEncoder> encoder_;
 
+// Five seconds of audio at a time for the pipelined encoder.
+constexpr int kNumHopsPerPipelinedChunk = 250;
+
 void initialize_encoder(int sample_rate_hz, int num_channels, int bitrate,
                                      bool enable_dtx,
                                      const ghc::filesystem::path& model_path) {
@@ -139,12 +145,104 @@ bool encodeWav(const std::vector<int16_t>& wav_data,
   return true;
 }
 
+namespace {
+
+// Runs one analysis thread and |num_threads| - 1 quantizer threads.
+bool EncodeWavPipelined(const std::vector<int16_t>& wav_data, int num_channels,
+                        int sample_rate_hz, int bitrate,
+                        bool enable_preprocessing, bool enable_dtx,
+                        const ghc::filesystem::path& model_path,
+                        std::vector<uint8_t>* encoded_features,
+                        int num_threads) {
+  auto encoder = PipelinedEncoder::Create(
+      sample_rate_hz, num_channels, bitrate, enable_dtx, model_path,
+      /*num_quantizer_threads=*/num_threads - 1);
+  if (encoder == nullptr) {
+    LOG(ERROR) << "Could not create pipelined lyra encoder.";
+    LOGE("Could not create pipelined lyra encoder.");
+    return false;
+  }
+
+  const auto benchmark_start = absl::Now();
+
+  // The input is only copied if it is preprocessed.
+  absl::Span<const int16_t> audio = absl::MakeConstSpan(wav_data);
+  std::vector<int16_t> processed_data;
+  if (enable_preprocessing) {
+    processed_data = NoOpPreprocessor().Process(audio, sample_rate_hz);
+    audio = absl::MakeConstSpan(processed_data);
+  }
+  auto encoded = encoder->Encode(audio);
+  if (!encoded.has_value()) {
+    LOG(ERROR) << "Unable to encode features.";
+    return false;
+  }
+  encoded_features->insert(encoded_features->end(), encoded->begin(),
+                           encoded->end());
+
+  const auto elapsed = absl::Now() - benchmark_start;
+  LOG(INFO) << "Elapsed seconds : " << absl::ToInt64Seconds(elapsed);
+  LOG(INFO) << "Samples per second : "
+            << wav_data.size() / absl::ToDoubleSeconds(elapsed);
+  return true;
+}
+
+bool EncodeWavInSegments(const std::vector<int16_t>& wav_data,
+                         int num_channels, int sample_rate_hz, int bitrate,
+                         bool enable_preprocessing, bool enable_dtx,
+                         const ghc::filesystem::path& model_path,
+                         std::vector<uint8_t>* encoded_features,
+                         int num_segments) {
+  if (num_channels != kNumChannels) {
+    LOG(ERROR) << num_channels << " channels are not supported.";
+    return false;
+  }
+
+  const auto benchmark_start = absl::Now();
+
+  // The input is only copied if it is preprocessed.
+  absl::Span<const int16_t> audio = absl::MakeConstSpan(wav_data);
+  std::vector<int16_t> processed_data;
+  if (enable_preprocessing) {
+    processed_data = NoOpPreprocessor().Process(audio, sample_rate_hz);
+    audio = absl::MakeConstSpan(processed_data);
+  }
+  auto encoded = EncodeInSegments(audio, sample_rate_hz, bitrate, enable_dtx,
+                                  model_path, num_segments);
+  if (!encoded.has_value()) {
+    LOG(ERROR) << "Unable to encode features in " << num_segments
+               << " segments.";
+    return false;
+  }
+  encoded_features->insert(encoded_features->end(), encoded->begin(),
+                           encoded->end());
+
+  const auto elapsed = absl::Now() - benchmark_start;
+  LOG(INFO) << "Elapsed seconds : " << absl::ToInt64Seconds(elapsed);
+  LOG(INFO) << "Samples per second : "
+            << wav_data.size() / absl::ToDoubleSeconds(elapsed);
+  return true;
+}
+
+}  // namespace
+
 // Packets are appended to encoded_features. The oldest packet is encoded
 // starting at index 0.
 bool EncodeWav(const std::vector<int16_t>& wav_data, int num_channels,
                int sample_rate_hz, int bitrate, bool enable_preprocessing,
                bool enable_dtx, const ghc::filesystem::path& model_path,
-               std::vector<uint8_t>* encoded_features) {
+               std::vector<uint8_t>* encoded_features, int num_threads,
+               int num_segments) {
+  if (num_segments > 1) {
+    return EncodeWavInSegments(wav_data, num_channels, sample_rate_hz,
+                               bitrate, enable_preprocessing, enable_dtx,
+                               model_path, encoded_features, num_segments);
+  }
+  if (num_threads > 1) {
+    return EncodeWavPipelined(wav_data, num_channels, sample_rate_hz, bitrate,
+                              enable_preprocessing, enable_dtx, model_path,
+                              encoded_features, num_threads);
+  }
   auto encoder = LyraEncoder::Create(/*sample_rate_hz=*/sample_rate_hz,
                                      /*num_channels=*/num_channels,
                                      /*bitrate=*/bitrate,
@@ -163,21 +261,23 @@ bool EncodeWav(const std::vector<int16_t>& wav_data, int num_channels,
 
   const auto benchmark_start = absl::Now();
 
-  std::vector<int16_t> processed_data(wav_data);
+  // The input is only copied if it is preprocessed.
+  absl::Span<const int16_t> audio = absl::MakeConstSpan(wav_data);
+  std::vector<int16_t> processed_data;
   if (enable_preprocessing) {
-    processed_data = preprocessor->Process(
-        absl::MakeConstSpan(wav_data.data(), wav_data.size()), sample_rate_hz);
+    processed_data = preprocessor->Process(audio, sample_rate_hz);
+    audio = absl::MakeConstSpan(processed_data);
   }
 
   const int num_samples_per_packet = sample_rate_hz / encoder->frame_rate();
   // Iterate over the wav data until the end of the vector.
   for (int wav_iterator = 0;
-       wav_iterator + num_samples_per_packet <= processed_data.size();
+       wav_iterator + num_samples_per_packet <= audio.size();
        wav_iterator += num_samples_per_packet) {
     // Move audio samples from the large in memory wav file frame by frame to
     // the encoder.
-    auto encoded = encoder->Encode(absl::MakeConstSpan(
-        &processed_data.at(wav_iterator), num_samples_per_packet));
+    auto encoded =
+        encoder->Encode(audio.subspan(wav_iterator, num_samples_per_packet));
     if (!encoded.has_value()) {
       LOG(ERROR) << "Unable to encode features starting at samples at byte "
                  << wav_iterator << ".";
@@ -197,42 +297,199 @@ bool EncodeWav(const std::vector<int16_t>& wav_data, int num_channels,
   return true;
 }
 
-bool EncodeFile(const ghc::filesystem::path& wav_path,
-                const ghc::filesystem::path& output_path, int bitrate,
-                bool enable_preprocessing, bool enable_dtx,
-                const ghc::filesystem::path& model_path) {
-  // Reads the entire wav file into memory.
+namespace {
+
+// Segments are encoded from random positions in the input, so the whole file
+// is read into memory.
+bool EncodeFileInSegments(const ghc::filesystem::path& wav_path,
+                          const ghc::filesystem::path& output_path,
+                          int bitrate, bool enable_preprocessing,
+                          bool enable_dtx,
+                          const ghc::filesystem::path& model_path,
+                          int num_segments, EncodedFileFormat format) {
   absl::StatusOr<ReadWavResult> read_wav_result =
       Read16BitWavFileToVector(wav_path.string());
-
   if (!read_wav_result.ok()) {
     LOG(ERROR) << read_wav_result.status();
     return false;
   }
 
-  // Keep an accumulator vector of all the encoded features to write to file.
   std::vector<uint8_t> encoded_features;
   if (!EncodeWav(read_wav_result->samples, read_wav_result->num_channels,
                  read_wav_result->sample_rate_hz, bitrate, enable_preprocessing,
-                 enable_dtx, model_path, &encoded_features)) {
+                 enable_dtx, model_path, &encoded_features,
+                 /*num_threads=*/1, num_segments)) {
     LOG(ERROR) << "Unable to encode features for file " << wav_path;
     LOGE("Unable to encode features for file %s", wav_path.string().c_str());
     return false;
   }
 
-  std::ofstream output_stream(output_path.string(),
-                              std::ios_base::binary | std::ios_base::trunc);
-  if (!output_stream.is_open()) {
-    LOG(ERROR) << "Could not open output file " << output_path;
+  if (format == EncodedFileFormat::kArchive) {
+    auto archive =
+        ArchivePackets(encoded_features, BitrateToPacketSize(bitrate));
+    if (!archive.has_value()) {
+      return false;
+    }
+    encoded_features = std::move(archive.value());
+  }
+  auto packet_writer = PacketFileWriter::Create(output_path);
+  if (packet_writer == nullptr) {
+    LOGE("Could not open output file %s", output_path.string().c_str());
+    return false;
+  }
+  return packet_writer->Write(encoded_features) && packet_writer->Close();
+}
+
+}  // namespace
+
+bool EncodeFile(const ghc::filesystem::path& wav_path,
+                const ghc::filesystem::path& output_path, int bitrate,
+                bool enable_preprocessing, bool enable_dtx,
+                const ghc::filesystem::path& model_path, int num_threads,
+                int num_segments, EncodedFileFormat format) {
+  if (num_segments > 1) {
+    if (format == EncodedFileFormat::kContainer) {
+      LOG(ERROR) << "Containers can not be written in segments.";
+      return false;
+    }
+    return EncodeFileInSegments(wav_path, output_path, bitrate,
+                                enable_preprocessing, enable_dtx, model_path,
+                                num_segments, format);
+  }
+
+  // Audio is read, encoded and written a chunk at a time, so that memory does
+  // not grow with the length of the file.
+  absl::StatusOr<std::unique_ptr<WavFileReader>> wav_reader =
+      WavFileReader::Open(wav_path.string());
+  if (!wav_reader.ok()) {
+    LOG(ERROR) << wav_reader.status();
+    return false;
+  }
+  const int sample_rate_hz = (*wav_reader)->sample_rate_hz();
+  const int num_channels = (*wav_reader)->num_channels();
+
+  std::unique_ptr<LyraEncoder> encoder;
+  std::unique_ptr<PipelinedEncoder> pipelined_encoder;
+  if (num_threads > 1) {
+    pipelined_encoder = PipelinedEncoder::Create(
+        sample_rate_hz, num_channels, bitrate, enable_dtx, model_path,
+        /*num_quantizer_threads=*/num_threads - 1);
+  } else {
+    encoder = LyraEncoder::Create(sample_rate_hz, num_channels, bitrate,
+                                  enable_dtx, model_path);
+  }
+  if (encoder == nullptr && pipelined_encoder == nullptr) {
+    LOG(ERROR) << "Could not create lyra encoder.";
+    LOGE("Could not create lyra encoder.");
+    return false;
+  }
+
+  std::unique_ptr<PacketFileWriter> packet_writer;
+  std::unique_ptr<LyraContainerWriter> container_writer;
+  std::unique_ptr<PacketArchiveWriter> archive_writer;
+  switch (format) {
+    case EncodedFileFormat::kPackets:
+      packet_writer = PacketFileWriter::Create(output_path);
+      break;
+    case EncodedFileFormat::kContainer:
+      container_writer = LyraContainerWriter::Create(output_path);
+      break;
+    case EncodedFileFormat::kArchive:
+      archive_writer = PacketArchiveWriter::Create(
+          output_path, BitrateToPacketSize(bitrate));
+      break;
+  }
+  if (packet_writer == nullptr && container_writer == nullptr &&
+      archive_writer == nullptr) {
     LOGE("Could not open output file %s", output_path.string().c_str());
     return false;
   }
-  absl::string_view encoded_data(
-      reinterpret_cast<const char*>(encoded_features.data()),
-      encoded_features.size());
-  std::ostreambuf_iterator<char> output_iterator(output_stream);
-  std::copy(encoded_data.begin(), encoded_data.end(), output_iterator);
+  const auto write_packet = [&](absl::Span<const uint8_t> packet) {
+    if (container_writer != nullptr) {
+      return container_writer->WriteFrame(packet);
+    }
+    if (archive_writer != nullptr) {
+      return packet.empty() || archive_writer->Write(packet);
+    }
+    return packet_writer->Write(packet);
+  };
+  const auto close = [&]() {
+    if (container_writer != nullptr) {
+      return container_writer->Close();
+    }
+    if (archive_writer != nullptr) {
+      return archive_writer->Close();
+    }
+    return packet_writer->Close();
+  };
+  // Leaves no partial output behind.
+  const auto fail = [&]() {
+    LOG(ERROR) << "Unable to encode features for file " << wav_path;
+    LOGE("Unable to encode features for file %s", wav_path.string().c_str());
+    packet_writer.reset();
+    container_writer.reset();
+    archive_writer.reset();
+    std::error_code error_code;
+    ghc::filesystem::remove(output_path, error_code);
+    return false;
+  };
+
+  const auto benchmark_start = absl::Now();
+  // The pipelined encoder needs many hops at a time to keep its threads busy.
+  const int num_hops_per_chunk =
+      pipelined_encoder != nullptr ? kNumHopsPerPipelinedChunk : 1;
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz);
+  std::vector<int16_t> chunk(num_hops_per_chunk * num_samples_per_hop);
+  int64_t num_samples_encoded = 0;
+  while (true) {
+    const absl::StatusOr<int> num_samples_read =
+        (*wav_reader)->Read(absl::MakeSpan(chunk));
+    if (!num_samples_read.ok()) {
+      LOG(ERROR) << num_samples_read.status();
+      return fail();
+    }
+    // Like |EncodeWav|, drops an incomplete hop at the end.
+    const int num_samples_to_encode =
+        *num_samples_read / num_samples_per_hop * num_samples_per_hop;
+    if (num_samples_to_encode == 0) {
+      break;
+    }
+    absl::Span<const int16_t> audio =
+        absl::MakeConstSpan(chunk.data(), num_samples_to_encode);
+    std::vector<int16_t> processed_data;
+    if (enable_preprocessing) {
+      processed_data = NoOpPreprocessor().Process(audio, sample_rate_hz);
+      audio = absl::MakeConstSpan(processed_data);
+    }
+    std::optional<std::vector<std::vector<uint8_t>>> packets;
+    if (pipelined_encoder != nullptr) {
+      packets = pipelined_encoder->EncodePackets(audio);
+    } else if (auto encoded = encoder->Encode(audio); encoded.has_value()) {
+      packets.emplace(1, std::move(encoded.value()));
+    }
+    if (!packets.has_value()) {
+      LOG(ERROR) << "Unable to encode features starting at sample "
+                 << num_samples_encoded << ".";
+      return fail();
+    }
+    for (const auto& packet : *packets) {
+      if (!write_packet(packet)) {
+        return fail();
+      }
+    }
+    num_samples_encoded += num_samples_to_encode;
+    if (*num_samples_read < chunk.size()) {
+      break;
+    }
+  }
+  if (!close()) {
+    return fail();
+  }
 
+  const auto elapsed = absl::Now() - benchmark_start;
+  LOG(INFO) << "Elapsed seconds : " << absl::ToInt64Seconds(elapsed);
+  LOG(INFO) << "Samples per second : "
+            << num_samples_encoded / absl::ToDoubleSeconds(elapsed);
   return true;
 }
 
@@ -38,19 +38,39 @@ bool encodeWav(const std::vector<int16_t>& wav_data,
                std::vector<uint8_t>* encoded_features);
 
 // Encodes a vector of wav_data into encoded_features.
-// Uses the quant files located under |model_path|.
+// Uses the quant files located under |model_path|. With more than one thread
+// the stages of the encoder run in a pipeline on |num_threads| threads, which
+// produces the same bytes faster. With more than one segment the audio is
+// instead split into |num_segments| segments encoded in parallel, which
+// scales further at a small cost in quality at the segment boundaries.
 bool EncodeWav(const std::vector<int16_t>& wav_data, int num_channels,
                int sample_rate_hz, int bitrate, bool enable_preprocessing,
                bool enable_dtx, const ghc::filesystem::path& model_path,
-               std::vector<uint8_t>* encoded_features);
+               std::vector<uint8_t>* encoded_features, int num_threads = 1,
+               int num_segments = 1);
+
+// Layout of the file written by |EncodeFile|.
+enum class EncodedFileFormat {
+  // Concatenated packets of one size. The empty packets of DTX hops are lost.
+  kPackets,
+  // A seekable container, see lyra_container.h, which keeps the size of
+  // every packet.
+  kContainer,
+  // A losslessly compressed archive of the packets, see packet_archive.h.
+  // The empty packets of DTX hops are lost as with |kPackets|.
+  kArchive,
+};
 
 // Encodes a wav file into an encoded feature file. Encodes num_samples from the
 // file at |wav_path| and writes the encoded features out to |output_path|.
-// Uses the quant files located under |model_path|.
+// Uses the quant files located under |model_path|. Containers can not be
+// written in segments.
 bool EncodeFile(const ghc::filesystem::path& wav_path,
                 const ghc::filesystem::path& output_path, int bitrate,
                 bool enable_preprocessing, bool enable_dtx,
-                const ghc::filesystem::path& model_path);
+                const ghc::filesystem::path& model_path, int num_threads = 1,
+                int num_segments = 1,
+                EncodedFileFormat format = EncodedFileFormat::kPackets);
 
 }  // namespace codec
 }  // namespace chromemedia
@@ -14,8 +14,12 @@
 
 #include "lyra/cli_example/encoder_main_lib.h"
 
+#include <cstdint>
+#include <fstream>
+#include <iterator>
 #include <string>
 #include <system_error>  // NOLINT(build/c++11)
+#include <vector>
 
 // Placeholder for get runfiles header.
 // Placeholder for testing header.
@@ -23,6 +27,7 @@
 #include "absl/strings/string_view.h"
 #include "gtest/gtest.h"
 #include "include/ghc/filesystem.hpp"
+#include "lyra/packet_archive.h"
 
 namespace chromemedia {
 namespace codec {
@@ -79,6 +84,28 @@ TEST_F(EncoderMainLibTest, EncodeSingleWavFiles) {
   }
 }
 
+TEST_F(EncoderMainLibTest, ArchiveRestoresPackets) {
+  const auto input_path = testdata_dir_ / "sample1_16kHz.wav";
+  const auto packets_path = output_dir_ / "packets.lyra";
+  const auto archive_path = output_dir_ / "archive.lyra";
+  ASSERT_TRUE(EncodeFile(input_path, packets_path, /*bitrate=*/3200,
+                         /*enable_preprocessing=*/false,
+                         /*enable_dtx=*/false, model_path_));
+  ASSERT_TRUE(EncodeFile(input_path, archive_path, /*bitrate=*/3200,
+                         /*enable_preprocessing=*/false,
+                         /*enable_dtx=*/false, model_path_,
+                         /*num_threads=*/1, /*num_segments=*/1,
+                         EncodedFileFormat::kArchive));
+
+  const auto read_file = [](const ghc::filesystem::path& path) {
+    std::ifstream stream(path.string(), std::ios_base::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), {});
+  };
+  const auto restored = RestorePackets(read_file(archive_path));
+  ASSERT_TRUE(restored.has_value());
+  EXPECT_EQ(restored.value(), read_file(packets_path));
+}
+
 }  // namespace
 }  // namespace codec
 }  // namespace chromemedia
@@ -31,6 +31,7 @@
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "lyra/dsp_utils.h"
 #include "lyra/log_mel_spectrogram_extractor_impl.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -84,6 +85,16 @@ std::optional<std::vector<int16_t>> ComfortNoiseGenerator::RunModel(
       reconstructed_samples_.begin() + next_sample_in_hop() + num_samples);
 }
 
+bool ComfortNoiseGenerator::SaveModelState(StateWriter* writer) const {
+  writer->WriteVector<int16_t>(reconstructed_samples_);
+  return true;
+}
+
+bool ComfortNoiseGenerator::RestoreModelState(StateReader* reader) {
+  return reader->ReadVectorOfSize(num_samples_per_hop(),
+                                  &reconstructed_samples_);
+}
+
 void ComfortNoiseGenerator::FftFromFeatures(
     const std::vector<float>& log_mel_features) {
   std::vector<double> mel_features(log_mel_features.size());
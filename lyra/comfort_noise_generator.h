@@ -25,6 +25,7 @@
 #include "audio/dsp/mfcc/mel_filterbank.h"
 #include "audio/dsp/spectrogram/inverse_spectrogram.h"
 #include "lyra/generative_model_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -50,6 +51,12 @@ class ComfortNoiseGenerator : public GenerativeModel {
 
   std::optional<std::vector<int16_t>> RunModel(int num_samples) override;
 
+  // Saves the samples of the current hop. The noise of the following hops
+  // has a random phase, so it only depends on the queued features.
+  bool SaveModelState(StateWriter* writer) const override;
+
+  bool RestoreModelState(StateReader* reader) override;
+
   // Estimates the Squared-Magnitude FFT that corresponds to the Log Mel
   // features. Returns true if the estimation completed successfully and false
   // otherwise.
@@ -0,0 +1,219 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/conference_mixer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder_interface.h"
+#include "lyra/resampler.h"
+#include "lyra/resampler_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Plain loops over raw pointers, so that the compiler vectorizes them.
+void Accumulate(absl::Span<const int16_t> samples,
+                std::vector<int32_t>* accumulator) {
+  const int16_t* in = samples.data();
+  int32_t* out = accumulator->data();
+  const int size = samples.size();
+  for (int i = 0; i < size; ++i) {
+    out[i] += in[i];
+  }
+}
+
+// Returns |minuend| - |subtrahend| saturated to int16. |subtrahend| may be
+// empty, in which case |minuend| is only saturated.
+std::vector<int16_t> SaturatedDifference(absl::Span<const int32_t> minuend,
+                                         absl::Span<const int16_t> subtrahend) {
+  constexpr int32_t kMin = std::numeric_limits<int16_t>::min();
+  constexpr int32_t kMax = std::numeric_limits<int16_t>::max();
+  std::vector<int16_t> difference(minuend.size());
+  const int32_t* a = minuend.data();
+  int16_t* out = difference.data();
+  const int size = minuend.size();
+  if (subtrahend.empty()) {
+    for (int i = 0; i < size; ++i) {
+      out[i] = std::clamp(a[i], kMin, kMax);
+    }
+  } else {
+    const int16_t* b = subtrahend.data();
+    for (int i = 0; i < size; ++i) {
+      out[i] = std::clamp(a[i] - b[i], kMin, kMax);
+    }
+  }
+  return difference;
+}
+
+}  // namespace
+
+const std::vector<int16_t>& ConferenceMix::ForListener(int stream_id) const {
+  const auto it = mix_minus.find(stream_id);
+  return it == mix_minus.end() ? mix : it->second;
+}
+
+std::unique_ptr<ConferenceMixer> ConferenceMixer::Create(
+    int output_sample_rate_hz) {
+  if (!IsSampleRateSupported(output_sample_rate_hz)) {
+    LOG(ERROR) << "Sample rate " << output_sample_rate_hz
+               << " Hz is not supported.";
+    return nullptr;
+  }
+  int num_flush_samples = 0;
+  if (output_sample_rate_hz != kInternalSampleRateHz) {
+    auto resampler =
+        Resampler::Create(kInternalSampleRateHz, output_sample_rate_hz);
+    if (resampler == nullptr) {
+      return nullptr;
+    }
+    num_flush_samples = ConvertNumSamplesBetweenSampleRate(
+        resampler->samples_until_steady_state(), output_sample_rate_hz,
+        kInternalSampleRateHz);
+  }
+  // After this many input samples all resamplers reach the same phase, so
+  // every stream produces the same number of output samples, whenever its
+  // resampler was created.
+  const int resampling_period =
+      kInternalSampleRateHz /
+      std::gcd(kInternalSampleRateHz, output_sample_rate_hz);
+  return absl::WrapUnique(new ConferenceMixer(
+      output_sample_rate_hz, resampling_period, num_flush_samples));
+}
+
+ConferenceMixer::ConferenceMixer(int output_sample_rate_hz,
+                                 int resampling_period, int num_flush_samples)
+    : output_sample_rate_hz_(output_sample_rate_hz),
+      resampling_period_(resampling_period),
+      num_flush_samples_(num_flush_samples),
+      next_stream_id_(0) {}
+
+int ConferenceMixer::AddStream(std::unique_ptr<LyraDecoderInterface> decoder) {
+  if (decoder == nullptr) {
+    LOG(ERROR) << "Cannot add a stream without a decoder.";
+    return -1;
+  }
+  if (decoder->sample_rate_hz() != kInternalSampleRateHz ||
+      decoder->num_channels() != 1) {
+    LOG(ERROR) << "Mixed streams have to be mono at " << kInternalSampleRateHz
+               << " Hz, but the decoder outputs " << decoder->num_channels()
+               << " channels at " << decoder->sample_rate_hz() << " Hz.";
+    return -1;
+  }
+  std::unique_ptr<ResamplerInterface> resampler;
+  if (output_sample_rate_hz_ != kInternalSampleRateHz) {
+    resampler =
+        Resampler::Create(kInternalSampleRateHz, output_sample_rate_hz_);
+    if (resampler == nullptr) {
+      return -1;
+    }
+  }
+  const int stream_id = next_stream_id_++;
+  streams_[stream_id] = {std::move(decoder), std::move(resampler),
+                         /*has_new_packet=*/false,
+                         /*num_samples_to_flush=*/0};
+  return stream_id;
+}
+
+bool ConferenceMixer::RemoveStream(int stream_id) {
+  return streams_.erase(stream_id) > 0;
+}
+
+bool ConferenceMixer::SetEncodedPacket(int stream_id,
+                                       absl::Span<const uint8_t> encoded) {
+  const auto it = streams_.find(stream_id);
+  if (it == streams_.end()) {
+    LOG(ERROR) << "There is no stream " << stream_id << ".";
+    return false;
+  }
+  if (!it->second.decoder->SetEncodedPacket(encoded)) {
+    return false;
+  }
+  it->second.has_new_packet = true;
+  return true;
+}
+
+std::optional<ConferenceMix> ConferenceMixer::Mix(int num_samples) {
+  if (num_samples < 0 || num_samples % resampling_period_ != 0) {
+    LOG(ERROR) << "The number of samples to mix (" << num_samples
+               << ") has to be a non-negative multiple of "
+               << resampling_period_ << ".";
+    return std::nullopt;
+  }
+  const int num_output_samples = ConvertNumSamplesBetweenSampleRate(
+      num_samples, kInternalSampleRateHz, output_sample_rate_hz_);
+
+  accumulator_.assign(num_output_samples, 0);
+  absl::flat_hash_map<int, std::vector<int16_t>> own_samples;
+  for (auto& [stream_id, stream] : streams_) {
+    std::vector<int16_t> samples;
+    // Comfort noise from every silent participant would only add up to a
+    // noise floor, so those streams are left out until they talk again.
+    if (!stream.decoder->is_comfort_noise() || stream.has_new_packet) {
+      std::optional<std::vector<int16_t>> decoded =
+          stream.decoder->DecodeSamples(num_samples);
+      if (!decoded.has_value()) {
+        LOG(ERROR) << "Could not decode stream " << stream_id << ".";
+        return std::nullopt;
+      }
+      stream.has_new_packet = false;
+      samples = std::move(decoded.value());
+      if (stream.resampler != nullptr) {
+        samples = stream.resampler->Resample(samples);
+        stream.num_samples_to_flush = num_flush_samples_;
+      }
+    } else if (stream.num_samples_to_flush > 0) {
+      // The resampler of the stream still holds the tail of its last mixed
+      // samples, which has to reach the mix.
+      samples =
+          stream.resampler->Resample(std::vector<int16_t>(num_samples, 0));
+      stream.num_samples_to_flush -= num_samples;
+    } else {
+      continue;
+    }
+    if (samples.size() != num_output_samples) {
+      LOG(ERROR) << "Stream " << stream_id << " produced " << samples.size()
+                 << " samples instead of " << num_output_samples << ".";
+      return std::nullopt;
+    }
+    Accumulate(samples, &accumulator_);
+    own_samples[stream_id] = std::move(samples);
+  }
+
+  // Saturation only happens here, so that a mix minus does not inherit the
+  // clipping of the full mix.
+  ConferenceMix result;
+  result.mix = SaturatedDifference(accumulator_, {});
+  for (const auto& [stream_id, samples] : own_samples) {
+    result.mix_minus[stream_id] = SaturatedDifference(accumulator_, samples);
+  }
+  return result;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_CONFERENCE_MIXER_H_
+#define LYRA_CONFERENCE_MIXER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "lyra/lyra_decoder_interface.h"
+#include "lyra/resampler_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// The output of one |ConferenceMixer::Mix| call.
+struct ConferenceMix {
+  // All mixed streams, for the listeners whose own stream was not mixed.
+  std::vector<int16_t> mix;
+  // All mixed streams but the listener's own, keyed by the id of each stream
+  // that was mixed or whose resampled tail still reaches the output.
+  absl::flat_hash_map<int, std::vector<int16_t>> mix_minus;
+
+  // Returns what the listener of |stream_id| should hear.
+  const std::vector<int16_t>& ForListener(int stream_id) const;
+};
+
+// Decodes and mixes the streams of a conference for all of its participants.
+//
+// Streams are decoded at |kInternalSampleRateHz|. Streams whose decoders are
+// in pure comfort noise and that received no packet since the previous mix
+// are neither decoded nor mixed, nor resampled. Each mixed stream is
+// resampled to the output sample rate once, and summed into a wide
+// accumulator that is only saturated when the outputs are taken from it.
+// Each participant hears the mix minus their own stream, which is the
+// accumulator minus their resampled stream, so no mix is resampled or
+// decoded twice. With one talker among N participants that is a single
+// resampling pass instead of one per decoder. Participants whose stream was
+// not mixed share the full mix.
+class ConferenceMixer {
+ public:
+  // Returns a nullptr if |output_sample_rate_hz| is not supported.
+  static std::unique_ptr<ConferenceMixer> Create(int output_sample_rate_hz);
+
+  // Adds the stream decoded by |decoder|, which has to output mono audio at
+  // |kInternalSampleRateHz|. Returns the id of the stream, or -1 on failure.
+  int AddStream(std::unique_ptr<LyraDecoderInterface> decoder);
+
+  // Returns false if there is no stream |stream_id|.
+  bool RemoveStream(int stream_id);
+
+  // Passes |encoded| to the decoder of |stream_id|. Returns false if there is
+  // no such stream or the decoder rejects the packet.
+  bool SetEncodedPacket(int stream_id, absl::Span<const uint8_t> encoded);
+
+  // Decodes |num_samples| samples at |kInternalSampleRateHz| from each stream
+  // and mixes them. |num_samples| has to be a multiple of the number of input
+  // samples after which the resampling phase repeats, which is 2 for an
+  // output of 8 kHz and 1 for the other supported rates. Returns a nullopt if
+  // that is not the case, or a decoder or resampler fails.
+  std::optional<ConferenceMix> Mix(int num_samples);
+
+  int output_sample_rate_hz() const { return output_sample_rate_hz_; }
+
+ private:
+  struct Stream {
+    std::unique_ptr<LyraDecoderInterface> decoder;
+    // Resamples the stream to the output sample rate. A nullptr if no
+    // resampling is needed.
+    std::unique_ptr<ResamplerInterface> resampler;
+    // Whether a packet arrived since the previous mix.
+    bool has_new_packet;
+    // Zero samples that still have to pass through |resampler| before its
+    // history holds no more of the stream's contribution.
+    int num_samples_to_flush;
+  };
+
+  ConferenceMixer(int output_sample_rate_hz, int resampling_period,
+                  int num_flush_samples);
+
+  const int output_sample_rate_hz_;
+  const int resampling_period_;
+  const int num_flush_samples_;
+  int next_stream_id_;
+  absl::flat_hash_map<int, Stream> streams_;
+  // Sum of the resampled streams being mixed, wide enough not to overflow.
+  std::vector<int32_t> accumulator_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_CONFERENCE_MIXER_H_
@@ -0,0 +1,253 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/conference_mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lyra/lyra_config.h"
+#include "lyra/resampler.h"
+#include "lyra/testing/mock_lyra_decoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+using testing::_;
+using testing::Each;
+using testing::Exactly;
+using testing::NiceMock;
+using testing::Return;
+
+constexpr int kNumSamples = 80;
+
+// Returns a decoder that outputs |value| in every sample, or a sine of
+// amplitude |value| if |sine| is set.
+std::unique_ptr<NiceMock<MockLyraDecoder>> MakeDecoder(int16_t value,
+                                                       bool sine = false) {
+  auto decoder = std::make_unique<NiceMock<MockLyraDecoder>>();
+  ON_CALL(*decoder, sample_rate_hz())
+      .WillByDefault(Return(kInternalSampleRateHz));
+  ON_CALL(*decoder, num_channels()).WillByDefault(Return(1));
+  ON_CALL(*decoder, is_comfort_noise()).WillByDefault(Return(false));
+  ON_CALL(*decoder, SetEncodedPacket(_)).WillByDefault(Return(true));
+  ON_CALL(*decoder, DecodeSamples(_))
+      .WillByDefault([value, sine, n = 0](int num_samples) mutable {
+        std::vector<int16_t> samples(num_samples, value);
+        if (sine) {
+          for (int16_t& sample : samples) {
+            sample = std::round(value * std::sin(0.05 * n++));
+          }
+        }
+        return std::optional<std::vector<int16_t>>(samples);
+      });
+  return decoder;
+}
+
+TEST(ConferenceMixerTest, CreateFailsWithUnsupportedSampleRate) {
+  EXPECT_EQ(ConferenceMixer::Create(44100), nullptr);
+}
+
+TEST(ConferenceMixerTest, AddStreamFailsWithOtherSampleRate) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  auto decoder = MakeDecoder(1);
+  ON_CALL(*decoder, sample_rate_hz()).WillByDefault(Return(48000));
+  EXPECT_EQ(mixer->AddStream(std::move(decoder)), -1);
+  EXPECT_EQ(mixer->AddStream(nullptr), -1);
+}
+
+TEST(ConferenceMixerTest, MixMinusLeavesOutOwnStream) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  const int first = mixer->AddStream(MakeDecoder(100));
+  const int second = mixer->AddStream(MakeDecoder(200));
+  const int third = mixer->AddStream(MakeDecoder(-300));
+  ASSERT_GE(first, 0);
+  ASSERT_GE(second, 0);
+  ASSERT_GE(third, 0);
+
+  const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_EQ(mix->mix.size(), kNumSamples);
+  EXPECT_THAT(mix->mix, Each(0));
+  EXPECT_THAT(mix->ForListener(first), Each(-100));
+  EXPECT_THAT(mix->ForListener(second), Each(-200));
+  EXPECT_THAT(mix->ForListener(third), Each(300));
+}
+
+TEST(ConferenceMixerTest, MixSaturatesWithoutWrapping) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  const int first = mixer->AddStream(MakeDecoder(30000));
+  mixer->AddStream(MakeDecoder(30000));
+  const int third = mixer->AddStream(MakeDecoder(-20000));
+
+  const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_THAT(mix->mix, Each(32767));
+  // Saturation applies to the mix minus, not to the full mix it comes from.
+  EXPECT_THAT(mix->ForListener(first), Each(10000));
+  EXPECT_THAT(mix->ForListener(third), Each(32767));
+}
+
+TEST(ConferenceMixerTest, ComfortNoiseStreamIsNotDecoded) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  auto silent_decoder = MakeDecoder(1000);
+  ON_CALL(*silent_decoder, is_comfort_noise()).WillByDefault(Return(true));
+  EXPECT_CALL(*silent_decoder, DecodeSamples(_)).Times(Exactly(0));
+  const int silent = mixer->AddStream(std::move(silent_decoder));
+  const int talker = mixer->AddStream(MakeDecoder(100));
+
+  const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_THAT(mix->mix, Each(100));
+  EXPECT_FALSE(mix->mix_minus.contains(silent));
+  EXPECT_THAT(mix->ForListener(silent), Each(100));
+  EXPECT_THAT(mix->ForListener(talker), Each(0));
+}
+
+TEST(ConferenceMixerTest, ComfortNoiseStreamIsDecodedAfterNewPacket) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  auto decoder = MakeDecoder(1000);
+  ON_CALL(*decoder, is_comfort_noise()).WillByDefault(Return(true));
+  EXPECT_CALL(*decoder, DecodeSamples(kNumSamples)).Times(Exactly(1));
+  const int stream = mixer->AddStream(std::move(decoder));
+  const std::vector<uint8_t> packet(
+      GetPacketSize(GetSupportedQuantizedBits()[0]));
+
+  ASSERT_TRUE(mixer->SetEncodedPacket(stream, packet));
+  std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_THAT(mix->mix, Each(1000));
+
+  // Without another packet the stream is left out again.
+  mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_THAT(mix->mix, Each(0));
+}
+
+TEST(ConferenceMixerTest, RemovedStreamIsNotMixed) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  const int removed = mixer->AddStream(MakeDecoder(100));
+  mixer->AddStream(MakeDecoder(200));
+  EXPECT_TRUE(mixer->RemoveStream(removed));
+  EXPECT_FALSE(mixer->RemoveStream(removed));
+  EXPECT_FALSE(mixer->SetEncodedPacket(removed, {}));
+
+  const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+  ASSERT_TRUE(mix.has_value());
+  EXPECT_THAT(mix->mix, Each(200));
+}
+
+TEST(ConferenceMixerTest, MixFailsWhenDecoderFails) {
+  auto mixer = ConferenceMixer::Create(kInternalSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  auto decoder = MakeDecoder(100);
+  ON_CALL(*decoder, DecodeSamples(_)).WillByDefault(Return(std::nullopt));
+  mixer->AddStream(std::move(decoder));
+  EXPECT_FALSE(mixer->Mix(kNumSamples).has_value());
+}
+
+TEST(ConferenceMixerTest, MixFailsOffTheResamplingPhase) {
+  auto mixer = ConferenceMixer::Create(8000);
+  ASSERT_NE(mixer, nullptr);
+  EXPECT_FALSE(mixer->Mix(kNumSamples + 1).has_value());
+  EXPECT_TRUE(mixer->Mix(kNumSamples).has_value());
+}
+
+TEST(ConferenceMixerTest, ResampledMixMinusOfOnlyTalkerIsSilent) {
+  constexpr int kOutputSampleRateHz = 48000;
+  auto mixer = ConferenceMixer::Create(kOutputSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  auto talker_decoder = MakeDecoder(10000, /*sine=*/true);
+  MockLyraDecoder* talker_decoder_ptr = talker_decoder.get();
+  const int talker = mixer->AddStream(std::move(talker_decoder));
+  auto listener_decoder = MakeDecoder(0);
+  ON_CALL(*listener_decoder, is_comfort_noise()).WillByDefault(Return(true));
+  const int listener = mixer->AddStream(std::move(listener_decoder));
+
+  for (int i = 0; i < 4; ++i) {
+    const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+    ASSERT_TRUE(mix.has_value());
+    EXPECT_EQ(mix->mix.size(), 3 * kNumSamples);
+    EXPECT_EQ(&mix->ForListener(listener), &mix->mix);
+    ASSERT_TRUE(mix->mix_minus.contains(talker));
+    EXPECT_THAT(mix->ForListener(talker), Each(0));
+  }
+
+  // Once the talker is silent, its resampled tail is still taken out of the
+  // mix until it has passed.
+  ON_CALL(*talker_decoder_ptr, is_comfort_noise()).WillByDefault(Return(true));
+  bool tail_passed = false;
+  for (int i = 0; i < 4 && !tail_passed; ++i) {
+    const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+    ASSERT_TRUE(mix.has_value());
+    EXPECT_THAT(mix->ForListener(talker), Each(0));
+    tail_passed = !mix->mix_minus.contains(talker);
+  }
+  EXPECT_TRUE(tail_passed);
+}
+
+// The resampled streams are summed without clipping, so a mix minus only
+// saturates on its own sum.
+TEST(ConferenceMixerTest, ResampledMixSaturatesAfterSubtraction) {
+  constexpr int kOutputSampleRateHz = 48000;
+  auto mixer = ConferenceMixer::Create(kOutputSampleRateHz);
+  ASSERT_NE(mixer, nullptr);
+  const int first = mixer->AddStream(MakeDecoder(30000, /*sine=*/true));
+  mixer->AddStream(MakeDecoder(30000, /*sine=*/true));
+  mixer->AddStream(MakeDecoder(-20000, /*sine=*/true));
+  auto loud = Resampler::Create(kInternalSampleRateHz, kOutputSampleRateHz);
+  auto quiet = Resampler::Create(kInternalSampleRateHz, kOutputSampleRateHz);
+  ASSERT_NE(loud, nullptr);
+  ASSERT_NE(quiet, nullptr);
+  auto loud_decoder = MakeDecoder(30000, /*sine=*/true);
+  auto quiet_decoder = MakeDecoder(-20000, /*sine=*/true);
+
+  bool mix_clipped = false;
+  for (int i = 0; i < 4; ++i) {
+    const std::optional<ConferenceMix> mix = mixer->Mix(kNumSamples);
+    ASSERT_TRUE(mix.has_value());
+    const std::vector<int16_t> loud_samples =
+        loud->Resample(loud_decoder->DecodeSamples(kNumSamples).value());
+    const std::vector<int16_t> quiet_samples =
+        quiet->Resample(quiet_decoder->DecodeSamples(kNumSamples).value());
+    ASSERT_EQ(mix->mix.size(), loud_samples.size());
+    const std::vector<int16_t>& first_hears = mix->ForListener(first);
+    for (int j = 0; j < loud_samples.size(); ++j) {
+      const int full_mix = 2 * loud_samples[j] + quiet_samples[j];
+      mix_clipped |= std::abs(full_mix) > 32767;
+      EXPECT_EQ(mix->mix[j], std::clamp(full_mix, -32768, 32767));
+      EXPECT_EQ(first_hears[j], loud_samples[j] + quiet_samples[j]);
+    }
+  }
+  EXPECT_TRUE(mix_clipped);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
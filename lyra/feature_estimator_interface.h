@@ -20,6 +20,8 @@
 #include <vector>
 
 #include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -31,6 +33,18 @@ class FeatureEstimatorInterface {
   virtual void Update(absl::Span<const float> features) = 0;
 
   virtual std::vector<float> Estimate() const = 0;
+
+  // Saves what the estimate is based on. Returns false if the estimator does
+  // not support this.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This feature estimator can not save its state.";
+    return false;
+  }
+
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This feature estimator can not restore its state.";
+    return false;
+  }
 };
 
 }  // namespace codec
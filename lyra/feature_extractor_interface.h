@@ -22,6 +22,9 @@
 #include <vector>
 
 #include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -36,6 +39,26 @@ class FeatureExtractorInterface {
   // Extracts features from the audio. On failure returns a nullopt.
   virtual std::optional<std::vector<float>> Extract(
       const absl::Span<const int16_t> audio) = 0;
+
+  // Extracts features from audio in unit floats. Implementations that work
+  // on floats internally should override this to skip the int16 conversion.
+  virtual std::optional<std::vector<float>> ExtractFloat(
+      absl::Span<const float> audio) {
+    return Extract(UnitToInt16(audio));
+  }
+
+  // Saves the audio history or recurrent state that the next features depend
+  // on. Returns false if the extractor does not support this.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This feature extractor can not save its state.";
+    return false;
+  }
+
+  // Restores what |SaveState| wrote. Returns false on failure.
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This feature extractor can not restore its state.";
+    return false;
+  }
 };
 
 }  // namespace codec
@@ -20,9 +20,13 @@
 #include <cstdint>
 #include <optional>
 #include <queue>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -38,7 +42,32 @@ class GenerativeModelInterface {
   virtual std::optional<std::vector<int16_t>> GenerateSamples(
       int num_samples) = 0;
 
+  // Like |GenerateSamples|, but returns unit floats. Defaults to converting
+  // the int16 samples.
+  virtual std::optional<std::vector<float>> GenerateFloatSamples(
+      int num_samples) {
+    auto samples = GenerateSamples(num_samples);
+    if (!samples.has_value()) {
+      return std::nullopt;
+    }
+    return Int16ToUnit<float>(samples.value());
+  }
+
   virtual int num_samples_available() const = 0;
+
+  // Writes everything the model needs to continue generating the same samples
+  // in another instance, which reads it back with |RestoreState|. Returns
+  // false if the model does not support this.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This generative model can not save its state.";
+    return false;
+  }
+
+  // Returns false on failure, after which the model has to be recreated.
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This generative model can not restore its state.";
+    return false;
+  }
 };
 
 // Enforces that features are added and then decoded via a FIFO queue.
@@ -61,13 +90,106 @@ class GenerativeModel : public GenerativeModelInterface {
   // Returns a vector of audio samples on success. Returns a nullopt on failure.
   std::optional<std::vector<int16_t>> GenerateSamples(
       int num_samples) override final {
+    return GenerateSamplesOfType<int16_t>(num_samples);
+  }
+
+  std::optional<std::vector<float>> GenerateFloatSamples(
+      int num_samples) override final {
+    return GenerateSamplesOfType<float>(num_samples);
+  }
+
+  int num_samples_available() const override final {
+    return features_queue_.size() * num_samples_per_hop_ - next_sample_in_hop_;
+  }
+
+  // Saves the queued features and the position in the current hop, followed
+  // by the state of the derived model.
+  bool SaveState(StateWriter* writer) const override final {
+    writer->Write<int32_t>(next_sample_in_hop_);
+    writer->Write<uint32_t>(features_queue_.size());
+    std::queue<std::vector<float>> features_queue = features_queue_;
+    for (; !features_queue.empty(); features_queue.pop()) {
+      writer->WriteVector<float>(features_queue.front());
+    }
+    return SaveModelState(writer);
+  }
+
+  bool RestoreState(StateReader* reader) override final {
+    int32_t next_sample_in_hop;
+    uint32_t num_queued_features;
+    if (!reader->Read(&next_sample_in_hop) ||
+        !reader->Read(&num_queued_features)) {
+      return false;
+    }
+    if (next_sample_in_hop < 0 || next_sample_in_hop >= num_samples_per_hop_ ||
+        (next_sample_in_hop > 0 && num_queued_features == 0)) {
+      LOG(ERROR) << "Invalid position " << next_sample_in_hop
+                 << " in the current hop.";
+      return false;
+    }
+    std::queue<std::vector<float>> features_queue;
+    for (int i = 0; i < num_queued_features; ++i) {
+      std::vector<float> features;
+      if (!reader->ReadVectorOfSize(num_features_, &features)) {
+        return false;
+      }
+      features_queue.push(std::move(features));
+    }
+    next_sample_in_hop_ = next_sample_in_hop;
+    features_queue_ = std::move(features_queue);
+    return RestoreModelState(reader);
+  }
+
+ protected:
+  GenerativeModel(int num_samples_per_hop, int num_features)
+      : num_samples_per_hop_(num_samples_per_hop),
+        num_features_(num_features),
+        next_sample_in_hop_(0) {
+    VLOG(1) << "Number of features: " << num_features;
+    VLOG(1) << "Number of samples per feature: " << num_samples_per_hop;
+  }
+
+  // Process the features on top of the queue.
+  // Called from |GenerateSamples|.
+  virtual bool RunConditioning(const std::vector<float>& features) = 0;
+
+  // Generate samples from the latest set of features added by |AddFeatures|,
+  // which have already been processed by |RunConditioning|.
+  virtual std::optional<std::vector<int16_t>> RunModel(int num_samples) = 0;
+
+  // Like |RunModel|, but returns unit floats. Models computing floats should
+  // override this to skip the int16 conversion.
+  virtual std::optional<std::vector<float>> RunModelFloat(int num_samples) {
+    auto samples = RunModel(num_samples);
+    if (!samples.has_value()) {
+      return std::nullopt;
+    }
+    return Int16ToUnit<float>(samples.value());
+  }
+
+  // Saves and restores the state of the derived model, such as the output of
+  // the last conditioning. Models without state of their own keep these.
+  virtual bool SaveModelState(StateWriter* writer) const { return true; }
+
+  virtual bool RestoreModelState(StateReader* reader) { return true; }
+
+  int num_samples_per_hop() const { return num_samples_per_hop_; }
+
+  int next_sample_in_hop() const { return next_sample_in_hop_; }
+
+ private:
+  GenerativeModel() = delete;
+
+  // Shared by |GenerateSamples| and |GenerateFloatSamples|.
+  template <typename T>
+  std::optional<std::vector<T>> GenerateSamplesOfType(int num_samples) {
     if (num_samples < 0) {
       LOG(ERROR) << "Number of samples must be positive.";
       return std::nullopt;
     }
     // Do not call costly models if no samples have been requested.
     if (num_samples == 0) {
-      return std::vector<int16_t>(0);
+      return std::vector<T>(0);
     }
     if (num_samples_available() == 0) {
       LOG(ERROR) << "Tried generating " << num_samples << " samples but only "
@@ -87,7 +209,12 @@ class GenerativeModel : public GenerativeModelInterface {
                  << " were available in current features.";
       return std::nullopt;
     }
-    auto samples = RunModel(num_samples);
+    std::optional<std::vector<T>> samples;
+    if constexpr (std::is_same_v<T, float>) {
+      samples = RunModelFloat(num_samples);
+    } else {
+      samples = RunModel(num_samples);
+    }
     if (samples.has_value()) {
       next_sample_in_hop_ += samples->size();
       // Cumulative samples generated are guaranteed to never straddle
@@ -100,32 +227,6 @@ class GenerativeModel : public GenerativeModelInterface {
     return samples;
   }
 
-  int num_samples_available() const override final {
-    return features_queue_.size() * num_samples_per_hop_ - next_sample_in_hop_;
-  }
-
- protected:
-  GenerativeModel(int num_samples_per_hop, int num_features)
-      : num_samples_per_hop_(num_samples_per_hop),
-        num_features_(num_features),
-        next_sample_in_hop_(0) {
-    VLOG(1) << "Number of features: " << num_features;
-    VLOG(1) << "Number of samples per feature: " << num_samples_per_hop;
-  }
-
-  // Process the features on top of the queue.
-  // Called from |GenerateSamples|.
-  virtual bool RunConditioning(const std::vector<float>& features) = 0;
-
-  // Generate samples from the latest set of features added by |AddFeatures|,
-  // which have already been processed by |RunConditioning|.
-  virtual std::optional<std::vector<int16_t>> RunModel(int num_samples) = 0;
-
-  int next_sample_in_hop() const { return next_sample_in_hop_; }
-
- private:
-  GenerativeModel() = delete;
-
   // Provide read-only access to these member variables in derived classes.
   const int num_samples_per_hop_;
   const int num_features_;
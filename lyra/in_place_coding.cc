@@ -0,0 +1,57 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/in_place_coding.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+
+int EncodeInto(LyraEncoder* encoder, absl::Span<const int16_t> samples,
+               absl::Span<uint8_t> packet) {
+  const auto encoded = encoder->Encode(samples);
+  if (!encoded.has_value()) {
+    return -1;
+  }
+  if (encoded->size() > packet.size()) {
+    LOG(ERROR) << "The packet of " << encoded->size()
+               << " bytes does not fit into " << packet.size() << " bytes.";
+    return -1;
+  }
+  std::copy(encoded->begin(), encoded->end(), packet.begin());
+  return encoded->size();
+}
+
+int DecodeInto(LyraDecoder* decoder, absl::Span<const uint8_t> packet,
+               absl::Span<int16_t> samples) {
+  if (!packet.empty() && !decoder->SetEncodedPacket(packet)) {
+    return -1;
+  }
+  const auto decoded = decoder->DecodeSamples(samples.size());
+  if (!decoded.has_value() || decoded->size() != samples.size()) {
+    return -1;
+  }
+  std::copy(decoded->begin(), decoded->end(), samples.begin());
+  return samples.size();
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef LYRA_IN_PLACE_CODING_H_
+#define LYRA_IN_PLACE_CODING_H_
+
+#include <cstdint>
+
+#include "absl/types/span.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Coding of one hop into buffers owned by the caller, shared by the C API and
+// the JNI bindings.
+
+// Encodes |samples| into |packet|. Returns the size of the packet, which is 0
+// if DTX left it out, or -1 if encoding fails or the packet does not fit.
+int EncodeInto(LyraEncoder* encoder, absl::Span<const int16_t> samples,
+               absl::Span<uint8_t> packet);
+
+// Sets |packet| unless it is empty, in which case the hop is concealed, and
+// decodes |samples.size()| samples into |samples|. Returns the number of
+// samples decoded, or -1 on failure.
+int DecodeInto(LyraDecoder* decoder, absl::Span<const uint8_t> packet,
+               absl::Span<int16_t> samples);
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_IN_PLACE_CODING_H_
@@ -28,6 +28,7 @@
 #include "audio/dsp/number_util.h"
 #include "audio/dsp/spectrogram/spectrogram.h"
 #include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -44,11 +45,13 @@ static constexpr double kUpperFreqLimitFactor = 0.495;
 LogMelSpectrogramExtractorImpl::LogMelSpectrogramExtractorImpl(
     std::unique_ptr<audio_dsp::Spectrogram> spectrogram,
     std::unique_ptr<audio_dsp::MelFilterbank> mel_filterbank,
-    int hop_length_samples)
+    int hop_length_samples, int window_length_samples)
     : spectrogram_(std::move(spectrogram)),
       mel_filterbank_(std::move(mel_filterbank)),
       hop_length_samples_(hop_length_samples),
-      samples_(hop_length_samples, 0.0) {}
+      window_length_samples_(window_length_samples),
+      samples_(hop_length_samples, 0.0),
+      window_samples_(window_length_samples, 0.0) {}
 
 std::unique_ptr<LogMelSpectrogramExtractorImpl>
 LogMelSpectrogramExtractorImpl::Create(int sample_rate_hz,
@@ -90,7 +93,8 @@ LogMelSpectrogramExtractorImpl::Create(int sample_rate_hz,
   }
 
   return absl::WrapUnique(new LogMelSpectrogramExtractorImpl(
-      std::move(spectrogram), std::move(mel_filterbank), hop_length_samples));
+      std::move(spectrogram), std::move(mel_filterbank), hop_length_samples,
+      window_length_samples));
 }
 
 std::optional<std::vector<float>> LogMelSpectrogramExtractorImpl::Extract(
@@ -102,6 +106,10 @@ std::optional<std::vector<float>> LogMelSpectrogramExtractorImpl::Extract(
   }
 
   std::copy(audio.begin(), audio.end(), samples_.begin());
+  std::copy(window_samples_.begin() + hop_length_samples_,
+            window_samples_.end(), window_samples_.begin());
+  std::copy(samples_.begin(), samples_.end(),
+            window_samples_.end() - hop_length_samples_);
 
   std::vector<std::vector<double>> spectrogram_slices;
   if (!spectrogram_->ComputeSpectrogram(samples_, &spectrogram_slices)) {
@@ -125,6 +133,25 @@ std::optional<std::vector<float>> LogMelSpectrogramExtractorImpl::Extract(
   return mel_features;
 }
 
+bool LogMelSpectrogramExtractorImpl::SaveState(StateWriter* writer) const {
+  writer->WriteVector<double>(window_samples_);
+  return true;
+}
+
+bool LogMelSpectrogramExtractorImpl::RestoreState(StateReader* reader) {
+  if (!reader->ReadVectorOfSize(window_length_samples_, &window_samples_)) {
+    return false;
+  }
+  std::vector<std::vector<double>> unused_spectrogram_slices;
+  if (!spectrogram_->Initialize(window_length_samples_, hop_length_samples_) ||
+      !spectrogram_->ComputeSpectrogram(window_samples_,
+                                        &unused_spectrogram_slices)) {
+    LOG(ERROR) << "Could not restore the spectrogram.";
+    return false;
+  }
+  return true;
+}
+
 double LogMelSpectrogramExtractorImpl::GetLowerFreqLimit() {
   return kLowerFreqLimit;
 }
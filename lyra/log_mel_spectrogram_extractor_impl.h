@@ -26,6 +26,7 @@
 #include "audio/dsp/mfcc/mel_filterbank.h"
 #include "audio/dsp/spectrogram/spectrogram.h"
 #include "lyra/feature_extractor_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -46,6 +47,13 @@ class LogMelSpectrogramExtractorImpl : public FeatureExtractorInterface {
   std::optional<std::vector<float>> Extract(
       const absl::Span<const int16_t> audio) override;
 
+  // Saves the samples of the last window. The spectrogram does not expose its
+  // internal queue, so it is restored by computing the spectrogram of that
+  // window again.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
   // Returns the lower frequency limit used to initialize the MelFilterbank
   // class.
   static double GetLowerFreqLimit();
@@ -66,12 +74,15 @@ class LogMelSpectrogramExtractorImpl : public FeatureExtractorInterface {
   LogMelSpectrogramExtractorImpl(
       std::unique_ptr<audio_dsp::Spectrogram> spectrogram,
       std::unique_ptr<audio_dsp::MelFilterbank> mel_filterbank,
-      int hop_length_samples);
+      int hop_length_samples, int window_length_samples);
 
   const std::unique_ptr<audio_dsp::Spectrogram> spectrogram_;
   const std::unique_ptr<const audio_dsp::MelFilterbank> mel_filterbank_;
   const int hop_length_samples_;
+  const int window_length_samples_;
   std::vector<double> samples_;
+  // The last |window_length_samples_| samples passed to |spectrogram_|.
+  std::vector<double> window_samples_;
 };
 
 }  // namespace codec
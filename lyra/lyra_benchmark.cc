@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
@@ -40,10 +41,126 @@ ABSL_FLAG(bool, benchmark_quantizer, true,
 ABSL_FLAG(bool, benchmark_generative_model, true,
           "Whether to benchmark the generative model.");
 
+ABSL_FLAG(bool, benchmark_precisions, false,
+          "Whether to compare the fp32, fp16 and int8 model variants instead. "
+          "Reports the runtime of each variant and the log-spectral distance "
+          "of its output to the fp32 variant.");
+
+ABSL_FLAG(std::string, precision_wav_path, "",
+          "Mono 16 kHz wav file used by --benchmark_precisions. If empty, "
+          "random audio is used.");
+
+ABSL_FLAG(int, benchmark_encoder_threads, 0,
+          "If greater than 1, compares the throughput of the pipelined "
+          "encoder on 2 up to this many threads with the serial encoder "
+          "instead.");
+
+ABSL_FLAG(int, benchmark_segments, 0,
+          "If greater than 1, compares encoding and decoding split into this "
+          "many segments coded in parallel with serial coding instead. "
+          "Reports the runtime of both and the log-spectral distance of the "
+          "segment-parallel output to the serial output.");
+
+ABSL_FLAG(std::string, segments_wav_path, "",
+          "Mono 16 kHz wav file used by --benchmark_segments. If empty, "
+          "random audio is used.");
+
+ABSL_FLAG(bool, benchmark_archive, false,
+          "Whether to measure lossless archiving of packets instead. Reports "
+          "the compression ratio and throughput for --archive_wav_paths at "
+          "every bitrate.");
+
+ABSL_FLAG(std::vector<std::string>, archive_wav_paths,
+          std::vector<std::string>({"lyra/testdata/sample1_8kHz.wav",
+                                    "lyra/testdata/sample1_16kHz.wav",
+                                    "lyra/testdata/sample1_32kHz.wav",
+                                    "lyra/testdata/sample1_48kHz.wav",
+                                    "lyra/testdata/sample2_8kHz.wav",
+                                    "lyra/testdata/sample2_16kHz.wav",
+                                    "lyra/testdata/sample2_32kHz.wav",
+                                    "lyra/testdata/sample2_48kHz.wav"}),
+          "Comma-separated mono wav files used by --benchmark_archive.");
+
+ABSL_FLAG(bool, benchmark_superframes, false,
+          "Whether to compare superframes of 1 to 4 hops per packet instead. "
+          "Reports the packet rate and the encoder and decoder runtime per "
+          "hop for every superframe size.");
+
+ABSL_FLAG(int, superframe_header_bytes, 40,
+          "Transport header bytes per packet counted by "
+          "--benchmark_superframes. Defaults to IPv4, UDP and RTP headers.");
+
+ABSL_FLAG(bool, benchmark_packet_analysis, false,
+          "Whether to compare analyzing packets for voice activity and "
+          "loudness with decoding them instead.");
+
+ABSL_FLAG(int, benchmark_float_io_sample_rate_hz, 0,
+          "If set, compares coding unit float audio at this sample rate "
+          "through the float API with converting it for the int16 API "
+          "instead.");
+
+ABSL_FLAG(bool, benchmark_fec, false,
+          "Whether to measure in-band forward error correction instead. "
+          "Reports its bitrate, the lost packets it recovers and the "
+          "log-spectral distance to lossless decoding with and without it.");
+
+ABSL_FLAG(float, fec_packet_loss_rate, 0.1f,
+          "Packet loss rate of the Gilbert model used by --benchmark_fec.");
+
+ABSL_FLAG(float, fec_average_burst_length, 1.5f,
+          "Average burst length of the Gilbert model used by "
+          "--benchmark_fec.");
+
+ABSL_FLAG(std::string, fec_wav_path, "",
+          "Mono 16 kHz wav file used by --benchmark_fec. If empty, random "
+          "audio is used.");
+
 int main(int argc, char** argv) {
   absl::SetProgramUsageMessage(argv[0]);
   absl::ParseCommandLine(argc, argv);
 
+  if (absl::GetFlag(FLAGS_benchmark_fec)) {
+    return chromemedia::codec::lyra_fec_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_fec_packet_loss_rate),
+        absl::GetFlag(FLAGS_fec_average_burst_length),
+        absl::GetFlag(FLAGS_fec_wav_path));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_float_io_sample_rate_hz) > 0) {
+    return chromemedia::codec::lyra_float_io_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_benchmark_float_io_sample_rate_hz));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_packet_analysis)) {
+    return chromemedia::codec::lyra_packet_analysis_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_superframes)) {
+    return chromemedia::codec::lyra_superframe_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_superframe_header_bytes));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_archive)) {
+    return chromemedia::codec::lyra_archive_benchmark(
+        absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_archive_wav_paths));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_encoder_threads) > 1) {
+    return chromemedia::codec::lyra_pipelined_encoder_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_benchmark_encoder_threads));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_segments) > 1) {
+    return chromemedia::codec::lyra_segment_parallel_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_benchmark_segments),
+        absl::GetFlag(FLAGS_segments_wav_path));
+  }
+  if (absl::GetFlag(FLAGS_benchmark_precisions)) {
+    return chromemedia::codec::lyra_precision_benchmark(
+        absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
+        absl::GetFlag(FLAGS_precision_wav_path));
+  }
   return chromemedia::codec::lyra_benchmark(
       absl::GetFlag(FLAGS_num_cond_vectors), absl::GetFlag(FLAGS_model_path),
       absl::GetFlag(FLAGS_benchmark_feature_extraction),
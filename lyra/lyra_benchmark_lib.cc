@@ -26,12 +26,14 @@
 #include <string>
 #include <system_error>  // NOLINT(build/c++11)
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #ifdef __ANDROID__
 #include <android/log.h>
 #endif
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
@@ -43,8 +45,17 @@
 #include "lyra/dsp_utils.h"
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/generative_model_interface.h"
+#include "lyra/gilbert_model.h"
 #include "lyra/lyra_components.h"
 #include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+#include "lyra/packet_analyzer.h"
+#include "lyra/packet_archive.h"
+#include "lyra/pipelined_encoder.h"
+#include "lyra/segment_parallel_codec.h"
+#include "lyra/tflite_model_wrapper.h"
+#include "lyra/wav_utils.h"
 
 #ifdef BENCHMARK
 #include "absl/base/thread_annotations.h"
@@ -292,5 +303,771 @@ int lyra_benchmark(const int num_cond_vectors,
   return 0;
 }
 
+namespace {
+
+constexpr ModelPrecision kPrecisions[] = {
+    ModelPrecision::kFloat32, ModelPrecision::kFloat16, ModelPrecision::kInt8};
+
+std::string PrecisionName(ModelPrecision precision) {
+  switch (precision) {
+    case ModelPrecision::kFloat32:
+      return "fp32";
+    case ModelPrecision::kFloat16:
+      return "fp16";
+    case ModelPrecision::kInt8:
+      return "int8";
+  }
+  return "unknown";
+}
+
+void PrintLine(const std::string& line) {
+#ifdef __ANDROID__
+  __android_log_print(ANDROID_LOG_DEBUG, "lyra_benchmark", "%s", line.c_str());
+#else
+  LOG(INFO) << line;
+#endif
+}
+
+// Encodes and decodes |input| hop by hop with models created at |precision|.
+// Per-hop runtimes of the whole pipeline are appended to |total_timings|.
+std::optional<std::vector<int16_t>> RunPipelineWithPrecision(
+    const std::vector<int16_t>& input, const std::string& model_path,
+    ModelPrecision precision, std::vector<int64_t>* total_timings) {
+  auto feature_extractor = CreateFeatureExtractor(model_path, precision);
+  auto vector_quantizer = CreateQuantizer(model_path, precision);
+  auto model = CreateGenerativeModel(kNumFeatures, model_path, precision);
+  if (feature_extractor == nullptr || vector_quantizer == nullptr ||
+      model == nullptr) {
+    LOG(ERROR) << "Could not create " << PrecisionName(precision)
+               << " components.";
+    return std::nullopt;
+  }
+
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  std::vector<int64_t> feature_extractor_timings;
+  std::vector<int64_t> quantizer_quantize_timings;
+  std::vector<int64_t> quantizer_decode_timings;
+  std::vector<int64_t> model_decode_timings;
+  std::vector<int16_t> decoded_all;
+  decoded_all.reserve(input.size());
+  for (int hop_begin = 0; hop_begin + num_samples_per_hop <= input.size();
+       hop_begin += num_samples_per_hop) {
+    const std::vector<int16_t> hop(input.begin() + hop_begin,
+                                   input.begin() + hop_begin +
+                                       num_samples_per_hop);
+    const auto features = MaybeRunFeatureExtraction(
+        hop, feature_extractor.get(), &feature_extractor_timings);
+    if (!features.has_value()) {
+      return std::nullopt;
+    }
+    const auto quantized_features = MaybeRunQuantizerQuantize(
+        features.value(), vector_quantizer.get(), &quantizer_quantize_timings);
+    if (!quantized_features.has_value()) {
+      return std::nullopt;
+    }
+    const auto lossy_features = MaybeRunQuantizerDecode(
+        quantized_features.value(), vector_quantizer.get(),
+        &quantizer_decode_timings);
+    if (!lossy_features.has_value()) {
+      return std::nullopt;
+    }
+    const auto decoded =
+        MaybeRunGenerativeModel(lossy_features.value(), num_samples_per_hop,
+                                model.get(), &model_decode_timings);
+    if (!decoded.has_value() || decoded->size() != num_samples_per_hop) {
+      return std::nullopt;
+    }
+    decoded_all.insert(decoded_all.end(), decoded->begin(), decoded->end());
+  }
+
+#ifdef BENCHMARK
+  for (int i = 0; i < model_decode_timings.size(); ++i) {
+    total_timings->push_back(
+        feature_extractor_timings[i] + quantizer_quantize_timings[i] +
+        quantizer_decode_timings[i] + model_decode_timings[i]);
+  }
+#endif  // BENCHMARK
+  return decoded_all;
+}
+
+// Returns |num_cond_vectors| hops of random audio if |wav_path| is empty, and
+// otherwise up to that many hops read from the mono wav file at
+// |kInternalSampleRateHz| at |wav_path|.
+std::optional<std::vector<int16_t>> ReadBenchmarkInput(
+    int num_cond_vectors, const std::string& wav_path) {
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  std::vector<int16_t> input;
+  if (wav_path.empty()) {
+    std::uniform_real_distribution<float> distribution(-1.0, 1.0);
+    std::default_random_engine generator;
+    input.resize(num_cond_vectors * num_samples_per_hop);
+    std::generate(input.begin(), input.end(),
+                  [&]() { return UnitToInt16Scalar(distribution(generator)); });
+    return input;
+  }
+  auto read_wav = Read16BitWavFileToVector(wav_path);
+  if (!read_wav.ok()) {
+    LOG(ERROR) << read_wav.status();
+    return std::nullopt;
+  }
+  if (read_wav->sample_rate_hz != kInternalSampleRateHz ||
+      read_wav->num_channels != kNumChannels) {
+    LOG(ERROR) << "Benchmark needs a mono " << kInternalSampleRateHz
+               << " Hz wav file.";
+    return std::nullopt;
+  }
+  const int num_samples = std::min<int>(read_wav->samples.size(),
+                                        num_cond_vectors * num_samples_per_hop);
+  input.assign(read_wav->samples.begin(),
+               read_wav->samples.begin() + num_samples);
+  return input;
+}
+
+// Decodes |packets|, which carry FEC data, hop by hop, skipping those that
+// are not |is_received|. A skipped packet is concealed, unless |use_fec| is
+// set and the next packet is received, in which case it is recovered from
+// the FEC data of the next packet and counted in |num_recovered|.
+std::optional<std::vector<int16_t>> DecodeWithPacketLoss(
+    const std::vector<std::vector<uint8_t>>& packets,
+    const std::vector<bool>& is_received, bool use_fec,
+    const std::string& model_path, int* num_recovered) {
+  auto decoder =
+      LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path);
+  if (decoder == nullptr) {
+    LOG(ERROR) << "Could not create decoder.";
+    return std::nullopt;
+  }
+  decoder->set_fec_enabled(true);
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  std::vector<int16_t> decoded;
+  decoded.reserve(packets.size() * num_samples_per_hop);
+  for (int i = 0; i < packets.size(); ++i) {
+    bool set = true;
+    if (is_received[i]) {
+      set = decoder->SetEncodedPacket(packets[i]);
+    } else if (use_fec && i + 1 < packets.size() && is_received[i + 1]) {
+      set = decoder->RecoverLostPacket(packets[i + 1]);
+      ++*num_recovered;
+    }
+    const auto samples =
+        set ? decoder->DecodeSamples(num_samples_per_hop) : std::nullopt;
+    if (!samples.has_value()) {
+      LOG(ERROR) << "Could not decode hop " << i << ".";
+      return std::nullopt;
+    }
+    decoded.insert(decoded.end(), samples->begin(), samples->end());
+  }
+  return decoded;
+}
+
+}  // namespace
+
+int lyra_precision_benchmark(const int num_cond_vectors,
+                             const std::string& model_base_path,
+                             const std::string& wav_path) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const auto input = ReadBenchmarkInput(num_cond_vectors, wav_path);
+  if (!input.has_value()) {
+    return -1;
+  }
+
+  std::optional<std::vector<int16_t>> reference;
+  for (const ModelPrecision precision : kPrecisions) {
+    std::vector<int64_t> total_timings;
+    const auto decoded = RunPipelineWithPrecision(*input, model_path, precision,
+                                                  &total_timings);
+    if (!decoded.has_value()) {
+      LOG(ERROR) << "Could not run the " << PrecisionName(precision)
+                 << " pipeline.";
+      return -1;
+    }
+    if (!reference.has_value()) {
+      reference = decoded;
+    }
+    const auto distance = MeanLogSpectralDistance(*reference, *decoded,
+                                                  kInternalSampleRateHz);
+    if (!distance.has_value()) {
+      LOG(ERROR) << "Could not compute the log-spectral distance.";
+      return -1;
+    }
+
+    PrintLine(absl::StrFormat("%s: mean log-spectral distance to fp32: %.3f dB",
+                              PrecisionName(precision), distance.value()));
+#ifdef BENCHMARK
+    if (!total_timings.empty()) {
+      PrintStatsAndWriteCSV(total_timings,
+                            absl::StrCat("total_", PrecisionName(precision)));
+    }
+#endif  // BENCHMARK
+  }
+  return 0;
+}
+
+int lyra_pipelined_encoder_benchmark(const int num_cond_vectors,
+                                     const std::string& model_base_path,
+                                     const int max_num_threads) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int bitrate = GetBitrate(kNumQuantizedBits);
+
+  std::uniform_real_distribution<float> distribution(-1.0, 1.0);
+  std::default_random_engine generator;
+  std::vector<int16_t> input(num_cond_vectors * num_samples_per_hop);
+  std::generate(input.begin(), input.end(),
+                [&]() { return UnitToInt16Scalar(distribution(generator)); });
+
+  auto serial_encoder =
+      LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, bitrate,
+                          /*enable_dtx=*/false, model_path);
+  if (serial_encoder == nullptr) {
+    LOG(ERROR) << "Could not create encoder.";
+    return -1;
+  }
+#ifdef BENCHMARK
+  absl::Time start = absl::Now();
+#endif  // BENCHMARK
+  std::vector<uint8_t> expected;
+  for (int hop_begin = 0; hop_begin + num_samples_per_hop <= input.size();
+       hop_begin += num_samples_per_hop) {
+    const auto packet = serial_encoder->Encode(
+        absl::MakeConstSpan(&input.at(hop_begin), num_samples_per_hop));
+    if (!packet.has_value()) {
+      LOG(ERROR) << "Could not encode hop.";
+      return -1;
+    }
+    expected.insert(expected.end(), packet->begin(), packet->end());
+  }
+#ifdef BENCHMARK
+  PrintLine(absl::StrFormat(
+      "1 thread (serial): %.1f hops per second",
+      num_cond_vectors / absl::ToDoubleSeconds(absl::Now() - start)));
+#endif  // BENCHMARK
+
+  for (int num_threads = 2; num_threads <= max_num_threads; ++num_threads) {
+    // Models are loaded before timing starts.
+    auto encoder = PipelinedEncoder::Create(
+        kInternalSampleRateHz, kNumChannels, bitrate, /*enable_dtx=*/false,
+        model_path, /*num_quantizer_threads=*/num_threads - 1);
+    if (encoder == nullptr) {
+      LOG(ERROR) << "Could not create pipelined encoder.";
+      return -1;
+    }
+#ifdef BENCHMARK
+    start = absl::Now();
+#endif  // BENCHMARK
+    const auto encoded = encoder->Encode(absl::MakeConstSpan(input));
+#ifdef BENCHMARK
+    const absl::Duration elapsed = absl::Now() - start;
+#endif  // BENCHMARK
+    if (!encoded.has_value()) {
+      LOG(ERROR) << "Could not encode with " << num_threads << " threads.";
+      return -1;
+    }
+    if (encoded.value() != expected) {
+      LOG(ERROR) << "Pipelined output with " << num_threads
+                 << " threads differs from serial output.";
+      return -1;
+    }
+#ifdef BENCHMARK
+    PrintLine(absl::StrFormat(
+        "%d threads (pipelined): %.1f hops per second", num_threads,
+        num_cond_vectors / absl::ToDoubleSeconds(elapsed)));
+#endif  // BENCHMARK
+  }
+  PrintLine("Pipelined output is identical to serial output.");
+  return 0;
+}
+
+int lyra_segment_parallel_benchmark(const int num_cond_vectors,
+                                    const std::string& model_base_path,
+                                    const int num_segments,
+                                    const std::string& wav_path) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int bitrate = GetBitrate(kNumQuantizedBits);
+  const int packet_size = BitrateToPacketSize(bitrate);
+  const auto input = ReadBenchmarkInput(num_cond_vectors, wav_path);
+  if (!input.has_value()) {
+    return -1;
+  }
+
+  std::optional<std::vector<int16_t>> serial_decoded;
+  std::optional<std::vector<uint8_t>> serial_encoded;
+  for (const int segments : {1, num_segments}) {
+#ifdef BENCHMARK
+    const absl::Time start = absl::Now();
+#endif  // BENCHMARK
+    const auto encoded = EncodeInSegments(
+        *input, kInternalSampleRateHz, bitrate, /*enable_dtx=*/false,
+        model_path, segments);
+#ifdef BENCHMARK
+    const absl::Time encoded_time = absl::Now();
+#endif  // BENCHMARK
+    if (!encoded.has_value()) {
+      LOG(ERROR) << "Could not encode in " << segments << " segments.";
+      return -1;
+    }
+    const auto decoded =
+        DecodeInSegments(*encoded, packet_size, kInternalSampleRateHz,
+                         model_path, /*is_packet_received=*/{}, segments);
+    if (!decoded.has_value()) {
+      LOG(ERROR) << "Could not decode in " << segments << " segments.";
+      return -1;
+    }
+#ifdef BENCHMARK
+    const absl::Time decoded_time = absl::Now();
+    PrintLine(absl::StrFormat(
+        "%d segments: encoding %.3f s, decoding %.3f s", segments,
+        absl::ToDoubleSeconds(encoded_time - start),
+        absl::ToDoubleSeconds(decoded_time - encoded_time)));
+#endif  // BENCHMARK
+    if (!serial_decoded.has_value()) {
+      serial_encoded = encoded;
+      serial_decoded = decoded;
+      continue;
+    }
+
+    // Decoding the serially encoded packets in segments separates the
+    // effect of segmenting the decoder from that of segmenting the encoder.
+    const auto decoded_serial_packets =
+        DecodeInSegments(*serial_encoded, packet_size, kInternalSampleRateHz,
+                         model_path, /*is_packet_received=*/{}, segments);
+    if (!decoded_serial_packets.has_value()) {
+      LOG(ERROR) << "Could not decode in " << segments << " segments.";
+      return -1;
+    }
+    const auto decoder_distance = MeanLogSpectralDistance(
+        *serial_decoded, *decoded_serial_packets, kInternalSampleRateHz);
+    const auto codec_distance =
+        MeanLogSpectralDistance(*serial_decoded, *decoded,
+                                kInternalSampleRateHz);
+    if (!decoder_distance.has_value() || !codec_distance.has_value()) {
+      LOG(ERROR) << "Could not compute the log-spectral distance.";
+      return -1;
+    }
+    PrintLine(absl::StrFormat(
+        "Mean log-spectral distance to serial output: %.3f dB segmenting the "
+        "decoder, %.3f dB segmenting encoder and decoder",
+        decoder_distance.value(), codec_distance.value()));
+  }
+  return 0;
+}
+
+int lyra_archive_benchmark(const std::string& model_base_path,
+                           const std::vector<std::string>& wav_paths) {
+  // Archiving the packets of a few files is too quick to time once.
+  constexpr int kNumRepetitions = 20;
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  std::vector<ReadWavResult> wavs;
+  for (const std::string& wav_path : wav_paths) {
+    auto read_wav = Read16BitWavFileToVector(wav_path);
+    if (!read_wav.ok()) {
+      LOG(ERROR) << read_wav.status();
+      return -1;
+    }
+    if (read_wav->num_channels != kNumChannels) {
+      LOG(ERROR) << wav_path << " is not mono.";
+      return -1;
+    }
+    wavs.push_back(std::move(read_wav.value()));
+  }
+
+  for (const int num_quantized_bits : GetSupportedQuantizedBits()) {
+    const int bitrate = GetBitrate(num_quantized_bits);
+    const int packet_size = BitrateToPacketSize(bitrate);
+    std::vector<std::vector<uint8_t>> packet_streams;
+    for (const ReadWavResult& wav : wavs) {
+      auto packets =
+          EncodeInSegments(wav.samples, wav.sample_rate_hz, bitrate,
+                           /*enable_dtx=*/false, model_path,
+                           /*num_segments=*/1);
+      if (!packets.has_value()) {
+        LOG(ERROR) << "Could not encode at " << bitrate << " bps.";
+        return -1;
+      }
+      packet_streams.push_back(std::move(packets.value()));
+    }
+
+    int64_t num_packet_bytes = 0;
+    int64_t num_archive_bytes = 0;
+#ifdef BENCHMARK
+    absl::Duration archive_time;
+    absl::Duration restore_time;
+#endif  // BENCHMARK
+    for (int repetition = 0; repetition < kNumRepetitions; ++repetition) {
+      for (const std::vector<uint8_t>& packets : packet_streams) {
+#ifdef BENCHMARK
+        const absl::Time start = absl::Now();
+#endif  // BENCHMARK
+        const auto archive = ArchivePackets(packets, packet_size);
+#ifdef BENCHMARK
+        const absl::Time archived = absl::Now();
+#endif  // BENCHMARK
+        if (!archive.has_value()) {
+          LOG(ERROR) << "Could not archive packets.";
+          return -1;
+        }
+        const auto restored = RestorePackets(archive.value());
+#ifdef BENCHMARK
+        archive_time += archived - start;
+        restore_time += absl::Now() - archived;
+#endif  // BENCHMARK
+        if (restored != packets) {
+          LOG(ERROR) << "Restored packets differ from the archived packets.";
+          return -1;
+        }
+        if (repetition == 0) {
+          num_packet_bytes += packets.size();
+          num_archive_bytes += archive->size();
+        }
+      }
+    }
+    PrintLine(absl::StrFormat(
+        "%d bps: %d packets, archive is %.1f%% of the packets (%.0f bps)",
+        bitrate, num_packet_bytes / packet_size,
+        100.0 * num_archive_bytes / std::max<int64_t>(num_packet_bytes, 1),
+        static_cast<double>(bitrate) * num_archive_bytes /
+            std::max<int64_t>(num_packet_bytes, 1)));
+#ifdef BENCHMARK
+    const double num_megabytes = 1e-6 * kNumRepetitions * num_packet_bytes;
+    PrintLine(absl::StrFormat(
+        "%d bps: archiving %.1f MB/s, restoring %.1f MB/s of packets",
+        bitrate, num_megabytes / absl::ToDoubleSeconds(archive_time),
+        num_megabytes / absl::ToDoubleSeconds(restore_time)));
+#endif  // BENCHMARK
+  }
+  return 0;
+}
+
+int lyra_superframe_benchmark(const int num_cond_vectors,
+                              const std::string& model_base_path,
+                              const int header_bytes) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int num_quantized_bits = GetSupportedQuantizedBits().front();
+  const int bitrate = GetBitrate(num_quantized_bits);
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  const auto input = ReadBenchmarkInput(num_cond_vectors, /*wav_path=*/"");
+  if (!input.has_value()) {
+    return -1;
+  }
+
+  for (int num_frames = 1; num_frames <= kMaxFramesPerSuperframe;
+       ++num_frames) {
+    auto encoder =
+        LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, bitrate,
+                            /*enable_dtx=*/false, model_path);
+    auto decoder =
+        LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path);
+    if (encoder == nullptr || decoder == nullptr) {
+      LOG(ERROR) << "Could not create encoder or decoder.";
+      return -1;
+    }
+    const int num_samples_per_superframe = num_frames * num_samples_per_hop;
+    const int num_superframes = input->size() / num_samples_per_superframe;
+#ifdef BENCHMARK
+    absl::Duration encode_time;
+    absl::Duration decode_time;
+#endif  // BENCHMARK
+    for (int i = 0; i < num_superframes; ++i) {
+#ifdef BENCHMARK
+      const absl::Time start = absl::Now();
+#endif  // BENCHMARK
+      const auto superframe = encoder->EncodeSuperframe(absl::MakeConstSpan(
+          &input->at(i * num_samples_per_superframe),
+          num_samples_per_superframe));
+#ifdef BENCHMARK
+      const absl::Time encoded = absl::Now();
+#endif  // BENCHMARK
+      if (!superframe.has_value() ||
+          !decoder->SetEncodedSuperframe(superframe.value())) {
+        LOG(ERROR) << "Could not code superframe " << i << ".";
+        return -1;
+      }
+      if (!decoder->DecodeSamples(num_samples_per_superframe).has_value()) {
+        LOG(ERROR) << "Could not decode superframe " << i << ".";
+        return -1;
+      }
+#ifdef BENCHMARK
+      encode_time += encoded - start;
+      decode_time += absl::Now() - encoded;
+#endif  // BENCHMARK
+    }
+
+    const double packet_rate = static_cast<double>(kFrameRate) / num_frames;
+    PrintLine(absl::StrFormat(
+        "%d ms superframes: %.1f packets per second, %.0f bps with %d header "
+        "bytes per packet",
+        num_frames * 1000 / kFrameRate, packet_rate,
+        bitrate + packet_rate * header_bytes * CHAR_BIT, header_bytes));
+#ifdef BENCHMARK
+    const int num_hops = std::max(num_superframes * num_frames, 1);
+    PrintLine(absl::StrFormat(
+        "%d ms superframes: encoding %.1f us per hop, decoding %.1f us per "
+        "hop",
+        num_frames * 1000 / kFrameRate,
+        absl::ToDoubleMicroseconds(encode_time) / num_hops,
+        absl::ToDoubleMicroseconds(decode_time) / num_hops));
+#endif  // BENCHMARK
+  }
+  return 0;
+}
+
+int lyra_packet_analysis_benchmark(const int num_cond_vectors,
+                                   const std::string& model_base_path) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  const auto input = ReadBenchmarkInput(num_cond_vectors, /*wav_path=*/"");
+  if (!input.has_value()) {
+    return -1;
+  }
+  auto encoder = LyraEncoder::Create(kInternalSampleRateHz, kNumChannels,
+                                     GetBitrate(kNumQuantizedBits),
+                                     /*enable_dtx=*/false, model_path);
+  auto decoder =
+      LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path);
+  auto analyzer = PacketAnalyzer::Create(model_path);
+  if (encoder == nullptr || decoder == nullptr || analyzer == nullptr) {
+    LOG(ERROR) << "Could not create encoder, decoder or analyzer.";
+    return -1;
+  }
+  std::vector<std::vector<uint8_t>> packets;
+  for (int i = 0; i + num_samples_per_hop <= input->size();
+       i += num_samples_per_hop) {
+    auto packet = encoder->Encode(
+        absl::MakeConstSpan(&input->at(i), num_samples_per_hop));
+    if (!packet.has_value()) {
+      LOG(ERROR) << "Could not encode hop " << packets.size() << ".";
+      return -1;
+    }
+    packets.push_back(std::move(packet.value()));
+  }
+
+  PacketAnalyzer::StreamState state;
+  int num_speech_hops = 0;
+#ifdef BENCHMARK
+  const absl::Time analysis_start = absl::Now();
+#endif  // BENCHMARK
+  for (const std::vector<uint8_t>& packet : packets) {
+    const auto analysis = analyzer->Analyze(packet, &state);
+    if (!analysis.has_value()) {
+      LOG(ERROR) << "Could not analyze packet.";
+      return -1;
+    }
+    num_speech_hops += analysis->is_speech;
+  }
+#ifdef BENCHMARK
+  const absl::Duration analysis_time = absl::Now() - analysis_start;
+  const absl::Time decode_start = absl::Now();
+#endif  // BENCHMARK
+  for (const std::vector<uint8_t>& packet : packets) {
+    if (!decoder->SetEncodedPacket(packet) ||
+        !decoder->DecodeSamples(num_samples_per_hop).has_value()) {
+      LOG(ERROR) << "Could not decode packet.";
+      return -1;
+    }
+  }
+  PrintLine(absl::StrFormat("%d of %d packets analyzed as speech.",
+                            num_speech_hops, packets.size()));
+#ifdef BENCHMARK
+  const absl::Duration decode_time = absl::Now() - decode_start;
+  const int num_packets = std::max(static_cast<int>(packets.size()), 1);
+  PrintLine(absl::StrFormat(
+      "Analyzing %.1f us per packet, decoding %.1f us per packet.",
+      absl::ToDoubleMicroseconds(analysis_time) / num_packets,
+      absl::ToDoubleMicroseconds(decode_time) / num_packets));
+#endif  // BENCHMARK
+  return 0;
+}
+
+int lyra_float_io_benchmark(const int num_cond_vectors,
+                            const std::string& model_base_path,
+                            const int sample_rate_hz) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz);
+  std::uniform_real_distribution<float> distribution(-1.0, 1.0);
+  std::default_random_engine generator;
+  std::vector<float> input(num_cond_vectors * num_samples_per_hop);
+  std::generate(input.begin(), input.end(),
+                [&]() { return distribution(generator); });
+
+  // Index 0 codes through the int16 API, index 1 through the float API.
+  std::vector<float> outputs[2];
+#ifdef BENCHMARK
+  absl::Duration durations[2];
+#endif  // BENCHMARK
+  for (const bool use_float : {false, true}) {
+    auto encoder =
+        LyraEncoder::Create(sample_rate_hz, kNumChannels,
+                            GetBitrate(kNumQuantizedBits),
+                            /*enable_dtx=*/false, model_path);
+    auto decoder = LyraDecoder::Create(sample_rate_hz, kNumChannels,
+                                       model_path);
+    if (encoder == nullptr || decoder == nullptr) {
+      LOG(ERROR) << "Could not create encoder or decoder.";
+      return -1;
+    }
+    std::vector<float>& output = outputs[use_float];
+    output.reserve(input.size());
+#ifdef BENCHMARK
+    const absl::Time start = absl::Now();
+#endif  // BENCHMARK
+    for (int i = 0; i < num_cond_vectors; ++i) {
+      const absl::Span<const float> hop =
+          absl::MakeConstSpan(&input.at(i * num_samples_per_hop),
+                              num_samples_per_hop);
+      std::optional<std::vector<float>> samples;
+      if (use_float) {
+        const auto packet = encoder->EncodeFloat(hop);
+        if (packet.has_value() && decoder->SetEncodedPacket(packet.value())) {
+          samples = decoder->DecodeSamplesFloat(num_samples_per_hop);
+        }
+      } else {
+        const auto packet = encoder->Encode(UnitToInt16(hop));
+        if (packet.has_value() && decoder->SetEncodedPacket(packet.value())) {
+          const auto int16_samples =
+              decoder->DecodeSamples(num_samples_per_hop);
+          if (int16_samples.has_value()) {
+            samples = Int16ToUnit<float>(int16_samples.value());
+          }
+        }
+      }
+      if (!samples.has_value()) {
+        LOG(ERROR) << "Could not code hop " << i << ".";
+        return -1;
+      }
+      output.insert(output.end(), samples->begin(), samples->end());
+    }
+#ifdef BENCHMARK
+    durations[use_float] = absl::Now() - start;
+#endif  // BENCHMARK
+  }
+
+  float max_difference = 0.f;
+  for (int i = 0; i < input.size(); ++i) {
+    max_difference =
+        std::max(max_difference, std::abs(outputs[0][i] - outputs[1][i]));
+  }
+  PrintLine(absl::StrFormat(
+      "Largest difference of the float output to the int16 output: %.2f "
+      "int16 steps.",
+      max_difference * 32768.f));
+#ifdef BENCHMARK
+  PrintLine(absl::StrFormat(
+      "%d Hz: int16 API %.1f us per hop, float API %.1f us per hop.",
+      sample_rate_hz,
+      absl::ToDoubleMicroseconds(durations[0]) / num_cond_vectors,
+      absl::ToDoubleMicroseconds(durations[1]) / num_cond_vectors));
+#endif  // BENCHMARK
+  return 0;
+}
+
+int lyra_fec_benchmark(const int num_cond_vectors,
+                       const std::string& model_base_path,
+                       const float packet_loss_rate,
+                       const float average_burst_length,
+                       const std::string& wav_path) {
+  if (num_cond_vectors <= 0) {
+    LOG(ERROR) << "The number of conditioning vectors has to be positive.";
+    return -1;
+  }
+  const std::string model_path = GetCompleteArchitecturePath(model_base_path);
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  const auto input = ReadBenchmarkInput(num_cond_vectors, wav_path);
+  if (!input.has_value()) {
+    return -1;
+  }
+  // Every bitrate loses the same packets.
+  auto packet_loss_model = GilbertModel::Create(
+      packet_loss_rate, average_burst_length, /*random_seed=*/false);
+  if (packet_loss_model == nullptr) {
+    return -1;
+  }
+  const int num_hops = input->size() / num_samples_per_hop;
+  std::vector<bool> is_received(num_hops);
+  std::vector<bool> none_lost(num_hops, true);
+  int num_lost = 0;
+  for (int i = 0; i < num_hops; ++i) {
+    is_received[i] = packet_loss_model->IsPacketReceived();
+    num_lost += !is_received[i];
+  }
+
+  for (const int num_quantized_bits : GetSupportedQuantizedBits()) {
+    const int bitrate = GetBitrate(num_quantized_bits);
+    auto encoder =
+        LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, bitrate,
+                            /*enable_dtx=*/false, model_path);
+    if (encoder == nullptr) {
+      LOG(ERROR) << "Could not create encoder.";
+      return -1;
+    }
+    encoder->set_fec_enabled(true);
+    std::vector<std::vector<uint8_t>> packets;
+    packets.reserve(num_hops);
+    for (int i = 0; i < num_hops; ++i) {
+      auto packet = encoder->Encode(absl::MakeConstSpan(
+          &input->at(i * num_samples_per_hop), num_samples_per_hop));
+      if (!packet.has_value()) {
+        LOG(ERROR) << "Could not encode hop " << i << ".";
+        return -1;
+      }
+      packets.push_back(std::move(packet.value()));
+    }
+
+    int num_recovered = 0;
+    const auto reference = DecodeWithPacketLoss(
+        packets, none_lost, /*use_fec=*/false, model_path, &num_recovered);
+    const auto concealed = DecodeWithPacketLoss(
+        packets, is_received, /*use_fec=*/false, model_path, &num_recovered);
+    const auto recovered = DecodeWithPacketLoss(
+        packets, is_received, /*use_fec=*/true, model_path, &num_recovered);
+    if (!reference.has_value() || !concealed.has_value() ||
+        !recovered.has_value()) {
+      return -1;
+    }
+    const auto concealed_distance = MeanLogSpectralDistance(
+        *reference, *concealed, kInternalSampleRateHz);
+    const auto recovered_distance = MeanLogSpectralDistance(
+        *reference, *recovered, kInternalSampleRateHz);
+    if (!concealed_distance.has_value() || !recovered_distance.has_value()) {
+      LOG(ERROR) << "Could not compute the log-spectral distance.";
+      return -1;
+    }
+
+    PrintLine(absl::StrFormat(
+        "%d bps: %d bps with FEC, %d of %d lost packets recovered", bitrate,
+        GetFecPacketSize(num_quantized_bits) * CHAR_BIT * kFrameRate,
+        num_recovered, num_lost));
+    PrintLine(absl::StrFormat(
+        "%d bps: mean log-spectral distance to lossless decoding: %.3f dB "
+        "concealed, %.3f dB with FEC",
+        bitrate, concealed_distance.value(), recovered_distance.value()));
+  }
+  return 0;
+}
+
 }  // namespace codec
 }  // namespace chromemedia
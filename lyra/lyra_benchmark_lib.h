@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace chromemedia {
 namespace codec {
@@ -35,6 +36,75 @@ int lyra_benchmark(int num_cond_vectors, const std::string& model_base_path,
                    bool benchmark_feature_extraction, bool benchmark_quantizer,
                    bool benchmark_generative_model);
 
+// Runs the full encode/decode pipeline once per |ModelPrecision| and reports
+// the per-frame runtime of each variant together with the mean log-spectral
+// distance of its decoded audio against the float32 variant. If |wav_path| is
+// empty random audio is used, otherwise it has to point to a mono wav file at
+// |kInternalSampleRateHz|.
+int lyra_precision_benchmark(int num_cond_vectors,
+                             const std::string& model_base_path,
+                             const std::string& wav_path);
+
+// Encodes |num_cond_vectors| hops of random audio with a serial LyraEncoder
+// and with a PipelinedEncoder on 2 to |max_num_threads| threads, checks that
+// all produce the same bytes, and reports the throughput of each in hops per
+// second.
+int lyra_pipelined_encoder_benchmark(int num_cond_vectors,
+                                     const std::string& model_base_path,
+                                     int max_num_threads);
+
+// Encodes and decodes |num_cond_vectors| hops of audio serially and split
+// into |num_segments| segments coded in parallel, and reports the runtime of
+// each together with the mean log-spectral distance of the segment-parallel
+// output to the serial output. |wav_path| is used as in
+// |lyra_precision_benchmark|.
+int lyra_segment_parallel_benchmark(int num_cond_vectors,
+                                    const std::string& model_base_path,
+                                    int num_segments,
+                                    const std::string& wav_path);
+
+// Encodes the mono wav files at |wav_paths| at every supported bitrate,
+// archives the packets of each file losslessly and restores them, and reports
+// the size of the archives relative to the packets together with the
+// throughput of archiving and restoring.
+int lyra_archive_benchmark(const std::string& model_base_path,
+                           const std::vector<std::string>& wav_paths);
+
+// Encodes and decodes |num_cond_vectors| hops of random audio at the lowest
+// supported bitrate in superframes of 1 to |kMaxFramesPerSuperframe| hops, and
+// reports the packet rate and bitrate including |header_bytes| of transport
+// headers per packet, together with the encoder and decoder runtime per hop,
+// for every superframe size.
+int lyra_superframe_benchmark(int num_cond_vectors,
+                              const std::string& model_base_path,
+                              int header_bytes);
+
+// Encodes |num_cond_vectors| hops of random audio and reports the runtime
+// per packet of |PacketAnalyzer| next to that of decoding the packets.
+int lyra_packet_analysis_benchmark(int num_cond_vectors,
+                                   const std::string& model_base_path);
+
+// Encodes and decodes |num_cond_vectors| hops of random unit float audio at
+// |sample_rate_hz| through the int16 API, converting at its boundaries, and
+// through the float API, and reports the runtime per hop of both paths
+// together with the largest difference between their decoded samples.
+int lyra_float_io_benchmark(int num_cond_vectors,
+                            const std::string& model_base_path,
+                            int sample_rate_hz);
+
+// Encodes |num_cond_vectors| hops of audio with forward error correction at
+// every supported bitrate, drops packets as a |GilbertModel| with
+// |packet_loss_rate| and |average_burst_length| does, and decodes the rest
+// once concealing every lost packet and once recovering lost packets from the
+// FEC data of the next packet. Reports the bitrate with FEC, the share of lost
+// packets that were recovered, and the mean log-spectral distance of both
+// decodings to decoding without loss. |wav_path| is used as in
+// |lyra_precision_benchmark|.
+int lyra_fec_benchmark(int num_cond_vectors,
+                       const std::string& model_base_path,
+                       float packet_loss_rate, float average_burst_length,
+                       const std::string& wav_path);
+
 }  // namespace codec
 }  // namespace chromemedia
 
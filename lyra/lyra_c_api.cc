@@ -0,0 +1,215 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/lyra_c_api.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/in_place_coding.h"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+// The handles are plain structs outside of any namespace, as they are
+// forward declared by the C header.
+struct lyra_encoder {
+  lyra_encoder(std::unique_ptr<chromemedia::codec::LyraEncoder> encoder,
+               std::vector<uint8_t> initial_state)
+      : encoder(std::move(encoder)),
+        initial_state(std::move(initial_state)) {}
+
+  absl::Mutex mutex;
+  const std::unique_ptr<chromemedia::codec::LyraEncoder> encoder
+      ABSL_PT_GUARDED_BY(mutex);
+  // Saved right after creation, and restored by |lyra_encoder_reset|. A
+  // restore either succeeds or leaves |encoder| untouched, so the handle stays
+  // usable after a failed reset.
+  const std::vector<uint8_t> initial_state;
+  lyra_encoder_stats_t stats ABSL_GUARDED_BY(mutex) = {};
+};
+
+struct lyra_decoder {
+  lyra_decoder(std::unique_ptr<chromemedia::codec::LyraDecoder> decoder,
+               std::vector<uint8_t> initial_state)
+      : decoder(std::move(decoder)),
+        initial_state(std::move(initial_state)) {}
+
+  absl::Mutex mutex;
+  const std::unique_ptr<chromemedia::codec::LyraDecoder> decoder
+      ABSL_PT_GUARDED_BY(mutex);
+  // Saved right after creation, and restored by |lyra_decoder_reset|. A
+  // restore either succeeds or leaves |decoder| untouched, so the handle stays
+  // usable after a failed reset.
+  const std::vector<uint8_t> initial_state;
+  lyra_decoder_stats_t stats ABSL_GUARDED_BY(mutex) = {};
+};
+
+// The header can not include the constexpr sizes of the codec.
+static_assert(LYRA_MAX_PACKET_SIZE == chromemedia::codec::kMaxPacketSize,
+              "LYRA_MAX_PACKET_SIZE has to match the largest packet.");
+
+using chromemedia::codec::DecodeInto;
+using chromemedia::codec::EncodeInto;
+using chromemedia::codec::GetNumSamplesPerHop;
+using chromemedia::codec::IsSampleRateSupported;
+using chromemedia::codec::kNumChannels;
+using chromemedia::codec::LyraDecoder;
+using chromemedia::codec::LyraEncoder;
+
+int lyra_num_samples_per_hop(int sample_rate_hz) {
+  if (!IsSampleRateSupported(sample_rate_hz)) {
+    return -1;
+  }
+  return GetNumSamplesPerHop(sample_rate_hz);
+}
+
+lyra_encoder_t* lyra_encoder_create(int sample_rate_hz, int bitrate,
+                                    int enable_dtx, const char* model_path) {
+  if (model_path == nullptr) {
+    LOG(ERROR) << "The model path is null.";
+    return nullptr;
+  }
+  auto encoder = LyraEncoder::Create(sample_rate_hz, kNumChannels, bitrate,
+                                     enable_dtx != 0, model_path);
+  if (encoder == nullptr) {
+    return nullptr;
+  }
+  auto initial_state = encoder->SaveState();
+  if (!initial_state.has_value()) {
+    return nullptr;
+  }
+  return new lyra_encoder(std::move(encoder),
+                          std::move(initial_state.value()));
+}
+
+void lyra_encoder_destroy(lyra_encoder_t* encoder) { delete encoder; }
+
+int lyra_encoder_encode(lyra_encoder_t* encoder, const int16_t* samples,
+                        int num_samples, uint8_t* packet,
+                        int packet_capacity) {
+  if (encoder == nullptr || samples == nullptr || num_samples < 0 ||
+      packet == nullptr || packet_capacity < 0) {
+    return -1;
+  }
+  absl::MutexLock lock(&encoder->mutex);
+  ++encoder->stats.num_hops;
+  const int packet_size =
+      EncodeInto(encoder->encoder.get(),
+                 absl::MakeConstSpan(samples, num_samples),
+                 absl::MakeSpan(packet, packet_capacity));
+  if (packet_size < 0) {
+    ++encoder->stats.num_failures;
+  } else if (packet_size > 0) {
+    ++encoder->stats.num_packets;
+    encoder->stats.num_packet_bytes += packet_size;
+  }
+  return packet_size;
+}
+
+int lyra_encoder_set_bitrate(lyra_encoder_t* encoder, int bitrate) {
+  if (encoder == nullptr) {
+    return -1;
+  }
+  absl::MutexLock lock(&encoder->mutex);
+  return encoder->encoder->set_bitrate(bitrate) ? 0 : -1;
+}
+
+int lyra_encoder_reset(lyra_encoder_t* encoder) {
+  if (encoder == nullptr) {
+    return -1;
+  }
+  absl::MutexLock lock(&encoder->mutex);
+  return encoder->encoder->RestoreState(encoder->initial_state) ? 0 : -1;
+}
+
+int lyra_encoder_get_stats(lyra_encoder_t* encoder,
+                           lyra_encoder_stats_t* stats) {
+  if (encoder == nullptr || stats == nullptr) {
+    return -1;
+  }
+  absl::MutexLock lock(&encoder->mutex);
+  *stats = encoder->stats;
+  return 0;
+}
+
+lyra_decoder_t* lyra_decoder_create(int sample_rate_hz,
+                                    const char* model_path) {
+  if (model_path == nullptr) {
+    LOG(ERROR) << "The model path is null.";
+    return nullptr;
+  }
+  auto decoder = LyraDecoder::Create(sample_rate_hz, kNumChannels, model_path);
+  if (decoder == nullptr) {
+    return nullptr;
+  }
+  auto initial_state = decoder->SaveState();
+  if (!initial_state.has_value()) {
+    return nullptr;
+  }
+  return new lyra_decoder(std::move(decoder),
+                          std::move(initial_state.value()));
+}
+
+void lyra_decoder_destroy(lyra_decoder_t* decoder) { delete decoder; }
+
+int lyra_decoder_decode(lyra_decoder_t* decoder, const uint8_t* packet,
+                        int packet_size, int16_t* samples, int num_samples) {
+  if (decoder == nullptr || packet_size < 0 ||
+      (packet == nullptr && packet_size > 0) || samples == nullptr ||
+      num_samples < 0) {
+    return -1;
+  }
+  absl::MutexLock lock(&decoder->mutex);
+  if (packet_size > 0) {
+    ++decoder->stats.num_packets;
+    decoder->stats.num_packet_bytes += packet_size;
+  } else {
+    ++decoder->stats.num_concealed_hops;
+  }
+  const int num_decoded =
+      DecodeInto(decoder->decoder.get(),
+                 absl::MakeConstSpan(packet, packet_size),
+                 absl::MakeSpan(samples, num_samples));
+  if (num_decoded < 0) {
+    ++decoder->stats.num_failures;
+  } else {
+    decoder->stats.num_samples += num_decoded;
+  }
+  return num_decoded;
+}
+
+int lyra_decoder_reset(lyra_decoder_t* decoder) {
+  if (decoder == nullptr) {
+    return -1;
+  }
+  absl::MutexLock lock(&decoder->mutex);
+  return decoder->decoder->RestoreState(decoder->initial_state) ? 0 : -1;
+}
+
+int lyra_decoder_get_stats(lyra_decoder_t* decoder,
+                           lyra_decoder_stats_t* stats) {
+  if (decoder == nullptr || stats == nullptr) {
+    return -1;
+  }
+  absl::MutexLock lock(&decoder->mutex);
+  *stats = decoder->stats;
+  return 0;
+}
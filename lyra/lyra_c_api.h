@@ -0,0 +1,123 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_LYRA_C_API_H_
+#define LYRA_LYRA_C_API_H_
+
+/* C API of Lyra, for callers that can not link against the C++ classes.
+ *
+ * Every encoder and decoder is an opaque handle that owns its own models and
+ * state, so any number of handles can be created and used concurrently from
+ * different threads. Calls on the same handle are serialized by a lock in the
+ * handle, so a handle may be shared between threads, but a handle must not be
+ * destroyed while another thread is using it.
+ *
+ * Functions that return an int return -1 on failure. Audio is coded one 20 ms
+ * hop per call, into and from buffers owned by the caller. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct lyra_encoder lyra_encoder_t;
+typedef struct lyra_decoder lyra_decoder_t;
+
+/* Counters since the creation of an encoder. Resetting the encoder does not
+ * clear them. */
+typedef struct {
+  /* Hops passed to |lyra_encoder_encode|. */
+  int64_t num_hops;
+  /* Packets produced, which leaves out the hops DTX did not send. */
+  int64_t num_packets;
+  int64_t num_packet_bytes;
+  int64_t num_failures;
+} lyra_encoder_stats_t;
+
+/* Counters since the creation of a decoder. Resetting the decoder does not
+ * clear them. */
+typedef struct {
+  /* Packets passed to |lyra_decoder_decode|. */
+  int64_t num_packets;
+  int64_t num_packet_bytes;
+  /* Calls without a packet, which conceal a lost hop. */
+  int64_t num_concealed_hops;
+  int64_t num_samples;
+  int64_t num_failures;
+} lyra_decoder_stats_t;
+
+/* Largest packet of any supported bitrate, in bytes, including in-band FEC.
+ * Checked against the codec at compile time. */
+#define LYRA_MAX_PACKET_SIZE 31
+
+/* Returns the number of samples of one hop at |sample_rate_hz|, or -1 if the
+ * sample rate is not supported. */
+int lyra_num_samples_per_hop(int sample_rate_hz);
+
+/* Returns NULL if the parameters are not supported or the models in
+ * |model_path| can not be loaded. |enable_dtx| is 0 or 1. */
+lyra_encoder_t* lyra_encoder_create(int sample_rate_hz, int bitrate,
+                                    int enable_dtx, const char* model_path);
+
+/* Does nothing for NULL. */
+void lyra_encoder_destroy(lyra_encoder_t* encoder);
+
+/* Encodes exactly one hop of |num_samples| samples into |packet|, which has
+ * room for |packet_capacity| bytes. Returns the size of the packet, which is
+ * 0 if DTX left it out. */
+int lyra_encoder_encode(lyra_encoder_t* encoder, const int16_t* samples,
+                        int num_samples, uint8_t* packet, int packet_capacity);
+
+/* Returns 0 on success. */
+int lyra_encoder_set_bitrate(lyra_encoder_t* encoder, int bitrate);
+
+/* Returns the encoder to the state right after its creation, including the
+ * bitrate and the recurrent state of the models, without loading the models
+ * again. Returns 0 on success. On failure the encoder is left as it was. */
+int lyra_encoder_reset(lyra_encoder_t* encoder);
+
+/* Returns 0 on success. */
+int lyra_encoder_get_stats(lyra_encoder_t* encoder,
+                           lyra_encoder_stats_t* stats);
+
+/* Returns NULL if the sample rate is not supported or the models in
+ * |model_path| can not be loaded. */
+lyra_decoder_t* lyra_decoder_create(int sample_rate_hz, const char* model_path);
+
+/* Does nothing for NULL. */
+void lyra_decoder_destroy(lyra_decoder_t* decoder);
+
+/* Decodes the packet of |packet_size| bytes into |num_samples| samples of
+ * |samples|. A NULL |packet| with a |packet_size| of 0 conceals a lost hop.
+ * Returns |num_samples|. */
+int lyra_decoder_decode(lyra_decoder_t* decoder, const uint8_t* packet,
+                        int packet_size, int16_t* samples, int num_samples);
+
+/* Returns the decoder to the state right after its creation, including the
+ * recurrent state of the models, without loading the models again. Returns 0
+ * on success. On failure the decoder is left as it was. */
+int lyra_decoder_reset(lyra_decoder_t* decoder);
+
+/* Returns 0 on success. */
+int lyra_decoder_get_stats(lyra_decoder_t* decoder,
+                           lyra_decoder_stats_t* stats);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif  /* LYRA_LYRA_C_API_H_ */
@@ -0,0 +1,281 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/lyra_c_api.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kBitrate = 6000;
+constexpr int kNumHops = 5;
+constexpr int kNumThreads = 4;
+
+// Packets and samples of a stream coded through the C API.
+struct CodedStream {
+  std::vector<std::vector<uint8_t>> packets;
+  std::vector<int16_t> samples;
+};
+
+class LyraCApiTest : public testing::Test {
+ protected:
+  LyraCApiTest()
+      : model_path_(
+            (ghc::filesystem::current_path() / "lyra/model_coeffs").string()),
+        num_samples_per_hop_(GetNumSamplesPerHop(kInternalSampleRateHz)),
+        audio_(kNumHops * num_samples_per_hop_) {
+    for (int i = 0; i < audio_.size(); ++i) {
+      audio_[i] = 8000 * std::sin(0.05 * i);
+    }
+  }
+
+  // Codes |audio_| with new handles. Returns false on failure.
+  bool CodeStream(CodedStream* stream) const {
+    lyra_encoder_t* encoder = lyra_encoder_create(
+        kInternalSampleRateHz, kBitrate, /*enable_dtx=*/0, model_path_.c_str());
+    lyra_decoder_t* decoder =
+        lyra_decoder_create(kInternalSampleRateHz, model_path_.c_str());
+    bool success = encoder != nullptr && decoder != nullptr;
+    std::vector<int16_t> samples(num_samples_per_hop_);
+    for (int hop = 0; success && hop < kNumHops; ++hop) {
+      std::vector<uint8_t> packet(LYRA_MAX_PACKET_SIZE);
+      const int packet_size = lyra_encoder_encode(
+          encoder, &audio_[hop * num_samples_per_hop_], num_samples_per_hop_,
+          packet.data(), packet.size());
+      success = packet_size > 0 &&
+                lyra_decoder_decode(decoder, packet.data(), packet_size,
+                                    samples.data(), samples.size()) ==
+                    num_samples_per_hop_;
+      packet.resize(std::max(packet_size, 0));
+      stream->packets.push_back(packet);
+      stream->samples.insert(stream->samples.end(), samples.begin(),
+                             samples.end());
+    }
+    lyra_encoder_destroy(encoder);
+    lyra_decoder_destroy(decoder);
+    return success;
+  }
+
+  const std::string model_path_;
+  const int num_samples_per_hop_;
+  std::vector<int16_t> audio_;
+};
+
+TEST_F(LyraCApiTest, CreationFailsWithUnsupportedParams) {
+  EXPECT_EQ(lyra_num_samples_per_hop(44100), -1);
+  EXPECT_EQ(lyra_num_samples_per_hop(kInternalSampleRateHz),
+            num_samples_per_hop_);
+  EXPECT_EQ(lyra_encoder_create(44100, kBitrate, 0, model_path_.c_str()),
+            nullptr);
+  EXPECT_EQ(
+      lyra_encoder_create(kInternalSampleRateHz, 1, 0, model_path_.c_str()),
+      nullptr);
+  EXPECT_EQ(lyra_encoder_create(kInternalSampleRateHz, kBitrate, 0, nullptr),
+            nullptr);
+  EXPECT_EQ(lyra_decoder_create(kInternalSampleRateHz, "invalid/model/path"),
+            nullptr);
+  lyra_encoder_destroy(nullptr);
+  lyra_decoder_destroy(nullptr);
+}
+
+TEST_F(LyraCApiTest, CodesLikeTheCppClasses) {
+  CodedStream stream;
+  ASSERT_TRUE(CodeStream(&stream));
+
+  auto encoder =
+      LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, kBitrate,
+                          /*enable_dtx=*/false, model_path_);
+  auto decoder =
+      LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path_);
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+  for (int hop = 0; hop < kNumHops; ++hop) {
+    const auto packet = encoder->Encode(absl::MakeConstSpan(
+        &audio_[hop * num_samples_per_hop_], num_samples_per_hop_));
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_EQ(stream.packets[hop], packet.value());
+    ASSERT_TRUE(decoder->SetEncodedPacket(packet.value()));
+    const auto samples = decoder->DecodeSamples(num_samples_per_hop_);
+    ASSERT_TRUE(samples.has_value());
+    EXPECT_EQ(std::vector<int16_t>(
+                  stream.samples.begin() + hop * num_samples_per_hop_,
+                  stream.samples.begin() + (hop + 1) * num_samples_per_hop_),
+              samples.value());
+  }
+}
+
+TEST_F(LyraCApiTest, InvalidBuffersFail) {
+  lyra_encoder_t* encoder = lyra_encoder_create(
+      kInternalSampleRateHz, kBitrate, /*enable_dtx=*/0, model_path_.c_str());
+  lyra_decoder_t* decoder =
+      lyra_decoder_create(kInternalSampleRateHz, model_path_.c_str());
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+  std::vector<uint8_t> packet(LYRA_MAX_PACKET_SIZE);
+  std::vector<int16_t> samples(num_samples_per_hop_);
+
+  EXPECT_EQ(lyra_encoder_encode(nullptr, audio_.data(), num_samples_per_hop_,
+                                packet.data(), packet.size()),
+            -1);
+  EXPECT_EQ(lyra_encoder_encode(encoder, audio_.data(),
+                                num_samples_per_hop_ - 1, packet.data(),
+                                packet.size()),
+            -1);
+  EXPECT_EQ(lyra_encoder_encode(encoder, audio_.data(), num_samples_per_hop_,
+                                packet.data(), /*packet_capacity=*/1),
+            -1);
+  EXPECT_EQ(lyra_encoder_set_bitrate(encoder, 1), -1);
+  EXPECT_EQ(lyra_decoder_decode(decoder, nullptr, /*packet_size=*/1,
+                                samples.data(), samples.size()),
+            -1);
+  EXPECT_EQ(lyra_decoder_decode(decoder, packet.data(),
+                                BitrateToPacketSize(kBitrate) + 1,
+                                samples.data(), samples.size()),
+            -1);
+
+  lyra_encoder_stats_t encoder_stats;
+  lyra_decoder_stats_t decoder_stats;
+  ASSERT_EQ(lyra_encoder_get_stats(encoder, &encoder_stats), 0);
+  ASSERT_EQ(lyra_decoder_get_stats(decoder, &decoder_stats), 0);
+  EXPECT_EQ(encoder_stats.num_failures, 2);
+  EXPECT_EQ(encoder_stats.num_packets, 0);
+  EXPECT_EQ(decoder_stats.num_failures, 1);
+  EXPECT_EQ(lyra_encoder_get_stats(encoder, nullptr), -1);
+  lyra_encoder_destroy(encoder);
+  lyra_decoder_destroy(decoder);
+}
+
+TEST_F(LyraCApiTest, ResetRestartsTheStreamAndKeepsStats) {
+  lyra_encoder_t* encoder = lyra_encoder_create(
+      kInternalSampleRateHz, kBitrate, /*enable_dtx=*/0, model_path_.c_str());
+  lyra_decoder_t* decoder =
+      lyra_decoder_create(kInternalSampleRateHz, model_path_.c_str());
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+
+  std::vector<std::vector<uint8_t>> packets[2];
+  std::vector<int16_t> samples[2];
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int hop = 0; hop < kNumHops; ++hop) {
+      std::vector<uint8_t> packet(LYRA_MAX_PACKET_SIZE);
+      const int packet_size = lyra_encoder_encode(
+          encoder, &audio_[hop * num_samples_per_hop_], num_samples_per_hop_,
+          packet.data(), packet.size());
+      ASSERT_GT(packet_size, 0);
+      packet.resize(packet_size);
+      packets[pass].push_back(packet);
+      std::vector<int16_t> hop_samples(num_samples_per_hop_);
+      // Every other hop is concealed.
+      ASSERT_EQ(lyra_decoder_decode(
+                    decoder, hop % 2 == 0 ? packet.data() : nullptr,
+                    hop % 2 == 0 ? packet_size : 0, hop_samples.data(),
+                    hop_samples.size()),
+                num_samples_per_hop_);
+      samples[pass].insert(samples[pass].end(), hop_samples.begin(),
+                           hop_samples.end());
+    }
+    // The reset also undoes the change of bitrate.
+    ASSERT_EQ(lyra_encoder_set_bitrate(encoder, 9200), 0);
+    ASSERT_EQ(lyra_encoder_reset(encoder), 0);
+    ASSERT_EQ(lyra_decoder_reset(decoder), 0);
+  }
+  EXPECT_EQ(packets[0], packets[1]);
+  EXPECT_EQ(samples[0], samples[1]);
+
+  lyra_encoder_stats_t encoder_stats;
+  lyra_decoder_stats_t decoder_stats;
+  ASSERT_EQ(lyra_encoder_get_stats(encoder, &encoder_stats), 0);
+  ASSERT_EQ(lyra_decoder_get_stats(decoder, &decoder_stats), 0);
+  EXPECT_EQ(encoder_stats.num_hops, 2 * kNumHops);
+  EXPECT_EQ(encoder_stats.num_packets, 2 * kNumHops);
+  EXPECT_EQ(encoder_stats.num_packet_bytes,
+            2 * kNumHops * BitrateToPacketSize(kBitrate));
+  EXPECT_EQ(encoder_stats.num_failures, 0);
+  EXPECT_EQ(decoder_stats.num_packets, 2 * ((kNumHops + 1) / 2));
+  EXPECT_EQ(decoder_stats.num_concealed_hops, 2 * (kNumHops / 2));
+  EXPECT_EQ(decoder_stats.num_samples, 2 * kNumHops * num_samples_per_hop_);
+  EXPECT_EQ(decoder_stats.num_failures, 0);
+  lyra_encoder_destroy(encoder);
+  lyra_decoder_destroy(decoder);
+}
+
+// Handles used on several threads at once have to code exactly as a single
+// handle on its own.
+TEST_F(LyraCApiTest, ConcurrentHandlesCodeIndependently) {
+  CodedStream expected;
+  ASSERT_TRUE(CodeStream(&expected));
+
+  std::vector<CodedStream> streams(kNumThreads);
+  std::vector<char> successes(kNumThreads, false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this, &streams, &successes, i]() {
+      successes[i] = CodeStream(&streams[i]);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int i = 0; i < kNumThreads; ++i) {
+    ASSERT_TRUE(successes[i]);
+    EXPECT_EQ(streams[i].packets, expected.packets);
+    EXPECT_EQ(streams[i].samples, expected.samples);
+  }
+}
+
+// One handle shared by several threads serializes their calls.
+TEST_F(LyraCApiTest, SharedHandleSerializesCalls) {
+  lyra_encoder_t* encoder = lyra_encoder_create(
+      kInternalSampleRateHz, kBitrate, /*enable_dtx=*/0, model_path_.c_str());
+  ASSERT_NE(encoder, nullptr);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this, encoder]() {
+      std::vector<uint8_t> packet(LYRA_MAX_PACKET_SIZE);
+      for (int hop = 0; hop < kNumHops; ++hop) {
+        lyra_encoder_encode(encoder, &audio_[hop * num_samples_per_hop_],
+                            num_samples_per_hop_, packet.data(),
+                            packet.size());
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  lyra_encoder_stats_t stats;
+  ASSERT_EQ(lyra_encoder_get_stats(encoder, &stats), 0);
+  EXPECT_EQ(stats.num_hops, kNumThreads * kNumHops);
+  EXPECT_EQ(stats.num_packets, kNumThreads * kNumHops);
+  EXPECT_EQ(stats.num_failures, 0);
+  lyra_encoder_destroy(encoder);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -15,14 +15,17 @@
 #include "lyra/lyra_components.h"
 
 #include <memory>
+#include <utility>
 
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/generative_model_interface.h"
 #include "lyra/lyra_gan_model.h"
+#include "lyra/model_bundle.h"
 #include "lyra/packet.h"
 #include "lyra/packet_interface.h"
 #include "lyra/residual_vector_quantizer.h"
 #include "lyra/soundstream_encoder.h"
+#include "lyra/tflite_model_wrapper.h"
 #include "lyra/vector_quantizer_interface.h"
 #include "lyra/zero_feature_estimator.h"
 
@@ -40,18 +43,36 @@ constexpr int kMaxNumPacketBits = 184;
 }  // namespace
 
 std::unique_ptr<VectorQuantizerInterface> CreateQuantizer(
-    const ghc::filesystem::path& model_path) {
-  return ResidualVectorQuantizer::Create(model_path);
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
+  return ResidualVectorQuantizer::Create(model_path, precision);
 }
 
 std::unique_ptr<GenerativeModelInterface> CreateGenerativeModel(
-    int num_output_features, const ghc::filesystem::path& model_path) {
-  return LyraGanModel::Create(model_path, num_output_features);
+    int num_output_features, const ghc::filesystem::path& model_path,
+    ModelPrecision precision) {
+  return LyraGanModel::Create(model_path, num_output_features, precision);
 }
 
 std::unique_ptr<FeatureExtractorInterface> CreateFeatureExtractor(
-    const ghc::filesystem::path& model_path) {
-  return SoundStreamEncoder::Create(model_path);
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
+  return SoundStreamEncoder::Create(model_path, precision);
+}
+
+std::unique_ptr<VectorQuantizerInterface> CreateQuantizer(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  return ResidualVectorQuantizer::Create(std::move(bundle), precision);
+}
+
+std::unique_ptr<GenerativeModelInterface> CreateGenerativeModel(
+    int num_output_features, std::shared_ptr<const ModelBundle> bundle,
+    ModelPrecision precision) {
+  return LyraGanModel::Create(std::move(bundle), num_output_features,
+                              precision);
+}
+
+std::unique_ptr<FeatureExtractorInterface> CreateFeatureExtractor(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  return SoundStreamEncoder::Create(std::move(bundle), precision);
 }
 
 std::unique_ptr<PacketInterface> CreatePacket(int num_header_bits,
@@ -23,20 +23,38 @@
 #include "lyra/feature_estimator_interface.h"
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/generative_model_interface.h"
+#include "lyra/model_bundle.h"
 #include "lyra/packet_interface.h"
+#include "lyra/tflite_model_wrapper.h"
 #include "lyra/vector_quantizer_interface.h"
 
 namespace chromemedia {
 namespace codec {
 
 std::unique_ptr<VectorQuantizerInterface> CreateQuantizer(
-    const ghc::filesystem::path& model_path);
+    const ghc::filesystem::path& model_path,
+    ModelPrecision precision = ModelPrecision::kFloat32);
 
 std::unique_ptr<GenerativeModelInterface> CreateGenerativeModel(
-    int num_output_features, const ghc::filesystem::path& model_path);
+    int num_output_features, const ghc::filesystem::path& model_path,
+    ModelPrecision precision = ModelPrecision::kInt8);
 
 std::unique_ptr<FeatureExtractorInterface> CreateFeatureExtractor(
-    const ghc::filesystem::path& model_path);
+    const ghc::filesystem::path& model_path,
+    ModelPrecision precision = ModelPrecision::kInt8);
+
+// Like the above, but load the models from |bundle|.
+std::unique_ptr<VectorQuantizerInterface> CreateQuantizer(
+    std::shared_ptr<const ModelBundle> bundle,
+    ModelPrecision precision = ModelPrecision::kFloat32);
+
+std::unique_ptr<GenerativeModelInterface> CreateGenerativeModel(
+    int num_output_features, std::shared_ptr<const ModelBundle> bundle,
+    ModelPrecision precision = ModelPrecision::kInt8);
+
+std::unique_ptr<FeatureExtractorInterface> CreateFeatureExtractor(
+    std::shared_ptr<const ModelBundle> bundle,
+    ModelPrecision precision = ModelPrecision::kInt8);
 
 std::unique_ptr<PacketInterface> CreatePacket(int num_header_bits,
                                               int num_quantized_bits);
@@ -14,6 +14,7 @@
 
 #include "lyra/lyra_config.h"
 
+#include <iterator>
 #include <vector>
 
 #include "absl/strings/string_view.h"
@@ -21,36 +22,12 @@
 namespace chromemedia {
 namespace codec {
 
-// The Lyra version is |kVersionMajor|.|kVersionMinor|.|kVersionMicro|
-// The version is not used internally, but clients may use it to configure
-// behavior, such as checking for version bumps that break the bitstream.
-// The major version should be bumped for major architectural changes.
-const int kVersionMajor = 1;
-// The minor version needs to be increased every time a new version requires a
-// simultaneous change in code and weights or if the bit stream is modified. The
-// |identifier| field needs to be set in lyra_config.textproto to match this.
-const int kVersionMinor = 3;
-// The micro version is for other things like a release of bugfixes.
-const int kVersionMicro = 2;
-
-const int kNumFeatures = 64;
-const int kNumMelBins = 160;
-const int kNumChannels = 1;
-const int kOverlapFactor = 2;
-
-// LINT.IfChange
-const int kNumHeaderBits = 0;
-const int kFrameRate = 50;
 const std::vector<int>& GetSupportedQuantizedBits() {
   static const std::vector<int>* const supported_quantization_bits =
-      new std::vector<int>{64, 120, 184};
+      new std::vector<int>(std::begin(kSupportedQuantizedBits),
+                           std::end(kSupportedQuantizedBits));
   return *supported_quantization_bits;
 }
-// LINT.ThenChange(
-// lyra_components.cc,
-// lyra_encoder.h,
-// residual_vector_quantizer.h,
-// )
 
 std::vector<absl::string_view> GetAssets() {
   return std::vector<absl::string_view>{"quantizer.tflite", "lyragan.tflite",
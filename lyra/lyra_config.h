@@ -22,40 +22,65 @@
 #include <cmath>
 #include <fstream>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 
-#include "absl/base/attributes.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
 #include "lyra/lyra_config.pb.h"
+#include "lyra/model_bundle.h"
 
 namespace chromemedia {
 namespace codec {
 
 // This file is reserved for non-configurable values needed by both the decoder
-// and encoder. What those non-configurable values are depends on which project
-// is chosen to be compiled.  As a result, a struct holding the configuration
-// data is defined to ensure each new target added and each new configuration
-// element is explicitly defined.
-
-ABSL_CONST_INIT extern const int kVersionMajor;
-ABSL_CONST_INIT extern const int kVersionMinor;
-ABSL_CONST_INIT extern const int kVersionMicro;
-ABSL_CONST_INIT extern const int kNumFeatures;
-ABSL_CONST_INIT extern const int kNumMelBins;
-ABSL_CONST_INIT extern const int kNumChannels;
-ABSL_CONST_INIT extern const int kFrameRate;  // Frames/packets sent per second.
-ABSL_CONST_INIT extern const int kOverlapFactor;
-ABSL_CONST_INIT extern const int kNumHeaderBits;
+// and encoder. They are constexpr, so that buffer sizes and loop bounds derived
+// from them are known at compile time.
+
+// The Lyra version is |kVersionMajor|.|kVersionMinor|.|kVersionMicro|
+// The version is not used internally, but clients may use it to configure
+// behavior, such as checking for version bumps that break the bitstream.
+// The major version should be bumped for major architectural changes.
+inline constexpr int kVersionMajor = 1;
+// The minor version needs to be increased every time a new version requires a
+// simultaneous change in code and weights or if the bit stream is modified. The
+// |identifier| field needs to be set in lyra_config.textproto to match this.
+inline constexpr int kVersionMinor = 3;
+// The micro version is for other things like a release of bugfixes.
+inline constexpr int kVersionMicro = 2;
+
+inline constexpr int kNumFeatures = 64;
+inline constexpr int kNumMelBins = 160;
+inline constexpr int kNumChannels = 1;
+inline constexpr int kOverlapFactor = 2;
+
+// LINT.IfChange
+inline constexpr int kNumHeaderBits = 0;
+inline constexpr int kFrameRate = 50;  // Frames/packets sent per second.
+// LINT.ThenChange(
+// lyra_components.cc,
+// lyra_encoder.h,
+// residual_vector_quantizer.h,
+// )
 
 inline constexpr int kSupportedSampleRates[] = {8000, 16000, 32000, 48000};
 inline constexpr int kInternalSampleRateHz = 16000;
 
+// LINT.IfChange
+inline constexpr int kSupportedQuantizedBits[] = {64, 120, 184};
+// LINT.ThenChange(
+// lyra_components.cc,
+// lyra_encoder.h,
+// residual_vector_quantizer.h,
+// )
+
+// Returns |kSupportedQuantizedBits|.
 const std::vector<int>& GetSupportedQuantizedBits();
 
 // Returns a string of form "|kVersionMajor|.|kVersionMinor|.|kVersionMicro|".
@@ -76,9 +101,9 @@ inline int GetNumSamplesPerWindow(int sample_rate_hz) {
   return kOverlapFactor * GetNumSamplesPerHop(sample_rate_hz);
 }
 
-inline int GetPacketSize(int num_quantized_bits) {
-  return static_cast<int>(std::ceil(
-      static_cast<float>(num_quantized_bits + kNumHeaderBits) / CHAR_BIT));
+// Rounds up to whole bytes in integer arithmetic, so that it is constexpr.
+constexpr int GetPacketSize(int num_quantized_bits) {
+  return (num_quantized_bits + kNumHeaderBits + CHAR_BIT - 1) / CHAR_BIT;
 }
 
 inline int BitrateToPacketSize(int bitrate) {
@@ -90,12 +115,35 @@ inline int GetBitrate(int num_quantized_bits) {
   return GetPacketSize(num_quantized_bits) * CHAR_BIT * kFrameRate;
 }
 
-inline bool IsSampleRateSupported(int sample_rate_hz) {
-  return std::find(std::begin(kSupportedSampleRates),
-                   std::end(kSupportedSampleRates),
-                   sample_rate_hz) != std::end(kSupportedSampleRates);
+constexpr bool IsSampleRateSupported(int sample_rate_hz) {
+  for (const int supported_sample_rate_hz : kSupportedSampleRates) {
+    if (sample_rate_hz == supported_sample_rate_hz) {
+      return true;
+    }
+  }
+  return false;
 }
 
+// The sizes of a stream at |SampleRateHz| as compile-time constants, for the
+// components that always run at one rate. Unlike |GetNumSamplesPerHop|, which
+// checks the rate on every call, an unsupported rate fails to compile.
+template <int SampleRateHz>
+struct CodecProfile {
+  static_assert(IsSampleRateSupported(SampleRateHz),
+                "The sample rate is not supported.");
+  static_assert(SampleRateHz % kFrameRate == 0,
+                "A hop has to be a whole number of samples.");
+
+  static constexpr int kSampleRateHz = SampleRateHz;
+  static constexpr int kNumSamplesPerHop = SampleRateHz / kFrameRate;
+  static constexpr int kNumSamplesPerWindow =
+      kOverlapFactor * kNumSamplesPerHop;
+};
+
+// Profile of the feature extractor, the quantizer and the generative model,
+// which all run at |kInternalSampleRateHz|.
+using InternalProfile = CodecProfile<kInternalSampleRateHz>;
+
 inline int PacketSizeToNumQuantizedBits(int packet_size) {
   for (int num_quantized_bits : GetSupportedQuantizedBits()) {
     if (packet_size == GetPacketSize(num_quantized_bits)) {
@@ -114,11 +162,74 @@ inline int BitrateToNumQuantizedBits(int bitrate) {
   return -1;
 }
 
+// A superframe is the concatenation of the packets of up to
+// |kMaxFramesPerSuperframe| consecutive hops of the same bitrate, which trades
+// latency for fewer packets per second.
+inline constexpr int kMaxFramesPerSuperframe = 4;
+
+// Returns the number of quantized bits of every frame of a superframe of
+// |superframe_size| bytes and stores its number of frames in |num_frames|, or
+// returns -1 if no single combination of a supported bitrate and a number of
+// frames results in that size.
+inline int SuperframeSizeToNumQuantizedBits(int superframe_size,
+                                            int* num_frames) {
+  int result = -1;
+  for (int num_quantized_bits : GetSupportedQuantizedBits()) {
+    const int packet_size = GetPacketSize(num_quantized_bits);
+    const int frames = superframe_size / packet_size;
+    if (superframe_size % packet_size != 0 || frames < 1 ||
+        frames > kMaxFramesPerSuperframe) {
+      continue;
+    }
+    if (result >= 0) {
+      return -1;
+    }
+    result = num_quantized_bits;
+    *num_frames = frames;
+  }
+  return result;
+}
+
+// With in-band forward error correction (FEC) every packet is followed by a
+// packet of the previous hop at the lowest supported bitrate. The residual
+// vector quantizer puts its coarsest quantizers first, so those are the first
+// |kNumFecQuantizedBits| quantized bits of the previous hop at any bitrate,
+// and a decoder can recover a single lost hop from the packet after it.
+inline constexpr int kNumFecQuantizedBits = 64;
+
+constexpr int GetFecPacketSize(int num_quantized_bits) {
+  return GetPacketSize(num_quantized_bits) +
+         GetPacketSize(kNumFecQuantizedBits);
+}
+
+// The largest packet of one hop at any supported bitrate, FEC included, for
+// buffers that have to hold any packet.
+constexpr int GetMaxPacketSize() {
+  int max_packet_size = 0;
+  for (const int num_quantized_bits : kSupportedQuantizedBits) {
+    max_packet_size =
+        std::max(max_packet_size, GetFecPacketSize(num_quantized_bits));
+  }
+  return max_packet_size;
+}
+
+inline constexpr int kMaxPacketSize = GetMaxPacketSize();
+
+// Returns the number of quantized bits of the primary packet of an FEC packet
+// of |packet_size| bytes, or -1 if the size is not supported.
+inline int FecPacketSizeToNumQuantizedBits(int packet_size) {
+  for (int num_quantized_bits : GetSupportedQuantizedBits()) {
+    if (packet_size == GetFecPacketSize(num_quantized_bits)) {
+      return num_quantized_bits;
+    }
+  }
+  return -1;
+}
+
 std::vector<absl::string_view> GetAssets();
 
-inline absl::Status AreParamsSupported(
-    int sample_rate_hz, int num_channels,
-    const ghc::filesystem::path& model_path) {
+inline absl::Status AreStreamParamsSupported(int sample_rate_hz,
+                                             int num_channels) {
   if (!IsSampleRateSupported(sample_rate_hz)) {
     return absl::InvalidArgumentError(absl::StrFormat(
         "Sample rate %d Hz is not supported by codec.", sample_rate_hz));
@@ -128,20 +239,38 @@ inline absl::Status AreParamsSupported(
         "Number of channels %d is not supported by codec. It needs to be %d.",
         num_channels, kNumChannels));
   }
-  for (auto asset : GetAssets()) {
-    std::error_code error;
-    const bool exists =
-        ghc::filesystem::exists(model_path / std::string(asset), error);
-    if (error) {
-      return absl::UnknownError(
-          absl::StrFormat("Error when probing for asset %s in %s: %s", asset,
-                          model_path, error.message()));
-    }
-    if (!exists) {
+  return absl::OkStatus();
+}
+
+// Returns the identifier in the lyra_config.binarypb section of |bundle|.
+// Defaults to 0 if there is no such section.
+inline absl::StatusOr<int> GetWeightsIdentifier(const ModelBundle& bundle) {
+  third_party::lyra_codec::lyra::LyraConfig lyra_config;
+  const auto section = bundle.GetSection("lyra_config.binarypb");
+  if (section.has_value() &&
+      !lyra_config.ParseFromArray(section->data(), section->size())) {
+    return absl::UnknownError(
+        "Error when parsing lyra_config.binarypb of model bundle");
+  }
+  return lyra_config.identifier();
+}
+
+// Returns the identifier in the lyra_config.binarypb of |model_path|, which
+// can be a model directory or a |ModelBundle|. Defaults to 0 if there is no
+// lyra_config.binarypb.
+inline absl::StatusOr<int> GetWeightsIdentifier(
+    const ghc::filesystem::path& model_path) {
+  if (ModelBundle::IsBundle(model_path)) {
+    const std::shared_ptr<const ModelBundle> bundle =
+        ModelBundle::Open(model_path);
+    if (bundle == nullptr) {
       return absl::InvalidArgumentError(
-          absl::StrFormat("Asset %s does not exist in %s.", asset, model_path));
+          absl::StrFormat("Could not open model bundle %s.", model_path));
     }
+    return GetWeightsIdentifier(*bundle);
   }
+
+  third_party::lyra_codec::lyra::LyraConfig lyra_config;
   const ghc::filesystem::path lyra_config_proto_path =
       model_path / "lyra_config.binarypb";
   std::error_code error;
@@ -151,7 +280,6 @@ inline absl::Status AreParamsSupported(
         absl::StrFormat("Error when probing for asset %s: %s",
                         lyra_config_proto_path.string(), error.message()));
   }
-  third_party::lyra_codec::lyra::LyraConfig lyra_config;
   if (exists) {
     std::ifstream lyra_config_stream(lyra_config_proto_path.string());
     if (!lyra_config.ParseFromIstream(&lyra_config_stream)) {
@@ -159,10 +287,54 @@ inline absl::Status AreParamsSupported(
           "Error when parsing %s", lyra_config_proto_path.string()));
     }
   }
-  if (lyra_config.identifier() != kVersionMinor) {
+  return lyra_config.identifier();
+}
+
+inline absl::Status AreParamsSupported(
+    int sample_rate_hz, int num_channels,
+    const ghc::filesystem::path& model_path) {
+  absl::Status are_stream_params_supported =
+      AreStreamParamsSupported(sample_rate_hz, num_channels);
+  if (!are_stream_params_supported.ok()) {
+    return are_stream_params_supported;
+  }
+  if (ModelBundle::IsBundle(model_path)) {
+    const std::shared_ptr<const ModelBundle> bundle =
+        ModelBundle::Open(model_path);
+    if (bundle == nullptr) {
+      return absl::InvalidArgumentError(
+          absl::StrFormat("Could not open model bundle %s.", model_path));
+    }
+    for (auto asset : GetAssets()) {
+      if (!bundle->GetSection(asset).has_value()) {
+        return absl::InvalidArgumentError(absl::StrFormat(
+            "Asset %s does not exist in %s.", asset, model_path));
+      }
+    }
+  } else {
+    for (auto asset : GetAssets()) {
+      std::error_code error;
+      const bool exists =
+          ghc::filesystem::exists(model_path / std::string(asset), error);
+      if (error) {
+        return absl::UnknownError(
+            absl::StrFormat("Error when probing for asset %s in %s: %s", asset,
+                            model_path, error.message()));
+      }
+      if (!exists) {
+        return absl::InvalidArgumentError(absl::StrFormat(
+            "Asset %s does not exist in %s.", asset, model_path));
+      }
+    }
+  }
+  const absl::StatusOr<int> identifier = GetWeightsIdentifier(model_path);
+  if (!identifier.ok()) {
+    return identifier.status();
+  }
+  if (*identifier != kVersionMinor) {
     return absl::InvalidArgumentError(absl::StrFormat(
         "Weights identifier (%d) is not compatible with code identifier (%d).",
-        lyra_config.identifier(), kVersionMinor));
+        *identifier, kVersionMinor));
   }
   return absl::OkStatus();
 }
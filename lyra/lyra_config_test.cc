@@ -14,6 +14,9 @@
 
 #include "lyra/lyra_config.h"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -91,6 +94,19 @@ TEST(LyraConfig, TestGetVersionString) {
   EXPECT_EQ(std::stoi(micro_string), kVersionMicro);
 }
 
+// The compile-time profiles have to agree with the runtime functions.
+TEST(LyraConfig, ProfilesMatchRuntimeSizes) {
+  static_assert(IsSampleRateSupported(kInternalSampleRateHz));
+  static_assert(!IsSampleRateSupported(44100));
+  EXPECT_EQ(InternalProfile::kNumSamplesPerHop,
+            GetNumSamplesPerHop(kInternalSampleRateHz));
+  EXPECT_EQ(InternalProfile::kNumSamplesPerWindow,
+            GetNumSamplesPerWindow(kInternalSampleRateHz));
+  EXPECT_EQ(CodecProfile<48000>::kNumSamplesPerHop, GetNumSamplesPerHop(48000));
+  EXPECT_EQ(CodecProfile<8000>::kNumSamplesPerWindow,
+            GetNumSamplesPerWindow(8000));
+}
+
 TEST_F(LyraConfigTest, GoodPacketSizeSupported) {
   for (int num_quantized_bits : GetSupportedQuantizedBits()) {
     EXPECT_EQ(PacketSizeToNumQuantizedBits(GetPacketSize(num_quantized_bits)),
@@ -113,6 +129,56 @@ TEST_F(LyraConfigTest, BadBitrateNotSupported) {
   EXPECT_LT(BitrateToNumQuantizedBits(0), 0);
 }
 
+// Every superframe size has to identify its bitrate and number of frames.
+TEST_F(LyraConfigTest, SuperframeSizesAreUnambiguous) {
+  for (int num_quantized_bits : GetSupportedQuantizedBits()) {
+    for (int frames = 1; frames <= kMaxFramesPerSuperframe; ++frames) {
+      int num_frames = 0;
+      EXPECT_EQ(SuperframeSizeToNumQuantizedBits(
+                    frames * GetPacketSize(num_quantized_bits), &num_frames),
+                num_quantized_bits);
+      EXPECT_EQ(num_frames, frames);
+    }
+  }
+}
+
+TEST_F(LyraConfigTest, BadSuperframeSizeNotSupported) {
+  int num_frames = 0;
+  EXPECT_LT(SuperframeSizeToNumQuantizedBits(0, &num_frames), 0);
+  const int largest_packet_size =
+      GetPacketSize(GetSupportedQuantizedBits().back());
+  EXPECT_LT(SuperframeSizeToNumQuantizedBits(
+                (kMaxFramesPerSuperframe + 1) * largest_packet_size,
+                &num_frames),
+            0);
+}
+
+// The FEC data has to fit the coarsest quantizers of every supported bitrate.
+TEST_F(LyraConfigTest, FecPacketSizesAreSupported) {
+  EXPECT_EQ(GetSupportedQuantizedBits().front(), kNumFecQuantizedBits);
+  for (int num_quantized_bits : GetSupportedQuantizedBits()) {
+    EXPECT_EQ(
+        FecPacketSizeToNumQuantizedBits(GetFecPacketSize(num_quantized_bits)),
+        num_quantized_bits);
+  }
+  EXPECT_LT(FecPacketSizeToNumQuantizedBits(
+                GetPacketSize(GetSupportedQuantizedBits().front())),
+            0);
+}
+
+TEST_F(LyraConfigTest, MaxPacketSizeIsTheLargestFecPacket) {
+  int max_packet_size = 0;
+  for (int num_quantized_bits : GetSupportedQuantizedBits()) {
+    EXPECT_EQ(GetPacketSize(num_quantized_bits),
+              static_cast<int>(std::ceil(
+                  static_cast<float>(num_quantized_bits + kNumHeaderBits) /
+                  CHAR_BIT)));
+    max_packet_size =
+        std::max(max_packet_size, GetFecPacketSize(num_quantized_bits));
+  }
+  EXPECT_EQ(kMaxPacketSize, max_packet_size);
+}
+
 TEST_F(LyraConfigTest, GoodParamsSupported) {
   EXPECT_TRUE(
       AreParamsSupported(kInternalSampleRateHz, kNumChannels, test_model_path_)
@@ -0,0 +1,335 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/lyra_container.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr char kHeaderMagic[4] = {'L', 'Y', 'R', 'A'};
+constexpr char kTrailerMagic[4] = {'L', 'Y', 'R', 'X'};
+constexpr uint8_t kVersion = 1;
+constexpr int kHeaderSize = 8;
+constexpr int kIndexEntrySize = 9;
+constexpr int kTrailerSize = 28;
+// Code bytes from this value on stand for runs of empty packets.
+constexpr int kEmptyRunCode = 128;
+constexpr int kMaxEmptyRunLength = 128;
+
+void AppendLittleEndian(uint64_t value, int num_bytes,
+                        std::vector<uint8_t>* bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint64_t LoadLittleEndian(const uint8_t* bytes, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+bool ReadBytes(std::ifstream& stream, uint8_t* bytes, int num_bytes) {
+  stream.read(reinterpret_cast<char*>(bytes), num_bytes);
+  return stream.gcount() == num_bytes;
+}
+
+bool HasHeader(std::ifstream& stream) {
+  uint8_t header[kHeaderSize];
+  return ReadBytes(stream, header, kHeaderSize) &&
+         std::memcmp(header, kHeaderMagic, sizeof(kHeaderMagic)) == 0 &&
+         header[4] == kVersion;
+}
+
+}  // namespace
+
+bool IsLyraContainer(const ghc::filesystem::path& path) {
+  std::ifstream stream(path.string(), std::ios_base::binary);
+  return stream.is_open() && HasHeader(stream);
+}
+
+std::unique_ptr<LyraContainerWriter> LyraContainerWriter::Create(
+    const ghc::filesystem::path& path, int frames_per_index_entry) {
+  if (frames_per_index_entry <= 0) {
+    LOG(ERROR) << "The number of frames per index entry has to be positive.";
+    return nullptr;
+  }
+  std::ofstream stream(path.string(),
+                       std::ios_base::binary | std::ios_base::trunc);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Could not open output file " << path;
+    return nullptr;
+  }
+  auto writer = absl::WrapUnique(
+      new LyraContainerWriter(std::move(stream), frames_per_index_entry));
+  const uint8_t header[kHeaderSize] = {kHeaderMagic[0], kHeaderMagic[1],
+                                       kHeaderMagic[2], kHeaderMagic[3],
+                                       kVersion,        0,
+                                       0,               0};
+  if (!writer->Write(header)) {
+    return nullptr;
+  }
+  return writer;
+}
+
+LyraContainerWriter::LyraContainerWriter(std::ofstream stream,
+                                         int frames_per_index_entry)
+    : stream_(std::move(stream)),
+      frames_per_index_entry_(frames_per_index_entry),
+      num_frames_(0),
+      offset_(0),
+      empty_run_length_(0),
+      empty_run_offset_(0) {}
+
+LyraContainerWriter::~LyraContainerWriter() {
+  if (stream_.is_open()) {
+    Close();
+  }
+}
+
+bool LyraContainerWriter::WriteFrame(absl::Span<const uint8_t> packet) {
+  if (packet.size() > kMaxContainerPacketSize) {
+    LOG(ERROR) << "Packets of " << packet.size()
+               << " bytes do not fit into the container.";
+    return false;
+  }
+  if (!packet.empty() || empty_run_length_ == kMaxEmptyRunLength) {
+    if (!FlushEmptyRun()) {
+      return false;
+    }
+  }
+  // An empty frame joins the pending run, whose record starts where the
+  // next record will be written if the run is new.
+  if (packet.empty() && empty_run_length_ == 0) {
+    empty_run_offset_ = offset_;
+  }
+  if (num_frames_ % frames_per_index_entry_ == 0) {
+    AppendLittleEndian(packet.empty() ? empty_run_offset_ : offset_, 8,
+                       &index_);
+    index_.push_back(packet.empty() ? empty_run_length_ : 0);
+  }
+  ++num_frames_;
+  if (packet.empty()) {
+    ++empty_run_length_;
+    return true;
+  }
+  const uint8_t code = packet.size();
+  return Write(absl::MakeConstSpan(&code, 1)) && Write(packet);
+}
+
+bool LyraContainerWriter::Close() {
+  if (!stream_.is_open()) {
+    LOG(ERROR) << "Container is already closed.";
+    return false;
+  }
+  bool success = FlushEmptyRun();
+  const int64_t index_offset = offset_;
+  std::vector<uint8_t> trailer;
+  AppendLittleEndian(num_frames_, 8, &trailer);
+  AppendLittleEndian(index_offset, 8, &trailer);
+  AppendLittleEndian(index_.size() / kIndexEntrySize, 4, &trailer);
+  AppendLittleEndian(frames_per_index_entry_, 4, &trailer);
+  trailer.insert(trailer.end(), kTrailerMagic,
+                 kTrailerMagic + sizeof(kTrailerMagic));
+  success = success && Write(index_) && Write(trailer);
+  stream_.close();
+  if (!success || stream_.fail()) {
+    LOG(ERROR) << "Could not complete container.";
+    return false;
+  }
+  return true;
+}
+
+bool LyraContainerWriter::Write(absl::Span<const uint8_t> bytes) {
+  stream_.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  if (!stream_.good()) {
+    LOG(ERROR) << "Could not write to container.";
+    return false;
+  }
+  offset_ += bytes.size();
+  return true;
+}
+
+bool LyraContainerWriter::FlushEmptyRun() {
+  if (empty_run_length_ == 0) {
+    return true;
+  }
+  const uint8_t code = kEmptyRunCode + empty_run_length_ - 1;
+  empty_run_length_ = 0;
+  return Write(absl::MakeConstSpan(&code, 1));
+}
+
+std::unique_ptr<LyraContainerReader> LyraContainerReader::Create(
+    const ghc::filesystem::path& path) {
+  std::ifstream stream(path.string(),
+                       std::ios_base::binary | std::ios_base::ate);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Open on file " << path << " failed.";
+    return nullptr;
+  }
+  const int64_t file_size = stream.tellg();
+  stream.seekg(0);
+  if (file_size < kHeaderSize + kTrailerSize || !HasHeader(stream)) {
+    LOG(ERROR) << path << " is not a Lyra container.";
+    return nullptr;
+  }
+
+  uint8_t trailer[kTrailerSize];
+  stream.seekg(file_size - kTrailerSize);
+  if (!ReadBytes(stream, trailer, kTrailerSize) ||
+      std::memcmp(trailer + 24, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+    LOG(ERROR) << path << " has no container index. Was it closed?";
+    return nullptr;
+  }
+  const int64_t num_frames = LoadLittleEndian(trailer, 8);
+  const int64_t index_offset = LoadLittleEndian(trailer + 8, 8);
+  const int64_t num_index_entries = LoadLittleEndian(trailer + 16, 4);
+  const int frames_per_index_entry = LoadLittleEndian(trailer + 20, 4);
+  if (frames_per_index_entry <= 0 || index_offset < kHeaderSize ||
+      index_offset + num_index_entries * kIndexEntrySize + kTrailerSize !=
+          file_size ||
+      num_index_entries !=
+          (num_frames + frames_per_index_entry - 1) / frames_per_index_entry) {
+    LOG(ERROR) << path << " has an inconsistent container index.";
+    return nullptr;
+  }
+  auto reader = absl::WrapUnique(
+      new LyraContainerReader(std::move(stream), num_frames, index_offset,
+                              num_index_entries, frames_per_index_entry));
+  if (!reader->SeekToOffset(kHeaderSize)) {
+    return nullptr;
+  }
+  return reader;
+}
+
+LyraContainerReader::LyraContainerReader(std::ifstream stream,
+                                         int64_t num_frames,
+                                         int64_t index_offset,
+                                         int64_t num_index_entries,
+                                         int frames_per_index_entry)
+    : stream_(std::move(stream)),
+      num_frames_(num_frames),
+      index_offset_(index_offset),
+      num_index_entries_(num_index_entries),
+      frames_per_index_entry_(frames_per_index_entry),
+      packet_(kMaxContainerPacketSize),
+      next_frame_(0),
+      offset_(0),
+      empty_run_remaining_(0) {}
+
+std::optional<absl::Span<const uint8_t>> LyraContainerReader::ReadFrame() {
+  if (next_frame_ >= num_frames_) {
+    return std::nullopt;
+  }
+  if (empty_run_remaining_ > 0) {
+    --empty_run_remaining_;
+    ++next_frame_;
+    return absl::Span<const uint8_t>();
+  }
+  uint8_t code;
+  if (offset_ >= index_offset_ || !ReadBytes(stream_, &code, 1)) {
+    LOG(ERROR) << "Container ends before frame " << next_frame_ << ".";
+    return std::nullopt;
+  }
+  ++offset_;
+  ++next_frame_;
+  if (code >= kEmptyRunCode) {
+    empty_run_remaining_ = code - kEmptyRunCode;
+    return absl::Span<const uint8_t>();
+  }
+  if (offset_ + code > index_offset_ ||
+      !ReadBytes(stream_, packet_.data(), code)) {
+    LOG(ERROR) << "Container ends within frame " << next_frame_ - 1 << ".";
+    return std::nullopt;
+  }
+  offset_ += code;
+  return absl::MakeConstSpan(packet_.data(), code);
+}
+
+bool LyraContainerReader::SeekToFrame(int64_t frame) {
+  if (frame < 0 || frame > num_frames_) {
+    LOG(ERROR) << "Frame " << frame << " is not in the container of "
+               << num_frames_ << " frames.";
+    return false;
+  }
+  if (num_frames_ == 0) {
+    return SeekToOffset(kHeaderSize);
+  }
+  // The frame after the last one has no index entry of its own, so the seek
+  // goes through the last frame.
+  const int64_t entry =
+      std::min(frame, num_frames_ - 1) / frames_per_index_entry_;
+  uint8_t index_entry[kIndexEntrySize];
+  stream_.clear();
+  stream_.seekg(index_offset_ + entry * kIndexEntrySize);
+  if (!ReadBytes(stream_, index_entry, kIndexEntrySize)) {
+    LOG(ERROR) << "Could not read index entry " << entry << ".";
+    return false;
+  }
+  const int64_t record_offset = LoadLittleEndian(index_entry, 8);
+  const int num_frames_before = index_entry[8];
+  if (!SeekToOffset(record_offset)) {
+    return false;
+  }
+  next_frame_ = entry * frames_per_index_entry_ - num_frames_before;
+  while (next_frame_ < frame) {
+    if (!ReadFrame().has_value()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LyraContainerReader::SeekToSeconds(double seconds) {
+  return SeekToFrame(static_cast<int64_t>(std::floor(seconds * kFrameRate)));
+}
+
+bool LyraContainerReader::SeekToOffset(int64_t offset) {
+  if (offset < kHeaderSize || offset > index_offset_) {
+    LOG(ERROR) << "Record offset " << offset << " is out of bounds.";
+    return false;
+  }
+  stream_.clear();
+  stream_.seekg(offset);
+  if (!stream_.good()) {
+    LOG(ERROR) << "Could not seek to record offset " << offset << ".";
+    return false;
+  }
+  offset_ = offset;
+  next_frame_ = 0;
+  empty_run_remaining_ = 0;
+  return true;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_LYRA_CONTAINER_H_
+#define LYRA_LYRA_CONTAINER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+// A framed container for archiving Lyra packets, which unlike a raw packet
+// stream records the size of every packet, so that bitrate changes and
+// empty DTX packets survive, and can be seeked into without reading what
+// comes before.
+//
+// All integers are little endian. The file consists of
+//  - an 8 byte header: "LYRA", the format version and 3 zero bytes,
+//  - one record per packet, or per run of empty packets, in frame order. A
+//    record starts with a code byte c: for c < 128 a packet of c bytes
+//    follows, for c >= 128 it stands for a run of c - 127 empty packets,
+//  - the index, one 9 byte entry per |frames_per_index_entry| frames. Entry
+//    i holds the 64 bit offset of the record containing frame
+//    i * |frames_per_index_entry| and, as one byte, how many frames of that
+//    record precede it,
+//  - a 28 byte trailer: the 64 bit number of frames, the 64 bit offset of
+//    the index, the 32 bit number of index entries, the 32 bit
+//    |frames_per_index_entry| and "LYRX".
+// Frames are |kFrameRate| per second.
+
+// One index entry per second of audio by default.
+inline constexpr int kDefaultFramesPerIndexEntry = 50;
+inline constexpr int kMaxContainerPacketSize = 127;
+
+// Returns true if the file at |path| starts with a container header.
+bool IsLyraContainer(const ghc::filesystem::path& path);
+
+class LyraContainerWriter {
+ public:
+  // Returns a nullptr if the file can not be created or
+  // |frames_per_index_entry| is not positive.
+  static std::unique_ptr<LyraContainerWriter> Create(
+      const ghc::filesystem::path& path,
+      int frames_per_index_entry = kDefaultFramesPerIndexEntry);
+
+  // Closes the file if |Close| has not been called, ignoring errors.
+  ~LyraContainerWriter();
+
+  // Appends the packet of the next frame, which is empty for frames that DTX
+  // did not send. Returns false on failure.
+  bool WriteFrame(absl::Span<const uint8_t> packet);
+
+  // Writes the index and trailer and closes the file. Returns false on
+  // failure.
+  bool Close();
+
+  int64_t num_frames() const { return num_frames_; }
+
+ private:
+  LyraContainerWriter(std::ofstream stream, int frames_per_index_entry);
+
+  bool Write(absl::Span<const uint8_t> bytes);
+  bool FlushEmptyRun();
+
+  std::ofstream stream_;
+  const int frames_per_index_entry_;
+  int64_t num_frames_;
+  // Number of bytes written so far.
+  int64_t offset_;
+  // Empty frames not written yet, and the offset their record will have.
+  int empty_run_length_;
+  int64_t empty_run_offset_;
+  // Serialized index entries, written by |Close|.
+  std::vector<uint8_t> index_;
+};
+
+class LyraContainerReader {
+ public:
+  // Returns a nullptr if the file can not be opened or is not a valid
+  // container.
+  static std::unique_ptr<LyraContainerReader> Create(
+      const ghc::filesystem::path& path);
+
+  // Returns the packet of the next frame, which stays valid until the next
+  // call and is empty for frames that DTX did not send. Returns a nullopt on
+  // failure or after the last frame.
+  std::optional<absl::Span<const uint8_t>> ReadFrame();
+
+  // Positions the reader so that the next call to |ReadFrame| returns frame
+  // |frame|, which may be |num_frames| to position at the end. Reads one
+  // index entry and fewer than |frames_per_index_entry| + 128 frames, however
+  // long the file is. Returns false on failure.
+  bool SeekToFrame(int64_t frame);
+
+  // Like |SeekToFrame| with the frame that contains |seconds|.
+  bool SeekToSeconds(double seconds);
+
+  int64_t num_frames() const { return num_frames_; }
+  int64_t next_frame() const { return next_frame_; }
+
+ private:
+  LyraContainerReader(std::ifstream stream, int64_t num_frames,
+                      int64_t index_offset, int64_t num_index_entries,
+                      int frames_per_index_entry);
+
+  bool SeekToOffset(int64_t offset);
+
+  std::ifstream stream_;
+  const int64_t num_frames_;
+  // Records end where the index begins.
+  const int64_t index_offset_;
+  const int64_t num_index_entries_;
+  const int frames_per_index_entry_;
+  std::vector<uint8_t> packet_;
+  int64_t next_frame_;
+  int64_t offset_;
+  // Empty frames left in the current run.
+  int empty_run_remaining_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_LYRA_CONTAINER_H_
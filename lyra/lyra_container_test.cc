@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/lyra_container.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kFramesPerIndexEntry = 7;
+
+// Packets of two bitrates with DTX runs of several lengths, including one
+// longer than a single run record.
+std::vector<std::vector<uint8_t>> MakeFrames() {
+  std::vector<std::vector<uint8_t>> frames;
+  for (int run_length : {0, 1, 5, 130, 300, 2}) {
+    for (int i = 0; i < run_length; ++i) {
+      frames.emplace_back();
+    }
+    for (int i = 0; i < 9; ++i) {
+      const int size = frames.size() % 2 == 0 ? 8 : 15;
+      frames.emplace_back(size, static_cast<uint8_t>(frames.size()));
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    frames.emplace_back();
+  }
+  return frames;
+}
+
+class LyraContainerTest : public testing::Test {
+ protected:
+  LyraContainerTest()
+      : path_(ghc::filesystem::path(testing::TempDir()) / "archive.lyra"),
+        frames_(MakeFrames()) {}
+
+  void WriteFrames() {
+    auto writer = LyraContainerWriter::Create(path_, kFramesPerIndexEntry);
+    ASSERT_NE(writer, nullptr);
+    for (const auto& frame : frames_) {
+      ASSERT_TRUE(writer->WriteFrame(frame));
+    }
+    EXPECT_EQ(writer->num_frames(), frames_.size());
+    ASSERT_TRUE(writer->Close());
+  }
+
+  void ExpectFrame(LyraContainerReader* reader, int frame) {
+    const auto packet = reader->ReadFrame();
+    ASSERT_TRUE(packet.has_value()) << "frame=" << frame;
+    EXPECT_EQ(std::vector<uint8_t>(packet->begin(), packet->end()),
+              frames_[frame])
+        << "frame=" << frame;
+  }
+
+  const ghc::filesystem::path path_;
+  const std::vector<std::vector<uint8_t>> frames_;
+};
+
+TEST_F(LyraContainerTest, ReadsWrittenFrames) {
+  WriteFrames();
+  EXPECT_TRUE(IsLyraContainer(path_));
+  auto reader = LyraContainerReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  ASSERT_EQ(reader->num_frames(), frames_.size());
+  for (int frame = 0; frame < frames_.size(); ++frame) {
+    ExpectFrame(reader.get(), frame);
+  }
+  EXPECT_FALSE(reader->ReadFrame().has_value());
+}
+
+TEST_F(LyraContainerTest, SeeksToEveryFrame) {
+  WriteFrames();
+  auto reader = LyraContainerReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  // Backwards, so that every seek moves away from the current position.
+  for (int frame = frames_.size() - 1; frame >= 0; --frame) {
+    ASSERT_TRUE(reader->SeekToFrame(frame));
+    EXPECT_EQ(reader->next_frame(), frame);
+    ExpectFrame(reader.get(), frame);
+    if (frame + 1 < frames_.size()) {
+      ExpectFrame(reader.get(), frame + 1);
+    }
+  }
+  ASSERT_TRUE(reader->SeekToFrame(frames_.size()));
+  EXPECT_FALSE(reader->ReadFrame().has_value());
+  EXPECT_FALSE(reader->SeekToFrame(frames_.size() + 1));
+  EXPECT_FALSE(reader->SeekToFrame(-1));
+}
+
+TEST_F(LyraContainerTest, SeeksToSeconds) {
+  WriteFrames();
+  auto reader = LyraContainerReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  ASSERT_TRUE(reader->SeekToSeconds(5.5));
+  EXPECT_EQ(reader->next_frame(), 5 * kFrameRate + kFrameRate / 2);
+  ExpectFrame(reader.get(), reader->next_frame());
+}
+
+TEST_F(LyraContainerTest, HandlesEmptyContainer) {
+  auto writer = LyraContainerWriter::Create(path_);
+  ASSERT_NE(writer, nullptr);
+  ASSERT_TRUE(writer->Close());
+  auto reader = LyraContainerReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->num_frames(), 0);
+  EXPECT_TRUE(reader->SeekToFrame(0));
+  EXPECT_FALSE(reader->ReadFrame().has_value());
+}
+
+TEST_F(LyraContainerTest, RejectsInvalidFiles) {
+  EXPECT_EQ(LyraContainerReader::Create("should/not/exist.lyra"), nullptr);
+  EXPECT_FALSE(IsLyraContainer("should/not/exist.lyra"));
+
+  // A raw packet stream.
+  {
+    std::ofstream stream(path_.string(), std::ios_base::binary);
+    stream << std::string(60, 'x');
+  }
+  EXPECT_FALSE(IsLyraContainer(path_));
+  EXPECT_EQ(LyraContainerReader::Create(path_), nullptr);
+
+  // A container cut off before its index.
+  WriteFrames();
+  const auto size = ghc::filesystem::file_size(path_);
+  ghc::filesystem::resize_file(path_, size - 1);
+  EXPECT_TRUE(IsLyraContainer(path_));
+  EXPECT_EQ(LyraContainerReader::Create(path_), nullptr);
+}
+
+TEST_F(LyraContainerTest, RejectsOversizedPackets) {
+  auto writer = LyraContainerWriter::Create(path_);
+  ASSERT_NE(writer, nullptr);
+  EXPECT_FALSE(writer->WriteFrame(
+      std::vector<uint8_t>(kMaxContainerPacketSize + 1)));
+  EXPECT_EQ(LyraContainerWriter::Create(path_, 0), nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
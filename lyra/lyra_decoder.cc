@@ -15,49 +15,70 @@
 #include "lyra/lyra_decoder.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
+#include "lyra/async_generative_model.h"
 #include "lyra/buffered_resampler.h"
 #include "lyra/comfort_noise_generator.h"
+#include "lyra/dsp_utils.h"
 #include "lyra/lyra_components.h"
 #include "lyra/lyra_config.h"
+#include "lyra/model_bundle.h"
 #include "lyra/noise_estimator.h"
+#include "lyra/quality_level.h"
+#include "lyra/session_state.h"
+#include "lyra/shared_models.h"
+#include "lyra/time_stretcher.h"
 
 namespace chromemedia {
 namespace codec {
 namespace {
 
 // Duration of pure packet loss concealment.
-inline int GetConcealmentDurationSamples() {
-  static constexpr float kConcealmentDurationSeconds = 0.08;
-  static constexpr int kConcealmentDurationSamples =
-      kConcealmentDurationSeconds * kInternalSampleRateHz;
-  CHECK_EQ(
-      kConcealmentDurationSamples % GetNumSamplesPerHop(kInternalSampleRateHz),
-      0);
-  return kConcealmentDurationSamples;
-}
+constexpr float kConcealmentDurationSeconds = 0.08;
+constexpr int kConcealmentDurationSamples =
+    kConcealmentDurationSeconds * InternalProfile::kSampleRateHz;
+static_assert(
+    kConcealmentDurationSamples % InternalProfile::kNumSamplesPerHop == 0,
+    "Concealment has to last a whole number of hops.");
 
 // Duration it takes to fade from concealment to comfort noise, and from
 // comfort noise to received packets.
-inline int GetFadeDurationSamples() {
-  static constexpr float kFadeDurationSeconds = 0.04;
-  static constexpr int kFadeDurationSamples =
-      kFadeDurationSeconds * kInternalSampleRateHz;
-  CHECK_EQ(kFadeDurationSamples % GetNumSamplesPerHop(kInternalSampleRateHz),
-           0);
-  return kFadeDurationSamples;
+constexpr float kFadeDurationSeconds = 0.04;
+constexpr int kFadeDurationSamples =
+    kFadeDurationSeconds * InternalProfile::kSampleRateHz;
+static_assert(kFadeDurationSamples % InternalProfile::kNumSamplesPerHop == 0,
+              "Fades have to last a whole number of hops.");
+
+// Weights of the generative model output at every |fade_progress| of a fade,
+// falling from 1 to 0 along a cos^2 window. Comfort noise is weighted by one
+// minus these.
+using FadeWeights = std::array<float, kFadeDurationSamples + 1>;
+
+const FadeWeights& GetFadeWeights() {
+  static const FadeWeights* const fade_weights = [] {
+    auto* weights = new FadeWeights;
+    for (int i = 0; i < weights->size(); ++i) {
+      (*weights)[i] = (1.f + std::cos(i * M_PI / kFadeDurationSamples)) / 2.f;
+    }
+    return weights;
+  }();
+  return *fade_weights;
 }
 
 // Reconciles the number of samples requested with the number we should
@@ -71,18 +92,18 @@ int GetNumSamplesToGenerate(int num_samples_requested,
   if (concealment_progress < 0) {
     // Finish playing out the remainder of the last fake packet.
     samples_remaining_packet = std::abs(concealment_progress);
-  } else if (concealment_progress < GetConcealmentDurationSamples()) {
+  } else if (concealment_progress < kConcealmentDurationSamples) {
     // If we have not yet maxed out concealment progress, the
     // |generative_model_| will be used.
     samples_remaining_packet =
-        model_samples_available % GetNumSamplesPerHop(kInternalSampleRateHz);
+        model_samples_available % InternalProfile::kNumSamplesPerHop;
   } else {
     // Otherwise the  |comfort_noise_generator_| is guaranteed to be used.
     samples_remaining_packet = cng_samples_available;
   }
   // If we are out of samples, assume we can always add estimated features.
   if (samples_remaining_packet == 0) {
-    samples_remaining_packet = GetNumSamplesPerHop(kInternalSampleRateHz);
+    samples_remaining_packet = InternalProfile::kNumSamplesPerHop;
   }
   // Take the min between the next packet boundary and the remaining number of
   // samples requested.
@@ -94,16 +115,59 @@ int GetNumSamplesToGenerate(int num_samples_requested,
 
 std::unique_ptr<LyraDecoder> LyraDecoder::Create(
     int sample_rate_hz, int num_channels,
-    const ghc::filesystem::path& model_path) {
+    const ghc::filesystem::path& model_path, bool run_model_asynchronously,
+    absl::Duration max_model_wait) {
   absl::Status are_params_supported =
       AreParamsSupported(sample_rate_hz, num_channels, model_path);
   if (!are_params_supported.ok()) {
     LOG(ERROR) << are_params_supported;
     return nullptr;
   }
-  const int kNumSamplesPerHop = GetNumSamplesPerHop(kInternalSampleRateHz);
-  const int kNumSamplesPerWindow =
-      GetNumSamplesPerWindow(kInternalSampleRateHz);
+  // All internal components operate at |kInternalSampleRateHz|.
+  std::unique_ptr<GenerativeModelInterface> model =
+      CreateGenerativeModel(kNumFeatures, model_path);
+  if (run_model_asynchronously && model != nullptr) {
+    model = AsyncGenerativeModel::Create(
+        std::move(model), InternalProfile::kNumSamplesPerHop, max_model_wait);
+  }
+  return CreateFromComponents(sample_rate_hz, num_channels, std::move(model),
+                              CreateQuantizer(model_path));
+}
+
+std::unique_ptr<LyraDecoder> LyraDecoder::Create(
+    int sample_rate_hz, int num_channels, const SharedModels& shared_models) {
+  absl::Status are_params_supported =
+      AreStreamParamsSupported(sample_rate_hz, num_channels);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  return CreateFromComponents(
+      sample_rate_hz, num_channels,
+      shared_models.CreateGenerativeModel(kNumFeatures),
+      shared_models.CreateQuantizer());
+}
+
+std::unique_ptr<LyraDecoder> LyraDecoder::Create(
+    int sample_rate_hz, int num_channels,
+    std::shared_ptr<const ModelBundle> bundle) {
+  absl::Status are_params_supported =
+      AreStreamParamsSupported(sample_rate_hz, num_channels);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  return CreateFromComponents(sample_rate_hz, num_channels,
+                              CreateGenerativeModel(kNumFeatures, bundle),
+                              CreateQuantizer(bundle));
+}
+
+std::unique_ptr<LyraDecoder> LyraDecoder::CreateFromComponents(
+    int sample_rate_hz, int num_channels,
+    std::unique_ptr<GenerativeModelInterface> model,
+    std::unique_ptr<VectorQuantizerInterface> vector_quantizer) {
+  constexpr int kNumSamplesPerHop = InternalProfile::kNumSamplesPerHop;
+  constexpr int kNumSamplesPerWindow = InternalProfile::kNumSamplesPerWindow;
 
   // The resampler always resamples from |kInternalSampleRateHz| to the
   // requested |sample_rate_hz|.
@@ -113,8 +177,6 @@ std::unique_ptr<LyraDecoder> LyraDecoder::Create(
     LOG(ERROR) << "Could not create Buffered Resampler.";
     return nullptr;
   }
-  // All internal components operate at |kInternalSampleRateHz|.
-  auto model = CreateGenerativeModel(kNumFeatures, model_path);
   if (model == nullptr) {
     LOG(ERROR) << "New model could not be instantiated.";
     return nullptr;
@@ -133,7 +195,6 @@ std::unique_ptr<LyraDecoder> LyraDecoder::Create(
     LOG(ERROR) << "Could not create Noise Estimator.";
     return nullptr;
   }
-  auto vector_quantizer = CreateQuantizer(model_path);
   if (vector_quantizer == nullptr) {
     LOG(ERROR) << "Could not create Vector Quantizer.";
     return nullptr;
@@ -163,29 +224,92 @@ LyraDecoder::LyraDecoder(
       noise_estimator_(std::move(noise_estimator)),
       feature_estimator_(std::move(feature_estimator)),
       resampler_(std::move(resampler)),
+      time_stretcher_(std::make_unique<TimeStretcher>(kInternalSampleRateHz)),
       concealment_progress_(0),
       fade_progress_(0),
       fade_direction_(FadeDirection::kFadeFromCNG),
+      fec_enabled_(false),
+      quality_level_(QualityLevel::kFull),
       external_sample_rate_hz_(external_sample_rate_hz),
       num_channels_(num_channels) {}
 
 bool LyraDecoder::SetEncodedPacket(absl::Span<const uint8_t> encoded) {
+  if (fec_enabled_) {
+    const int num_quantized_bits =
+        FecPacketSizeToNumQuantizedBits(encoded.size());
+    if (num_quantized_bits < 0) {
+      LOG(ERROR) << "The FEC packet size (" << encoded.size()
+                 << " bytes) is not supported.";
+      return false;
+    }
+    return SetEncodedFrames(encoded.first(GetPacketSize(num_quantized_bits)),
+                            num_quantized_bits, /*num_frames=*/1);
+  }
   const int num_quantized_bits = PacketSizeToNumQuantizedBits(encoded.size());
   if (num_quantized_bits < 0) {
     LOG(ERROR) << "The packet size (" << encoded.size()
                << " bytes) is not supported.";
     return false;
   }
-  auto packet = CreatePacket(kNumHeaderBits, num_quantized_bits);
-  const auto unpacked = packet->UnpackPacket(encoded);
-  if (!unpacked.has_value()) {
-    LOG(ERROR) << "Could not read Lyra packet for decoding.";
+  return SetEncodedFrames(encoded, num_quantized_bits, /*num_frames=*/1);
+}
+
+bool LyraDecoder::RecoverLostPacket(absl::Span<const uint8_t> next_encoded) {
+  if (!fec_enabled_) {
+    LOG(ERROR) << "Lost packets can only be recovered with FEC enabled.";
+    return false;
+  }
+  const int num_quantized_bits =
+      FecPacketSizeToNumQuantizedBits(next_encoded.size());
+  if (num_quantized_bits < 0) {
+    LOG(ERROR) << "The FEC packet size (" << next_encoded.size()
+               << " bytes) is not supported.";
     return false;
   }
+  return SetEncodedFrames(
+      next_encoded.subspan(GetPacketSize(num_quantized_bits)),
+      kNumFecQuantizedBits, /*num_frames=*/1);
+}
+
+bool LyraDecoder::SetEncodedSuperframe(absl::Span<const uint8_t> encoded) {
+  if (fec_enabled_) {
+    LOG(ERROR) << "Superframes do not support forward error correction.";
+    return false;
+  }
+  int num_frames = 0;
+  const int num_quantized_bits =
+      SuperframeSizeToNumQuantizedBits(encoded.size(), &num_frames);
+  if (num_quantized_bits < 0) {
+    LOG(ERROR) << "The superframe size (" << encoded.size()
+               << " bytes) is not supported.";
+    return false;
+  }
+  return SetEncodedFrames(encoded, num_quantized_bits, num_frames);
+}
+
+bool LyraDecoder::SetEncodedFrames(absl::Span<const uint8_t> encoded,
+                                   int num_quantized_bits, int num_frames) {
+  const int packet_size = GetPacketSize(num_quantized_bits);
+  auto packet = CreatePacket(kNumHeaderBits, num_quantized_bits);
+  std::vector<std::string> quantized_frames;
+  quantized_frames.reserve(num_frames);
+  for (int i = 0; i < num_frames; ++i) {
+    auto unpacked =
+        packet->UnpackPacket(encoded.subspan(i * packet_size, packet_size));
+    if (!unpacked.has_value()) {
+      LOG(ERROR) << "Could not read Lyra packet for decoding.";
+      return false;
+    }
+    quantized_frames.push_back(std::move(unpacked.value()));
+  }
+  // Comfort noise does not need the features, so do not decode them.
+  if (quality_level_ == QualityLevel::kComfortNoise) {
+    return true;
+  }
 
   // Finish playing out any concealment or comfort noise packets before
   // moving on to the packet we are receiving.
-  if (concealment_progress_ == GetConcealmentDurationSamples()) {
+  if (concealment_progress_ == kConcealmentDurationSamples) {
     concealment_progress_ = -comfort_noise_generator_->num_samples_available();
   } else if (concealment_progress_ > 0) {
     concealment_progress_ = -generative_model_->num_samples_available();
@@ -195,16 +319,19 @@ bool LyraDecoder::SetEncodedPacket(absl::Span<const uint8_t> encoded) {
   // If less than zero we received than one packet while still decoding
   // concealment or comfort noise.
 
-  auto features = vector_quantizer_->DecodeToLossyFeatures(unpacked.value());
-  if (!features.has_value()) {
+  auto frames =
+      vector_quantizer_->DecodeFramesToLossyFeatures(quantized_frames);
+  if (!frames.has_value() || frames->size() != num_frames) {
     LOG(ERROR) << "Could not decode to lossy features.";
     return false;
   }
-  if (!generative_model_->AddFeatures(features.value())) {
-    LOG(ERROR) << "Could not add received features to generative model.";
-    return false;
+  for (const std::vector<float>& features : frames.value()) {
+    if (!generative_model_->AddFeatures(features)) {
+      LOG(ERROR) << "Could not add received features to generative model.";
+      return false;
+    }
+    feature_estimator_->Update(features);
   }
-  feature_estimator_->Update(features.value());
   return true;
 }
 
@@ -213,10 +340,15 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamples(
   std::function<std::optional<std::vector<int16_t>>(int)> decode_function =
       [this](int internal_num_samples_to_generate)
       -> std::optional<std::vector<int16_t>> {
-    return DecodeSamplesInternal(internal_num_samples_to_generate);
+    return DecodeSamplesInternal<int16_t>(internal_num_samples_to_generate);
   };
+  std::function<std::optional<std::vector<int16_t>>(int)> stretch_function =
+      [this, &decode_function](int internal_num_samples_to_generate) {
+        return time_stretcher_->FilterAndBuffer(
+            decode_function, internal_num_samples_to_generate);
+      };
   auto external_samples =
-      resampler_->FilterAndBuffer(decode_function, num_samples);
+      resampler_->FilterAndBuffer(stretch_function, num_samples);
 
   if (!external_samples.has_value()) {
     LOG(ERROR) << "Could not decode samples.";
@@ -225,14 +357,52 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamples(
   return external_samples;
 }
 
-std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
+std::optional<std::vector<float>> LyraDecoder::DecodeSamplesFloat(
+    int num_samples) {
+  std::function<std::optional<std::vector<float>>(int)> decode_function =
+      [this](int internal_num_samples_to_generate)
+      -> std::optional<std::vector<float>> {
+    return DecodeSamplesInternal<float>(internal_num_samples_to_generate);
+  };
+  std::function<std::optional<std::vector<float>>(int)> stretch_function =
+      [this, &decode_function](int internal_num_samples_to_generate) {
+        return time_stretcher_->FilterAndBufferFloat(
+            decode_function, internal_num_samples_to_generate);
+      };
+  auto external_samples =
+      resampler_->FilterAndBufferFloat(stretch_function, num_samples);
+
+  if (!external_samples.has_value()) {
+    LOG(ERROR) << "Could not decode samples.";
+    return std::nullopt;
+  }
+  return external_samples;
+}
+
+template <typename T>
+std::optional<std::vector<T>> LyraDecoder::DecodeSamplesInternal(
     int internal_num_samples_to_generate) {
-  std::vector<int16_t> result;
+  std::vector<T> result;
   result.reserve(internal_num_samples_to_generate);
   while (result.size() < internal_num_samples_to_generate) {
+    // At comfort noise quality skip concealment and fade to comfort noise
+    // right away, as if the packets had been lost for a while. This waits
+    // for the end of the hops in progress, so fades stay aligned with them.
+    if (quality_level_ == QualityLevel::kComfortNoise &&
+        concealment_progress_ >= 0 &&
+        concealment_progress_ < kConcealmentDurationSamples &&
+        generative_model_->num_samples_available() %
+                InternalProfile::kNumSamplesPerHop ==
+            0 &&
+        comfort_noise_generator_->num_samples_available() %
+                InternalProfile::kNumSamplesPerHop ==
+            0) {
+      concealment_progress_ = kConcealmentDurationSamples;
+    }
+
     // Aligns the number of samples requested with the number of samples per
     // packet.
-    // |GetFadeDurationSamples()| and |GetConcealmentDurationSamples()| are also
+    // |kFadeDurationSamples| and |kConcealmentDurationSamples| are also
     // multiples of the number of samples per packet, so
     // |num_samples_to_generate| will be aligned with fade and concealment
     // progress as well.
@@ -254,9 +424,9 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
       // Decoding from a received packet triggers comfort noise, if there is
       // any, to fade out.
       fade_direction_ = kFadeFromCNG;
-    } else if (concealment_progress_ == GetConcealmentDurationSamples()) {
+    } else if (concealment_progress_ == kConcealmentDurationSamples) {
       // Comfort noise begins fading in again once we have lost
-      // |GetConcealmentDurationSamples()| samples in a row.
+      // |kConcealmentDurationSamples| samples in a row.
       fade_direction_ = kFadeToCNG;
     } else {
       // We are not decoding from a received packet and have not yet started
@@ -269,10 +439,10 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
     int next_fade_progress =
         fade_progress_ + fade_direction_ * num_samples_to_generate;
     if (fade_direction_ == kFadeToCNG &&
-        fade_progress_ == GetFadeDurationSamples()) {
-      // |fade_progress_| maxes out at |GetFadeDurationSamples()|. Once here
-      // we only generate comfort noise until |fade_direction_| is reversed.
-      next_fade_progress = GetFadeDurationSamples();
+        fade_progress_ == kFadeDurationSamples) {
+      // |fade_progress_| maxes out at |kFadeDurationSamples|. Once here we
+      // only generate comfort noise until |fade_direction_| is reversed.
+      next_fade_progress = kFadeDurationSamples;
       generative_samples_to_generate = 0;
     } else if (fade_direction_ == kFadeFromCNG && fade_progress_ == 0) {
       // |fade_progress_| has a minimum at 0. Once here we only produce
@@ -281,7 +451,7 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
       cng_samples_to_generate = 0;
     }
 
-    auto audio = RunGenerativeModel(generative_samples_to_generate);
+    auto audio = RunGenerativeModel<T>(generative_samples_to_generate);
     if (!audio.has_value()) {
       LOG(ERROR) << "Model could not be run on features.";
       return std::nullopt;
@@ -291,10 +461,16 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
       LOG(ERROR) << "Could not generate comfort noise.";
       return std::nullopt;
     }
+    std::vector<T> comfort_noise_hop;
+    if constexpr (std::is_same_v<T, float>) {
+      comfort_noise_hop = Int16ToUnit<float>(comfort_noise.value());
+    } else {
+      comfort_noise_hop = std::move(comfort_noise.value());
+    }
 
     // Perform any necessary overlap and insert into |result|.
     if (!MaybeOverlapAndInsert(fade_direction_, fade_progress_, audio.value(),
-                               comfort_noise.value(), result)) {
+                               comfort_noise_hop, result)) {
       LOG(ERROR) << "Could not overlap comfort noise.";
       return std::nullopt;
     }
@@ -304,7 +480,14 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
     // Only update |noise_estimator_| if we are dealing with received packets.
     // Do not update with concealment.
     if (is_packet_received) {
-      if (!noise_estimator_->ReceiveSamples(audio.value())) {
+      bool received;
+      if constexpr (std::is_same_v<T, float>) {
+        received = noise_estimator_->ReceiveSamples(
+            UnitToInt16(absl::MakeConstSpan(audio.value())));
+      } else {
+        received = noise_estimator_->ReceiveSamples(audio.value());
+      }
+      if (!received) {
         LOG(ERROR) << "Could not update noise estimator on decoder output.";
         return std::nullopt;
       }
@@ -314,7 +497,8 @@ std::optional<std::vector<int16_t>> LyraDecoder::DecodeSamplesInternal(
   return result;
 }
 
-std::optional<std::vector<int16_t>> LyraDecoder::RunGenerativeModel(
+template <typename T>
+std::optional<std::vector<T>> LyraDecoder::RunGenerativeModel(
     int num_samples) {
   if (num_samples > 0 && generative_model_->num_samples_available() == 0) {
     if (!generative_model_->AddFeatures(feature_estimator_->Estimate())) {
@@ -322,7 +506,11 @@ std::optional<std::vector<int16_t>> LyraDecoder::RunGenerativeModel(
       return std::nullopt;
     }
   }
-  return generative_model_->GenerateSamples(num_samples);
+  if constexpr (std::is_same_v<T, float>) {
+    return generative_model_->GenerateFloatSamples(num_samples);
+  } else {
+    return generative_model_->GenerateSamples(num_samples);
+  }
 }
 
 std::optional<std::vector<int16_t>> LyraDecoder::RunComfortNoiseGenerator(
@@ -339,11 +527,11 @@ std::optional<std::vector<int16_t>> LyraDecoder::RunComfortNoiseGenerator(
   return comfort_noise_generator_->GenerateSamples(num_samples);
 }
 
+template <typename T>
 bool LyraDecoder::MaybeOverlapAndInsert(
     FadeDirection fade_direction, int fade_progress,
-    const std::vector<int16_t>& generative_model_hop,
-    const std::vector<int16_t>& comfort_noise_hop,
-    std::vector<int16_t>& result) {
+    const std::vector<T>& generative_model_hop,
+    const std::vector<T>& comfort_noise_hop, std::vector<T>& result) {
   if (comfort_noise_hop.empty()) {
     result.insert(result.end(), generative_model_hop.begin(),
                   generative_model_hop.end());
@@ -362,9 +550,9 @@ bool LyraDecoder::MaybeOverlapAndInsert(
     return false;
   }
 
+  const FadeWeights& fade_weights = GetFadeWeights();
   for (int i = 0; i < generative_model_hop.size(); ++i) {
-    const float overlap_weight =
-        (1.f + std::cos(fade_progress * M_PI / GetFadeDurationSamples())) / 2.f;
+    const float overlap_weight = fade_weights[fade_progress];
     result.push_back(generative_model_hop.at(i) * overlap_weight +
                      comfort_noise_hop.at(i) * (1.f - overlap_weight));
     fade_progress += fade_direction;
@@ -372,6 +560,122 @@ bool LyraDecoder::MaybeOverlapAndInsert(
   return true;
 }
 
+bool LyraDecoder::set_playout_rate(float rate) {
+  return time_stretcher_->set_rate(rate);
+}
+
+float LyraDecoder::playout_rate() const { return time_stretcher_->rate(); }
+
+void LyraDecoder::set_fec_enabled(bool fec_enabled) {
+  fec_enabled_ = fec_enabled;
+}
+
+bool LyraDecoder::fec_enabled() const { return fec_enabled_; }
+
+void LyraDecoder::set_quality_level(QualityLevel quality_level) {
+  quality_level_ = quality_level;
+}
+
+QualityLevel LyraDecoder::quality_level() const { return quality_level_; }
+
+std::optional<std::vector<uint8_t>> LyraDecoder::SaveState() const {
+  StateWriter writer(SessionKind::kDecoder);
+  writer.Write<int32_t>(external_sample_rate_hz_);
+  writer.Write<int32_t>(concealment_progress_);
+  writer.Write<int32_t>(fade_progress_);
+  writer.Write<int32_t>(fade_direction_);
+  writer.Write(fec_enabled_);
+  writer.Write<int32_t>(static_cast<int32_t>(quality_level_));
+  if (!generative_model_->SaveState(&writer) ||
+      !comfort_noise_generator_->SaveState(&writer) ||
+      !noise_estimator_->SaveState(&writer) ||
+      !feature_estimator_->SaveState(&writer) ||
+      !time_stretcher_->SaveState(&writer) ||
+      !resampler_->SaveState(&writer)) {
+    LOG(ERROR) << "Could not save the decoder state.";
+    return std::nullopt;
+  }
+  return writer.bytes();
+}
+
+bool LyraDecoder::RestoreState(absl::Span<const uint8_t> state) {
+  // A state that turns out to be invalid after some components took it is
+  // undone with a snapshot of the current state.
+  const auto current_state = SaveState();
+  if (!current_state.has_value()) {
+    return false;
+  }
+  if (RestoreStateOfComponents(state)) {
+    return true;
+  }
+  CHECK(RestoreStateOfComponents(current_state.value()))
+      << "Could not return the decoder to its state before the restore.";
+  return false;
+}
+
+bool LyraDecoder::RestoreStateOfComponents(absl::Span<const uint8_t> state) {
+  auto reader = StateReader::Create(state, SessionKind::kDecoder);
+  if (reader == nullptr) {
+    return false;
+  }
+  int32_t sample_rate_hz;
+  int32_t concealment_progress;
+  int32_t fade_progress;
+  int32_t fade_direction;
+  bool fec_enabled;
+  int32_t quality_level;
+  if (!reader->Read(&sample_rate_hz) || !reader->Read(&concealment_progress) ||
+      !reader->Read(&fade_progress) || !reader->Read(&fade_direction) ||
+      !reader->Read(&fec_enabled) || !reader->Read(&quality_level)) {
+    return false;
+  }
+  if (sample_rate_hz != external_sample_rate_hz_) {
+    LOG(ERROR) << "The state was saved by a decoder at " << sample_rate_hz
+               << " Hz, but this decoder runs at " << external_sample_rate_hz_
+               << " Hz.";
+    return false;
+  }
+  if (concealment_progress > kConcealmentDurationSamples ||
+      fade_progress < 0 || fade_progress > kFadeDurationSamples ||
+      (fade_direction != kFadeToCNG && fade_direction != kFadeFromCNG)) {
+    LOG(ERROR) << "Invalid packet loss state in the decoder state.";
+    return false;
+  }
+  if (quality_level < static_cast<int32_t>(QualityLevel::kFull) ||
+      quality_level > static_cast<int32_t>(QualityLevel::kComfortNoise)) {
+    LOG(ERROR) << "Invalid quality level " << quality_level
+               << " in the decoder state.";
+    return false;
+  }
+  if (!generative_model_->RestoreState(reader.get()) ||
+      !comfort_noise_generator_->RestoreState(reader.get()) ||
+      !noise_estimator_->RestoreState(reader.get()) ||
+      !feature_estimator_->RestoreState(reader.get()) ||
+      !time_stretcher_->RestoreState(reader.get()) ||
+      !resampler_->RestoreState(reader.get())) {
+    LOG(ERROR) << "Could not restore the decoder state.";
+    return false;
+  }
+  // Negative progress counts the samples left in one of the models.
+  const int min_concealment_progress =
+      -std::max(generative_model_->num_samples_available(),
+                comfort_noise_generator_->num_samples_available());
+  if (concealment_progress < min_concealment_progress) {
+    LOG(ERROR) << "Invalid packet loss state in the decoder state.";
+    return false;
+  }
+  if (!reader->at_end()) {
+    LOG(ERROR) << "The decoder state has unexpected trailing data.";
+    return false;
+  }
+  concealment_progress_ = concealment_progress;
+  fade_progress_ = fade_progress;
+  fade_direction_ = static_cast<FadeDirection>(fade_direction);
+  fec_enabled_ = fec_enabled;
+  quality_level_ = static_cast<QualityLevel>(quality_level);
+  return true;
+}
+
 int LyraDecoder::sample_rate_hz() const { return external_sample_rate_hz_; }
 
 int LyraDecoder::num_channels() const { return num_channels_; }
@@ -379,7 +683,7 @@ int LyraDecoder::num_channels() const { return num_channels_; }
 int LyraDecoder::frame_rate() const { return kFrameRate; }
 
 bool LyraDecoder::is_comfort_noise() const {
-  return fade_progress_ == GetFadeDurationSamples();
+  return fade_progress_ == kFadeDurationSamples;
 }
 
 }  // namespace codec
@@ -22,18 +22,24 @@
 #include <optional>
 #include <vector>
 
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "include/ghc/filesystem.hpp"
 #include "lyra/buffered_filter_interface.h"
 #include "lyra/feature_estimator_interface.h"
 #include "lyra/generative_model_interface.h"
 #include "lyra/lyra_decoder_interface.h"
+#include "lyra/model_bundle.h"
 #include "lyra/noise_estimator_interface.h"
+#include "lyra/quality_level.h"
+#include "lyra/time_stretcher.h"
 #include "lyra/vector_quantizer_interface.h"
 
 namespace chromemedia {
 namespace codec {
 
+class SharedModels;
+
 /// Lyra decoder class.
 ///
 /// This class unpacks the bit stream into features and uses a generative model
@@ -49,18 +55,88 @@ class LyraDecoder : public LyraDecoderInterface {
   /// @param model_path Path to the model weights. The identifier in the
   ///                   lyra_config.binarypb has to coincide with the
   ///                   |kVersionMinor| constant in lyra_config.cc.
+  /// @param run_model_asynchronously Set to true to run LyraGAN on a
+  ///                                 background thread as soon as a packet is
+  ///                                 set, so that |DecodeSamples| does bounded
+  ///                                 work suitable for an audio callback.
+  /// @param max_model_wait With |run_model_asynchronously|, the longest
+  ///                       |DecodeSamples| waits for a hop that is still being
+  ///                       synthesized when playout reaches it. Packets set
+  ///                       ahead of playout do not wait. Concealment and
+  ///                       packets set right before decoding are waited for,
+  ///                       and hops that miss this deadline are concealed.
+  /// @return A unique_ptr to a |LyraDecoder| if all desired params are
+  ///         supported. Else it returns a nullptr.
+  static std::unique_ptr<LyraDecoder> Create(
+      int sample_rate_hz, int num_channels,
+      const ghc::filesystem::path& model_path,
+      bool run_model_asynchronously = false,
+      absl::Duration max_model_wait = absl::Milliseconds(5));
+
+  /// Static method to create a LyraDecoder running on interpreters shared with
+  /// other sessions of the same worker thread.
+  ///
+  /// The decoder only owns the recurrent state of the models, and has to be
+  /// used on the same thread as every other session created from
+  /// |shared_models|, which has to outlive it.
+  ///
+  /// @param sample_rate_hz Desired sample rate in Hertz.
+  /// @param num_channels Desired number of channels.
+  /// @param shared_models Models shared by the sessions of one worker.
+  /// @return A unique_ptr to a |LyraDecoder| if all desired params are
+  ///         supported. Else it returns a nullptr.
+  static std::unique_ptr<LyraDecoder> Create(int sample_rate_hz,
+                                             int num_channels,
+                                             const SharedModels& shared_models);
+
+  /// Static method to create a LyraDecoder from models that were loaded into
+  /// a |ModelBundle| before.
+  ///
+  /// @param sample_rate_hz Desired sample rate in Hertz.
+  /// @param num_channels Desired number of channels.
+  /// @param bundle Bundle holding the models, which the decoder keeps alive.
   /// @return A unique_ptr to a |LyraDecoder| if all desired params are
   ///         supported. Else it returns a nullptr.
   static std::unique_ptr<LyraDecoder> Create(
       int sample_rate_hz, int num_channels,
-      const ghc::filesystem::path& model_path);
+      std::shared_ptr<const ModelBundle> bundle);
 
   /// Parses a packet and prepares to decode samples from the payload.
   ///
+  /// If forward error correction is enabled, the packet has to carry FEC
+  /// data, which is skipped.
+  ///
   /// @param encoded Encoded packet as a span of bytes.
   /// @return True if the provided packet is a valid Lyra packet.
   bool SetEncodedPacket(absl::Span<const uint8_t> encoded) override;
 
+  /// Recovers a lost packet from the forward error correction (FEC) data of
+  /// the packet after it.
+  ///
+  /// A jitter buffer that already holds the packet after a lost one calls
+  /// this in place of |SetEncodedPacket| for the lost packet, and then
+  /// |SetEncodedPacket| with the next packet as usual. The lost hop is decoded
+  /// at the lowest bitrate instead of being concealed. A burst of lost packets
+  /// can only recover its last packet this way.
+  ///
+  /// @param next_encoded The packet after the lost one, encoded with FEC
+  ///                     enabled.
+  /// @return True if FEC is enabled and |next_encoded| is a valid FEC packet.
+  bool RecoverLostPacket(absl::Span<const uint8_t> next_encoded);
+
+  /// Parses a superframe and prepares to decode samples from all of its hops.
+  ///
+  /// The number of hops and the bitrate are inferred from the size of the
+  /// superframe. The quantized features of all hops are decoded together and
+  /// queued into the generative model in order, so that the following calls
+  /// to |DecodeSamples| play out every hop before concealing.
+  ///
+  /// @param encoded Superframe as produced by |LyraEncoder::EncodeSuperframe|.
+  ///                A single packet is a superframe of one hop.
+  /// @return True if the provided superframe is valid and forward error
+  ///         correction is disabled.
+  bool SetEncodedSuperframe(absl::Span<const uint8_t> encoded);
+
   /// Decodes samples.
   ///
   /// If more samples are requested for decoding than are available from the
@@ -73,6 +149,83 @@ class LyraDecoder : public LyraDecoderInterface {
   /// @return Vector of int16-formatted samples, or nullopt on failure.
   std::optional<std::vector<int16_t>> DecodeSamples(int num_samples) override;
 
+  /// Decodes samples as unit floats.
+  ///
+  /// Same as |DecodeSamples|, but the output of the generative model is
+  /// resampled and returned as floats, without a round trip through int16.
+  ///
+  /// @param num_samples Number of samples to decode.
+  ///
+  /// @return Vector of float samples in [-1, 1], or nullopt on failure.
+  std::optional<std::vector<float>> DecodeSamplesFloat(int num_samples);
+
+  /// Sets the speed at which the decoded audio is played out.
+  ///
+  /// The decoded audio is time-stretched without changing its pitch before it
+  /// is resampled, so a jitter buffer can play out slightly slower to ride
+  /// out a late packet or slightly faster to drain built up latency, without
+  /// concealing or dropping whole hops. A rate of 1 plays out the decoded
+  /// samples unchanged.
+  ///
+  /// @param rate Playout speed relative to real time, between 0.5 and 2.
+  /// @return True if the rate is supported.
+  bool set_playout_rate(float rate);
+
+  /// Getter for the playout speed.
+  ///
+  /// @return Playout speed relative to real time.
+  float playout_rate() const;
+
+  /// Sets whether packets carry forward error correction data, as negotiated
+  /// with the encoder through |LyraEncoder::set_fec_enabled|. The sizes of
+  /// some packets with and without FEC data coincide, so it can not be
+  /// inferred from the packets.
+  ///
+  /// @param fec_enabled Set to true if packets carry FEC data.
+  void set_fec_enabled(bool fec_enabled);
+
+  /// Getter for whether forward error correction is enabled.
+  ///
+  /// @return True if packets are expected to carry FEC data.
+  bool fec_enabled() const;
+
+  /// Sets the quality to decode at, to shed load when the decoder runs out of
+  /// time.
+  ///
+  /// At |QualityLevel::kComfortNoise| received packets are only validated, and
+  /// the decoder fades to comfort noise without concealing first, so that the
+  /// generative model only runs for the fade. Once the quality is raised
+  /// again, the next packet fades back from comfort noise as after a loss.
+  /// The other levels decode as usual.
+  ///
+  /// @param quality_level Quality to decode the following samples at.
+  void set_quality_level(QualityLevel quality_level);
+
+  /// Getter for the quality level.
+  ///
+  /// @return Quality the decoder decodes at.
+  QualityLevel quality_level() const;
+
+  /// Saves the state of the session, so that another decoder, possibly in
+  /// another process, can continue the stream without a discontinuity.
+  ///
+  /// The state holds the packet loss state, the quality level, the queued
+  /// features and recurrent state of the models, the noise statistics, and the
+  /// samples buffered for time-stretching and resampling. It is only valid for a decoder created
+  /// with the same sample rate and models, and running the model
+  /// synchronously.
+  ///
+  /// @return The state in a versioned binary format, or nullopt on failure.
+  std::optional<std::vector<uint8_t>> SaveState() const;
+
+  /// Restores a state saved by |SaveState|, after which this decoder produces
+  /// the same samples as the decoder that saved it would have, except for the
+  /// random phase of comfort noise.
+  ///
+  /// @param state State returned by |SaveState|.
+  /// @return True on success. On failure the decoder is left as it was.
+  bool RestoreState(absl::Span<const uint8_t> state);
+
   /// Getter for the sample rate in Hertz.
   ///
   /// @return Sample rate in Hertz.
@@ -101,6 +254,10 @@ class LyraDecoder : public LyraDecoderInterface {
   };
 
   LyraDecoder() = delete;
+  static std::unique_ptr<LyraDecoder> CreateFromComponents(
+      int sample_rate_hz, int num_channels,
+      std::unique_ptr<GenerativeModelInterface> generative_model,
+      std::unique_ptr<VectorQuantizerInterface> vector_quantizer);
   LyraDecoder(std::unique_ptr<GenerativeModelInterface> generative_model,
               std::unique_ptr<GenerativeModelInterface> comfort_noise_generator,
               std::unique_ptr<VectorQuantizerInterface> vector_quantizer,
@@ -109,19 +266,32 @@ class LyraDecoder : public LyraDecoderInterface {
               std::unique_ptr<BufferedFilterInterface> resampler,
               int external_sample_rate_hz, int num_channels);
 
-  // Runs the while loop for generating samples at the internal sample rate.
-  std::optional<std::vector<int16_t>> DecodeSamplesInternal(
+  // Restores the components one after the other, so on failure the decoder
+  // may be partially restored. The own fields are only set on success.
+  bool RestoreStateOfComponents(absl::Span<const uint8_t> state);
+
+  // Decodes the |num_frames| packets of |num_quantized_bits| bits each that
+  // are concatenated in |encoded| and queues their features.
+  bool SetEncodedFrames(absl::Span<const uint8_t> encoded,
+                        int num_quantized_bits, int num_frames);
+
+  // Runs the while loop for generating samples at the internal sample rate,
+  // either as int16 or as unit floats.
+  template <typename T>
+  std::optional<std::vector<T>> DecodeSamplesInternal(
       int internal_num_samples_to_generate);
 
   // Overlaps hops using a cos^2 window.
   // Returns true on success, false on failure.
+  template <typename T>
   bool MaybeOverlapAndInsert(FadeDirection fade_direction, int fade_progress,
-                             const std::vector<int16_t>& generative_model_hop,
-                             const std::vector<int16_t>& comfort_noise_hop,
-                             std::vector<int16_t>& result);
+                             const std::vector<T>& generative_model_hop,
+                             const std::vector<T>& comfort_noise_hop,
+                             std::vector<T>& result);
 
   // Runs the generative model and adds estimated features if needed.
-  std::optional<std::vector<int16_t>> RunGenerativeModel(int num_samples);
+  template <typename T>
+  std::optional<std::vector<T>> RunGenerativeModel(int num_samples);
 
   // Runs the comfort noise generator and adds estimated features if needed.
   std::optional<std::vector<int16_t>> RunComfortNoiseGenerator(int num_samples);
@@ -141,6 +311,9 @@ class LyraDecoder : public LyraDecoderInterface {
   // Resamples from the generative model sample rate to the external sampling
   // rate.
   std::unique_ptr<BufferedFilterInterface> resampler_;
+  // Changes the playout speed of the samples of the generative model before
+  // they are resampled.
+  std::unique_ptr<TimeStretcher> time_stretcher_;
 
   // The packet loss state is described by the following three variables:
 
@@ -156,6 +329,11 @@ class LyraDecoder : public LyraDecoderInterface {
   // Indicates if we are incrementing or decrementing |fade_progress|.
   FadeDirection fade_direction_;
 
+  // Whether packets are followed by the FEC data of the previous hop.
+  bool fec_enabled_;
+
+  QualityLevel quality_level_;
+
   const int external_sample_rate_hz_;
   const int num_channels_;
 
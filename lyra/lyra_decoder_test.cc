@@ -26,6 +26,7 @@
 
 // Placeholder for get runfiles header.
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -38,6 +39,7 @@
 #include "lyra/lyra_components.h"
 #include "lyra/lyra_config.h"
 #include "lyra/packet_interface.h"
+#include "lyra/quality_level.h"
 #include "lyra/resampler.h"
 #include "lyra/testing/mock_generative_model.h"
 #include "lyra/testing/mock_noise_estimator.h"
@@ -70,6 +72,14 @@ class LyraDecoderPeer {
     return decoder_.SetEncodedPacket(encoded);
   }
 
+  bool SetEncodedSuperframe(const absl::Span<const uint8_t> encoded) {
+    return decoder_.SetEncodedSuperframe(encoded);
+  }
+
+  void set_quality_level(QualityLevel quality_level) {
+    decoder_.set_quality_level(quality_level);
+  }
+
   std::optional<std::vector<int16_t>> DecodeSamples(int num_samples) {
     return decoder_.DecodeSamples(num_samples);
   }
@@ -553,6 +563,50 @@ TEST_P(LyraDecoderTest, TestFinishDecoding_ComfortNoiseFadetoNormal) {
   }
 }
 
+// Comfort noise quality: State 1 -> State 3 -> State 4 while packets keep
+// arriving, then full quality: State 5 -> State 1.
+TEST_P(LyraDecoderTest, ComfortNoiseQualitySkipsGenerativeModel) {
+  const int kNumComfortNoisePackets = 3;
+  const std::vector<int16_t> hop_samples(internal_num_samples_per_hop_);
+  {
+    ::testing::InSequence in;
+    ExpectSetEncodedPacket(1);
+    ExpectNormalDecoding(hop_samples);
+    // The packets are not decoded at comfort noise quality, and the
+    // generative model only runs to fade out, on estimated features.
+    for (int i = 0; i < fade_duration_packets_; ++i) {
+      ExpectFadeToComfortNoise(hop_samples, /*expect_add_features=*/true);
+    }
+    for (int i = 0; i < kNumComfortNoisePackets; ++i) {
+      ExpectComfortNoise(hop_samples, /*expect_add_features=*/true);
+    }
+    // Back at full quality packets fade in as after a loss.
+    for (int i = 0; i < fade_duration_packets_; ++i) {
+      ExpectSetEncodedPacket(1);
+      ExpectFadeToNormalDecoding(hop_samples, /*expect_add_features=*/true);
+    }
+  }
+
+  CreateDecoder();
+  ASSERT_TRUE(lyra_decoder_peer_->SetEncodedPacket(encoded_zeros_));
+  ASSERT_TRUE(lyra_decoder_peer_->DecodeSamples(external_num_samples_per_hop_)
+                  .has_value());
+  lyra_decoder_peer_->set_quality_level(QualityLevel::kComfortNoise);
+  for (int i = 0; i < fade_duration_packets_ + kNumComfortNoisePackets; ++i) {
+    ASSERT_TRUE(lyra_decoder_peer_->SetEncodedPacket(encoded_zeros_));
+    ASSERT_TRUE(
+        lyra_decoder_peer_->DecodeSamples(external_num_samples_per_hop_)
+            .has_value());
+  }
+  lyra_decoder_peer_->set_quality_level(QualityLevel::kFull);
+  for (int i = 0; i < fade_duration_packets_; ++i) {
+    ASSERT_TRUE(lyra_decoder_peer_->SetEncodedPacket(encoded_zeros_));
+    ASSERT_TRUE(
+        lyra_decoder_peer_->DecodeSamples(external_num_samples_per_hop_)
+            .has_value());
+  }
+}
+
 TEST_P(LyraDecoderTest, MultipleHopsOneRequestNormalDecode) {
   const int kNumHopsToDecode = 4;
   std::vector<int16_t> expected_merged_samples(
@@ -580,6 +634,40 @@ TEST_P(LyraDecoderTest, MultipleHopsOneRequestNormalDecode) {
   ASSERT_TRUE(lyra_decoder_peer_->DecodeSamples(sample_request).has_value());
 }
 
+TEST_P(LyraDecoderTest, SuperframeQueuesAllHops) {
+  const int kNumHopsToDecode = kMaxFramesPerSuperframe;
+  const int sample_request = ConvertNumSamplesBetweenSampleRate(
+      kNumHopsToDecode * internal_num_samples_per_hop_, kInternalSampleRateHz,
+      external_sample_rate_hz_);
+
+  ExpectSetEncodedPacket(/*num_calls=*/kNumHopsToDecode);
+  // All hops are played out without concealment.
+  EXPECT_CALL(*mock_noise_estimator_, ReceiveSamples(::testing::_))
+      .Times(Exactly(kNumHopsToDecode))
+      .WillRepeatedly(Return(true));
+
+  CreateDecoder();
+
+  std::vector<uint8_t> superframe;
+  for (int i = 0; i < kNumHopsToDecode; ++i) {
+    superframe.insert(superframe.end(), encoded_zeros_.begin(),
+                      encoded_zeros_.end());
+  }
+  ASSERT_TRUE(lyra_decoder_peer_->SetEncodedSuperframe(superframe));
+  ASSERT_TRUE(lyra_decoder_peer_->DecodeSamples(sample_request).has_value());
+}
+
+TEST_P(LyraDecoderTest, InvalidSuperframeFails) {
+  EXPECT_CALL(*mock_vector_quantizer_, DecodeToLossyFeatures(::testing::_))
+      .Times(Exactly(0));
+  CreateDecoder();
+
+  EXPECT_FALSE(lyra_decoder_peer_->SetEncodedSuperframe({}));
+  std::vector<uint8_t> too_long(encoded_zeros_);
+  too_long.resize((kMaxFramesPerSuperframe + 1) * encoded_zeros_.size());
+  EXPECT_FALSE(lyra_decoder_peer_->SetEncodedSuperframe(too_long));
+}
+
 TEST_P(LyraDecoderTest, HopsAreOverlappedCorrectly) {
   // Test overlap for correctness. Given two hops, where the values of one
   // are always above the values are the other, the values of the overlapped
@@ -786,6 +874,258 @@ TEST_P(LyraDecoderTest, ValidConfig) {
       nullptr);
 }
 
+// When no hop misses its deadline, running the model in the background has to
+// produce exactly the synchronous output, including the concealment of lost
+// packets whose features are only estimated at playout. The losses are kept
+// shorter than the concealment, since comfort noise is random.
+TEST_P(LyraDecoderTest, AsynchronousModelMatchesSynchronousModel) {
+  auto sync_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  auto async_decoder = LyraDecoder::Create(
+      external_sample_rate_hz_, kNumChannels, model_path_,
+      /*run_model_asynchronously=*/true,
+      /*max_model_wait=*/absl::InfiniteDuration());
+  ASSERT_NE(sync_decoder, nullptr);
+  ASSERT_NE(async_decoder, nullptr);
+  for (const bool is_received :
+       {true, true, false, true, false, false, true, true, false, true}) {
+    if (is_received) {
+      ASSERT_TRUE(sync_decoder->SetEncodedPacket(encoded_zeros_));
+      ASSERT_TRUE(async_decoder->SetEncodedPacket(encoded_zeros_));
+    }
+    auto expected = sync_decoder->DecodeSamples(external_num_samples_per_hop_);
+    auto samples = async_decoder->DecodeSamples(external_num_samples_per_hop_);
+    ASSERT_TRUE(expected.has_value());
+    ASSERT_TRUE(samples.has_value());
+    EXPECT_EQ(samples.value(), expected.value());
+  }
+}
+
+// Decoding the stacked hops of a superframe together has to produce exactly
+// the output of decoding them packet by packet.
+TEST_P(LyraDecoderTest, SuperframeMatchesSeparatePackets) {
+  auto packet_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  auto superframe_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(packet_decoder, nullptr);
+  ASSERT_NE(superframe_decoder, nullptr);
+  const std::string quantized_ones(num_quantized_bits_, '1');
+  const std::vector<std::vector<uint8_t>> packets = {
+      encoded_zeros_, packet_->PackQuantized(quantized_ones), encoded_zeros_};
+  std::vector<uint8_t> superframe;
+  for (const std::vector<uint8_t>& packet : packets) {
+    ASSERT_TRUE(packet_decoder->SetEncodedPacket(packet));
+    superframe.insert(superframe.end(), packet.begin(), packet.end());
+  }
+  ASSERT_TRUE(superframe_decoder->SetEncodedSuperframe(superframe));
+
+  const int num_samples = packets.size() * external_num_samples_per_hop_;
+  auto expected = packet_decoder->DecodeSamples(num_samples);
+  auto samples = superframe_decoder->DecodeSamples(num_samples);
+  ASSERT_TRUE(expected.has_value());
+  ASSERT_TRUE(samples.has_value());
+  EXPECT_EQ(samples.value(), expected.value());
+}
+
+// Decoding to floats skips the int16 rounding of the model output before
+// resampling, so it may only differ from the int16 output by that rounding.
+TEST_P(LyraDecoderTest, FloatSamplesMatchInt16Samples) {
+  auto int16_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  auto float_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(int16_decoder, nullptr);
+  ASSERT_NE(float_decoder, nullptr);
+  const std::string quantized_ones(num_quantized_bits_, '1');
+  for (const auto& packet :
+       {encoded_zeros_, packet_->PackQuantized(quantized_ones)}) {
+    ASSERT_TRUE(int16_decoder->SetEncodedPacket(packet));
+    ASSERT_TRUE(float_decoder->SetEncodedPacket(packet));
+  }
+  // Also decodes two hops of concealment, in uneven requests.
+  const int num_samples = external_num_samples_per_hop_ * 4;
+  for (const int num_samples_requested : {num_samples / 3, num_samples / 2,
+                                          num_samples / 6}) {
+    auto expected = int16_decoder->DecodeSamples(num_samples_requested);
+    auto samples = float_decoder->DecodeSamplesFloat(num_samples_requested);
+    ASSERT_TRUE(expected.has_value());
+    ASSERT_TRUE(samples.has_value());
+    ASSERT_EQ(samples->size(), expected->size());
+    for (int i = 0; i < samples->size(); ++i) {
+      EXPECT_NEAR(samples->at(i), Int16ToUnitScalar<float>(expected->at(i)),
+                  2.f / 32768.f);
+    }
+  }
+}
+
+TEST_P(LyraDecoderTest, PlayoutRateChangesSpeedOfDecoding) {
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  EXPECT_EQ(decoder->playout_rate(), 1.f);
+  EXPECT_FALSE(decoder->set_playout_rate(0.f));
+  EXPECT_FALSE(decoder->set_playout_rate(3.f));
+  EXPECT_EQ(decoder->playout_rate(), 1.f);
+
+  for (const float rate : {0.8f, 1.25f, 2.f, 1.f}) {
+    ASSERT_TRUE(decoder->set_playout_rate(rate));
+    EXPECT_EQ(decoder->playout_rate(), rate);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(decoder->SetEncodedPacket(encoded_zeros_));
+      auto samples = decoder->DecodeSamples(external_num_samples_per_hop_);
+      ASSERT_TRUE(samples.has_value());
+      EXPECT_EQ(samples->size(), external_num_samples_per_hop_);
+    }
+  }
+}
+
+TEST_P(LyraDecoderTest, FecPacketsDecodeLikeTheirParts) {
+  const std::string quantized_ones(num_quantized_bits_, '1');
+  const std::string fec_quantized(kNumFecQuantizedBits, '0');
+  const std::vector<uint8_t> primary = packet_->PackQuantized(quantized_ones);
+  const std::vector<uint8_t> fec_data =
+      CreatePacket(kNumHeaderBits, kNumFecQuantizedBits)
+          ->PackQuantized(fec_quantized);
+  std::vector<uint8_t> fec_packet = primary;
+  fec_packet.insert(fec_packet.end(), fec_data.begin(), fec_data.end());
+
+  auto fec_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(fec_decoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+  EXPECT_FALSE(fec_decoder->fec_enabled());
+  EXPECT_FALSE(fec_decoder->RecoverLostPacket(fec_packet));
+  fec_decoder->set_fec_enabled(true);
+  EXPECT_TRUE(fec_decoder->fec_enabled());
+
+  // The lost hop is decoded from the FEC data, and the next from the primary
+  // packet.
+  ASSERT_TRUE(fec_decoder->RecoverLostPacket(fec_packet));
+  ASSERT_TRUE(fec_decoder->SetEncodedPacket(fec_packet));
+  ASSERT_TRUE(decoder->SetEncodedPacket(fec_data));
+  ASSERT_TRUE(decoder->SetEncodedPacket(primary));
+  for (int i = 0; i < 2; ++i) {
+    const auto expected = decoder->DecodeSamples(external_num_samples_per_hop_);
+    ASSERT_TRUE(expected.has_value());
+    const auto samples =
+        fec_decoder->DecodeSamples(external_num_samples_per_hop_);
+    ASSERT_TRUE(samples.has_value());
+    EXPECT_THAT(samples.value(), testing::ElementsAreArray(expected.value()));
+  }
+}
+
+TEST_P(LyraDecoderTest, FecRejectsPacketsWithoutFecData) {
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  decoder->set_fec_enabled(true);
+  const std::vector<uint8_t> lowest_bitrate_packet(
+      GetPacketSize(GetSupportedQuantizedBits().front()));
+  EXPECT_FALSE(decoder->SetEncodedPacket(lowest_bitrate_packet));
+  EXPECT_FALSE(decoder->RecoverLostPacket(lowest_bitrate_packet));
+  EXPECT_FALSE(decoder->SetEncodedSuperframe(encoded_zeros_));
+}
+
+TEST_P(LyraDecoderTest, RestoredStateContinuesTheSameSamples) {
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  const std::string quantized_ones(num_quantized_bits_, '1');
+  const std::vector<uint8_t> encoded_ones =
+      packet_->PackQuantized(quantized_ones);
+
+  // Saves in the middle of a hop, with another packet queued.
+  ASSERT_TRUE(decoder->SetEncodedPacket(encoded_zeros_));
+  ASSERT_TRUE(
+      decoder->DecodeSamples(external_num_samples_per_hop_ / 2).has_value());
+  ASSERT_TRUE(decoder->SetEncodedPacket(encoded_ones));
+  ASSERT_TRUE(decoder->set_playout_rate(1.25f));
+  const auto state = decoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+
+  auto restored =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(restored, nullptr);
+  ASSERT_TRUE(restored->RestoreState(state.value()));
+  EXPECT_EQ(restored->playout_rate(), 1.25f);
+
+  // Continues through the queued packet into concealment, which ends before
+  // the random comfort noise.
+  for (int i = 0; i < 3; ++i) {
+    const auto expected =
+        decoder->DecodeSamples(external_num_samples_per_hop_ / 2);
+    ASSERT_TRUE(expected.has_value());
+    const auto samples =
+        restored->DecodeSamples(external_num_samples_per_hop_ / 2);
+    ASSERT_TRUE(samples.has_value());
+    EXPECT_THAT(samples.value(), testing::ElementsAreArray(expected.value()));
+  }
+}
+
+TEST_P(LyraDecoderTest, RestoringInvalidStateFails) {
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  ASSERT_TRUE(decoder->SetEncodedPacket(encoded_zeros_));
+  ASSERT_TRUE(
+      decoder->DecodeSamples(external_num_samples_per_hop_).has_value());
+  const auto state = decoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+
+  std::vector<uint8_t> truncated = state.value();
+  truncated.pop_back();
+  EXPECT_FALSE(decoder->RestoreState(truncated));
+  std::vector<uint8_t> extended = state.value();
+  extended.push_back(0);
+  EXPECT_FALSE(decoder->RestoreState(extended));
+  std::vector<uint8_t> wrong_version = state.value();
+  ++wrong_version[4];
+  EXPECT_FALSE(decoder->RestoreState(wrong_version));
+
+  const int other_sample_rate_hz =
+      external_sample_rate_hz_ == 48000 ? kInternalSampleRateHz : 48000;
+  auto other_decoder =
+      LyraDecoder::Create(other_sample_rate_hz, kNumChannels, model_path_);
+  ASSERT_NE(other_decoder, nullptr);
+  EXPECT_FALSE(other_decoder->RestoreState(state.value()));
+  EXPECT_TRUE(decoder->RestoreState(state.value()));
+}
+
+TEST_P(LyraDecoderTest, FailedRestoreLeavesTheDecoderUnchanged) {
+  auto decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  auto other_decoder =
+      LyraDecoder::Create(external_sample_rate_hz_, kNumChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  ASSERT_NE(other_decoder, nullptr);
+  ASSERT_TRUE(decoder->SetEncodedPacket(encoded_zeros_));
+  ASSERT_TRUE(
+      decoder->DecodeSamples(external_num_samples_per_hop_ / 2).has_value());
+  const std::vector<uint8_t> encoded_ones =
+      packet_->PackQuantized(std::string(num_quantized_bits_, '1'));
+  ASSERT_TRUE(other_decoder->SetEncodedPacket(encoded_ones));
+  ASSERT_TRUE(
+      other_decoder->DecodeSamples(external_num_samples_per_hop_).has_value());
+  other_decoder->set_quality_level(QualityLevel::kReducedBitrate);
+  const auto state = decoder->SaveState();
+  const auto other_state = other_decoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+  ASSERT_TRUE(other_state.has_value());
+
+  // Only the last field is missing, so every component could take its state.
+  std::vector<uint8_t> truncated = other_state.value();
+  truncated.pop_back();
+  EXPECT_FALSE(decoder->RestoreState(truncated));
+  EXPECT_EQ(decoder->SaveState(), state);
+  EXPECT_EQ(decoder->quality_level(), QualityLevel::kFull);
+
+  ASSERT_TRUE(decoder->RestoreState(other_state.value()));
+  EXPECT_EQ(decoder->quality_level(), QualityLevel::kReducedBitrate);
+}
+
 TEST_P(LyraDecoderTest, InvalidConfig) {
   for (const auto& invalid_num_channels : {-1, 0, 2}) {
     EXPECT_EQ(LyraDecoder::Create(external_sample_rate_hz_,
@@ -18,6 +18,8 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -26,15 +28,19 @@
 #include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
+#include "lyra/dsp_utils.h"
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/lyra_components.h"
 #include "lyra/lyra_config.h"
+#include "lyra/model_bundle.h"
 #include "lyra/noise_estimator.h"
 #include "lyra/noise_estimator_interface.h"
 #include "lyra/packet.h"
 #include "lyra/packet_interface.h"
 #include "lyra/resampler.h"
 #include "lyra/resampler_interface.h"
+#include "lyra/session_state.h"
+#include "lyra/shared_models.h"
 #include "lyra/vector_quantizer_interface.h"
 
 namespace chromemedia {
@@ -49,6 +55,43 @@ std::unique_ptr<LyraEncoder> LyraEncoder::Create(
     LOG(ERROR) << are_params_supported;
     return nullptr;
   }
+  return CreateFromComponents(sample_rate_hz, num_channels, bitrate,
+                              enable_dtx, CreateFeatureExtractor(model_path),
+                              CreateQuantizer(model_path));
+}
+
+std::unique_ptr<LyraEncoder> LyraEncoder::Create(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+    const SharedModels& shared_models) {
+  absl::Status are_params_supported =
+      AreStreamParamsSupported(sample_rate_hz, num_channels);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  return CreateFromComponents(
+      sample_rate_hz, num_channels, bitrate, enable_dtx,
+      shared_models.CreateFeatureExtractor(), shared_models.CreateQuantizer());
+}
+
+std::unique_ptr<LyraEncoder> LyraEncoder::Create(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+    std::shared_ptr<const ModelBundle> bundle) {
+  absl::Status are_params_supported =
+      AreStreamParamsSupported(sample_rate_hz, num_channels);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  return CreateFromComponents(sample_rate_hz, num_channels, bitrate,
+                              enable_dtx, CreateFeatureExtractor(bundle),
+                              CreateQuantizer(bundle));
+}
+
+std::unique_ptr<LyraEncoder> LyraEncoder::CreateFromComponents(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+    std::unique_ptr<FeatureExtractorInterface> feature_extractor,
+    std::unique_ptr<VectorQuantizerInterface> vector_quantizer) {
   const int num_quantized_bits = BitrateToNumQuantizedBits(bitrate);
   if (num_quantized_bits < 0) {
     LOG(ERROR) << "Bitrate " << bitrate << " bps is not supported by codec.";
@@ -64,13 +107,11 @@ std::unique_ptr<LyraEncoder> LyraEncoder::Create(
     }
   }
 
-  auto feature_extractor = CreateFeatureExtractor(model_path);
   if (feature_extractor == nullptr) {
     LOG(ERROR) << "Could not create Features Extractor.";
     return nullptr;
   }
 
-  auto vector_quantizer = CreateQuantizer(model_path);
   if (vector_quantizer == nullptr) {
     LOG(ERROR) << "Could not create Vector Quantizer.";
     return nullptr;
@@ -79,8 +120,8 @@ std::unique_ptr<LyraEncoder> LyraEncoder::Create(
   std::unique_ptr<NoiseEstimatorInterface> noise_estimator = nullptr;
   if (enable_dtx) {
     noise_estimator = NoiseEstimator::Create(
-        sample_rate_hz, GetNumSamplesPerHop(kInternalSampleRateHz),
-        GetNumSamplesPerWindow(kInternalSampleRateHz), kNumMelBins);
+        sample_rate_hz, InternalProfile::kNumSamplesPerHop,
+        InternalProfile::kNumSamplesPerWindow, kNumMelBins);
     if (noise_estimator == nullptr) {
       LOG(ERROR) << "Could not create Noise Estimator.";
       return nullptr;
@@ -106,41 +147,73 @@ LyraEncoder::LyraEncoder(
       noise_estimator_(std::move(noise_estimator)),
       vector_quantizer_(std::move(vector_quantizer)),
       sample_rate_hz_(sample_rate_hz),
+      num_samples_per_hop_(GetNumSamplesPerHop(sample_rate_hz)),
       num_channels_(num_channels),
       num_quantized_bits_(num_quantized_bits),
-      enable_dtx_(enable_dtx) {}
+      enable_dtx_(enable_dtx),
+      fec_enabled_(false) {}
 
-std::optional<std::vector<uint8_t>> LyraEncoder::Encode(
-    const absl::Span<const int16_t> audio) {
-  absl::Span<const int16_t> audio_for_encoding = audio;
+template <typename T>
+std::optional<absl::Span<const T>> LyraEncoder::PrepareHop(
+    absl::Span<const T> audio, std::vector<T>* processed) {
+  absl::Span<const T> audio_for_encoding = audio;
 
-  // Space to store resampled and/or filtered samples.
-  std::vector<int16_t> processed;
   if (kInternalSampleRateHz != sample_rate_hz_) {
-    processed = resampler_->Resample(audio);
-    audio_for_encoding = absl::MakeConstSpan(processed);
+    if constexpr (std::is_same_v<T, float>) {
+      *processed = resampler_->ResampleFloat(audio);
+    } else {
+      *processed = resampler_->Resample(audio);
+    }
+    audio_for_encoding = absl::MakeConstSpan(*processed);
   }
 
-  if (audio_for_encoding.size() != GetNumSamplesPerHop(kInternalSampleRateHz)) {
+  if (audio_for_encoding.size() != InternalProfile::kNumSamplesPerHop) {
     LOG(ERROR) << "The number of audio samples has to be exactly "
-               << GetNumSamplesPerHop(sample_rate_hz_) << ", but is "
+               << num_samples_per_hop_ << ", but is "
                << audio.size() << ".";
     return std::nullopt;
   }
 
   if (enable_dtx_) {
-    if (!noise_estimator_->ReceiveSamples(audio_for_encoding)) {
+    // The noise estimator only works on int16 samples.
+    bool received;
+    if constexpr (std::is_same_v<T, float>) {
+      received = noise_estimator_->ReceiveSamples(
+          UnitToInt16(audio_for_encoding));
+    } else {
+      received = noise_estimator_->ReceiveSamples(audio_for_encoding);
+    }
+    if (!received) {
       LOG(ERROR) << "Unable to update encoder noise estimator.";
       return std::nullopt;
     }
-    // We send an empty packet only if this hop is just noise.
-    if (noise_estimator_->is_noise()) {
-      auto empty_packet = Packet<0>::Create(0, 0);
-      return empty_packet->PackQuantized(std::bitset<0>{}.to_string());
-    }
+  }
+  return audio_for_encoding;
+}
+
+template <typename T>
+std::optional<std::vector<uint8_t>> LyraEncoder::EncodeOfType(
+    absl::Span<const T> audio) {
+  // Space to store resampled and/or filtered samples.
+  std::vector<T> processed;
+  const auto audio_for_encoding = PrepareHop(audio, &processed);
+  if (!audio_for_encoding.has_value()) {
+    return std::nullopt;
+  }
+
+  // We send an empty packet only if this hop is just noise.
+  if (enable_dtx_ && noise_estimator_->is_noise()) {
+    previous_fec_packet_.clear();
+    auto empty_packet = Packet<0>::Create(0, 0);
+    return empty_packet->PackQuantized(std::bitset<0>{}.to_string());
   }
 
-  auto features = feature_extractor_->Extract(audio_for_encoding);
+  std::optional<std::vector<float>> features;
+  if constexpr (std::is_same_v<T, float>) {
+    features = feature_extractor_->ExtractFloat(audio_for_encoding.value());
+  } else {
+    features = feature_extractor_->Extract(audio_for_encoding.value());
+  }
   if (!features.has_value()) {
     LOG(ERROR) << "Unable to extract features from audio hop.";
     return std::nullopt;
@@ -151,10 +224,102 @@ std::optional<std::vector<uint8_t>> LyraEncoder::Encode(
     LOG(ERROR) << "Unable to quantize features.";
     return std::nullopt;
   }
+  return PackHop(quantized_features.value());
+}
+
+std::vector<uint8_t> LyraEncoder::PackHop(const std::string& quantized) {
   auto packet = CreatePacket(kNumHeaderBits, num_quantized_bits_);
-  return packet->PackQuantized(quantized_features.value());
+  std::vector<uint8_t> encoded = packet->PackQuantized(quantized);
+  if (!fec_enabled_) {
+    previous_fec_packet_.clear();
+    return encoded;
+  }
+  // The first quantizers are the coarsest, so their bits lead |quantized|.
+  auto fec_packet = CreatePacket(kNumHeaderBits, kNumFecQuantizedBits);
+  std::vector<uint8_t> fec_encoded =
+      fec_packet->PackQuantized(quantized.substr(0, kNumFecQuantizedBits));
+  const std::vector<uint8_t>& fec_data =
+      previous_fec_packet_.empty() ? fec_encoded : previous_fec_packet_;
+  encoded.insert(encoded.end(), fec_data.begin(), fec_data.end());
+  previous_fec_packet_ = std::move(fec_encoded);
+  return encoded;
+}
+
+std::optional<std::vector<uint8_t>> LyraEncoder::Encode(
+    const absl::Span<const int16_t> audio) {
+  return EncodeOfType(audio);
+}
+
+std::optional<std::vector<uint8_t>> LyraEncoder::EncodeFloat(
+    absl::Span<const float> audio) {
+  return EncodeOfType(audio);
+}
+
+std::optional<std::vector<uint8_t>> LyraEncoder::EncodeSuperframe(
+    absl::Span<const int16_t> audio) {
+  if (fec_enabled_) {
+    LOG(ERROR) << "Superframes do not support forward error correction.";
+    return std::nullopt;
+  }
+  const int num_frames = audio.size() / num_samples_per_hop_;
+  if (audio.size() % num_samples_per_hop_ != 0 || num_frames < 1 ||
+      num_frames > kMaxFramesPerSuperframe) {
+    LOG(ERROR) << "A superframe has to hold between 1 and "
+               << kMaxFramesPerSuperframe << " hops of "
+               << num_samples_per_hop_ << " samples, but " << audio.size()
+               << " samples were provided.";
+    return std::nullopt;
+  }
+
+  // Features are extracted for every hop, since the superframe is sent if any
+  // of them is not noise, and to keep the streaming extractor in step.
+  std::vector<int16_t> processed;
+  std::vector<std::vector<float>> frames;
+  frames.reserve(num_frames);
+  bool is_noise = enable_dtx_;
+  for (int i = 0; i < num_frames; ++i) {
+    const auto audio_for_encoding = PrepareHop(
+        audio.subspan(i * num_samples_per_hop_, num_samples_per_hop_),
+        &processed);
+    if (!audio_for_encoding.has_value()) {
+      return std::nullopt;
+    }
+    is_noise = is_noise && noise_estimator_->is_noise();
+    auto features = feature_extractor_->Extract(audio_for_encoding.value());
+    if (!features.has_value()) {
+      LOG(ERROR) << "Unable to extract features from audio hop " << i << ".";
+      return std::nullopt;
+    }
+    frames.push_back(std::move(features.value()));
+  }
+  if (is_noise) {
+    previous_fec_packet_.clear();
+    return std::vector<uint8_t>();
+  }
+
+  std::vector<uint8_t> superframe;
+  superframe.reserve(num_frames * GetPacketSize(num_quantized_bits_));
+  for (const std::vector<float>& features : frames) {
+    auto quantized_features =
+        vector_quantizer_->Quantize(features, num_quantized_bits_);
+    if (!quantized_features.has_value()) {
+      LOG(ERROR) << "Unable to quantize features.";
+      return std::nullopt;
+    }
+    const std::vector<uint8_t> frame_packet =
+        PackHop(quantized_features.value());
+    superframe.insert(superframe.end(), frame_packet.begin(),
+                      frame_packet.end());
+  }
+  return superframe;
+}
+
+void LyraEncoder::set_fec_enabled(bool fec_enabled) {
+  fec_enabled_ = fec_enabled;
 }
 
+bool LyraEncoder::fec_enabled() const { return fec_enabled_; }
+
 bool LyraEncoder::set_bitrate(int bitrate) {
   const int num_quantized_bits = BitrateToNumQuantizedBits(bitrate);
   if (num_quantized_bits < 0) {
@@ -165,6 +330,86 @@ bool LyraEncoder::set_bitrate(int bitrate) {
   return true;
 }
 
+std::optional<std::vector<uint8_t>> LyraEncoder::SaveState() const {
+  StateWriter writer(SessionKind::kEncoder);
+  writer.Write<int32_t>(sample_rate_hz_);
+  writer.Write(enable_dtx_);
+  writer.Write<int32_t>(num_quantized_bits_);
+  writer.Write(fec_enabled_);
+  writer.WriteVector<uint8_t>(previous_fec_packet_);
+  if ((resampler_ != nullptr && !resampler_->SaveState(&writer)) ||
+      !feature_extractor_->SaveState(&writer) ||
+      (enable_dtx_ && !noise_estimator_->SaveState(&writer))) {
+    LOG(ERROR) << "Could not save the encoder state.";
+    return std::nullopt;
+  }
+  return writer.bytes();
+}
+
+bool LyraEncoder::RestoreState(absl::Span<const uint8_t> state) {
+  // A state that turns out to be invalid after some components took it is
+  // undone with a snapshot of the current state.
+  const auto current_state = SaveState();
+  if (!current_state.has_value()) {
+    return false;
+  }
+  if (RestoreStateOfComponents(state)) {
+    return true;
+  }
+  CHECK(RestoreStateOfComponents(current_state.value()))
+      << "Could not return the encoder to its state before the restore.";
+  return false;
+}
+
+bool LyraEncoder::RestoreStateOfComponents(absl::Span<const uint8_t> state) {
+  auto reader = StateReader::Create(state, SessionKind::kEncoder);
+  if (reader == nullptr) {
+    return false;
+  }
+  int32_t sample_rate_hz;
+  bool enable_dtx;
+  int32_t num_quantized_bits;
+  bool fec_enabled;
+  std::vector<uint8_t> previous_fec_packet;
+  if (!reader->Read(&sample_rate_hz) || !reader->Read(&enable_dtx) ||
+      !reader->Read(&num_quantized_bits) || !reader->Read(&fec_enabled) ||
+      !reader->ReadVector(&previous_fec_packet)) {
+    return false;
+  }
+  if (sample_rate_hz != sample_rate_hz_ || enable_dtx != enable_dtx_) {
+    LOG(ERROR) << "The state was saved by an encoder at " << sample_rate_hz
+               << " Hz with DTX " << (enable_dtx ? "on" : "off")
+               << ", but this encoder runs at " << sample_rate_hz_
+               << " Hz with DTX " << (enable_dtx_ ? "on" : "off") << ".";
+    return false;
+  }
+  if (BitrateToNumQuantizedBits(GetBitrate(num_quantized_bits)) !=
+      num_quantized_bits) {
+    LOG(ERROR) << num_quantized_bits << " quantized bits are not supported.";
+    return false;
+  }
+  if (!previous_fec_packet.empty() &&
+      previous_fec_packet.size() != GetPacketSize(kNumFecQuantizedBits)) {
+    LOG(ERROR) << "Invalid FEC packet of " << previous_fec_packet.size()
+               << " bytes in the encoder state.";
+    return false;
+  }
+  if ((resampler_ != nullptr && !resampler_->RestoreState(reader.get())) ||
+      !feature_extractor_->RestoreState(reader.get()) ||
+      (enable_dtx_ && !noise_estimator_->RestoreState(reader.get()))) {
+    LOG(ERROR) << "Could not restore the encoder state.";
+    return false;
+  }
+  if (!reader->at_end()) {
+    LOG(ERROR) << "The encoder state has unexpected trailing data.";
+    return false;
+  }
+  num_quantized_bits_ = num_quantized_bits;
+  fec_enabled_ = fec_enabled;
+  previous_fec_packet_ = std::move(previous_fec_packet);
+  return true;
+}
+
 int LyraEncoder::sample_rate_hz() const { return sample_rate_hz_; }
 
 int LyraEncoder::num_channels() const { return num_channels_; }
@@ -20,12 +20,14 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "absl/types/span.h"
 #include "include/ghc/filesystem.hpp"
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/lyra_encoder_interface.h"
+#include "lyra/model_bundle.h"
 #include "lyra/noise_estimator_interface.h"
 #include "lyra/resampler_interface.h"
 #include "lyra/vector_quantizer_interface.h"
@@ -33,6 +35,8 @@
 namespace chromemedia {
 namespace codec {
 
+class SharedModels;
+
 /// @example lyra_integration_test.cc
 /// An example of how to encode and decode an audio stream using LyraEncoder and
 /// LyraDecoder can be found here.
@@ -62,6 +66,41 @@ class LyraEncoder : public LyraEncoderInterface {
       int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
       const ghc::filesystem::path& model_path);
 
+  /// Static method to create a LyraEncoder running on interpreters shared with
+  /// other sessions of the same worker thread.
+  ///
+  /// The encoder only owns the recurrent state of the models, and has to be
+  /// used on the same thread as every other session created from
+  /// |shared_models|, which has to outlive it.
+  ///
+  /// @param sample_rate_hz Desired sample rate in Hertz.
+  /// @param num_channels Desired number of channels.
+  /// @param bitrate Desired bit rate.
+  /// @param enable_dtx Set to true if discontinuous transmission should be
+  ///                   enabled.
+  /// @param shared_models Models shared by the sessions of one worker.
+  /// @return A unique_ptr to a LyraEncoder if all desired params are supported.
+  ///         Else it returns a nullptr.
+  static std::unique_ptr<LyraEncoder> Create(int sample_rate_hz,
+                                             int num_channels, int bitrate,
+                                             bool enable_dtx,
+                                             const SharedModels& shared_models);
+
+  /// Static method to create a LyraEncoder from models that were loaded into
+  /// a |ModelBundle| before.
+  ///
+  /// @param sample_rate_hz Desired sample rate in Hertz.
+  /// @param num_channels Desired number of channels.
+  /// @param bitrate Desired bit rate.
+  /// @param enable_dtx Set to true if discontinuous transmission should be
+  ///                   enabled.
+  /// @param bundle Bundle holding the models, which the encoder keeps alive.
+  /// @return A unique_ptr to a LyraEncoder if all desired params are supported.
+  ///         Else it returns a nullptr.
+  static std::unique_ptr<LyraEncoder> Create(
+      int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+      std::shared_ptr<const ModelBundle> bundle);
+
   /// Encodes the audio samples into a vector wrapped byte array.
   ///
   /// @param audio Span of int16-formatted samples. It is assumed to contain
@@ -74,6 +113,73 @@ class LyraEncoder : public LyraEncoderInterface {
   std::optional<std::vector<uint8_t>> Encode(
       const absl::Span<const int16_t> audio) override;
 
+  /// Encodes unit float audio samples into a vector wrapped byte array.
+  ///
+  /// Same as |Encode|, but the samples are fed to the resampler and the
+  /// feature extractor as floats, without a round trip through int16.
+  ///
+  /// @param audio Span of float samples in [-1, 1]. It is assumed to contain
+  ///              20ms of data at the sample rate chosen at Create time.
+  /// @return Encoded packet as a vector of bytes, or nullopt on failure. The
+  ///         return vector will be of length zero if discontinuous
+  ///         transmission mode is enabled and the frame contains background
+  ///         noise.
+  std::optional<std::vector<uint8_t>> EncodeFloat(
+      absl::Span<const float> audio);
+
+  /// Encodes several consecutive hops into a single superframe packet.
+  ///
+  /// The features of every hop are extracted and quantized on their own, as
+  /// |Encode| would, and the superframe is the concatenation of the packets
+  /// of every hop. With discontinuous transmission the superframe is only
+  /// left empty if all of its hops contain background noise, so that a
+  /// decoder never has to fill gaps within it.
+  ///
+  /// @param audio Span of int16-formatted samples. It is assumed to contain
+  ///              between 1 and |kMaxFramesPerSuperframe| hops of 20ms at the
+  ///              sample rate chosen at Create time.
+  /// @return Encoded superframe as a vector of bytes, or nullopt if the
+  ///         number of samples is not a supported number of hops or if
+  ///         forward error correction is enabled.
+  std::optional<std::vector<uint8_t>> EncodeSuperframe(
+      absl::Span<const int16_t> audio);
+
+  /// Saves the state of the session, so that another encoder, possibly in
+  /// another process, can continue the stream where this one left off.
+  ///
+  /// The state holds the recurrent state of the feature extractor, the latest
+  /// input of the resampler, the noise statistics if discontinuous
+  /// transmission is enabled, and the bitrate. It is only valid for an encoder
+  /// created with the same sample rate, setting of discontinuous transmission
+  /// and models.
+  ///
+  /// @return The state in a versioned binary format, or nullopt on failure.
+  std::optional<std::vector<uint8_t>> SaveState() const;
+
+  /// Restores a state saved by |SaveState|, after which this encoder produces
+  /// the same packets as the encoder that saved it would have.
+  ///
+  /// @param state State returned by |SaveState|.
+  /// @return True on success. On failure the encoder is left as it was.
+  bool RestoreState(absl::Span<const uint8_t> state);
+
+  /// Enables or disables in-band forward error correction (FEC).
+  ///
+  /// With FEC every packet from |Encode| and |EncodeFloat| is followed by a
+  /// packet of the previous hop at the lowest bitrate, which adds 3200 bps and
+  /// lets |LyraDecoder::RecoverLostPacket| recover a single lost packet from
+  /// the packet after it. The first packet, the first one after a packet left
+  /// out by discontinuous transmission and the first one after FEC is enabled
+  /// carry their own hop instead.
+  ///
+  /// @param fec_enabled Set to true to append FEC data to every packet.
+  void set_fec_enabled(bool fec_enabled);
+
+  /// Getter for whether forward error correction is enabled.
+  ///
+  /// @return True if FEC data is appended to every packet.
+  bool fec_enabled() const;
+
   /// Setter for the bitrate.
   ///
   /// @param bitrate Desired bitrate in bps.
@@ -102,6 +208,11 @@ class LyraEncoder : public LyraEncoderInterface {
 
  private:
   LyraEncoder() = delete;
+  static std::unique_ptr<LyraEncoder> CreateFromComponents(
+      int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+      std::unique_ptr<FeatureExtractorInterface> feature_extractor,
+      std::unique_ptr<VectorQuantizerInterface> vector_quantizer);
+
   LyraEncoder(std::unique_ptr<ResamplerInterface> resampler,
               std::unique_ptr<FeatureExtractorInterface> feature_extractor,
               std::unique_ptr<NoiseEstimatorInterface> noise_estimator,
@@ -109,15 +220,42 @@ class LyraEncoder : public LyraEncoderInterface {
               int sample_rate_hz, int num_channels, int num_quantized_bits,
               bool enable_dtx);
 
+  // Restores the components one after the other, so on failure the encoder
+  // may be partially restored. The own fields are only set on success.
+  bool RestoreStateOfComponents(absl::Span<const uint8_t> state);
+
+  // Resamples one hop of |audio| to the internal sample rate, storing the
+  // resampled audio in |processed| if needed, and feeds it to the noise
+  // estimator if discontinuous transmission is enabled. Returns the hop at the
+  // internal sample rate, or nullopt on failure.
+  template <typename T>
+  std::optional<absl::Span<const T>> PrepareHop(absl::Span<const T> audio,
+                                                std::vector<T>* processed);
+
+  template <typename T>
+  std::optional<std::vector<uint8_t>> EncodeOfType(absl::Span<const T> audio);
+
+  // Packs |quantized| into a packet. If FEC is enabled, appends the FEC data
+  // of the previous hop and keeps the packet of the coarsest quantizers of
+  // |quantized| for the next hop.
+  std::vector<uint8_t> PackHop(const std::string& quantized);
+
   const std::unique_ptr<ResamplerInterface> resampler_;
   const std::unique_ptr<FeatureExtractorInterface> feature_extractor_;
   const std::unique_ptr<NoiseEstimatorInterface> noise_estimator_;
   const std::unique_ptr<VectorQuantizerInterface> vector_quantizer_;
 
   const int sample_rate_hz_;
+  // Computed once, since every hop and superframe is checked against it.
+  const int num_samples_per_hop_;
   const int num_channels_;
   int num_quantized_bits_;
   const bool enable_dtx_;
+  bool fec_enabled_;
+  // Coarsest quantizers of the last encoded hop at the lowest bitrate, or
+  // empty if that hop was left out by discontinuous transmission or encoded
+  // without FEC.
+  std::vector<uint8_t> previous_fec_packet_;
   friend class LyraEncoderPeer;
 };
 
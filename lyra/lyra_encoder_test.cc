@@ -14,6 +14,7 @@
 
 #include "lyra/lyra_encoder.h"
 
+#include <algorithm>
 #include <bitset>
 #include <climits>
 #include <cstdint>
@@ -30,6 +31,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "include/ghc/filesystem.hpp"
+#include "lyra/dsp_utils.h"
 #include "lyra/feature_extractor_interface.h"
 #include "lyra/lyra_config.h"
 #include "lyra/noise_estimator_interface.h"
@@ -64,6 +66,16 @@ class LyraEncoderPeer {
     return encoder_.Encode(audio);
   }
 
+  std::optional<std::vector<uint8_t>> EncodeFloat(
+      absl::Span<const float> audio) {
+    return encoder_.EncodeFloat(audio);
+  }
+
+  std::optional<std::vector<uint8_t>> EncodeSuperframe(
+      absl::Span<const int16_t> audio) {
+    return encoder_.EncodeSuperframe(audio);
+  }
+
   bool set_bitrate(int bitrate) { return encoder_.set_bitrate(bitrate); }
 
  private:
@@ -301,6 +313,152 @@ TEST_P(LyraEncoderTest, MultipleEncodeCalls) {
   }
 }
 
+TEST_P(LyraEncoderTest, EncodeFloatFeedsFloatsToExtractor) {
+  const std::vector<float> float_samples =
+      Int16ToUnit<float>(absl::MakeConstSpan(samples_));
+  const std::vector<float> internal_float_samples =
+      Int16ToUnit<float>(internal_samples_span_);
+  if (kInternalSampleRateHz == external_sample_rate_hz_) {
+    EXPECT_CALL(*mock_resampler_, ResampleFloat(_)).Times(0);
+  } else {
+    EXPECT_CALL(*mock_resampler_,
+                ResampleFloat(absl::MakeConstSpan(float_samples)))
+        .WillOnce(Return(internal_float_samples));
+  }
+  EXPECT_CALL(*mock_resampler_, Resample(_)).Times(0);
+  EXPECT_CALL(*mock_feature_extractor_, Extract(_)).Times(0);
+  EXPECT_CALL(*mock_feature_extractor_,
+              ExtractFloat(absl::MakeConstSpan(internal_float_samples)))
+      .WillOnce(Return(mock_features_));
+  EXPECT_CALL(*mock_vector_quantizer_,
+              Quantize(mock_features_, num_quantized_bits_))
+      .WillOnce(Return(mock_quantized_));
+
+  LyraEncoderPeer encoder_peer(std::move(mock_resampler_),
+                               std::move(mock_feature_extractor_), nullptr,
+                               std::move(mock_vector_quantizer_),
+                               external_sample_rate_hz_, num_quantized_bits_,
+                               /*enable_dtx=*/false);
+  auto encoded = encoder_peer.EncodeFloat(float_samples);
+  ASSERT_TRUE(encoded.has_value());
+  EXPECT_TRUE(DoesPacketContainQuantized(encoded.value(), mock_quantized_));
+}
+
+TEST_P(LyraEncoderTest, EncodeFloatFeedsNoiseEstimatorInt16) {
+  const std::vector<float> float_samples(
+      GetNumSamplesPerHop(external_sample_rate_hz_), 0.5f);
+  const std::vector<float> internal_float_samples(
+      internal_num_samples_per_hop_, 0.5f);
+  const std::vector<int16_t> internal_int16_samples(
+      internal_num_samples_per_hop_, 16384);
+  if (kInternalSampleRateHz != external_sample_rate_hz_) {
+    EXPECT_CALL(*mock_resampler_, ResampleFloat(_))
+        .WillOnce(Return(internal_float_samples));
+  }
+  EXPECT_CALL(*mock_noise_estimator_,
+              ReceiveSamples(absl::MakeConstSpan(internal_int16_samples)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_noise_estimator_, is_noise()).WillOnce(Return(true));
+  EXPECT_CALL(*mock_feature_extractor_, ExtractFloat(_)).Times(0);
+
+  LyraEncoderPeer encoder_peer(
+      std::move(mock_resampler_), std::move(mock_feature_extractor_),
+      std::move(mock_noise_estimator_), std::move(mock_vector_quantizer_),
+      external_sample_rate_hz_, num_quantized_bits_, /*enable_dtx=*/true);
+  auto encoded = encoder_peer.EncodeFloat(float_samples);
+  ASSERT_TRUE(encoded.has_value());
+  EXPECT_TRUE(encoded->empty());
+}
+
+TEST_P(LyraEncoderTest, SuperframeConcatenatesPacketsOfAllHops) {
+  constexpr int kNumFrames = 3;
+  std::vector<int16_t> superframe_samples;
+  for (int i = 0; i < kNumFrames; ++i) {
+    superframe_samples.insert(superframe_samples.end(), samples_.begin(),
+                              samples_.end());
+  }
+  SetResamplerExpectation(kNumFrames);
+  EXPECT_CALL(*mock_feature_extractor_, Extract(internal_samples_span_))
+      .Times(kNumFrames)
+      .WillRepeatedly(Return(mock_features_));
+  EXPECT_CALL(*mock_vector_quantizer_,
+              Quantize(mock_features_, num_quantized_bits_))
+      .Times(kNumFrames)
+      .WillRepeatedly(Return(mock_quantized_));
+
+  LyraEncoderPeer encoder_peer(std::move(mock_resampler_),
+                               std::move(mock_feature_extractor_), nullptr,
+                               std::move(mock_vector_quantizer_),
+                               external_sample_rate_hz_, num_quantized_bits_,
+                               /*enable_dtx=*/false);
+  auto encoded = encoder_peer.EncodeSuperframe(superframe_samples);
+
+  ASSERT_TRUE(encoded.has_value());
+  const int packet_size = GetPacketSize(num_quantized_bits_);
+  ASSERT_EQ(encoded->size(), kNumFrames * packet_size);
+  for (int i = 0; i < kNumFrames; ++i) {
+    EXPECT_TRUE(DoesPacketContainQuantized(
+        std::vector<uint8_t>(encoded->begin() + i * packet_size,
+                             encoded->begin() + (i + 1) * packet_size),
+        mock_quantized_));
+  }
+}
+
+TEST_P(LyraEncoderTest, SuperframeIsOnlyEmptyIfAllHopsAreNoise) {
+  constexpr int kNumFrames = 2;
+  std::vector<int16_t> superframe_samples = samples_;
+  superframe_samples.insert(superframe_samples.end(), samples_.begin(),
+                            samples_.end());
+  SetResamplerExpectation(2 * kNumFrames);
+  EXPECT_CALL(*mock_noise_estimator_, ReceiveSamples(_))
+      .Times(2 * kNumFrames)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_noise_estimator_, is_noise())
+      .WillOnce(Return(true))
+      .WillOnce(Return(true))
+      .WillOnce(Return(true))
+      .WillOnce(Return(false));
+  EXPECT_CALL(*mock_feature_extractor_, Extract(_))
+      .Times(2 * kNumFrames)
+      .WillRepeatedly(Return(mock_features_));
+  EXPECT_CALL(*mock_vector_quantizer_, Quantize(_, _))
+      .Times(kNumFrames)
+      .WillRepeatedly(Return(mock_quantized_));
+
+  LyraEncoderPeer encoder_peer(
+      std::move(mock_resampler_), std::move(mock_feature_extractor_),
+      std::move(mock_noise_estimator_), std::move(mock_vector_quantizer_),
+      external_sample_rate_hz_, num_quantized_bits_,
+      /*enable_dtx=*/true);
+  auto noise = encoder_peer.EncodeSuperframe(superframe_samples);
+  auto partly_noise = encoder_peer.EncodeSuperframe(superframe_samples);
+
+  ASSERT_TRUE(noise.has_value());
+  EXPECT_TRUE(noise->empty());
+  ASSERT_TRUE(partly_noise.has_value());
+  EXPECT_EQ(partly_noise->size(),
+            kNumFrames * GetPacketSize(num_quantized_bits_));
+}
+
+TEST_P(LyraEncoderTest, SuperframeWithUnsupportedNumberOfHopsFails) {
+  EXPECT_CALL(*mock_feature_extractor_, Extract(_)).Times(0);
+  EXPECT_CALL(*mock_vector_quantizer_, Quantize(_, _)).Times(0);
+
+  LyraEncoderPeer encoder_peer(std::move(mock_resampler_),
+                               std::move(mock_feature_extractor_), nullptr,
+                               std::move(mock_vector_quantizer_),
+                               external_sample_rate_hz_, num_quantized_bits_,
+                               /*enable_dtx=*/false);
+  EXPECT_FALSE(encoder_peer.EncodeSuperframe({}).has_value());
+  EXPECT_FALSE(encoder_peer
+                   .EncodeSuperframe(std::vector<int16_t>(
+                       (kMaxFramesPerSuperframe + 1) * samples_.size()))
+                   .has_value());
+  EXPECT_FALSE(encoder_peer
+                   .EncodeSuperframe(std::vector<int16_t>(samples_.size() + 1))
+                   .has_value());
+}
+
 TEST_P(LyraEncoderTest, GoodCreationParametersReturnNotNullptr) {
   const auto valid_model_path =
       ghc::filesystem::current_path() / "lyra/model_coeffs";
@@ -349,6 +507,125 @@ TEST_P(LyraEncoderTest, BadCreationParametersReturnNullptr) {
                                 /*enable_dtx=*/true, "bad_model_path"));
 }
 
+TEST_P(LyraEncoderTest, RestoredStateEncodesTheSamePackets) {
+  const auto model_path = ghc::filesystem::current_path() / "lyra/model_coeffs";
+  auto encoder = LyraEncoder::Create(external_sample_rate_hz_, kNumChannels,
+                                     GetBitrate(num_quantized_bits_),
+                                     /*enable_dtx=*/true, model_path);
+  ASSERT_NE(encoder, nullptr);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(encoder->Encode(samples_span_).has_value());
+  }
+  const auto state = encoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+
+  auto restored = LyraEncoder::Create(external_sample_rate_hz_, kNumChannels,
+                                      GetBitrate(num_quantized_bits_),
+                                      /*enable_dtx=*/true, model_path);
+  ASSERT_NE(restored, nullptr);
+  ASSERT_TRUE(restored->RestoreState(state.value()));
+  for (int i = 0; i < 3; ++i) {
+    const auto expected = encoder->Encode(samples_span_);
+    ASSERT_TRUE(expected.has_value());
+    const auto packet = restored->Encode(samples_span_);
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_EQ(packet.value(), expected.value());
+  }
+}
+
+TEST_P(LyraEncoderTest, RestoringMismatchedStateFails) {
+  const auto model_path = ghc::filesystem::current_path() / "lyra/model_coeffs";
+  auto encoder = LyraEncoder::Create(external_sample_rate_hz_, kNumChannels,
+                                     GetBitrate(num_quantized_bits_),
+                                     /*enable_dtx=*/false, model_path);
+  ASSERT_NE(encoder, nullptr);
+  const auto state = encoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+
+  auto dtx_encoder = LyraEncoder::Create(external_sample_rate_hz_,
+                                         kNumChannels,
+                                         GetBitrate(num_quantized_bits_),
+                                         /*enable_dtx=*/true, model_path);
+  ASSERT_NE(dtx_encoder, nullptr);
+  EXPECT_FALSE(dtx_encoder->RestoreState(state.value()));
+  std::vector<uint8_t> truncated = state.value();
+  truncated.pop_back();
+  EXPECT_FALSE(encoder->RestoreState(truncated));
+  EXPECT_TRUE(encoder->RestoreState(state.value()));
+}
+
+TEST_P(LyraEncoderTest, FailedRestoreLeavesTheEncoderUnchanged) {
+  const auto model_path = ghc::filesystem::current_path() / "lyra/model_coeffs";
+  auto encoder = LyraEncoder::Create(external_sample_rate_hz_, kNumChannels,
+                                     GetBitrate(num_quantized_bits_),
+                                     /*enable_dtx=*/true, model_path);
+  auto other_encoder = LyraEncoder::Create(external_sample_rate_hz_,
+                                           kNumChannels,
+                                           GetBitrate(num_quantized_bits_),
+                                           /*enable_dtx=*/true, model_path);
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(other_encoder, nullptr);
+  other_encoder->set_fec_enabled(true);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(other_encoder->Encode(samples_span_).has_value());
+  }
+  const auto state = encoder->SaveState();
+  const auto other_state = other_encoder->SaveState();
+  ASSERT_TRUE(state.has_value());
+  ASSERT_TRUE(other_state.has_value());
+
+  // Only the last field is missing, so every component could take its state.
+  std::vector<uint8_t> truncated = other_state.value();
+  truncated.pop_back();
+  EXPECT_FALSE(encoder->RestoreState(truncated));
+  EXPECT_EQ(encoder->SaveState(), state);
+  EXPECT_FALSE(encoder->fec_enabled());
+}
+
+TEST_P(LyraEncoderTest, FecAppendsCoarsePacketOfPreviousHop) {
+  const auto model_path = ghc::filesystem::current_path() / "lyra/model_coeffs";
+  auto fec_encoder = LyraEncoder::Create(external_sample_rate_hz_,
+                                         kNumChannels,
+                                         GetBitrate(num_quantized_bits_),
+                                         /*enable_dtx=*/false, model_path);
+  auto encoder = LyraEncoder::Create(external_sample_rate_hz_, kNumChannels,
+                                     GetBitrate(num_quantized_bits_),
+                                     /*enable_dtx=*/false, model_path);
+  ASSERT_NE(fec_encoder, nullptr);
+  ASSERT_NE(encoder, nullptr);
+  EXPECT_FALSE(fec_encoder->fec_enabled());
+  EXPECT_EQ(fec_encoder->bitrate(), encoder->bitrate());
+
+  // A hop encoded without FEC leaves nothing for the next packet.
+  const auto first_packet = fec_encoder->Encode(samples_);
+  ASSERT_TRUE(first_packet.has_value());
+  EXPECT_EQ(first_packet, encoder->Encode(samples_));
+  fec_encoder->set_fec_enabled(true);
+  EXPECT_TRUE(fec_encoder->fec_enabled());
+
+  // Without a header, the coarse packet of a hop is the start of its packet.
+  const int packet_size = GetPacketSize(num_quantized_bits_);
+  const int fec_size = GetPacketSize(kNumFecQuantizedBits);
+  std::vector<uint8_t> previous_packet;
+  for (int i = 0; i < 4; ++i) {
+    std::vector<int16_t> audio(samples_);
+    std::rotate(audio.begin(), audio.begin() + 7 * (i + 1), audio.end());
+    const auto packet = encoder->Encode(audio);
+    ASSERT_TRUE(packet.has_value());
+    const auto fec_packet = fec_encoder->Encode(audio);
+    ASSERT_TRUE(fec_packet.has_value());
+    ASSERT_EQ(fec_packet->size(), GetFecPacketSize(num_quantized_bits_));
+    EXPECT_TRUE(std::equal(packet->begin(), packet->end(),
+                           fec_packet->begin()));
+    // The first packet with FEC carries its own hop.
+    const std::vector<uint8_t>& fec_hop = i == 0 ? *packet : previous_packet;
+    EXPECT_TRUE(std::equal(fec_hop.begin(), fec_hop.begin() + fec_size,
+                           fec_packet->begin() + packet_size));
+    previous_packet = packet.value();
+  }
+  EXPECT_FALSE(fec_encoder->EncodeSuperframe(samples_).has_value());
+}
+
 TEST_P(LyraEncoderTest, SetBitrateSucceeds) {
   LyraEncoderPeer encoder_peer(std::move(mock_resampler_),
                                std::move(mock_feature_extractor_), nullptr,
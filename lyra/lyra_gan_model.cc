@@ -28,39 +28,128 @@
 #include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "lyra/dsp_utils.h"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
 #include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
 namespace codec {
 
 std::unique_ptr<LyraGanModel> LyraGanModel::Create(
-    const ghc::filesystem::path& model_path, int num_features) {
-  auto model =
-      TfLiteModelWrapper::Create(model_path / "lyragan.tflite",
-                                 /*use_xnn=*/true, /*int8_quantized=*/true);
+    const ghc::filesystem::path& model_path, int num_features,
+    ModelPrecision precision) {
+  auto model = CreateModelWrapper(model_path, precision);
   if (model == nullptr) {
-    LOG(ERROR) << "Unable to create LyraGAN TFLite model wrapper.";
     return nullptr;
   }
-  return absl::WrapUnique(new LyraGanModel(std::move(model), num_features));
+  return absl::WrapUnique(
+      new LyraGanModel(std::move(model), num_features, std::nullopt));
+}
+
+std::unique_ptr<LyraGanModel> LyraGanModel::Create(
+    std::shared_ptr<const ModelBundle> bundle, int num_features,
+    ModelPrecision precision) {
+  auto model = CreateModelWrapper(std::move(bundle), precision);
+  if (model == nullptr) {
+    return nullptr;
+  }
+  return absl::WrapUnique(
+      new LyraGanModel(std::move(model), num_features, std::nullopt));
+}
+
+std::unique_ptr<LyraGanModel> LyraGanModel::Create(
+    std::shared_ptr<TfLiteModelWrapper> shared_model, int num_features) {
+  if (shared_model == nullptr) {
+    LOG(ERROR) << "Shared LyraGAN TFLite model wrapper is null.";
+    return nullptr;
+  }
+  auto variable_tensor_state = shared_model->CreateInitialVariableTensorState();
+  return absl::WrapUnique(new LyraGanModel(std::move(shared_model),
+                                           num_features,
+                                           std::move(variable_tensor_state)));
+}
+
+std::unique_ptr<TfLiteModelWrapper> LyraGanModel::CreateModelWrapper(
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
+  auto model = TfLiteModelWrapper::Create(model_path / "lyragan.tflite",
+                                          /*use_xnn=*/true, precision);
+  if (model == nullptr) {
+    LOG(ERROR) << "Unable to create LyraGAN TFLite model wrapper.";
+  }
+  return model;
 }
 
-LyraGanModel::LyraGanModel(std::unique_ptr<TfLiteModelWrapper> model,
-                           int num_features)
+std::unique_ptr<TfLiteModelWrapper> LyraGanModel::CreateModelWrapper(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  auto model = TfLiteModelWrapper::Create(std::move(bundle), "lyragan.tflite",
+                                          /*use_xnn=*/true, precision);
+  if (model == nullptr) {
+    LOG(ERROR) << "Unable to create LyraGAN TFLite model wrapper.";
+  }
+  return model;
+}
+
+LyraGanModel::LyraGanModel(
+    std::shared_ptr<TfLiteModelWrapper> model, int num_features,
+    std::optional<TfLiteModelWrapper::VariableTensorState>
+        variable_tensor_state)
     : GenerativeModel(model->get_output_tensor<float>(0).size(), num_features),
-      model_(std::move(model)) {}
+      model_(std::move(model)),
+      variable_tensor_state_(std::move(variable_tensor_state)),
+      output_hop_(num_samples_per_hop(), 0.f) {}
 
 bool LyraGanModel::RunConditioning(const std::vector<float>& features) {
   absl::Span<float> input = model_->get_input_tensor<float>(0);
   std::copy(features.begin(), features.end(), input.begin());
-  model_->Invoke();
+  if (!variable_tensor_state_.has_value()) {
+    model_->Invoke();
+  } else if (!model_->InvokeWithVariableTensorState(
+                 &variable_tensor_state_.value())) {
+    LOG(ERROR) << "Unable to invoke shared LyraGAN TFLite model wrapper.";
+    return false;
+  }
+  absl::Span<const float> output = model_->get_output_tensor<float>(0);
+  output_hop_.assign(output.begin(), output.end());
   return true;
 }
 
 std::optional<std::vector<int16_t>> LyraGanModel::RunModel(int num_samples) {
-  return UnitToInt16(absl::MakeConstSpan(
-      &model_->get_output_tensor<float>(0).at(next_sample_in_hop()),
-      num_samples));
+  return UnitToInt16(
+      absl::MakeConstSpan(&output_hop_[next_sample_in_hop()], num_samples));
+}
+
+std::optional<std::vector<float>> LyraGanModel::RunModelFloat(
+    int num_samples) {
+  const auto begin = output_hop_.begin() + next_sample_in_hop();
+  return std::vector<float>(begin, begin + num_samples);
+}
+
+bool LyraGanModel::SaveModelState(StateWriter* writer) const {
+  if (variable_tensor_state_.has_value()) {
+    variable_tensor_state_->Save(writer);
+  } else {
+    model_->GetVariableTensorState().Save(writer);
+  }
+  writer->WriteVector<float>(output_hop_);
+  return true;
+}
+
+bool LyraGanModel::RestoreModelState(StateReader* reader) {
+  TfLiteModelWrapper::VariableTensorState state =
+      variable_tensor_state_.has_value() ? variable_tensor_state_.value()
+                                         : model_->GetVariableTensorState();
+  std::vector<float> output_hop;
+  if (!state.Restore(reader) ||
+      !reader->ReadVectorOfSize(num_samples_per_hop(), &output_hop)) {
+    return false;
+  }
+  output_hop_ = std::move(output_hop);
+  if (variable_tensor_state_.has_value()) {
+    variable_tensor_state_ = std::move(state);
+  } else {
+    model_->SetVariableTensorState(state);
+  }
+  return true;
 }
 
 }  // namespace codec
@@ -24,6 +24,8 @@
 
 #include "include/ghc/filesystem.hpp"
 #include "lyra/generative_model_interface.h"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
 #include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
@@ -34,19 +36,55 @@ class LyraGanModel : public GenerativeModel {
  public:
   // Returns a nullptr on failure.
   static std::unique_ptr<LyraGanModel> Create(
-      const ghc::filesystem::path& model_path, int num_features);
+      const ghc::filesystem::path& model_path, int num_features,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  // Like the above, but loads the model from |bundle|. Returns a nullptr on
+  // failure.
+  static std::unique_ptr<LyraGanModel> Create(
+      std::shared_ptr<const ModelBundle> bundle, int num_features,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  // Creates a session running on |shared_model|, which may be used by other
+  // sessions on the same thread. The session only owns the variable tensors of
+  // the model and one hop of output samples. Returns a nullptr on failure.
+  static std::unique_ptr<LyraGanModel> Create(
+      std::shared_ptr<TfLiteModelWrapper> shared_model, int num_features);
+
+  // Loads the LyraGAN TFLite model. Returns a nullptr on failure.
+  static std::unique_ptr<TfLiteModelWrapper> CreateModelWrapper(
+      const ghc::filesystem::path& model_path,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  static std::unique_ptr<TfLiteModelWrapper> CreateModelWrapper(
+      std::shared_ptr<const ModelBundle> bundle,
+      ModelPrecision precision = ModelPrecision::kInt8);
 
   ~LyraGanModel() override {}
 
  private:
-  explicit LyraGanModel(std::unique_ptr<TfLiteModelWrapper> model,
-                        int num_features);
+  LyraGanModel(std::shared_ptr<TfLiteModelWrapper> model, int num_features,
+               std::optional<TfLiteModelWrapper::VariableTensorState>
+                   variable_tensor_state);
 
   bool RunConditioning(const std::vector<float>& features) override;
 
   std::optional<std::vector<int16_t>> RunModel(int num_samples) override;
 
-  const std::unique_ptr<TfLiteModelWrapper> model_;
+  std::optional<std::vector<float>> RunModelFloat(int num_samples) override;
+
+  // Saves the variable tensors of the model and the output of the last
+  // conditioning.
+  bool SaveModelState(StateWriter* writer) const override;
+
+  bool RestoreModelState(StateReader* reader) override;
+
+  const std::shared_ptr<TfLiteModelWrapper> model_;
+  // Only set when |model_| is shared with other sessions.
+  std::optional<TfLiteModelWrapper::VariableTensorState> variable_tensor_state_;
+  // Output of the last conditioning, since other sessions sharing |model_|
+  // overwrite the output tensor, and since it has to be saved with the state.
+  std::vector<float> output_hop_;
 };
 
 }  // namespace codec
@@ -16,6 +16,7 @@
 
 #include "lyra/lyra_gan_model.h"
 
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <string>
@@ -25,6 +26,7 @@
 #include "gtest/gtest.h"
 #include "include/ghc/filesystem.hpp"
 #include "lyra/lyra_config.h"
+#include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
 namespace codec {
@@ -75,6 +77,40 @@ TEST_F(LyraGanModelTest, SamplesAreGeneratedUntilHopLimit) {
   EXPECT_FALSE(model_->GenerateSamples(1).has_value());
 }
 
+TEST_F(LyraGanModelTest, SessionsOnSharedModelMatchIndependentModel) {
+  ASSERT_NE(model_, nullptr);
+  std::shared_ptr<TfLiteModelWrapper> shared_model =
+      LyraGanModel::CreateModelWrapper(ghc::filesystem::current_path() /
+                                       "lyra/model_coeffs");
+  ASSERT_NE(shared_model, nullptr);
+  auto first_session = LyraGanModel::Create(shared_model, kNumFeatures);
+  auto second_session = LyraGanModel::Create(shared_model, kNumFeatures);
+  ASSERT_NE(first_session, nullptr);
+  ASSERT_NE(second_session, nullptr);
+
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  for (int hop = 0; hop < 3; ++hop) {
+    std::fill(features_.begin(), features_.end(), 0.1f * hop);
+    model_->AddFeatures(features_);
+    first_session->AddFeatures(features_);
+    second_session->AddFeatures(features_);
+    // Interleave the sessions within a hop to make sure each one keeps its
+    // own output.
+    auto first_half = first_session->GenerateSamples(num_samples_per_hop / 2);
+    auto second = second_session->GenerateSamples(num_samples_per_hop);
+    auto first_rest = first_session->GenerateSamples(num_samples_per_hop / 2);
+    auto expected = model_->GenerateSamples(num_samples_per_hop);
+    ASSERT_TRUE(first_half.has_value());
+    ASSERT_TRUE(first_rest.has_value());
+    ASSERT_TRUE(second.has_value());
+    ASSERT_TRUE(expected.has_value());
+    first_half->insert(first_half->end(), first_rest->begin(),
+                       first_rest->end());
+    EXPECT_EQ(first_half.value(), expected.value());
+    EXPECT_EQ(second.value(), expected.value());
+  }
+}
+
 }  // namespace
 }  // namespace codec
 }  // namespace chromemedia
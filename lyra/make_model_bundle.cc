@@ -0,0 +1,64 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Packs a model directory into a single ModelBundle file.
+
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/lyra_config.h"
+#include "lyra/model_bundle.h"
+
+ABSL_FLAG(std::string, model_path, "lyra/model_coeffs",
+          "Path to directory containing lyra_config.binarypb and the TFLite "
+          "files.");
+
+ABSL_FLAG(std::string, bundle_file, "",
+          "Path of the bundle to write. An existing file is replaced "
+          "atomically.");
+
+ABSL_FLAG(std::vector<std::string>, extra_sections, {},
+          "Comma separated list of additional files in --model_path to add "
+          "to the bundle.");
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(argv[0]);
+  absl::ParseCommandLine(argc, argv);
+
+  const std::string bundle_file = absl::GetFlag(FLAGS_bundle_file);
+  if (bundle_file.empty()) {
+    LOG(ERROR) << "Flag --bundle_file not set.";
+    return -1;
+  }
+  std::vector<std::string> sections = {"lyra_config.binarypb"};
+  for (auto asset : chromemedia::codec::GetAssets()) {
+    sections.push_back(std::string(asset));
+  }
+  for (const std::string& extra : absl::GetFlag(FLAGS_extra_sections)) {
+    sections.push_back(extra);
+  }
+
+  const absl::Status status = chromemedia::codec::ModelBundle::Write(
+      absl::GetFlag(FLAGS_model_path), sections, bundle_file);
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    return -1;
+  }
+  return 0;
+}
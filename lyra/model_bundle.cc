@@ -0,0 +1,375 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/model_bundle.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <system_error>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr char kMagic[8] = {'L', 'Y', 'R', 'A', 'B', 'N', 'D', 'L'};
+constexpr int kHeaderSize = 16;
+constexpr int kNameFieldSize = ModelBundle::kMaxSectionNameLength + 1;
+constexpr int kTableEntrySize = kNameFieldSize + 16;
+
+uint64_t ReadLittleEndian(const char* bytes, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+  }
+  return value;
+}
+
+void AppendLittleEndian(uint64_t value, int num_bytes, std::string* bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    bytes->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + ModelBundle::kSectionAlignment - 1) /
+         ModelBundle::kSectionAlignment * ModelBundle::kSectionAlignment;
+}
+
+struct MappedFile {
+  void* data;
+  size_t size_bytes;
+};
+
+void* AllocateBuffer(size_t size_bytes) {
+  return ::operator new(size_bytes,
+                        std::align_val_t(ModelBundle::kSectionAlignment));
+}
+
+void FreeBuffer(void* data) {
+  ::operator delete(data, std::align_val_t(ModelBundle::kSectionAlignment));
+}
+
+// Reads the files |section_names| of the directory |model_path|.
+absl::StatusOr<std::vector<std::string>> ReadSections(
+    const ghc::filesystem::path& model_path,
+    const std::vector<std::string>& section_names) {
+  std::vector<std::string> contents;
+  for (const std::string& name : section_names) {
+    if (name.empty() || name.size() > ModelBundle::kMaxSectionNameLength) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid section name: ", name));
+    }
+    std::ifstream section_stream((model_path / name).string(),
+                                 std::ios::binary);
+    if (!section_stream) {
+      return absl::NotFoundError(
+          absl::StrCat("Could not read ", (model_path / name).string()));
+    }
+    contents.emplace_back(std::istreambuf_iterator<char>(section_stream),
+                          std::istreambuf_iterator<char>());
+  }
+  return contents;
+}
+
+#ifdef _WIN32
+// Returns a string that distinguishes |file| from any file later renamed over
+// the same path.
+std::optional<std::string> GetFileIdentity(const ghc::filesystem::path& file) {
+  std::error_code error;
+  const uintmax_t size_bytes = ghc::filesystem::file_size(file, error);
+  const auto write_time = ghc::filesystem::last_write_time(file, error);
+  if (error) {
+    return std::nullopt;
+  }
+  return absl::StrCat(ghc::filesystem::absolute(file).string(), ":",
+                      size_bytes, ":", write_time.time_since_epoch().count());
+}
+
+// Windows builds read the bundle into an aligned heap buffer instead.
+std::optional<MappedFile> MapFile(const ghc::filesystem::path& file) {
+  std::error_code error;
+  const uintmax_t size_bytes = ghc::filesystem::file_size(file, error);
+  if (error || size_bytes == 0) {
+    return std::nullopt;
+  }
+  std::ifstream stream(file.string(), std::ios::binary);
+  void* data = AllocateBuffer(size_bytes);
+  if (!stream.read(static_cast<char*>(data), size_bytes)) {
+    FreeBuffer(data);
+    return std::nullopt;
+  }
+  return MappedFile{data, static_cast<size_t>(size_bytes)};
+}
+
+void UnmapFile(const MappedFile& mapped_file) { FreeBuffer(mapped_file.data); }
+#else
+// Returns a string that distinguishes |file| from any file later renamed over
+// the same path.
+std::optional<std::string> GetFileIdentity(const ghc::filesystem::path& file) {
+  struct stat file_stat;
+  if (stat(file.c_str(), &file_stat) != 0) {
+    return std::nullopt;
+  }
+  return absl::StrCat(file_stat.st_dev, ":", file_stat.st_ino, ":",
+                      file_stat.st_size, ":", file_stat.st_mtime);
+}
+
+std::optional<MappedFile> MapFile(const ghc::filesystem::path& file) {
+  const int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return std::nullopt;
+  }
+  const size_t size_bytes = static_cast<size_t>(file_stat.st_size);
+  void* data = mmap(nullptr, size_bytes, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return std::nullopt;
+  }
+  return MappedFile{data, size_bytes};
+}
+
+void UnmapFile(const MappedFile& mapped_file) {
+  munmap(mapped_file.data, mapped_file.size_bytes);
+}
+#endif  // _WIN32
+
+// Open bundles by file identity, so that replacing a bundle file by renaming
+// a new one over it maps the new file instead of returning the stale mapping.
+struct Registry {
+  absl::Mutex mutex;
+  absl::flat_hash_map<std::string, std::weak_ptr<const ModelBundle>> bundles
+      ABSL_GUARDED_BY(mutex);
+};
+
+Registry& GetRegistry() {
+  static Registry* const registry = new Registry;
+  return *registry;
+}
+
+}  // namespace
+
+std::shared_ptr<const ModelBundle> ModelBundle::Open(
+    const ghc::filesystem::path& bundle_file) {
+  const std::optional<std::string> identity = GetFileIdentity(bundle_file);
+  if (!identity.has_value()) {
+    LOG(ERROR) << "Could not stat model bundle " << bundle_file;
+    return nullptr;
+  }
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  if (auto bundle = registry.bundles[*identity].lock()) {
+    return bundle;
+  }
+  const std::optional<MappedFile> mapped_file = MapFile(bundle_file);
+  if (!mapped_file.has_value()) {
+    LOG(ERROR) << "Could not map model bundle " << bundle_file;
+    return nullptr;
+  }
+
+  void* const data = mapped_file->data;
+  const size_t size_bytes = mapped_file->size_bytes;
+  auto fail = [&](absl::string_view reason) {
+    LOG(ERROR) << "Invalid model bundle " << bundle_file << ": " << reason;
+    UnmapFile(*mapped_file);
+    return nullptr;
+  };
+  if (size_bytes < kHeaderSize) {
+    return fail("too small");
+  }
+  const char* bytes = static_cast<const char*>(data);
+
+  if (std::memcmp(bytes, kMagic, sizeof(kMagic)) != 0) {
+    return fail("bad magic");
+  }
+  if (ReadLittleEndian(bytes + 8, 4) != kFormatVersion) {
+    return fail("unsupported version");
+  }
+  const uint64_t num_sections = ReadLittleEndian(bytes + 12, 4);
+  if (kHeaderSize + num_sections * kTableEntrySize > size_bytes) {
+    return fail("truncated section table");
+  }
+  std::vector<Section> sections;
+  sections.reserve(num_sections);
+  for (uint64_t i = 0; i < num_sections; ++i) {
+    const char* entry = bytes + kHeaderSize + i * kTableEntrySize;
+    const std::string name(entry, strnlen(entry, kNameFieldSize));
+    const uint64_t offset = ReadLittleEndian(entry + kNameFieldSize, 8);
+    const uint64_t size = ReadLittleEndian(entry + kNameFieldSize + 8, 8);
+    if (name.empty() || name.size() > kMaxSectionNameLength) {
+      return fail("bad section name");
+    }
+    if (offset % kSectionAlignment != 0 || offset > size_bytes ||
+        size > size_bytes - offset) {
+      return fail(absl::StrCat("section ", name, " is out of bounds"));
+    }
+    sections.push_back({name, offset, size});
+  }
+
+  auto bundle = std::shared_ptr<const ModelBundle>(
+      new ModelBundle(data, size_bytes, std::move(sections), /*mapped=*/true));
+  registry.bundles[*identity] = bundle;
+  return bundle;
+}
+
+std::shared_ptr<const ModelBundle> ModelBundle::Read(
+    const ghc::filesystem::path& model_path,
+    const std::vector<std::string>& section_names) {
+  const absl::StatusOr<std::vector<std::string>> contents =
+      ReadSections(model_path, section_names);
+  if (!contents.ok()) {
+    LOG(ERROR) << contents.status();
+    return nullptr;
+  }
+  std::vector<Section> sections;
+  uint64_t size_bytes = 0;
+  for (int i = 0; i < section_names.size(); ++i) {
+    sections.push_back({section_names[i], size_bytes, (*contents)[i].size()});
+    size_bytes = AlignUp(size_bytes + (*contents)[i].size());
+  }
+  char* data = static_cast<char*>(AllocateBuffer(size_bytes));
+  for (int i = 0; i < sections.size(); ++i) {
+    std::memcpy(data + sections[i].offset, (*contents)[i].data(),
+                sections[i].size);
+  }
+  return std::shared_ptr<const ModelBundle>(
+      new ModelBundle(data, size_bytes, std::move(sections),
+                      /*mapped=*/false));
+}
+
+bool ModelBundle::IsBundle(const ghc::filesystem::path& model_path) {
+  std::error_code error;
+  return ghc::filesystem::is_regular_file(model_path, error);
+}
+
+absl::Status ModelBundle::Write(const ghc::filesystem::path& model_path,
+                                const std::vector<std::string>& section_names,
+                                const ghc::filesystem::path& bundle_file) {
+  const absl::StatusOr<std::vector<std::string>> read_contents =
+      ReadSections(model_path, section_names);
+  if (!read_contents.ok()) {
+    return read_contents.status();
+  }
+  const std::vector<std::string>& contents = *read_contents;
+
+  std::string header(kMagic, sizeof(kMagic));
+  AppendLittleEndian(kFormatVersion, 4, &header);
+  AppendLittleEndian(section_names.size(), 4, &header);
+  uint64_t offset =
+      AlignUp(kHeaderSize + section_names.size() * kTableEntrySize);
+  std::vector<uint64_t> offsets;
+  for (int i = 0; i < section_names.size(); ++i) {
+    std::string name_field = section_names[i];
+    name_field.resize(kNameFieldSize, '\0');
+    header += name_field;
+    AppendLittleEndian(offset, 8, &header);
+    AppendLittleEndian(contents[i].size(), 8, &header);
+    offsets.push_back(offset);
+    offset = AlignUp(offset + contents[i].size());
+  }
+
+  ghc::filesystem::path temporary_file = bundle_file;
+  temporary_file += ".tmp";
+  {
+    std::ofstream bundle_stream(temporary_file.string(), std::ios::binary);
+    bundle_stream << header;
+    for (int i = 0; i < contents.size(); ++i) {
+      bundle_stream << std::string(offsets[i] - bundle_stream.tellp(), '\0');
+      bundle_stream << contents[i];
+    }
+    if (!bundle_stream.flush()) {
+      return absl::AbortedError(
+          absl::StrCat("Failed to write ", temporary_file.string()));
+    }
+  }
+  std::error_code error;
+  ghc::filesystem::rename(temporary_file, bundle_file, error);
+  if (error) {
+    return absl::AbortedError(absl::StrCat("Failed to rename bundle to ",
+                                           bundle_file.string(), ": ",
+                                           error.message()));
+  }
+  return absl::OkStatus();
+}
+
+ModelBundle::ModelBundle(const void* data, size_t size_bytes,
+                         std::vector<Section> sections, bool mapped)
+    : data_(data),
+      size_bytes_(size_bytes),
+      sections_(std::move(sections)),
+      mapped_(mapped) {}
+
+ModelBundle::~ModelBundle() {
+  if (mapped_) {
+    UnmapFile({const_cast<void*>(data_), size_bytes_});
+  } else {
+    FreeBuffer(const_cast<void*>(data_));
+  }
+}
+
+std::optional<absl::Span<const char>> ModelBundle::GetSection(
+    absl::string_view name) const {
+  for (const Section& section : sections_) {
+    if (section.name == name) {
+      return absl::MakeConstSpan(static_cast<const char*>(data_) +
+                                     section.offset,
+                                 section.size);
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<std::string> ModelBundle::section_names() const {
+  std::vector<std::string> names;
+  names.reserve(sections_.size());
+  for (const Section& section : sections_) {
+    names.push_back(section.name);
+  }
+  return names;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_MODEL_BUNDLE_H_
+#define LYRA_MODEL_BUNDLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+// A read-only, memory-mapped file that packs the contents of a model
+// directory (lyra_config.binarypb and the .tflite files, plus any optional
+// extra sections) so that a model can be opened with a single open and mmap
+// and rolled out by atomically renaming one file.
+//
+// A bundle can be used wherever a model directory is expected: the path of
+// the bundle file stands in for the directory and |bundle_file / name| refers
+// to the section |name|.
+//
+// Layout, all integers little endian:
+//   Header:  char magic[8] = "LYRABNDL", uint32 version, uint32 num_sections.
+//   Table:   |num_sections| entries of char name[48] (NUL padded),
+//            uint64 offset, uint64 size.
+//   Data:    Each section starts at an offset that is a multiple of
+//            |kSectionAlignment|.
+class ModelBundle {
+ public:
+  static constexpr int kFormatVersion = 1;
+  static constexpr int kMaxSectionNameLength = 47;
+  static constexpr int kSectionAlignment = 64;
+
+  // Maps |bundle_file|. Bundles are shared: opening the same file again while
+  // it is still in use returns the existing mapping. Returns a nullptr if the
+  // file can't be mapped or is not a valid bundle.
+  static std::shared_ptr<const ModelBundle> Open(
+      const ghc::filesystem::path& bundle_file);
+
+  // Reads the files |section_names| of the directory |model_path| into a
+  // bundle held in memory, which keeps serving the contents read here even if
+  // the files are replaced later. Returns a nullptr if a file can't be read.
+  static std::shared_ptr<const ModelBundle> Read(
+      const ghc::filesystem::path& model_path,
+      const std::vector<std::string>& section_names);
+
+  // Returns true if |model_path| refers to a bundle file rather than a model
+  // directory.
+  static bool IsBundle(const ghc::filesystem::path& model_path);
+
+  // Writes the files |section_names| of the directory |model_path| into a
+  // bundle. The bundle is written next to |bundle_file| and renamed into
+  // place, so readers never see a partial file.
+  static absl::Status Write(const ghc::filesystem::path& model_path,
+                            const std::vector<std::string>& section_names,
+                            const ghc::filesystem::path& bundle_file);
+
+  ~ModelBundle();
+
+  // Returns the contents of section |name|, or a nullopt if it does not exist.
+  // The span is valid as long as the bundle is.
+  std::optional<absl::Span<const char>> GetSection(
+      absl::string_view name) const;
+
+  std::vector<std::string> section_names() const;
+
+  // Size of the mapping, or of the buffer of a bundle read into memory, in
+  // bytes.
+  size_t size_bytes() const { return size_bytes_; }
+
+ private:
+  struct Section {
+    std::string name;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  ModelBundle(const void* data, size_t size_bytes,
+              std::vector<Section> sections, bool mapped);
+
+  const void* const data_;
+  const size_t size_bytes_;
+  const std::vector<Section> sections_;
+  // False if |data_| is a buffer allocated by |Read()|.
+  const bool mapped_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_MODEL_BUNDLE_H_
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/model_bundle.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/tflite_model_wrapper.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+std::vector<std::string> GetBundledSections() {
+  std::vector<std::string> sections = {"lyra_config.binarypb"};
+  for (auto asset : GetAssets()) {
+    sections.push_back(std::string(asset));
+  }
+  return sections;
+}
+
+std::string ReadFile(const ghc::filesystem::path& file) {
+  std::ifstream stream(file.string(), std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(stream),
+                     std::istreambuf_iterator<char>());
+}
+
+class ModelBundleTest : public testing::Test {
+ protected:
+  ModelBundleTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs") {}
+
+  void SetUp() override {
+    const testing::TestInfo* const test_info =
+        testing::UnitTest::GetInstance()->current_test_info();
+    bundle_file_ = ghc::filesystem::path(testing::TempDir()) /
+                   (std::string(test_info->name()) + ".bundle");
+    ASSERT_TRUE(
+        ModelBundle::Write(model_path_, GetBundledSections(), bundle_file_)
+            .ok());
+  }
+
+  const ghc::filesystem::path model_path_;
+  ghc::filesystem::path bundle_file_;
+};
+
+TEST_F(ModelBundleTest, SectionsMatchModelFilesAndAreAligned) {
+  auto bundle = ModelBundle::Open(bundle_file_);
+  ASSERT_NE(bundle, nullptr);
+  EXPECT_EQ(bundle->section_names(), GetBundledSections());
+  for (const std::string& name : GetBundledSections()) {
+    const auto section = bundle->GetSection(name);
+    ASSERT_TRUE(section.has_value()) << name;
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(section->data()) %
+                  ModelBundle::kSectionAlignment,
+              0);
+    EXPECT_EQ(std::string(section->data(), section->size()),
+              ReadFile(model_path_ / name));
+  }
+  EXPECT_FALSE(bundle->GetSection("missing.tflite").has_value());
+}
+
+TEST_F(ModelBundleTest, OpenSharesMappingWhileInUse) {
+  auto bundle = ModelBundle::Open(bundle_file_);
+  ASSERT_NE(bundle, nullptr);
+  EXPECT_EQ(ModelBundle::Open(bundle_file_), bundle);
+}
+
+TEST_F(ModelBundleTest, OpenFailsForInvalidFile) {
+  EXPECT_EQ(ModelBundle::Open(model_path_ / "lyragan.tflite"), nullptr);
+  EXPECT_EQ(ModelBundle::Open(model_path_ / "missing.bundle"), nullptr);
+}
+
+TEST_F(ModelBundleTest, WriteFailsForMissingSection) {
+  EXPECT_FALSE(
+      ModelBundle::Write(model_path_, {"missing.tflite"}, bundle_file_).ok());
+}
+
+TEST_F(ModelBundleTest, BundleCanReplaceModelDirectory) {
+  EXPECT_TRUE(ModelBundle::IsBundle(bundle_file_));
+  EXPECT_FALSE(ModelBundle::IsBundle(model_path_));
+  EXPECT_TRUE(AreParamsSupported(kInternalSampleRateHz, kNumChannels,
+                                 bundle_file_)
+                  .ok());
+  const auto identifier = GetWeightsIdentifier(bundle_file_);
+  ASSERT_TRUE(identifier.ok());
+  EXPECT_EQ(*identifier, kVersionMinor);
+  EXPECT_NE(TfLiteModelWrapper::Create(bundle_file_ / "lyragan.tflite", true,
+                                       ModelPrecision::kInt8),
+            nullptr);
+}
+
+TEST_F(ModelBundleTest, ReadCopiesModelDirectory) {
+  auto bundle = ModelBundle::Read(model_path_, GetBundledSections());
+  ASSERT_NE(bundle, nullptr);
+  EXPECT_EQ(bundle->section_names(), GetBundledSections());
+  for (const std::string& name : GetBundledSections()) {
+    const auto section = bundle->GetSection(name);
+    ASSERT_TRUE(section.has_value()) << name;
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(section->data()) %
+                  ModelBundle::kSectionAlignment,
+              0);
+    EXPECT_EQ(std::string(section->data(), section->size()),
+              ReadFile(model_path_ / name));
+  }
+  const auto identifier = GetWeightsIdentifier(*bundle);
+  ASSERT_TRUE(identifier.ok());
+  EXPECT_EQ(*identifier, kVersionMinor);
+  EXPECT_NE(TfLiteModelWrapper::Create(bundle, "lyragan.tflite", true,
+                                       ModelPrecision::kInt8),
+            nullptr);
+  EXPECT_EQ(ModelBundle::Read(model_path_, {"missing.tflite"}), nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
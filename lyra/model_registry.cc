@@ -0,0 +1,193 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/model_registry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <future>  // NOLINT(build/c++11)
+#include <memory>
+#include <string>
+#include <system_error>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+#include "lyra/model_bundle.h"
+#include "lyra/shared_models.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Maps the bundle |model_path|, or reads the model files of the directory
+// |model_path| into memory. Returns a nullptr on failure.
+std::shared_ptr<const ModelBundle> PinModels(
+    const ghc::filesystem::path& model_path) {
+  if (ModelBundle::IsBundle(model_path)) {
+    return ModelBundle::Open(model_path);
+  }
+  std::vector<std::string> section_names;
+  for (auto asset : GetAssets()) {
+    section_names.push_back(std::string(asset));
+  }
+  std::error_code error;
+  if (ghc::filesystem::exists(model_path / "lyra_config.binarypb", error)) {
+    section_names.push_back("lyra_config.binarypb");
+  }
+  return ModelBundle::Read(model_path, section_names);
+}
+
+// Transfers ownership of |object| to a shared pointer that also keeps
+// |version| alive.
+template <typename T>
+std::shared_ptr<T> KeepVersionAlive(
+    std::unique_ptr<T> object, std::shared_ptr<const ModelVersion> version) {
+  if (object == nullptr) {
+    return nullptr;
+  }
+  return std::shared_ptr<T>(object.release(),
+                            [version = std::move(version)](T* released) {
+                              delete released;
+                            });
+}
+
+}  // namespace
+
+ModelVersion::ModelVersion(int64_t version,
+                           const ghc::filesystem::path& model_path,
+                           std::shared_ptr<const ModelBundle> bundle,
+                           std::unique_ptr<SharedModels> warm_models)
+    : version_(version),
+      model_path_(model_path),
+      bundle_(std::move(bundle)),
+      warm_models_(std::move(warm_models)) {}
+
+std::shared_ptr<LyraEncoder> ModelVersion::CreateEncoder(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx) const {
+  return KeepVersionAlive(LyraEncoder::Create(sample_rate_hz, num_channels,
+                                              bitrate, enable_dtx, bundle_),
+                          shared_from_this());
+}
+
+std::shared_ptr<LyraDecoder> ModelVersion::CreateDecoder(
+    int sample_rate_hz, int num_channels) const {
+  return KeepVersionAlive(
+      LyraDecoder::Create(sample_rate_hz, num_channels, bundle_),
+      shared_from_this());
+}
+
+std::shared_ptr<SharedModels> ModelVersion::CreateSharedModels() const {
+  return KeepVersionAlive(SharedModels::Create(bundle_), shared_from_this());
+}
+
+std::unique_ptr<ModelRegistry> ModelRegistry::Create(
+    const ghc::filesystem::path& model_path) {
+  auto registry = absl::WrapUnique(new ModelRegistry);
+  const absl::Status status = registry->Load(model_path);
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    return nullptr;
+  }
+  return registry;
+}
+
+absl::StatusOr<std::shared_ptr<const ModelVersion>> ModelRegistry::LoadVersion(
+    int64_t version, const ghc::filesystem::path& model_path) {
+  const absl::Status are_params_supported =
+      AreParamsSupported(kInternalSampleRateHz, kNumChannels, model_path);
+  if (!are_params_supported.ok()) {
+    return are_params_supported;
+  }
+  std::shared_ptr<const ModelBundle> bundle = PinModels(model_path);
+  if (bundle == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Could not read models from %s.", model_path));
+  }
+  std::unique_ptr<SharedModels> warm_models = SharedModels::Create(bundle);
+  if (warm_models == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Could not load models from %s.", model_path));
+  }
+  return std::shared_ptr<const ModelVersion>(new ModelVersion(
+      version, model_path, std::move(bundle), std::move(warm_models)));
+}
+
+absl::Status ModelRegistry::Load(const ghc::filesystem::path& model_path) {
+  int64_t version;
+  {
+    absl::MutexLock lock(&mutex_);
+    version = next_version_++;
+  }
+  // Loading takes a while, so it runs without holding the lock.
+  absl::StatusOr<std::shared_ptr<const ModelVersion>> loaded =
+      LoadVersion(version, model_path);
+  if (!loaded.ok()) {
+    return loaded.status();
+  }
+
+  absl::MutexLock lock(&mutex_);
+  versions_.erase(std::remove_if(versions_.begin(), versions_.end(),
+                                 [](const auto& weak_version) {
+                                   return weak_version.expired();
+                                 }),
+                  versions_.end());
+  versions_.push_back(*loaded);
+  // Of concurrent loads the one started last wins.
+  if (current_ == nullptr || current_->version() < version) {
+    current_ = *std::move(loaded);
+  }
+  return absl::OkStatus();
+}
+
+std::future<absl::Status> ModelRegistry::LoadAsync(
+    const ghc::filesystem::path& model_path) {
+  return std::async(std::launch::async,
+                    [this, model_path]() { return Load(model_path); });
+}
+
+std::shared_ptr<const ModelVersion> ModelRegistry::current() const {
+  absl::MutexLock lock(&mutex_);
+  return current_;
+}
+
+std::vector<ModelRegistry::VersionMetrics> ModelRegistry::GetMetrics() const {
+  absl::MutexLock lock(&mutex_);
+  std::vector<VersionMetrics> metrics;
+  for (const auto& weak_version : versions_) {
+    const std::shared_ptr<const ModelVersion> version = weak_version.lock();
+    if (version == nullptr) {
+      continue;
+    }
+    const bool current = version == current_;
+    // Discount the reference held here and, for the current version, the one
+    // held by the registry.
+    metrics.push_back({version->version(), version->model_path().string(),
+                       version->model_bytes(),
+                       version.use_count() - 1 - (current ? 1 : 0), current});
+  }
+  return metrics;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
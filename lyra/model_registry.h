@@ -0,0 +1,134 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_MODEL_REGISTRY_H_
+#define LYRA_MODEL_REGISTRY_H_
+
+#include <cstdint>
+#include <future>  // NOLINT(build/c++11)
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+#include "lyra/model_bundle.h"
+#include "lyra/shared_models.h"
+
+namespace chromemedia {
+namespace codec {
+
+// One loaded set of model weights. Every session created from a version keeps
+// it alive, so a version is released once it has been replaced in its
+// |ModelRegistry| and its last session has ended.
+//
+// A version maps its bundle file, or reads the files of its model directory
+// into memory, once when it is loaded and creates every session from those
+// bytes. Replacing the files afterwards, e.g. by renaming a new bundle over
+// the old one, only affects versions loaded later.
+class ModelVersion : public std::enable_shared_from_this<ModelVersion> {
+ public:
+  // Number assigned by the registry, increasing with every loaded version.
+  int64_t version() const { return version_; }
+
+  const ghc::filesystem::path& model_path() const { return model_path_; }
+
+  // Bytes of model data this version holds, either mapped from its bundle or
+  // read from its model directory.
+  int64_t model_bytes() const { return bundle_->size_bytes(); }
+
+  // Each of these returns a nullptr on failure. The returned objects keep
+  // this version alive.
+  std::shared_ptr<LyraEncoder> CreateEncoder(int sample_rate_hz,
+                                             int num_channels, int bitrate,
+                                             bool enable_dtx) const;
+
+  std::shared_ptr<LyraDecoder> CreateDecoder(int sample_rate_hz,
+                                             int num_channels) const;
+
+  // See |SharedModels| for the threading requirements.
+  std::shared_ptr<SharedModels> CreateSharedModels() const;
+
+ private:
+  friend class ModelRegistry;
+
+  ModelVersion(int64_t version, const ghc::filesystem::path& model_path,
+               std::shared_ptr<const ModelBundle> bundle,
+               std::unique_ptr<SharedModels> warm_models);
+
+  const int64_t version_;
+  const ghc::filesystem::path model_path_;
+  const std::shared_ptr<const ModelBundle> bundle_;
+  // Holds the packed XNNPack weights for as long as the version is alive, so
+  // creating sessions does not pack them again.
+  const std::unique_ptr<SharedModels> warm_models_;
+};
+
+// Thread safe registry of model versions. New sessions are created from the
+// current version, while sessions created earlier keep using theirs. Loading
+// a version does not block session creation.
+class ModelRegistry {
+ public:
+  struct VersionMetrics {
+    int64_t version;
+    std::string model_path;
+    int64_t model_bytes;
+    // Number of sessions and other objects keeping the version alive, not
+    // counting the registry itself.
+    int64_t num_users;
+    bool current;
+  };
+
+  // Loads the initial version from |model_path|. Returns a nullptr on
+  // failure.
+  static std::unique_ptr<ModelRegistry> Create(
+      const ghc::filesystem::path& model_path);
+
+  // Loads |model_path| and makes it the current version. Sessions created
+  // before keep their version. On failure the current version is kept.
+  absl::Status Load(const ghc::filesystem::path& model_path);
+
+  // Like |Load()|, but runs on a separate thread. The registry has to outlive
+  // the returned future.
+  std::future<absl::Status> LoadAsync(const ghc::filesystem::path& model_path);
+
+  std::shared_ptr<const ModelVersion> current() const;
+
+  // Returns metrics of every version still alive, oldest first.
+  std::vector<VersionMetrics> GetMetrics() const;
+
+ private:
+  ModelRegistry() = default;
+
+  static absl::StatusOr<std::shared_ptr<const ModelVersion>> LoadVersion(
+      int64_t version, const ghc::filesystem::path& model_path);
+
+  mutable absl::Mutex mutex_;
+  int64_t next_version_ ABSL_GUARDED_BY(mutex_) = 1;
+  std::shared_ptr<const ModelVersion> current_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::weak_ptr<const ModelVersion>> versions_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_MODEL_REGISTRY_H_
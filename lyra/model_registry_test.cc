@@ -0,0 +1,159 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/model_registry.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/model_bundle.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+class ModelRegistryTest : public testing::Test {
+ protected:
+  ModelRegistryTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs") {}
+
+  void SetUp() override {
+    // The second version is a bundle of the same weights.
+    const testing::TestInfo* const test_info =
+        testing::UnitTest::GetInstance()->current_test_info();
+    bundle_file_ = ghc::filesystem::path(testing::TempDir()) /
+                   (std::string(test_info->name()) + ".bundle");
+    std::vector<std::string> sections = {"lyra_config.binarypb"};
+    for (auto asset : GetAssets()) {
+      sections.push_back(std::string(asset));
+    }
+    ASSERT_TRUE(ModelBundle::Write(model_path_, sections, bundle_file_).ok());
+  }
+
+  const ghc::filesystem::path model_path_;
+  ghc::filesystem::path bundle_file_;
+};
+
+TEST_F(ModelRegistryTest, CreationFailsWithInvalidModelPath) {
+  EXPECT_EQ(ModelRegistry::Create("invalid/model/path"), nullptr);
+}
+
+TEST_F(ModelRegistryTest, FailedLoadKeepsCurrentVersion) {
+  auto registry = ModelRegistry::Create(model_path_);
+  ASSERT_NE(registry, nullptr);
+  auto current = registry->current();
+  EXPECT_FALSE(registry->Load("invalid/model/path").ok());
+  EXPECT_EQ(registry->current(), current);
+}
+
+TEST_F(ModelRegistryTest, LiveSessionsKeepTheirVersion) {
+  auto registry = ModelRegistry::Create(model_path_);
+  ASSERT_NE(registry, nullptr);
+  const int64_t first_version = registry->current()->version();
+  auto old_encoder = registry->current()->CreateEncoder(
+      kInternalSampleRateHz, kNumChannels, /*bitrate=*/6000,
+      /*enable_dtx=*/false);
+  ASSERT_NE(old_encoder, nullptr);
+
+  ASSERT_TRUE(registry->LoadAsync(bundle_file_).get().ok());
+  EXPECT_GT(registry->current()->version(), first_version);
+  EXPECT_EQ(registry->current()->model_path(), bundle_file_);
+  auto new_decoder = registry->current()->CreateDecoder(kInternalSampleRateHz,
+                                                        kNumChannels);
+  ASSERT_NE(new_decoder, nullptr);
+
+  // The session created before the swap still runs on the first version.
+  const std::vector<int16_t> audio(
+      GetNumSamplesPerHop(kInternalSampleRateHz), 0);
+  EXPECT_TRUE(old_encoder->Encode(absl::MakeConstSpan(audio)).has_value());
+
+  std::vector<ModelRegistry::VersionMetrics> metrics = registry->GetMetrics();
+  ASSERT_EQ(metrics.size(), 2);
+  EXPECT_EQ(metrics[0].version, first_version);
+  EXPECT_FALSE(metrics[0].current);
+  EXPECT_EQ(metrics[0].num_users, 1);
+  EXPECT_GT(metrics[0].model_bytes, 0);
+  EXPECT_TRUE(metrics[1].current);
+  EXPECT_EQ(metrics[1].num_users, 1);
+  EXPECT_EQ(metrics[1].model_bytes,
+            static_cast<int64_t>(ghc::filesystem::file_size(bundle_file_)));
+
+  // Ending the last session of the first version releases it.
+  old_encoder.reset();
+  metrics = registry->GetMetrics();
+  ASSERT_EQ(metrics.size(), 1);
+  EXPECT_TRUE(metrics[0].current);
+}
+
+TEST_F(ModelRegistryTest, VersionKeepsItsWeightsWhenBundleIsReplaced) {
+  auto registry = ModelRegistry::Create(bundle_file_);
+  ASSERT_NE(registry, nullptr);
+  auto version = registry->current();
+  const std::vector<int16_t> audio(
+      GetNumSamplesPerHop(kInternalSampleRateHz), 0);
+
+  // Rename a bundle without the models over the one the version was loaded
+  // from, as a rollout of new weights would.
+  ASSERT_TRUE(ModelBundle::Write(model_path_, {"lyra_config.binarypb"},
+                                 bundle_file_)
+                  .ok());
+  EXPECT_EQ(ModelRegistry::Create(bundle_file_), nullptr);
+
+  auto encoder = version->CreateEncoder(kInternalSampleRateHz, kNumChannels,
+                                        /*bitrate=*/6000,
+                                        /*enable_dtx=*/false);
+  ASSERT_NE(encoder, nullptr);
+  const auto packet = encoder->Encode(absl::MakeConstSpan(audio));
+  ASSERT_TRUE(packet.has_value());
+  auto decoder = version->CreateDecoder(kInternalSampleRateHz, kNumChannels);
+  ASSERT_NE(decoder, nullptr);
+  ASSERT_TRUE(decoder->SetEncodedPacket(*packet));
+  EXPECT_TRUE(decoder->DecodeSamples(audio.size()).has_value());
+  EXPECT_NE(version->CreateSharedModels(), nullptr);
+}
+
+TEST_F(ModelRegistryTest, VersionKeepsItsWeightsWhenDirectoryIsRemoved) {
+  // Copy the model directory, so that it can be removed under the version.
+  const ghc::filesystem::path model_copy =
+      ghc::filesystem::path(testing::TempDir()) /
+      testing::UnitTest::GetInstance()->current_test_info()->name();
+  ghc::filesystem::create_directories(model_copy);
+  ghc::filesystem::copy(model_path_, model_copy,
+                        ghc::filesystem::copy_options::overwrite_existing);
+  auto registry = ModelRegistry::Create(model_copy);
+  ASSERT_NE(registry, nullptr);
+  ghc::filesystem::remove_all(model_copy);
+
+  EXPECT_NE(registry->current()->CreateEncoder(
+                kInternalSampleRateHz, kNumChannels, /*bitrate=*/6000,
+                /*enable_dtx=*/false),
+            nullptr);
+  EXPECT_NE(
+      registry->current()->CreateDecoder(kInternalSampleRateHz, kNumChannels),
+      nullptr);
+  EXPECT_GT(registry->current()->model_bytes(), 0);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
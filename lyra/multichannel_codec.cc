@@ -0,0 +1,235 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/multichannel_codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+bool IsNumChannelsSupported(int num_channels) {
+  if (num_channels < 1 || num_channels > kMaxNumChannels) {
+    LOG(ERROR) << "The number of channels has to be between 1 and "
+               << kMaxNumChannels << ", but is " << num_channels << ".";
+    return false;
+  }
+  return true;
+}
+
+// Copies channel |channel| of |audio|, which holds |num_channels| channels
+// laid out as |layout|, into |channel_audio|.
+void ExtractChannel(absl::Span<const int16_t> audio, ChannelLayout layout,
+                    int num_channels, int channel,
+                    std::vector<int16_t>* channel_audio) {
+  const int num_samples = audio.size() / num_channels;
+  if (layout == ChannelLayout::kPlanar) {
+    const auto planar = audio.subspan(channel * num_samples, num_samples);
+    channel_audio->assign(planar.begin(), planar.end());
+    return;
+  }
+  channel_audio->resize(num_samples);
+  for (int i = 0; i < num_samples; ++i) {
+    (*channel_audio)[i] = audio[i * num_channels + channel];
+  }
+}
+
+}  // namespace
+
+std::unique_ptr<MultichannelEncoder> MultichannelEncoder::Create(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+    MultichannelPacketMode packet_mode,
+    const ghc::filesystem::path& model_path) {
+  if (!IsNumChannelsSupported(num_channels)) {
+    return nullptr;
+  }
+  if (enable_dtx && packet_mode == MultichannelPacketMode::kCombined) {
+    LOG(ERROR) << "Combined packets can not leave out single channels, so "
+                  "they do not support DTX.";
+    return nullptr;
+  }
+  std::vector<std::unique_ptr<LyraEncoder>> encoders;
+  encoders.reserve(num_channels);
+  for (int i = 0; i < num_channels; ++i) {
+    encoders.push_back(LyraEncoder::Create(sample_rate_hz, kNumChannels,
+                                           bitrate, enable_dtx, model_path));
+    if (encoders.back() == nullptr) {
+      LOG(ERROR) << "Could not create the encoder of channel " << i << ".";
+      return nullptr;
+    }
+  }
+  return absl::WrapUnique(
+      new MultichannelEncoder(std::move(encoders), packet_mode));
+}
+
+MultichannelEncoder::MultichannelEncoder(
+    std::vector<std::unique_ptr<LyraEncoder>> encoders,
+    MultichannelPacketMode packet_mode)
+    : encoders_(std::move(encoders)),
+      packet_mode_(packet_mode),
+      num_samples_per_hop_(
+          GetNumSamplesPerHop(encoders_.front()->sample_rate_hz())) {}
+
+std::optional<std::vector<std::vector<uint8_t>>> MultichannelEncoder::Encode(
+    absl::Span<const int16_t> audio, ChannelLayout layout) {
+  const int num_samples = num_channels() * num_samples_per_hop_;
+  if (audio.size() != num_samples) {
+    LOG(ERROR) << "The number of audio samples has to be exactly "
+               << num_samples << " for " << num_channels()
+               << " channels, but is " << audio.size() << ".";
+    return std::nullopt;
+  }
+  std::vector<std::vector<uint8_t>> packets;
+  packets.reserve(num_channels());
+  std::vector<int16_t> channel_audio;
+  for (int i = 0; i < num_channels(); ++i) {
+    ExtractChannel(audio, layout, num_channels(), i, &channel_audio);
+    auto packet = encoders_[i]->Encode(channel_audio);
+    if (!packet.has_value()) {
+      LOG(ERROR) << "Could not encode channel " << i << ".";
+      return std::nullopt;
+    }
+    packets.push_back(std::move(packet.value()));
+  }
+  if (packet_mode_ == MultichannelPacketMode::kPerChannel) {
+    return packets;
+  }
+  std::vector<uint8_t> combined;
+  combined.reserve(packets.size() * packets.front().size());
+  for (const std::vector<uint8_t>& packet : packets) {
+    combined.insert(combined.end(), packet.begin(), packet.end());
+  }
+  return std::vector<std::vector<uint8_t>>{std::move(combined)};
+}
+
+bool MultichannelEncoder::set_bitrate(int bitrate) {
+  if (BitrateToNumQuantizedBits(bitrate) < 0) {
+    LOG(ERROR) << "Bitrate " << bitrate << " bps is not supported by codec.";
+    return false;
+  }
+  for (const auto& encoder : encoders_) {
+    encoder->set_bitrate(bitrate);
+  }
+  return true;
+}
+
+int MultichannelEncoder::num_channels() const { return encoders_.size(); }
+
+int MultichannelEncoder::sample_rate_hz() const {
+  return encoders_.front()->sample_rate_hz();
+}
+
+std::unique_ptr<MultichannelDecoder> MultichannelDecoder::Create(
+    int sample_rate_hz, int num_channels,
+    const ghc::filesystem::path& model_path) {
+  if (!IsNumChannelsSupported(num_channels)) {
+    return nullptr;
+  }
+  std::vector<std::unique_ptr<LyraDecoder>> decoders;
+  decoders.reserve(num_channels);
+  for (int i = 0; i < num_channels; ++i) {
+    decoders.push_back(
+        LyraDecoder::Create(sample_rate_hz, kNumChannels, model_path));
+    if (decoders.back() == nullptr) {
+      LOG(ERROR) << "Could not create the decoder of channel " << i << ".";
+      return nullptr;
+    }
+  }
+  return absl::WrapUnique(new MultichannelDecoder(std::move(decoders)));
+}
+
+MultichannelDecoder::MultichannelDecoder(
+    std::vector<std::unique_ptr<LyraDecoder>> decoders)
+    : decoders_(std::move(decoders)) {}
+
+bool MultichannelDecoder::SetEncodedPackets(
+    const std::vector<absl::Span<const uint8_t>>& encoded) {
+  if (encoded.size() != num_channels()) {
+    LOG(ERROR) << "Expected " << num_channels() << " packets, but got "
+               << encoded.size() << ".";
+    return false;
+  }
+  for (int i = 0; i < num_channels(); ++i) {
+    if (encoded[i].empty()) {
+      continue;
+    }
+    if (!decoders_[i]->SetEncodedPacket(encoded[i])) {
+      LOG(ERROR) << "Could not set the packet of channel " << i << ".";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MultichannelDecoder::SetEncodedCombinedPacket(
+    absl::Span<const uint8_t> encoded) {
+  const int packet_size = encoded.size() / num_channels();
+  if (encoded.size() % num_channels() != 0 ||
+      PacketSizeToNumQuantizedBits(packet_size) < 0) {
+    LOG(ERROR) << "The combined packet size (" << encoded.size()
+               << " bytes) is not supported for " << num_channels()
+               << " channels.";
+    return false;
+  }
+  std::vector<absl::Span<const uint8_t>> packets;
+  packets.reserve(num_channels());
+  for (int i = 0; i < num_channels(); ++i) {
+    packets.push_back(encoded.subspan(i * packet_size, packet_size));
+  }
+  return SetEncodedPackets(packets);
+}
+
+std::optional<std::vector<int16_t>> MultichannelDecoder::DecodeSamples(
+    int num_samples, ChannelLayout layout) {
+  std::vector<int16_t> audio(num_channels() * num_samples);
+  for (int i = 0; i < num_channels(); ++i) {
+    const auto samples = decoders_[i]->DecodeSamples(num_samples);
+    if (!samples.has_value()) {
+      LOG(ERROR) << "Could not decode channel " << i << ".";
+      return std::nullopt;
+    }
+    if (layout == ChannelLayout::kPlanar) {
+      std::copy(samples->begin(), samples->end(),
+                audio.begin() + i * num_samples);
+      continue;
+    }
+    for (int j = 0; j < num_samples; ++j) {
+      audio[j * num_channels() + i] = samples->at(j);
+    }
+  }
+  return audio;
+}
+
+int MultichannelDecoder::num_channels() const { return decoders_.size(); }
+
+int MultichannelDecoder::sample_rate_hz() const {
+  return decoders_.front()->sample_rate_hz();
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_MULTICHANNEL_CODEC_H_
+#define LYRA_MULTICHANNEL_CODEC_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Multichannel coding of stereo or multi-microphone audio.
+//
+// Every channel is coded as its own mono Lyra stream with its own instance of
+// each model, so that no channel conditions the models of another. The
+// interpreters of one model share their packed weights. A session is not
+// thread safe.
+
+inline constexpr int kMaxNumChannels = 8;
+
+// How the samples of several channels are laid out in one buffer.
+enum class ChannelLayout {
+  // One sample of every channel after the other, as in wav files.
+  kInterleaved,
+  // All samples of the first channel, then all of the second, and so on.
+  kPlanar,
+};
+
+// How the packets of the channels of one hop are transmitted.
+enum class MultichannelPacketMode {
+  // One packet per channel. With DTX, each channel leaves out its own packets.
+  kPerChannel,
+  // One packet with the packets of all channels concatenated in order. Every
+  // channel is coded at the same bitrate, so the channels are recovered from
+  // the size of the combined packet.
+  kCombined,
+};
+
+class MultichannelEncoder {
+ public:
+  // Returns a nullptr if |num_channels| is not between 1 and
+  // |kMaxNumChannels|, if the other parameters are not supported by
+  // |LyraEncoder|, or if DTX is requested for combined packets, which can not
+  // leave out single channels.
+  static std::unique_ptr<MultichannelEncoder> Create(
+      int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+      MultichannelPacketMode packet_mode,
+      const ghc::filesystem::path& model_path);
+
+  // Encodes one hop of all channels, with |audio| laid out as |layout|.
+  // Returns one packet per channel for |kPerChannel|, where a packet is empty
+  // if DTX left it out, and a single packet for |kCombined|. Returns a nullopt
+  // if |audio| does not hold exactly one hop of every channel or if a channel
+  // can not be encoded.
+  std::optional<std::vector<std::vector<uint8_t>>> Encode(
+      absl::Span<const int16_t> audio, ChannelLayout layout);
+
+  // Sets the bitrate of all channels. Returns false if it is not supported.
+  bool set_bitrate(int bitrate);
+
+  int num_channels() const;
+
+  int sample_rate_hz() const;
+
+ private:
+  MultichannelEncoder(std::vector<std::unique_ptr<LyraEncoder>> encoders,
+                      MultichannelPacketMode packet_mode);
+
+  const std::vector<std::unique_ptr<LyraEncoder>> encoders_;
+  const MultichannelPacketMode packet_mode_;
+  // Of every channel, computed once instead of on every hop.
+  const int num_samples_per_hop_;
+};
+
+class MultichannelDecoder {
+ public:
+  // Returns a nullptr if |num_channels| is not between 1 and
+  // |kMaxNumChannels| or if the other parameters are not supported by
+  // |LyraDecoder|.
+  static std::unique_ptr<MultichannelDecoder> Create(
+      int sample_rate_hz, int num_channels,
+      const ghc::filesystem::path& model_path);
+
+  // Sets the packets of the next hop, one per channel. An empty packet
+  // leaves the channel to conceal the hop, as if the packet was lost or left
+  // out by DTX. Returns false if there is not one packet per channel or if a
+  // packet is not valid.
+  bool SetEncodedPackets(const std::vector<absl::Span<const uint8_t>>& encoded);
+
+  // Sets a packet produced in |MultichannelPacketMode::kCombined|. Returns
+  // false if its size is not that of |num_channels| packets of one supported
+  // bitrate.
+  bool SetEncodedCombinedPacket(absl::Span<const uint8_t> encoded);
+
+  // Decodes |num_samples| samples of every channel, laid out as |layout|.
+  // Returns a nullopt on failure.
+  std::optional<std::vector<int16_t>> DecodeSamples(int num_samples,
+                                                    ChannelLayout layout);
+
+  int num_channels() const;
+
+  int sample_rate_hz() const;
+
+ private:
+  explicit MultichannelDecoder(
+      std::vector<std::unique_ptr<LyraDecoder>> decoders);
+
+  const std::vector<std::unique_ptr<LyraDecoder>> decoders_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_MULTICHANNEL_CODEC_H_
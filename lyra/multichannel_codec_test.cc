@@ -0,0 +1,234 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/multichannel_codec.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kNumTestChannels = 2;
+constexpr int kBitrate = 6000;
+constexpr int kNumHops = 3;
+
+class MultichannelCodecTest : public testing::Test {
+ protected:
+  MultichannelCodecTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs"),
+        num_samples_per_hop_(GetNumSamplesPerHop(kInternalSampleRateHz)) {
+    // A different tone in every channel.
+    for (int channel = 0; channel < kNumTestChannels; ++channel) {
+      channels_.emplace_back(kNumHops * num_samples_per_hop_);
+      for (int i = 0; i < channels_.back().size(); ++i) {
+        channels_.back()[i] = 8000 * std::sin(0.05 * (channel + 1) * i);
+      }
+    }
+  }
+
+  // Returns hop |hop| of all channels laid out as |layout|.
+  std::vector<int16_t> GetHop(int hop, ChannelLayout layout) const {
+    std::vector<int16_t> audio;
+    for (int i = 0; i < num_samples_per_hop_; ++i) {
+      for (int channel = 0; channel < kNumTestChannels; ++channel) {
+        audio.push_back(channels_[channel][hop * num_samples_per_hop_ + i]);
+      }
+    }
+    if (layout == ChannelLayout::kInterleaved) {
+      return audio;
+    }
+    std::vector<int16_t> planar;
+    for (int channel = 0; channel < kNumTestChannels; ++channel) {
+      for (int i = 0; i < num_samples_per_hop_; ++i) {
+        planar.push_back(audio[i * kNumTestChannels + channel]);
+      }
+    }
+    return planar;
+  }
+
+  const ghc::filesystem::path model_path_;
+  const int num_samples_per_hop_;
+  std::vector<std::vector<int16_t>> channels_;
+};
+
+TEST_F(MultichannelCodecTest, CreationFailsWithUnsupportedParams) {
+  for (const int num_channels : {0, kMaxNumChannels + 1}) {
+    EXPECT_EQ(MultichannelEncoder::Create(
+                  kInternalSampleRateHz, num_channels, kBitrate,
+                  /*enable_dtx=*/false, MultichannelPacketMode::kPerChannel,
+                  model_path_),
+              nullptr);
+    EXPECT_EQ(MultichannelDecoder::Create(kInternalSampleRateHz, num_channels,
+                                          model_path_),
+              nullptr);
+  }
+  EXPECT_EQ(MultichannelEncoder::Create(
+                kInternalSampleRateHz, kNumTestChannels, kBitrate,
+                /*enable_dtx=*/true, MultichannelPacketMode::kCombined,
+                model_path_),
+            nullptr);
+  EXPECT_EQ(MultichannelEncoder::Create(
+                kInternalSampleRateHz, kNumTestChannels, kBitrate,
+                /*enable_dtx=*/false, MultichannelPacketMode::kPerChannel,
+                "invalid/model/path"),
+            nullptr);
+}
+
+TEST_F(MultichannelCodecTest, EncodeFailsWithWrongNumberOfSamples) {
+  auto encoder = MultichannelEncoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, kBitrate,
+      /*enable_dtx=*/false, MultichannelPacketMode::kPerChannel, model_path_);
+  ASSERT_NE(encoder, nullptr);
+  const std::vector<int16_t> mono_hop(num_samples_per_hop_);
+  EXPECT_FALSE(
+      encoder->Encode(mono_hop, ChannelLayout::kInterleaved).has_value());
+}
+
+// Every channel has to be coded exactly as by its own mono codec.
+TEST_F(MultichannelCodecTest, ChannelsMatchIndependentCodecs) {
+  auto encoder = MultichannelEncoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, kBitrate,
+      /*enable_dtx=*/false, MultichannelPacketMode::kPerChannel, model_path_);
+  auto decoder = MultichannelDecoder::Create(kInternalSampleRateHz,
+                                             kNumTestChannels, model_path_);
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+  std::vector<std::unique_ptr<LyraEncoder>> mono_encoders;
+  std::vector<std::unique_ptr<LyraDecoder>> mono_decoders;
+  for (int channel = 0; channel < kNumTestChannels; ++channel) {
+    mono_encoders.push_back(
+        LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, kBitrate,
+                            /*enable_dtx=*/false, model_path_));
+    mono_decoders.push_back(LyraDecoder::Create(kInternalSampleRateHz,
+                                                kNumChannels, model_path_));
+    ASSERT_NE(mono_encoders.back(), nullptr);
+    ASSERT_NE(mono_decoders.back(), nullptr);
+  }
+
+  for (int hop = 0; hop < kNumHops; ++hop) {
+    const auto packets =
+        encoder->Encode(GetHop(hop, ChannelLayout::kInterleaved),
+                        ChannelLayout::kInterleaved);
+    ASSERT_TRUE(packets.has_value());
+    ASSERT_EQ(packets->size(), kNumTestChannels);
+    std::vector<absl::Span<const uint8_t>> packet_spans;
+    for (int channel = 0; channel < kNumTestChannels; ++channel) {
+      const auto expected_packet =
+          mono_encoders[channel]->Encode(absl::MakeConstSpan(
+              &channels_[channel][hop * num_samples_per_hop_],
+              num_samples_per_hop_));
+      ASSERT_TRUE(expected_packet.has_value());
+      EXPECT_EQ(packets->at(channel), expected_packet.value());
+      ASSERT_TRUE(
+          mono_decoders[channel]->SetEncodedPacket(expected_packet.value()));
+      packet_spans.push_back(packets->at(channel));
+    }
+    ASSERT_TRUE(decoder->SetEncodedPackets(packet_spans));
+
+    const auto audio =
+        decoder->DecodeSamples(num_samples_per_hop_, ChannelLayout::kPlanar);
+    ASSERT_TRUE(audio.has_value());
+    for (int channel = 0; channel < kNumTestChannels; ++channel) {
+      const auto expected =
+          mono_decoders[channel]->DecodeSamples(num_samples_per_hop_);
+      ASSERT_TRUE(expected.has_value());
+      EXPECT_EQ(std::vector<int16_t>(
+                    audio->begin() + channel * num_samples_per_hop_,
+                    audio->begin() + (channel + 1) * num_samples_per_hop_),
+                expected.value());
+    }
+  }
+}
+
+TEST_F(MultichannelCodecTest, LayoutsAndPacketModesAgree) {
+  auto interleaved_encoder = MultichannelEncoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, kBitrate,
+      /*enable_dtx=*/false, MultichannelPacketMode::kPerChannel, model_path_);
+  auto planar_encoder = MultichannelEncoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, kBitrate,
+      /*enable_dtx=*/false, MultichannelPacketMode::kCombined, model_path_);
+  auto per_channel_decoder = MultichannelDecoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, model_path_);
+  auto combined_decoder = MultichannelDecoder::Create(
+      kInternalSampleRateHz, kNumTestChannels, model_path_);
+  ASSERT_NE(interleaved_encoder, nullptr);
+  ASSERT_NE(planar_encoder, nullptr);
+  ASSERT_NE(per_channel_decoder, nullptr);
+  ASSERT_NE(combined_decoder, nullptr);
+
+  for (int hop = 0; hop < kNumHops; ++hop) {
+    const auto packets = interleaved_encoder->Encode(
+        GetHop(hop, ChannelLayout::kInterleaved), ChannelLayout::kInterleaved);
+    const auto combined = planar_encoder->Encode(
+        GetHop(hop, ChannelLayout::kPlanar), ChannelLayout::kPlanar);
+    ASSERT_TRUE(packets.has_value());
+    ASSERT_TRUE(combined.has_value());
+    ASSERT_EQ(combined->size(), 1);
+    std::vector<uint8_t> concatenated;
+    std::vector<absl::Span<const uint8_t>> packet_spans;
+    for (const auto& packet : packets.value()) {
+      concatenated.insert(concatenated.end(), packet.begin(), packet.end());
+      packet_spans.push_back(packet);
+    }
+    EXPECT_EQ(combined->front(), concatenated);
+
+    ASSERT_TRUE(per_channel_decoder->SetEncodedPackets(packet_spans));
+    ASSERT_TRUE(combined_decoder->SetEncodedCombinedPacket(combined->front()));
+    const auto interleaved = per_channel_decoder->DecodeSamples(
+        num_samples_per_hop_, ChannelLayout::kInterleaved);
+    const auto planar = combined_decoder->DecodeSamples(
+        num_samples_per_hop_, ChannelLayout::kPlanar);
+    ASSERT_TRUE(interleaved.has_value());
+    ASSERT_TRUE(planar.has_value());
+    for (int i = 0; i < num_samples_per_hop_; ++i) {
+      for (int channel = 0; channel < kNumTestChannels; ++channel) {
+        EXPECT_EQ(interleaved->at(i * kNumTestChannels + channel),
+                  planar->at(channel * num_samples_per_hop_ + i));
+      }
+    }
+  }
+}
+
+TEST_F(MultichannelCodecTest, InvalidPacketsFail) {
+  auto decoder = MultichannelDecoder::Create(kInternalSampleRateHz,
+                                             kNumTestChannels, model_path_);
+  ASSERT_NE(decoder, nullptr);
+  const std::vector<uint8_t> packet(
+      GetPacketSize(GetSupportedQuantizedBits().front()));
+  EXPECT_FALSE(decoder->SetEncodedPackets({packet}));
+  EXPECT_FALSE(decoder->SetEncodedCombinedPacket(packet));
+  std::vector<uint8_t> combined(kNumTestChannels * packet.size() + 1);
+  EXPECT_FALSE(decoder->SetEncodedCombinedPacket(combined));
+  combined.pop_back();
+  EXPECT_TRUE(decoder->SetEncodedCombinedPacket(combined));
+  // A missing packet is concealed.
+  EXPECT_TRUE(decoder->SetEncodedPackets({packet, {}}));
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
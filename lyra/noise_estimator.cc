@@ -28,6 +28,7 @@
 #include "audio/dsp/signal_vector_util.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "lyra/log_mel_spectrogram_extractor_impl.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -172,6 +173,45 @@ bool NoiseEstimator::ReceiveSamples(const absl::Span<const int16_t> samples) {
   return true;
 }
 
+bool NoiseEstimator::SaveState(StateWriter* writer) const {
+  writer->WriteVector<float>(smoothed_power_);
+  writer->WriteVector<float>(squared_smoothed_power_);
+  writer->WriteVector<float>(tmp_min_smoothed_power_);
+  writer->WriteVector<float>(noise_estimate_);
+  writer->WriteVector<float>(noise_bound_);
+  writer->WriteVector<int16_t>(past_samples_hop_);
+  writer->Write(is_noise_);
+  writer->Write<int32_t>(num_hops_received_);
+  writer->Write<int32_t>(next_sample_in_hop_);
+  return log_mel_spectrogram_extractor_->SaveState(writer);
+}
+
+bool NoiseEstimator::RestoreState(StateReader* reader) {
+  const int num_features = noise_estimate_.size();
+  int32_t num_hops_received;
+  int32_t next_sample_in_hop;
+  if (!reader->ReadVector(&smoothed_power_) ||
+      !reader->ReadVectorOfSize(num_features, &squared_smoothed_power_) ||
+      !reader->ReadVectorOfSize(num_features, &tmp_min_smoothed_power_) ||
+      !reader->ReadVectorOfSize(num_features, &noise_estimate_) ||
+      !reader->ReadVectorOfSize(num_features, &noise_bound_) ||
+      !reader->ReadVectorOfSize(num_samples_per_hop_, &past_samples_hop_) ||
+      !reader->Read(&is_noise_) || !reader->Read(&num_hops_received) ||
+      !reader->Read(&next_sample_in_hop)) {
+    return false;
+  }
+  // The smoothed power is only set once the first noise estimate is updated.
+  if ((!smoothed_power_.empty() && smoothed_power_.size() != num_features) ||
+      num_hops_received < 0 || num_hops_received >= num_hops_per_update_ ||
+      next_sample_in_hop < 0 || next_sample_in_hop >= num_samples_per_hop_) {
+    LOG(ERROR) << "Invalid noise estimator state.";
+    return false;
+  }
+  num_hops_received_ = num_hops_received;
+  next_sample_in_hop_ = next_sample_in_hop;
+  return log_mel_spectrogram_extractor_->RestoreState(reader);
+}
+
 void NoiseEstimator::UpdateNoiseEstimate(
     const std::vector<float>& current_power_db) {
   // Only executed once, the first time |num_samples_per_hop_| samples have been
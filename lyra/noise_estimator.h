@@ -24,6 +24,7 @@
 #include "absl/types/span.h"
 #include "lyra/log_mel_spectrogram_extractor_impl.h"
 #include "lyra/noise_estimator_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -54,6 +55,12 @@ class NoiseEstimator : public NoiseEstimatorInterface {
   // |ReceiveSamples| is noise.
   bool is_noise() const override;
 
+  // Saves the noise statistics, the samples of the current hop and the state
+  // of the spectrogram.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
  private:
   NoiseEstimator(int num_samples_per_hop, int num_hops_per_update,
                  int num_features, float max_smoothing,
@@ -21,6 +21,8 @@
 #include <vector>
 
 #include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -35,6 +37,18 @@ class NoiseEstimatorInterface {
   virtual std::vector<float> noise_estimate() const = 0;
 
   virtual bool is_noise() const = 0;
+
+  // Saves the noise statistics gathered so far. Returns false if the
+  // estimator does not support this.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This noise estimator can not save its state.";
+    return false;
+  }
+
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This noise estimator can not restore its state.";
+    return false;
+  }
 };
 
 }  // namespace codec
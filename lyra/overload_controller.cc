@@ -0,0 +1,121 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/overload_controller.h"
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/lyra_config.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+std::unique_ptr<OverloadController> OverloadController::Create(
+    const Options& options) {
+  if (options.recovery_utilization < 0 ||
+      options.recovery_utilization >= options.overload_utilization) {
+    LOG(ERROR) << "The recovery utilization has to be non-negative and lower "
+                  "than the overload utilization.";
+    return nullptr;
+  }
+  if (options.smoothing <= 0 || options.smoothing > 1) {
+    LOG(ERROR) << "The smoothing has to be in (0, 1].";
+    return nullptr;
+  }
+  if (options.num_periods_to_degrade < 1 ||
+      options.num_periods_to_recover < 1) {
+    LOG(ERROR) << "The number of periods per step has to be positive.";
+    return nullptr;
+  }
+  return absl::WrapUnique(new OverloadController(options));
+}
+
+OverloadController::OverloadController(const Options& options)
+    : options_(options),
+      utilization_(0),
+      degradation_step_(0),
+      num_overloaded_periods_(0),
+      num_recovered_periods_(0) {}
+
+void OverloadController::Update(absl::Duration busy_time,
+                                absl::Duration budget) {
+  if (budget <= absl::ZeroDuration()) {
+    return;
+  }
+  const double new_utilization = absl::FDivDuration(busy_time, budget);
+  utilization_ = options_.smoothing * new_utilization +
+                 (1 - options_.smoothing) * utilization_;
+
+  if (utilization_ > options_.overload_utilization) {
+    num_recovered_periods_ = 0;
+    if (++num_overloaded_periods_ >= options_.num_periods_to_degrade &&
+        degradation_step_ < kMaxDegradationStep) {
+      ++degradation_step_;
+      num_overloaded_periods_ = 0;
+    }
+  } else if (utilization_ < options_.recovery_utilization) {
+    num_overloaded_periods_ = 0;
+    if (++num_recovered_periods_ >= options_.num_periods_to_recover &&
+        degradation_step_ > 0) {
+      --degradation_step_;
+      num_recovered_periods_ = 0;
+    }
+  } else {
+    num_overloaded_periods_ = 0;
+    num_recovered_periods_ = 0;
+  }
+}
+
+QualityLevel OverloadController::GetQualityLevel(
+    SessionPriority priority) const {
+  // The first step at which sessions of |priority| reduce their bitrate and
+  // switch to comfort noise, respectively.
+  int reduced_bitrate_step;
+  int comfort_noise_step;
+  switch (priority) {
+    case SessionPriority::kLow:
+      reduced_bitrate_step = 1;
+      comfort_noise_step = 2;
+      break;
+    case SessionPriority::kNormal:
+      reduced_bitrate_step = 3;
+      comfort_noise_step = 4;
+      break;
+    case SessionPriority::kHigh:
+      reduced_bitrate_step = 5;
+      comfort_noise_step = kMaxDegradationStep + 1;
+      break;
+  }
+  if (degradation_step_ >= comfort_noise_step) {
+    return QualityLevel::kComfortNoise;
+  }
+  if (degradation_step_ >= reduced_bitrate_step) {
+    return QualityLevel::kReducedBitrate;
+  }
+  return QualityLevel::kFull;
+}
+
+int GetBitrateForQualityLevel(QualityLevel quality_level, int bitrate) {
+  if (quality_level == QualityLevel::kFull) {
+    return bitrate;
+  }
+  return GetBitrate(GetSupportedQuantizedBits().front());
+}
+
+}  // namespace codec
+}  // namespace chromemedia
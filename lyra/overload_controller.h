@@ -0,0 +1,95 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_OVERLOAD_CONTROLLER_H_
+#define LYRA_OVERLOAD_CONTROLLER_H_
+
+#include <memory>
+
+#include "absl/time/time.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Decides the quality sessions of one worker run at from the time it takes
+// to process their frames, relative to the frame period. While the smoothed
+// utilization stays above |overload_utilization| quality is lowered one step
+// at a time, low priority sessions first; while it stays below
+// |recovery_utilization| it is raised again one step at a time. The gap
+// between the two thresholds and the number of periods required for each
+// step keep sessions from oscillating between levels.
+//
+// Degradation steps, in order:
+//   1. Low priority sessions reduce their bitrate.
+//   2. Low priority sessions switch to comfort noise.
+//   3. Normal priority sessions reduce their bitrate.
+//   4. Normal priority sessions switch to comfort noise.
+//   5. High priority sessions reduce their bitrate.
+// High priority sessions never switch to comfort noise.
+//
+// This class is not thread-safe.
+class OverloadController {
+ public:
+  struct Options {
+    double overload_utilization = 0.9;
+    double recovery_utilization = 0.6;
+    // Weight of the newest period in the exponentially smoothed utilization.
+    double smoothing = 0.2;
+    // Consecutive periods above or below the thresholds needed for one step.
+    // Degrading is quick so deadlines are kept; recovering is slow so the
+    // freed time is not immediately used up again.
+    int num_periods_to_degrade = 10;
+    int num_periods_to_recover = 100;
+  };
+
+  static constexpr int kMaxDegradationStep = 5;
+
+  // Returns a nullptr if |options| are invalid.
+  static std::unique_ptr<OverloadController> Create(const Options& options);
+
+  // Reports that the worker spent |busy_time| on frames that were allotted
+  // |budget| of its time, typically an equal share of the frame period each.
+  // Unlike the fraction of wall time spent busy, this exceeds 1 when the
+  // sessions need more time than the worker has, and does not grow while the
+  // worker catches up on late frames.
+  void Update(absl::Duration busy_time, absl::Duration budget);
+
+  QualityLevel GetQualityLevel(SessionPriority priority) const;
+
+  // Ranges from 0 (full quality) to |kMaxDegradationStep|.
+  int degradation_step() const { return degradation_step_; }
+
+  double utilization() const { return utilization_; }
+
+ private:
+  explicit OverloadController(const Options& options);
+
+  const Options options_;
+  double utilization_;
+  int degradation_step_;
+  int num_overloaded_periods_;
+  int num_recovered_periods_;
+};
+
+// Returns the bitrate a session nominally at |bitrate| should encode at on
+// |quality_level|.
+int GetBitrateForQualityLevel(QualityLevel quality_level, int bitrate);
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_OVERLOAD_CONTROLLER_H_
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/overload_controller.h"
+
+#include <memory>
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lyra/lyra_config.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr absl::Duration kPeriod = absl::Milliseconds(20);
+
+OverloadController::Options MakeOptions() {
+  OverloadController::Options options;
+  options.smoothing = 1.0;
+  options.num_periods_to_degrade = 2;
+  options.num_periods_to_recover = 4;
+  return options;
+}
+
+void RunPeriods(int num_periods, double utilization,
+                OverloadController* controller) {
+  for (int i = 0; i < num_periods; ++i) {
+    controller->Update(kPeriod * utilization, kPeriod);
+  }
+}
+
+TEST(OverloadControllerTest, CreateFailsWithInvalidOptions) {
+  OverloadController::Options options = MakeOptions();
+  options.recovery_utilization = options.overload_utilization;
+  EXPECT_EQ(OverloadController::Create(options), nullptr);
+
+  options = MakeOptions();
+  options.smoothing = 0;
+  EXPECT_EQ(OverloadController::Create(options), nullptr);
+
+  options = MakeOptions();
+  options.num_periods_to_recover = 0;
+  EXPECT_EQ(OverloadController::Create(options), nullptr);
+}
+
+TEST(OverloadControllerTest, StartsAtFullQuality) {
+  auto controller = OverloadController::Create(MakeOptions());
+  ASSERT_NE(controller, nullptr);
+  EXPECT_EQ(controller->degradation_step(), 0);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kLow),
+            QualityLevel::kFull);
+}
+
+TEST(OverloadControllerTest, DegradesLowPriorityFirst) {
+  auto controller = OverloadController::Create(MakeOptions());
+  ASSERT_NE(controller, nullptr);
+
+  RunPeriods(2, 1.0, controller.get());
+  EXPECT_EQ(controller->degradation_step(), 1);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kLow),
+            QualityLevel::kReducedBitrate);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kNormal),
+            QualityLevel::kFull);
+
+  RunPeriods(2, 1.0, controller.get());
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kLow),
+            QualityLevel::kComfortNoise);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kNormal),
+            QualityLevel::kFull);
+
+  RunPeriods(100, 1.0, controller.get());
+  EXPECT_EQ(controller->degradation_step(),
+            OverloadController::kMaxDegradationStep);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kNormal),
+            QualityLevel::kComfortNoise);
+  EXPECT_EQ(controller->GetQualityLevel(SessionPriority::kHigh),
+            QualityLevel::kReducedBitrate);
+}
+
+TEST(OverloadControllerTest, HoldsBetweenThresholds) {
+  auto controller = OverloadController::Create(MakeOptions());
+  ASSERT_NE(controller, nullptr);
+  RunPeriods(2, 1.0, controller.get());
+  ASSERT_EQ(controller->degradation_step(), 1);
+
+  RunPeriods(100, 0.75, controller.get());
+  EXPECT_EQ(controller->degradation_step(), 1);
+}
+
+TEST(OverloadControllerTest, RecoversOneStepAtATime) {
+  auto controller = OverloadController::Create(MakeOptions());
+  ASSERT_NE(controller, nullptr);
+  RunPeriods(4, 1.0, controller.get());
+  ASSERT_EQ(controller->degradation_step(), 2);
+
+  RunPeriods(3, 0.1, controller.get());
+  EXPECT_EQ(controller->degradation_step(), 2);
+  RunPeriods(1, 0.1, controller.get());
+  EXPECT_EQ(controller->degradation_step(), 1);
+  RunPeriods(4, 0.1, controller.get());
+  EXPECT_EQ(controller->degradation_step(), 0);
+}
+
+TEST(OverloadControllerTest, SpikesDoNotDegrade) {
+  auto controller = OverloadController::Create(MakeOptions());
+  ASSERT_NE(controller, nullptr);
+  for (int i = 0; i < 50; ++i) {
+    RunPeriods(1, 1.0, controller.get());
+    RunPeriods(1, 0.5, controller.get());
+  }
+  EXPECT_EQ(controller->degradation_step(), 0);
+}
+
+TEST(OverloadControllerTest, ReducedBitrateIsLowestSupported) {
+  EXPECT_EQ(GetBitrateForQualityLevel(QualityLevel::kFull, 9200), 9200);
+  EXPECT_EQ(GetBitrateForQualityLevel(QualityLevel::kReducedBitrate, 9200),
+            GetBitrate(GetSupportedQuantizedBits().front()));
+  EXPECT_EQ(GetBitrateForQualityLevel(QualityLevel::kComfortNoise, 6000),
+            GetBitrate(GetSupportedQuantizedBits().front()));
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
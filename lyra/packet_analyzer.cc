@@ -0,0 +1,283 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/packet_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/feature_extractor_interface.h"
+#include "lyra/lyra_components.h"
+#include "lyra/lyra_config.h"
+#include "lyra/vector_quantizer_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Hops of silence the encoder runs before its features of silence settle.
+constexpr int kNumSilenceHops = 5;
+// Keeps the log of the distance to silence finite.
+constexpr float kLevelFloor = 1e-2f;
+constexpr float kLevelHalfLifeSecs = 0.04f;
+// Length of the windows over which the minimum level is tracked.
+constexpr float kMinWindowSecs = 1.f;
+constexpr float kNoiseHalfLifeSecs = 1.f;
+constexpr float kScoreHalfLifeSecs = 0.2f;
+// A hop is speech if its level exceeds the noise floor by this many standard
+// deviations of the noise, and by at least |kMinSpeechMargin|.
+constexpr float kBoundFactor = 3.f;
+constexpr float kMinSpeechMargin = 0.5f;
+
+float HopDecay(float half_life_secs) {
+  // x(t) = x0 * (1/2) ^ (t / t_half_life)
+  return std::pow(0.5f, 1.f / (kFrameRate * half_life_secs));
+}
+
+}  // namespace
+
+std::optional<LoudnessRegressor> FitLoudnessRegressor(
+    const std::vector<std::vector<float>>& features,
+    const std::vector<float>& loudness_dbfs, float ridge) {
+  if (features.empty() || features.size() != loudness_dbfs.size()) {
+    LOG(ERROR) << "Need the same positive number of feature vectors and "
+                  "loudness values, but got "
+               << features.size() << " and " << loudness_dbfs.size() << ".";
+    return std::nullopt;
+  }
+  // Solves the normal equations (X^T X + ridge I) w = X^T y, where X has a
+  // trailing column of ones for the unpenalized bias.
+  const int num_features = features.front().size();
+  const int size = num_features + 1;
+  std::vector<double> gram(size * size, 0.0);
+  std::vector<double> solution(size, 0.0);
+  std::vector<double> row(size, 1.0);
+  for (int n = 0; n < features.size(); ++n) {
+    if (features[n].size() != num_features) {
+      LOG(ERROR) << "Feature vector " << n << " has " << features[n].size()
+                 << " instead of " << num_features << " features.";
+      return std::nullopt;
+    }
+    std::copy(features[n].begin(), features[n].end(), row.begin());
+    for (int i = 0; i < size; ++i) {
+      for (int j = 0; j <= i; ++j) {
+        gram[i * size + j] += row[i] * row[j];
+      }
+      solution[i] += row[i] * loudness_dbfs[n];
+    }
+  }
+  for (int i = 0; i < num_features; ++i) {
+    gram[i * size + i] += ridge;
+  }
+
+  // Cholesky decomposition of the lower triangle in place.
+  for (int j = 0; j < size; ++j) {
+    for (int k = 0; k < j; ++k) {
+      gram[j * size + j] -= gram[j * size + k] * gram[j * size + k];
+    }
+    if (gram[j * size + j] <= 0.0) {
+      LOG(ERROR) << "The features are degenerate; increase the ridge.";
+      return std::nullopt;
+    }
+    gram[j * size + j] = std::sqrt(gram[j * size + j]);
+    for (int i = j + 1; i < size; ++i) {
+      for (int k = 0; k < j; ++k) {
+        gram[i * size + j] -= gram[i * size + k] * gram[j * size + k];
+      }
+      gram[i * size + j] /= gram[j * size + j];
+    }
+  }
+  // Forward and back substitution.
+  for (int i = 0; i < size; ++i) {
+    for (int k = 0; k < i; ++k) {
+      solution[i] -= gram[i * size + k] * solution[k];
+    }
+    solution[i] /= gram[i * size + i];
+  }
+  for (int i = size - 1; i >= 0; --i) {
+    for (int k = i + 1; k < size; ++k) {
+      solution[i] -= gram[k * size + i] * solution[k];
+    }
+    solution[i] /= gram[i * size + i];
+  }
+  return LoudnessRegressor{
+      std::vector<float>(solution.begin(), solution.end() - 1),
+      static_cast<float>(solution.back())};
+}
+
+std::unique_ptr<PacketAnalyzer> PacketAnalyzer::Create(
+    const ghc::filesystem::path& model_path,
+    std::optional<LoudnessRegressor> regressor) {
+  std::unique_ptr<VectorQuantizerInterface> quantizer =
+      CreateQuantizer(model_path);
+  if (quantizer == nullptr) {
+    LOG(ERROR) << "Could not create Vector Quantizer.";
+    return nullptr;
+  }
+  std::unique_ptr<FeatureExtractorInterface> feature_extractor =
+      CreateFeatureExtractor(model_path);
+  if (feature_extractor == nullptr) {
+    LOG(ERROR) << "Could not create Features Extractor.";
+    return nullptr;
+  }
+
+  const std::vector<int16_t> silence(InternalProfile::kNumSamplesPerHop, 0);
+  std::optional<std::vector<float>> features;
+  for (int i = 0; i < kNumSilenceHops; ++i) {
+    features = feature_extractor->Extract(silence);
+    if (!features.has_value()) {
+      LOG(ERROR) << "Could not extract the features of silence.";
+      return nullptr;
+    }
+  }
+  if (regressor.has_value() &&
+      regressor->weights.size() != features->size()) {
+    LOG(ERROR) << "The loudness regressor has " << regressor->weights.size()
+               << " weights, but there are " << features->size()
+               << " features.";
+    return nullptr;
+  }
+
+  absl::flat_hash_map<int, std::vector<float>> silence_features;
+  for (const int num_quantized_bits : GetSupportedQuantizedBits()) {
+    std::optional<std::string> quantized =
+        quantizer->Quantize(features.value(), num_quantized_bits);
+    if (!quantized.has_value()) {
+      LOG(ERROR) << "Could not quantize the features of silence.";
+      return nullptr;
+    }
+    std::optional<std::vector<float>> lossy_features =
+        quantizer->DecodeToLossyFeatures(quantized.value());
+    if (!lossy_features.has_value()) {
+      LOG(ERROR) << "Could not decode the features of silence.";
+      return nullptr;
+    }
+    silence_features[num_quantized_bits] = std::move(lossy_features.value());
+  }
+  return absl::WrapUnique(new PacketAnalyzer(std::move(quantizer),
+                                             std::move(silence_features),
+                                             std::move(regressor)));
+}
+
+PacketAnalyzer::PacketAnalyzer(
+    std::unique_ptr<VectorQuantizerInterface> quantizer,
+    absl::flat_hash_map<int, std::vector<float>> silence_features,
+    std::optional<LoudnessRegressor> regressor)
+    : quantizer_(std::move(quantizer)),
+      silence_features_(std::move(silence_features)),
+      regressor_(std::move(regressor)) {}
+
+std::optional<std::vector<float>> PacketAnalyzer::DecodeFeatures(
+    absl::Span<const uint8_t> encoded) const {
+  const int num_quantized_bits = PacketSizeToNumQuantizedBits(encoded.size());
+  if (num_quantized_bits < 0) {
+    LOG(ERROR) << "The packet size (" << encoded.size()
+               << " bytes) is not supported.";
+    return std::nullopt;
+  }
+  auto packet = CreatePacket(kNumHeaderBits, num_quantized_bits);
+  std::optional<std::string> quantized = packet->UnpackPacket(encoded);
+  if (!quantized.has_value()) {
+    LOG(ERROR) << "Could not read Lyra packet for analysis.";
+    return std::nullopt;
+  }
+  return quantizer_->DecodeToLossyFeatures(quantized.value());
+}
+
+std::optional<PacketAnalysis> PacketAnalyzer::Analyze(
+    absl::Span<const uint8_t> encoded, StreamState* state) const {
+  const std::optional<std::vector<float>> features = DecodeFeatures(encoded);
+  if (!features.has_value()) {
+    return std::nullopt;
+  }
+  const std::vector<float>& silence =
+      silence_features_.at(PacketSizeToNumQuantizedBits(encoded.size()));
+  float squared_distance = 0.f;
+  for (int i = 0; i < silence.size(); ++i) {
+    const float difference = features->at(i) - silence[i];
+    squared_distance += difference * difference;
+  }
+  const float level = std::log(std::sqrt(squared_distance) + kLevelFloor);
+
+  PacketAnalysis analysis;
+  analysis.is_speech = UpdateLevel(level, state);
+  analysis.activity = std::max(0.f, level - state->min_level);
+  const float score_decay = HopDecay(kScoreHalfLifeSecs);
+  state->speaking_score = score_decay * state->speaking_score +
+                          (analysis.is_speech ? 1.f - score_decay : 0.f);
+  analysis.speaking_score = state->speaking_score;
+  if (regressor_.has_value()) {
+    float loudness = regressor_->bias;
+    for (int i = 0; i < regressor_->weights.size(); ++i) {
+      loudness += regressor_->weights[i] * features->at(i);
+    }
+    analysis.loudness_dbfs = loudness;
+  }
+  return analysis;
+}
+
+void PacketAnalyzer::AddMissingHop(StreamState* state) const {
+  state->speaking_score *= HopDecay(kScoreHalfLifeSecs);
+}
+
+bool PacketAnalyzer::UpdateLevel(float level, StreamState* state) const {
+  if (!state->has_level) {
+    state->has_level = true;
+    state->smoothed_level = level;
+    state->min_level = level;
+    state->tmp_min_level = level;
+  }
+  const float smoothing = HopDecay(kLevelHalfLifeSecs);
+  state->smoothed_level =
+      smoothing * state->smoothed_level + (1.f - smoothing) * level;
+
+  // The minimum over the current and the previous window, so that the noise
+  // floor follows a rising noise level within two windows.
+  if (state->num_hops_in_window == 0) {
+    state->min_level = std::min(state->tmp_min_level, state->smoothed_level);
+    state->tmp_min_level = state->smoothed_level;
+  } else {
+    state->min_level = std::min(state->min_level, state->smoothed_level);
+    state->tmp_min_level =
+        std::min(state->tmp_min_level, state->smoothed_level);
+  }
+  const int num_hops_per_window = std::round(kMinWindowSecs * kFrameRate);
+  state->num_hops_in_window =
+      (state->num_hops_in_window + 1) % num_hops_per_window;
+
+  const float deviation = level - state->min_level;
+  const float bound = std::max(
+      kMinSpeechMargin, kBoundFactor * std::sqrt(state->noise_variance));
+  const bool is_speech = deviation > bound;
+  if (!is_speech) {
+    const float noise_decay = HopDecay(kNoiseHalfLifeSecs);
+    state->noise_variance = noise_decay * state->noise_variance +
+                            (1.f - noise_decay) * deviation * deviation;
+  }
+  return is_speech;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
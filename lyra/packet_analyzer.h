@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_PACKET_ANALYZER_H_
+#define LYRA_PACKET_ANALYZER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/vector_quantizer_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// A linear model predicting the loudness of a hop from its lossy features.
+struct LoudnessRegressor {
+  std::vector<float> weights;
+  float bias;
+};
+
+// Fits a |LoudnessRegressor| by ridge regression of |loudness_dbfs| on
+// |features|, for example the lossy features of packets and the loudness of
+// the same hops decoded. |ridge| weighs the penalty on the weights. Returns a
+// nullopt if the inputs are empty or of inconsistent sizes.
+std::optional<LoudnessRegressor> FitLoudnessRegressor(
+    const std::vector<std::vector<float>>& features,
+    const std::vector<float>& loudness_dbfs, float ridge = 1e-3f);
+
+struct PacketAnalysis {
+  // Voice activity of the hop.
+  bool is_speech;
+  // Natural log of how far the features are from silence, relative to the
+  // stream's noise floor. Near 0 for background noise.
+  float activity;
+  // Voice activity smoothed over a few hundred milliseconds, in [0, 1], to
+  // rank active speakers.
+  float speaking_score;
+  // Loudness of the hop, if the analyzer has a |LoudnessRegressor|.
+  std::optional<float> loudness_dbfs;
+};
+
+// Analyzes Lyra packets without decoding them to audio. Only the quantizer is
+// run to recover the lossy features. Their distance to the features of
+// silence is tracked with minimum statistics, as |NoiseEstimator| does with
+// the power of decoded audio, to tell speech from the noise floor of each
+// stream.
+//
+// One analyzer serves any number of streams, each of which keeps its own
+// |StreamState|. Like the quantizer it runs, an analyzer must only be used by
+// one thread at a time.
+class PacketAnalyzer {
+ public:
+  // State of one stream. Value-initialize it for a new stream.
+  struct StreamState {
+    bool has_level = false;
+    float smoothed_level = 0.f;
+    float min_level = 0.f;
+    float tmp_min_level = 0.f;
+    float noise_variance = 0.f;
+    int num_hops_in_window = 0;
+    float speaking_score = 0.f;
+  };
+
+  // Returns a nullptr on failure, or if the size of |regressor|'s weights is
+  // not the number of features.
+  static std::unique_ptr<PacketAnalyzer> Create(
+      const ghc::filesystem::path& model_path,
+      std::optional<LoudnessRegressor> regressor = std::nullopt);
+
+  // Analyzes the packet of the next hop of the stream with |state|. Returns a
+  // nullopt if the packet can not be read.
+  std::optional<PacketAnalysis> Analyze(absl::Span<const uint8_t> encoded,
+                                        StreamState* state) const;
+
+  // Accounts for a hop of the stream with |state| that did not arrive, for
+  // example because DTX did not send it.
+  void AddMissingHop(StreamState* state) const;
+
+  // Returns the lossy features of |encoded|, or a nullopt if it can not be
+  // read.
+  std::optional<std::vector<float>> DecodeFeatures(
+      absl::Span<const uint8_t> encoded) const;
+
+ private:
+  PacketAnalyzer(
+      std::unique_ptr<VectorQuantizerInterface> quantizer,
+      absl::flat_hash_map<int, std::vector<float>> silence_features,
+      std::optional<LoudnessRegressor> regressor);
+
+  // Returns whether the hop at |level| is speech and updates the noise floor.
+  bool UpdateLevel(float level, StreamState* state) const;
+
+  const std::unique_ptr<VectorQuantizerInterface> quantizer_;
+  // Lossy features of silence, per number of quantized bits.
+  const absl::flat_hash_map<int, std::vector<float>> silence_features_;
+  const std::optional<LoudnessRegressor> regressor_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_PACKET_ANALYZER_H_
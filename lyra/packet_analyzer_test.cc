@@ -0,0 +1,190 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/packet_analyzer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_encoder.h"
+#include "lyra/wav_utils.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+class PacketAnalyzerTest : public testing::TestWithParam<int> {
+ protected:
+  PacketAnalyzerTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs"),
+        num_samples_per_hop_(GetNumSamplesPerHop(kInternalSampleRateHz)) {}
+
+  // Encodes |audio| hop by hop at the bitrate of the test.
+  std::vector<std::vector<uint8_t>> Encode(const std::vector<int16_t>& audio) {
+    auto encoder = LyraEncoder::Create(kInternalSampleRateHz, kNumChannels,
+                                       GetBitrate(GetParam()),
+                                       /*enable_dtx=*/false, model_path_);
+    EXPECT_NE(encoder, nullptr);
+    std::vector<std::vector<uint8_t>> packets;
+    for (int i = 0; i + num_samples_per_hop_ <= audio.size();
+         i += num_samples_per_hop_) {
+      auto packet = encoder->Encode(
+          absl::MakeConstSpan(&audio.at(i), num_samples_per_hop_));
+      EXPECT_TRUE(packet.has_value());
+      packets.push_back(packet.value());
+    }
+    return packets;
+  }
+
+  const ghc::filesystem::path model_path_;
+  const int num_samples_per_hop_;
+};
+
+TEST_P(PacketAnalyzerTest, CreationFailsWithInvalidModelPath) {
+  EXPECT_EQ(PacketAnalyzer::Create("invalid/model/path"), nullptr);
+}
+
+TEST_P(PacketAnalyzerTest, CreationFailsWithMismatchedRegressor) {
+  EXPECT_EQ(PacketAnalyzer::Create(model_path_, LoudnessRegressor{{1.f}, 0.f}),
+            nullptr);
+}
+
+TEST_P(PacketAnalyzerTest, AnalysisFailsWithUnsupportedPacketSize) {
+  auto analyzer = PacketAnalyzer::Create(model_path_);
+  ASSERT_NE(analyzer, nullptr);
+  PacketAnalyzer::StreamState state;
+  const std::vector<uint8_t> packet(GetPacketSize(GetParam()) + 1);
+  EXPECT_FALSE(analyzer->Analyze(packet, &state).has_value());
+}
+
+TEST_P(PacketAnalyzerTest, SilenceIsNotSpeech) {
+  auto analyzer = PacketAnalyzer::Create(model_path_);
+  ASSERT_NE(analyzer, nullptr);
+  PacketAnalyzer::StreamState state;
+  for (const auto& packet : Encode(std::vector<int16_t>(kInternalSampleRateHz,
+                                                        0))) {
+    const auto analysis = analyzer->Analyze(packet, &state);
+    ASSERT_TRUE(analysis.has_value());
+    EXPECT_FALSE(analysis->is_speech);
+    EXPECT_EQ(analysis->speaking_score, 0.f);
+    EXPECT_FALSE(analysis->loudness_dbfs.has_value());
+  }
+}
+
+TEST_P(PacketAnalyzerTest, SpeechAfterSilenceIsDetected) {
+  const absl::StatusOr<ReadWavResult> wav = Read16BitWavFileToVector(
+      (ghc::filesystem::current_path() / "lyra/testdata/sample1_16kHz.wav")
+          .string());
+  ASSERT_TRUE(wav.ok());
+  std::vector<int16_t> audio(kInternalSampleRateHz, 0);
+  audio.insert(audio.end(), wav->samples.begin(), wav->samples.end());
+  auto analyzer = PacketAnalyzer::Create(model_path_);
+  ASSERT_NE(analyzer, nullptr);
+
+  PacketAnalyzer::StreamState state;
+  int num_speech_hops = 0;
+  float max_speaking_score = 0.f;
+  for (const auto& packet : Encode(audio)) {
+    const auto analysis = analyzer->Analyze(packet, &state);
+    ASSERT_TRUE(analysis.has_value());
+    num_speech_hops += analysis->is_speech;
+    max_speaking_score =
+        std::max(max_speaking_score, analysis->speaking_score);
+  }
+  EXPECT_GT(num_speech_hops, 0);
+  EXPECT_GT(max_speaking_score, 0.5f);
+
+  // The score fades while no packets arrive.
+  const float speaking_score = state.speaking_score;
+  for (int i = 0; i < kFrameRate; ++i) {
+    analyzer->AddMissingHop(&state);
+  }
+  EXPECT_LT(state.speaking_score, 0.1f * speaking_score);
+}
+
+TEST_P(PacketAnalyzerTest, RegressorPredictsFromLossyFeatures) {
+  const std::vector<std::vector<uint8_t>> packets =
+      Encode(std::vector<int16_t>(num_samples_per_hop_, 1000));
+  auto plain_analyzer = PacketAnalyzer::Create(model_path_);
+  ASSERT_NE(plain_analyzer, nullptr);
+  const auto features = plain_analyzer->DecodeFeatures(packets.front());
+  ASSERT_TRUE(features.has_value());
+
+  LoudnessRegressor regressor{std::vector<float>(features->size(), 0.f),
+                              -20.f};
+  regressor.weights.front() = 2.f;
+  auto analyzer = PacketAnalyzer::Create(model_path_, regressor);
+  ASSERT_NE(analyzer, nullptr);
+  PacketAnalyzer::StreamState state;
+  const auto analysis = analyzer->Analyze(packets.front(), &state);
+  ASSERT_TRUE(analysis.has_value());
+  ASSERT_TRUE(analysis->loudness_dbfs.has_value());
+  EXPECT_FLOAT_EQ(analysis->loudness_dbfs.value(),
+                  -20.f + 2.f * features->front());
+}
+
+INSTANTIATE_TEST_SUITE_P(NumQuantizedBits, PacketAnalyzerTest,
+                         testing::ValuesIn(GetSupportedQuantizedBits()));
+
+TEST(FitLoudnessRegressorTest, RecoversLinearModel) {
+  constexpr int kNumFeatures = 8;
+  std::mt19937 gen(1234);
+  std::normal_distribution<float> distribution;
+  std::vector<float> weights(kNumFeatures);
+  for (float& weight : weights) {
+    weight = distribution(gen);
+  }
+  constexpr float kBias = -30.f;
+  std::vector<std::vector<float>> features(200,
+                                           std::vector<float>(kNumFeatures));
+  std::vector<float> loudness_dbfs;
+  for (auto& feature_vector : features) {
+    float loudness = kBias;
+    for (int i = 0; i < kNumFeatures; ++i) {
+      feature_vector[i] = distribution(gen);
+      loudness += weights[i] * feature_vector[i];
+    }
+    loudness_dbfs.push_back(loudness);
+  }
+
+  const auto regressor =
+      FitLoudnessRegressor(features, loudness_dbfs, /*ridge=*/1e-6f);
+  ASSERT_TRUE(regressor.has_value());
+  ASSERT_EQ(regressor->weights.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    EXPECT_NEAR(regressor->weights[i], weights[i], 1e-3f);
+  }
+  EXPECT_NEAR(regressor->bias, kBias, 1e-3f);
+}
+
+TEST(FitLoudnessRegressorTest, FailsWithInconsistentSizes) {
+  EXPECT_FALSE(FitLoudnessRegressor({}, {}).has_value());
+  EXPECT_FALSE(FitLoudnessRegressor({{1.f, 2.f}}, {0.f, 1.f}).has_value());
+  EXPECT_FALSE(
+      FitLoudnessRegressor({{1.f, 2.f}, {1.f}}, {0.f, 1.f}).has_value());
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,498 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/packet_archive.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr char kMagic[4] = {'L', 'Y', 'R', 'Z'};
+constexpr uint8_t kVersion = 1;
+constexpr int kHeaderSize = 16;
+constexpr int kBlockHeaderSize = 8;
+constexpr int kMaxPacketSize = 255;
+
+// Every 4 bit group of a packet is coded as one index.
+constexpr int kBitsPerIndex = 4;
+constexpr int kNumIndexValues = 1 << kBitsPerIndex;
+constexpr int kCdfSize = kNumIndexValues + 1;
+
+// Probabilities are in units of 2^-|kProbabilityBits|, and the rANS state is
+// renormalized a byte at a time to stay in [kRansLowerBound, 2^32).
+constexpr int kProbabilityBits = 15;
+constexpr int kProbabilityScale = 1 << kProbabilityBits;
+constexpr uint32_t kRansLowerBound = 1u << 23;
+// Every coded index moves the model 1/64 of the way towards it, which is
+// slow enough to cost little on indices that are close to uniform.
+constexpr int kAdaptationShift = 6;
+
+int NumIndices(int packet_size) {
+  return packet_size * CHAR_BIT / kBitsPerIndex;
+}
+
+// One uniform cumulative distribution per stage and previous index.
+std::vector<uint16_t> InitialCdfs(int packet_size) {
+  std::vector<uint16_t> cdfs(NumIndices(packet_size) * kNumIndexValues *
+                             kCdfSize);
+  for (int context = 0; context < cdfs.size() / kCdfSize; ++context) {
+    for (int i = 0; i < kCdfSize; ++i) {
+      cdfs[context * kCdfSize + i] = i * kProbabilityScale / kNumIndexValues;
+    }
+  }
+  return cdfs;
+}
+
+uint16_t* Cdf(int index_position, uint8_t previous_index,
+              std::vector<uint16_t>* cdfs) {
+  return cdfs->data() +
+         (index_position * kNumIndexValues + previous_index) * kCdfSize;
+}
+
+// Moves |cdf| towards a distribution in which all but one unit of
+// probability per value falls on |index|. Every value keeps a probability of
+// at least one unit, since |cdf[i]| - i stays non-decreasing in i.
+void Adapt(int index, uint16_t* cdf) {
+  for (int i = 1; i < kNumIndexValues; ++i) {
+    const int target =
+        (i > index ? kProbabilityScale - kNumIndexValues : 0) + i;
+    cdf[i] += (target - cdf[i]) >> kAdaptationShift;
+  }
+}
+
+uint8_t GetIndex(const uint8_t* packet, int index_position) {
+  const uint8_t byte = packet[index_position / 2];
+  return index_position % 2 == 0 ? byte >> kBitsPerIndex : byte & 0x0F;
+}
+
+void SetIndex(int index_position, uint8_t index, uint8_t* packet) {
+  uint8_t& byte = packet[index_position / 2];
+  byte = index_position % 2 == 0 ? (index << kBitsPerIndex) | (byte & 0x0F)
+                                 : (byte & 0xF0) | index;
+}
+
+void AppendLittleEndian(uint64_t value, int num_bytes,
+                        std::vector<uint8_t>* bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    bytes->push_back((value >> (8 * i)) & 0xFF);
+  }
+}
+
+uint64_t LoadLittleEndian(const uint8_t* bytes, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+bool IsPacketSizeSupported(int packet_size) {
+  if (packet_size <= 0 || packet_size > kMaxPacketSize) {
+    LOG(ERROR) << "Packets of " << packet_size
+               << " bytes can not be archived.";
+    return false;
+  }
+  return true;
+}
+
+std::vector<uint8_t> ArchiveHeader(int packet_size, int64_t num_packets) {
+  std::vector<uint8_t> header(kMagic, kMagic + sizeof(kMagic));
+  header.push_back(kVersion);
+  header.push_back(packet_size);
+  header.push_back(0);
+  header.push_back(0);
+  AppendLittleEndian(num_packets, 8, &header);
+  return header;
+}
+
+// Returns the packet size and number of packets of the archive with
+// |header|.
+std::optional<std::pair<int, int64_t>> ParseArchiveHeader(
+    const uint8_t* header) {
+  if (std::memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+      header[4] != kVersion || header[5] == 0) {
+    LOG(ERROR) << "Not a packet archive.";
+    return std::nullopt;
+  }
+  const int64_t num_packets = LoadLittleEndian(header + 8, 8);
+  if (num_packets < 0) {
+    LOG(ERROR) << "Archive header is corrupt.";
+    return std::nullopt;
+  }
+  return std::make_pair(static_cast<int>(header[5]), num_packets);
+}
+
+// Appends the block header and the rANS bytes of |packets| to |archive|.
+// rANS codes in reverse order, so the probabilities are gathered from the
+// adapting models in a first pass.
+void AppendBlock(absl::Span<const uint8_t> packets, int packet_size,
+                 std::vector<uint16_t>* cdfs,
+                 std::vector<uint8_t>* previous_indices,
+                 std::vector<uint8_t>* archive) {
+  const int num_indices = NumIndices(packet_size);
+  const int num_packets = packets.size() / packet_size;
+  // The start of each index in the cumulative distribution in the upper and
+  // its probability in the lower 16 bits.
+  std::vector<uint32_t> symbols;
+  symbols.reserve(num_packets * num_indices);
+  for (int p = 0; p < num_packets; ++p) {
+    const uint8_t* packet = packets.data() + p * packet_size;
+    for (int k = 0; k < num_indices; ++k) {
+      const uint8_t index = GetIndex(packet, k);
+      uint16_t* cdf = Cdf(k, (*previous_indices)[k], cdfs);
+      symbols.push_back(static_cast<uint32_t>(cdf[index]) << 16 |
+                        (cdf[index + 1] - cdf[index]));
+      Adapt(index, cdf);
+      (*previous_indices)[k] = index;
+    }
+  }
+
+  std::vector<uint8_t> coded;
+  uint32_t state = kRansLowerBound;
+  for (auto it = symbols.rbegin(); it != symbols.rend(); ++it) {
+    const uint32_t start = *it >> 16;
+    const uint32_t frequency = *it & 0xFFFF;
+    const uint32_t max_state =
+        ((kRansLowerBound >> kProbabilityBits) << CHAR_BIT) * frequency;
+    while (state >= max_state) {
+      coded.push_back(state & 0xFF);
+      state >>= CHAR_BIT;
+    }
+    state = ((state / frequency) << kProbabilityBits) + state % frequency +
+            start;
+  }
+  for (int shift = 24; shift >= 0; shift -= CHAR_BIT) {
+    coded.push_back((state >> shift) & 0xFF);
+  }
+  std::reverse(coded.begin(), coded.end());
+
+  AppendLittleEndian(num_packets, 4, archive);
+  AppendLittleEndian(coded.size(), 4, archive);
+  archive->insert(archive->end(), coded.begin(), coded.end());
+}
+
+// Restores |num_packets| packets from the rANS bytes |coded| of a block into
+// |packets|. Returns false if |coded| is corrupt.
+bool RestoreBlock(absl::Span<const uint8_t> coded, int num_packets,
+                  int packet_size, std::vector<uint16_t>* cdfs,
+                  std::vector<uint8_t>* previous_indices, uint8_t* packets) {
+  if (coded.size() < 4) {
+    LOG(ERROR) << "Archive block is truncated.";
+    return false;
+  }
+  const int num_indices = NumIndices(packet_size);
+  uint32_t state = LoadLittleEndian(coded.data(), 4);
+  int position = 4;
+  for (int p = 0; p < num_packets; ++p) {
+    uint8_t* packet = packets + p * packet_size;
+    for (int k = 0; k < num_indices; ++k) {
+      uint16_t* cdf = Cdf(k, (*previous_indices)[k], cdfs);
+      const uint32_t slot = state & (kProbabilityScale - 1);
+      uint8_t index = 0;
+      while (cdf[index + 1] <= slot) {
+        ++index;
+      }
+      state = (cdf[index + 1] - cdf[index]) * (state >> kProbabilityBits) +
+              slot - cdf[index];
+      while (state < kRansLowerBound) {
+        if (position == coded.size()) {
+          LOG(ERROR) << "Archive block is truncated.";
+          return false;
+        }
+        state = (state << CHAR_BIT) | coded[position++];
+      }
+      SetIndex(k, index, packet);
+      Adapt(index, cdf);
+      (*previous_indices)[k] = index;
+    }
+  }
+  // The encoder started from |kRansLowerBound|, so anything else means the
+  // block was altered.
+  if (position != coded.size() || state != kRansLowerBound) {
+    LOG(ERROR) << "Archive block is corrupt.";
+    return false;
+  }
+  return true;
+}
+
+// Returns the number of packets and bytes of the block with |header|, which
+// has to hold at most |max_num_packets| packets.
+std::optional<std::pair<int, int>> ParseBlockHeader(const uint8_t* header,
+                                                    int64_t max_num_packets,
+                                                    int packet_size) {
+  const int64_t num_packets = LoadLittleEndian(header, 4);
+  const int64_t num_bytes = LoadLittleEndian(header + 4, 4);
+  // No index costs more than 16 bits, since every probability is at least
+  // 2^-15.
+  if (num_packets <= 0 || num_packets > kPacketsPerArchiveBlock ||
+      num_packets > max_num_packets ||
+      num_bytes > 2 * num_packets * NumIndices(packet_size) + 4) {
+    LOG(ERROR) << "Archive block header is corrupt.";
+    return std::nullopt;
+  }
+  return std::make_pair(static_cast<int>(num_packets),
+                        static_cast<int>(num_bytes));
+}
+
+bool ReadBytes(std::ifstream& stream, uint8_t* bytes, int num_bytes) {
+  stream.read(reinterpret_cast<char*>(bytes), num_bytes);
+  return stream.gcount() == num_bytes;
+}
+
+}  // namespace
+
+bool IsPacketArchive(const ghc::filesystem::path& path) {
+  std::ifstream stream(path.string(), std::ios_base::binary);
+  uint8_t magic[sizeof(kMagic)];
+  return stream.is_open() && ReadBytes(stream, magic, sizeof(magic)) &&
+         std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+std::optional<std::vector<uint8_t>> ArchivePackets(
+    absl::Span<const uint8_t> packets, int packet_size) {
+  if (!IsPacketSizeSupported(packet_size)) {
+    return std::nullopt;
+  }
+  if (packets.size() % packet_size != 0) {
+    LOG(ERROR) << "Packets are not all " << packet_size << " bytes long.";
+    return std::nullopt;
+  }
+  const int64_t num_packets = packets.size() / packet_size;
+  std::vector<uint8_t> archive = ArchiveHeader(packet_size, num_packets);
+  std::vector<uint16_t> cdfs = InitialCdfs(packet_size);
+  std::vector<uint8_t> previous_indices(NumIndices(packet_size), 0);
+  const int block_size = kPacketsPerArchiveBlock * packet_size;
+  for (int64_t begin = 0; begin < packets.size(); begin += block_size) {
+    AppendBlock(packets.subspan(begin, block_size), packet_size, &cdfs,
+                &previous_indices, &archive);
+  }
+  return archive;
+}
+
+std::optional<std::vector<uint8_t>> RestorePackets(
+    absl::Span<const uint8_t> archive) {
+  if (archive.size() < kHeaderSize) {
+    LOG(ERROR) << "Archive is truncated.";
+    return std::nullopt;
+  }
+  const auto header = ParseArchiveHeader(archive.data());
+  if (!header.has_value()) {
+    return std::nullopt;
+  }
+  const auto [packet_size, num_packets] = header.value();
+  std::vector<uint16_t> cdfs = InitialCdfs(packet_size);
+  std::vector<uint8_t> previous_indices(NumIndices(packet_size), 0);
+  std::vector<uint8_t> packets;
+  int64_t position = kHeaderSize;
+  for (int64_t num_restored = 0; num_restored < num_packets;) {
+    if (archive.size() - position < kBlockHeaderSize) {
+      LOG(ERROR) << "Archive is truncated.";
+      return std::nullopt;
+    }
+    const auto block = ParseBlockHeader(
+        archive.data() + position, num_packets - num_restored, packet_size);
+    if (!block.has_value()) {
+      return std::nullopt;
+    }
+    const auto [num_block_packets, num_block_bytes] = block.value();
+    position += kBlockHeaderSize;
+    if (archive.size() - position < num_block_bytes) {
+      LOG(ERROR) << "Archive is truncated.";
+      return std::nullopt;
+    }
+    packets.resize(packets.size() + num_block_packets * packet_size);
+    if (!RestoreBlock(archive.subspan(position, num_block_bytes),
+                      num_block_packets, packet_size, &cdfs,
+                      &previous_indices,
+                      packets.data() + num_restored * packet_size)) {
+      return std::nullopt;
+    }
+    position += num_block_bytes;
+    num_restored += num_block_packets;
+  }
+  if (position != archive.size()) {
+    LOG(ERROR) << "Archive has " << archive.size() - position
+               << " bytes after the last block.";
+    return std::nullopt;
+  }
+  return packets;
+}
+
+std::unique_ptr<PacketArchiveWriter> PacketArchiveWriter::Create(
+    const ghc::filesystem::path& path, int packet_size) {
+  if (!IsPacketSizeSupported(packet_size)) {
+    return nullptr;
+  }
+  std::ofstream stream(path.string(),
+                       std::ios_base::binary | std::ios_base::trunc);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Could not open output file " << path;
+    return nullptr;
+  }
+  // The number of packets is filled in by |Close|.
+  const std::vector<uint8_t> header = ArchiveHeader(packet_size, 0);
+  stream.write(reinterpret_cast<const char*>(header.data()), header.size());
+  if (!stream.good()) {
+    LOG(ERROR) << "Could not write archive header.";
+    return nullptr;
+  }
+  return absl::WrapUnique(
+      new PacketArchiveWriter(std::move(stream), packet_size));
+}
+
+PacketArchiveWriter::PacketArchiveWriter(std::ofstream stream,
+                                         int packet_size)
+    : stream_(std::move(stream)),
+      packet_size_(packet_size),
+      num_packets_(0),
+      cdfs_(InitialCdfs(packet_size)),
+      previous_indices_(NumIndices(packet_size), 0) {
+  block_.reserve(kPacketsPerArchiveBlock * packet_size);
+}
+
+PacketArchiveWriter::~PacketArchiveWriter() {
+  if (stream_.is_open()) {
+    Close();
+  }
+}
+
+bool PacketArchiveWriter::Write(absl::Span<const uint8_t> packet) {
+  if (packet.size() != packet_size_) {
+    LOG(ERROR) << "Packet of unexpected length: " << packet.size();
+    return false;
+  }
+  block_.insert(block_.end(), packet.begin(), packet.end());
+  ++num_packets_;
+  if (block_.size() == kPacketsPerArchiveBlock * packet_size_) {
+    return WriteBlock();
+  }
+  return true;
+}
+
+bool PacketArchiveWriter::Close() {
+  if (!stream_.is_open()) {
+    LOG(ERROR) << "Archive is already closed.";
+    return false;
+  }
+  bool success = block_.empty() || WriteBlock();
+  std::vector<uint8_t> num_packets;
+  AppendLittleEndian(num_packets_, 8, &num_packets);
+  stream_.seekp(8);
+  stream_.write(reinterpret_cast<const char*>(num_packets.data()),
+                num_packets.size());
+  stream_.close();
+  if (!success || stream_.fail()) {
+    LOG(ERROR) << "Could not complete archive.";
+    return false;
+  }
+  return true;
+}
+
+bool PacketArchiveWriter::WriteBlock() {
+  std::vector<uint8_t> coded;
+  AppendBlock(block_, packet_size_, &cdfs_, &previous_indices_, &coded);
+  block_.clear();
+  stream_.write(reinterpret_cast<const char*>(coded.data()), coded.size());
+  if (!stream_.good()) {
+    LOG(ERROR) << "Could not write archive block.";
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<PacketArchiveReader> PacketArchiveReader::Create(
+    const ghc::filesystem::path& path) {
+  std::ifstream stream(path.string(), std::ios_base::binary);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Open on file " << path << " failed.";
+    return nullptr;
+  }
+  uint8_t header[kHeaderSize];
+  if (!ReadBytes(stream, header, kHeaderSize)) {
+    LOG(ERROR) << path << " is not a packet archive.";
+    return nullptr;
+  }
+  const auto parsed_header = ParseArchiveHeader(header);
+  if (!parsed_header.has_value()) {
+    return nullptr;
+  }
+  return absl::WrapUnique(new PacketArchiveReader(
+      std::move(stream), parsed_header->first, parsed_header->second));
+}
+
+PacketArchiveReader::PacketArchiveReader(std::ifstream stream,
+                                         int packet_size, int64_t num_packets)
+    : stream_(std::move(stream)),
+      packet_size_(packet_size),
+      num_packets_(num_packets),
+      num_packets_read_(0),
+      cdfs_(InitialCdfs(packet_size)),
+      previous_indices_(NumIndices(packet_size), 0),
+      block_offset_(0) {}
+
+std::optional<absl::Span<const uint8_t>> PacketArchiveReader::Read() {
+  if (num_packets_read_ == num_packets_) {
+    return absl::Span<const uint8_t>();
+  }
+  if (block_offset_ == block_.size() && !ReadBlock()) {
+    LOG(ERROR) << "Could not read packet " << num_packets_read_ << ".";
+    return std::nullopt;
+  }
+  const absl::Span<const uint8_t> packet =
+      absl::MakeConstSpan(block_).subspan(block_offset_, packet_size_);
+  block_offset_ += packet_size_;
+  ++num_packets_read_;
+  return packet;
+}
+
+bool PacketArchiveReader::ReadBlock() {
+  uint8_t header[kBlockHeaderSize];
+  if (!ReadBytes(stream_, header, kBlockHeaderSize)) {
+    LOG(ERROR) << "Archive is truncated.";
+    return false;
+  }
+  const auto block = ParseBlockHeader(
+      header, num_packets_ - num_packets_read_, packet_size_);
+  if (!block.has_value()) {
+    return false;
+  }
+  const auto [num_block_packets, num_block_bytes] = block.value();
+  coded_block_.resize(num_block_bytes);
+  if (!ReadBytes(stream_, coded_block_.data(), num_block_bytes)) {
+    LOG(ERROR) << "Archive is truncated.";
+    return false;
+  }
+  block_.resize(num_block_packets * packet_size_);
+  block_offset_ = 0;
+  return RestoreBlock(coded_block_, num_block_packets, packet_size_, &cdfs_,
+                      &previous_indices_, block_.data());
+}
+
+}  // namespace codec
+}  // namespace chromemedia
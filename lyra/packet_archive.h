@@ -0,0 +1,139 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_PACKET_ARCHIVE_H_
+#define LYRA_PACKET_ARCHIVE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+// Lossless archival coding of a stream of packets of equal size.
+//
+// Packets carry the codebook indices of the residual vector quantizer stages
+// at fixed length, most significant bits first. Indices are far from
+// uniformly distributed, and an index tends to repeat the index of the same
+// stage in the previous frame. The archive codes every 4 bit group of a
+// packet, which is one stage index for the 16 entry codebooks of the
+// quantizer, with an adaptive rANS coder whose context is the stage and the
+// index the stage had in the previous frame. Restoring returns the original
+// packets bit for bit, so decoded audio does not change.
+//
+// All integers are little endian. The file consists of
+//  - a 16 byte header: "LYRZ", the format version, the packet size, 2 zero
+//    bytes and the 64 bit number of packets,
+//  - blocks of up to |kPacketsPerArchiveBlock| packets, each with the 32 bit
+//    numbers of packets and bytes in the block followed by the rANS bytes.
+//    Blocks are coded independently of each other but the context models
+//    carry over, so that blocks bound memory without resetting adaptation.
+
+inline constexpr int kPacketsPerArchiveBlock = 1024;
+
+// Returns true if the file at |path| starts with an archive header.
+bool IsPacketArchive(const ghc::filesystem::path& path);
+
+// Returns the archive of |packets|, which are concatenated packets of
+// |packet_size| bytes, or a nullopt if the size of |packets| is not a
+// multiple of |packet_size| or |packet_size| is not in [1, 255].
+std::optional<std::vector<uint8_t>> ArchivePackets(
+    absl::Span<const uint8_t> packets, int packet_size);
+
+// Returns the concatenated packets of |archive|, or a nullopt if it is not a
+// valid archive.
+std::optional<std::vector<uint8_t>> RestorePackets(
+    absl::Span<const uint8_t> archive);
+
+// Writes an archive a block at a time, so that memory does not grow with the
+// length of the stream.
+class PacketArchiveWriter {
+ public:
+  // Returns a nullptr if the file can not be created or |packet_size| is not
+  // in [1, 255].
+  static std::unique_ptr<PacketArchiveWriter> Create(
+      const ghc::filesystem::path& path, int packet_size);
+
+  // Closes the file if |Close| has not been called, ignoring errors.
+  ~PacketArchiveWriter();
+
+  // Returns false on failure or if |packet| is not |packet_size| bytes long.
+  bool Write(absl::Span<const uint8_t> packet);
+
+  // Writes the last block, completes the header and closes the file.
+  // Returns false on failure.
+  bool Close();
+
+ private:
+  PacketArchiveWriter(std::ofstream stream, int packet_size);
+
+  bool WriteBlock();
+
+  std::ofstream stream_;
+  const int packet_size_;
+  int64_t num_packets_;
+  // Cumulative frequencies of every context, adapted as packets are coded.
+  std::vector<uint16_t> cdfs_;
+  // Indices of the last packet coded, which select the contexts of the next.
+  std::vector<uint8_t> previous_indices_;
+  // Packets of the current block, which are coded once it is complete.
+  std::vector<uint8_t> block_;
+};
+
+// Reads an archive a block at a time, with the interface of
+// |PacketFileReader|.
+class PacketArchiveReader {
+ public:
+  // Returns a nullptr if the file can not be opened or does not start with a
+  // valid archive header.
+  static std::unique_ptr<PacketArchiveReader> Create(
+      const ghc::filesystem::path& path);
+
+  // Returns the next packet, which stays valid until the next call, or an
+  // empty span after the last packet. Returns a nullopt on failure.
+  std::optional<absl::Span<const uint8_t>> Read();
+
+  int packet_size() const { return packet_size_; }
+  int64_t num_packets() const { return num_packets_; }
+
+ private:
+  PacketArchiveReader(std::ifstream stream, int packet_size,
+                      int64_t num_packets);
+
+  bool ReadBlock();
+
+  std::ifstream stream_;
+  const int packet_size_;
+  const int64_t num_packets_;
+  int64_t num_packets_read_;
+  std::vector<uint16_t> cdfs_;
+  std::vector<uint8_t> previous_indices_;
+  // Restored packets of the current block and the position of the next one.
+  std::vector<uint8_t> block_;
+  int block_offset_;
+  std::vector<uint8_t> coded_block_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_PACKET_ARCHIVE_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/packet_archive.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kPacketSize = 23;
+constexpr int kNumPackets = 2 * kPacketsPerArchiveBlock + 100;
+
+std::vector<uint8_t> UniformPackets() {
+  std::mt19937 generator(1);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  std::vector<uint8_t> packets(kNumPackets * kPacketSize);
+  for (uint8_t& byte : packets) {
+    byte = distribution(generator);
+  }
+  return packets;
+}
+
+// Indices that favor small values and often repeat the previous frame, like
+// those of the quantizer.
+std::vector<uint8_t> SkewedPackets() {
+  std::mt19937 generator(2);
+  std::geometric_distribution<int> index_distribution(0.3);
+  std::bernoulli_distribution repeat_distribution(0.5);
+  std::vector<uint8_t> packets(kNumPackets * kPacketSize);
+  for (int i = 0; i < packets.size(); ++i) {
+    if (i >= kPacketSize && repeat_distribution(generator)) {
+      packets[i] = packets[i - kPacketSize];
+      continue;
+    }
+    const int high = std::min(index_distribution(generator), 15);
+    const int low = std::min(index_distribution(generator), 15);
+    packets[i] = high << 4 | low;
+  }
+  return packets;
+}
+
+std::vector<uint8_t> ReadFile(const ghc::filesystem::path& path) {
+  std::ifstream stream(path.string(), std::ios_base::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), {});
+}
+
+TEST(PacketArchiveTest, RestoresUniformPackets) {
+  const std::vector<uint8_t> packets = UniformPackets();
+  const auto archive = ArchivePackets(packets, kPacketSize);
+  ASSERT_TRUE(archive.has_value());
+  const auto restored = RestorePackets(archive.value());
+  ASSERT_TRUE(restored.has_value());
+  EXPECT_EQ(restored.value(), packets);
+  // Incompressible packets cost little more than their size.
+  EXPECT_LT(archive->size(), packets.size() * 1.03);
+}
+
+TEST(PacketArchiveTest, CompressesSkewedPackets) {
+  const std::vector<uint8_t> packets = SkewedPackets();
+  const auto archive = ArchivePackets(packets, kPacketSize);
+  ASSERT_TRUE(archive.has_value());
+  const auto restored = RestorePackets(archive.value());
+  ASSERT_TRUE(restored.has_value());
+  EXPECT_EQ(restored.value(), packets);
+  EXPECT_LT(archive->size(), packets.size() * 0.7);
+}
+
+TEST(PacketArchiveTest, RestoresEmptyArchive) {
+  const auto archive = ArchivePackets({}, kPacketSize);
+  ASSERT_TRUE(archive.has_value());
+  const auto restored = RestorePackets(archive.value());
+  ASSERT_TRUE(restored.has_value());
+  EXPECT_TRUE(restored->empty());
+}
+
+TEST(PacketArchiveTest, RejectsInvalidInput) {
+  EXPECT_FALSE(ArchivePackets(std::vector<uint8_t>(kPacketSize), 0));
+  EXPECT_FALSE(ArchivePackets(std::vector<uint8_t>(256), 256));
+  EXPECT_FALSE(ArchivePackets(std::vector<uint8_t>(kPacketSize + 1),
+                              kPacketSize));
+
+  const std::vector<uint8_t> archive =
+      ArchivePackets(SkewedPackets(), kPacketSize).value();
+  EXPECT_FALSE(RestorePackets(
+      absl::MakeConstSpan(archive).subspan(0, archive.size() - 1)));
+  std::vector<uint8_t> extended = archive;
+  extended.push_back(0);
+  EXPECT_FALSE(RestorePackets(extended));
+  std::vector<uint8_t> corrupt = archive;
+  corrupt[archive.size() / 2] ^= 0x10;
+  EXPECT_FALSE(RestorePackets(corrupt));
+  std::vector<uint8_t> wrong_magic = archive;
+  wrong_magic[0] = 'X';
+  EXPECT_FALSE(RestorePackets(wrong_magic));
+}
+
+class PacketArchiveFileTest : public testing::Test {
+ protected:
+  PacketArchiveFileTest()
+      : path_(ghc::filesystem::path(testing::TempDir()) / "packets.lyrz") {}
+
+  const ghc::filesystem::path path_;
+};
+
+TEST_F(PacketArchiveFileTest, StreamsSameBytesAsInMemory) {
+  const std::vector<uint8_t> packets = SkewedPackets();
+  auto writer = PacketArchiveWriter::Create(path_, kPacketSize);
+  ASSERT_NE(writer, nullptr);
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_TRUE(writer->Write(
+        absl::MakeConstSpan(packets).subspan(i * kPacketSize, kPacketSize)));
+  }
+  ASSERT_TRUE(writer->Close());
+  EXPECT_TRUE(IsPacketArchive(path_));
+  EXPECT_EQ(ReadFile(path_), ArchivePackets(packets, kPacketSize).value());
+
+  auto reader = PacketArchiveReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->packet_size(), kPacketSize);
+  EXPECT_EQ(reader->num_packets(), kNumPackets);
+  std::vector<uint8_t> restored;
+  while (true) {
+    const auto packet = reader->Read();
+    ASSERT_TRUE(packet.has_value());
+    if (packet->empty()) {
+      break;
+    }
+    restored.insert(restored.end(), packet->begin(), packet->end());
+  }
+  EXPECT_EQ(restored, packets);
+}
+
+TEST_F(PacketArchiveFileTest, FailsOnInvalidFiles) {
+  EXPECT_EQ(PacketArchiveWriter::Create(path_, 0), nullptr);
+  EXPECT_EQ(PacketArchiveWriter::Create("/invalid/path/test.lyrz",
+                                        kPacketSize),
+            nullptr);
+  EXPECT_EQ(PacketArchiveReader::Create("should/not/exist.lyrz"), nullptr);
+
+  auto writer = PacketArchiveWriter::Create(path_, kPacketSize);
+  ASSERT_NE(writer, nullptr);
+  EXPECT_FALSE(writer->Write(std::vector<uint8_t>(kPacketSize - 1)));
+  ASSERT_TRUE(writer->Write(std::vector<uint8_t>(kPacketSize)));
+  ASSERT_TRUE(writer->Close());
+
+  // Cut off within the only block.
+  ghc::filesystem::resize_file(path_, ghc::filesystem::file_size(path_) - 1);
+  auto reader = PacketArchiveReader::Create(path_);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_FALSE(reader->Read().has_value());
+
+  std::ofstream(path_.string(), std::ios_base::binary) << "raw packets";
+  EXPECT_FALSE(IsPacketArchive(path_));
+  EXPECT_EQ(PacketArchiveReader::Create(path_), nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
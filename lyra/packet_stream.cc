@@ -0,0 +1,108 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/packet_stream.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+std::unique_ptr<PacketFileReader> PacketFileReader::Create(
+    const ghc::filesystem::path& path, int packet_size) {
+  if (packet_size <= 0) {
+    LOG(ERROR) << "Packet size has to be positive.";
+    return nullptr;
+  }
+  std::ifstream stream(path.string(),
+                       std::ios_base::binary | std::ios_base::ate);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Open on file " << path << " failed.";
+    return nullptr;
+  }
+  const int64_t file_size = stream.tellg();
+  stream.seekg(0);
+  if (file_size < 0 || !stream.good()) {
+    LOG(ERROR) << "Could not determine the size of file " << path << ".";
+    return nullptr;
+  }
+  return absl::WrapUnique(new PacketFileReader(std::move(stream), packet_size,
+                                               file_size / packet_size,
+                                               file_size % packet_size));
+}
+
+PacketFileReader::PacketFileReader(std::ifstream stream, int packet_size,
+                                   int64_t num_packets, int num_trailing_bytes)
+    : stream_(std::move(stream)),
+      packet_(packet_size),
+      num_packets_(num_packets),
+      num_trailing_bytes_(num_trailing_bytes),
+      num_packets_read_(0) {}
+
+std::optional<absl::Span<const uint8_t>> PacketFileReader::Read() {
+  if (num_packets_read_ == num_packets_) {
+    return absl::Span<const uint8_t>();
+  }
+  stream_.read(reinterpret_cast<char*>(packet_.data()), packet_.size());
+  if (stream_.gcount() != packet_.size()) {
+    LOG(ERROR) << "Could not read packet " << num_packets_read_ << ".";
+    return std::nullopt;
+  }
+  ++num_packets_read_;
+  return absl::MakeConstSpan(packet_);
+}
+
+std::unique_ptr<PacketFileWriter> PacketFileWriter::Create(
+    const ghc::filesystem::path& path) {
+  std::ofstream stream(path.string(),
+                       std::ios_base::binary | std::ios_base::trunc);
+  if (!stream.is_open()) {
+    LOG(ERROR) << "Could not open output file " << path;
+    return nullptr;
+  }
+  return absl::WrapUnique(new PacketFileWriter(std::move(stream)));
+}
+
+PacketFileWriter::PacketFileWriter(std::ofstream stream)
+    : stream_(std::move(stream)) {}
+
+bool PacketFileWriter::Write(absl::Span<const uint8_t> packet) {
+  stream_.write(reinterpret_cast<const char*>(packet.data()), packet.size());
+  if (!stream_.good()) {
+    LOG(ERROR) << "Could not write packet.";
+    return false;
+  }
+  return true;
+}
+
+bool PacketFileWriter::Close() {
+  stream_.close();
+  if (stream_.fail()) {
+    LOG(ERROR) << "Could not close output file.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
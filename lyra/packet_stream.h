@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_PACKET_STREAM_H_
+#define LYRA_PACKET_STREAM_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+// Reads a file of concatenated packets of equal size one packet at a time,
+// so that memory does not grow with the length of the file.
+class PacketFileReader {
+ public:
+  // Returns a nullptr if the file can not be opened or |packet_size| is not
+  // positive.
+  static std::unique_ptr<PacketFileReader> Create(
+      const ghc::filesystem::path& path, int packet_size);
+
+  // Returns the next packet, which stays valid until the next call, or an
+  // empty span after the last complete packet. Returns a nullopt on failure.
+  std::optional<absl::Span<const uint8_t>> Read();
+
+  // Number of complete packets in the file.
+  int64_t num_packets() const { return num_packets_; }
+
+  // Number of bytes after the last complete packet, which are never read.
+  int num_trailing_bytes() const { return num_trailing_bytes_; }
+
+ private:
+  PacketFileReader(std::ifstream stream, int packet_size, int64_t num_packets,
+                   int num_trailing_bytes);
+
+  std::ifstream stream_;
+  std::vector<uint8_t> packet_;
+  const int64_t num_packets_;
+  const int num_trailing_bytes_;
+  int64_t num_packets_read_;
+};
+
+// Appends packets to a file as they are produced.
+class PacketFileWriter {
+ public:
+  // Returns a nullptr if the file can not be created.
+  static std::unique_ptr<PacketFileWriter> Create(
+      const ghc::filesystem::path& path);
+
+  // Returns false on failure.
+  bool Write(absl::Span<const uint8_t> packet);
+
+  // Flushes and closes the file. Returns false on failure.
+  bool Close();
+
+ private:
+  explicit PacketFileWriter(std::ofstream stream);
+
+  std::ofstream stream_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_PACKET_STREAM_H_
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/packet_stream.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kPacketSize = 3;
+
+class PacketStreamTest : public testing::Test {
+ protected:
+  PacketStreamTest()
+      : path_(ghc::filesystem::path(testing::TempDir()) / "packets.lyra") {}
+
+  void WriteBytes(const std::vector<std::vector<uint8_t>>& chunks) {
+    auto writer = PacketFileWriter::Create(path_);
+    ASSERT_NE(writer, nullptr);
+    for (const auto& chunk : chunks) {
+      ASSERT_TRUE(writer->Write(chunk));
+    }
+    ASSERT_TRUE(writer->Close());
+  }
+
+  const ghc::filesystem::path path_;
+};
+
+TEST_F(PacketStreamTest, ReadsWrittenPackets) {
+  const std::vector<std::vector<uint8_t>> packets = {{1, 2, 3}, {4, 5, 6}};
+  WriteBytes(packets);
+
+  auto reader = PacketFileReader::Create(path_, kPacketSize);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->num_packets(), 2);
+  EXPECT_EQ(reader->num_trailing_bytes(), 0);
+  for (const auto& expected : packets) {
+    const auto packet = reader->Read();
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_EQ(std::vector<uint8_t>(packet->begin(), packet->end()), expected);
+  }
+  const auto end = reader->Read();
+  ASSERT_TRUE(end.has_value());
+  EXPECT_TRUE(end->empty());
+}
+
+TEST_F(PacketStreamTest, IgnoresTrailingBytes) {
+  WriteBytes({{1, 2, 3, 4, 5}});
+
+  auto reader = PacketFileReader::Create(path_, kPacketSize);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(reader->num_packets(), 1);
+  EXPECT_EQ(reader->num_trailing_bytes(), 2);
+  ASSERT_EQ(reader->Read()->size(), kPacketSize);
+  EXPECT_TRUE(reader->Read()->empty());
+}
+
+TEST_F(PacketStreamTest, CreateFails) {
+  EXPECT_EQ(PacketFileReader::Create("should/not/exist.lyra", kPacketSize),
+            nullptr);
+  WriteBytes({});
+  EXPECT_EQ(PacketFileReader::Create(path_, /*packet_size=*/0), nullptr);
+  EXPECT_EQ(PacketFileWriter::Create("/invalid/path/test.lyra"), nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
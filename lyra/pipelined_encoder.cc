@@ -0,0 +1,260 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/pipelined_encoder.h"
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/feature_extractor_interface.h"
+#include "lyra/lyra_components.h"
+#include "lyra/lyra_config.h"
+#include "lyra/noise_estimator.h"
+#include "lyra/noise_estimator_interface.h"
+#include "lyra/packet.h"
+#include "lyra/resampler.h"
+#include "lyra/resampler_interface.h"
+#include "lyra/spsc_queue.h"
+#include "lyra/vector_quantizer_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Enough hops in flight per quantizer thread to absorb jitter between the
+// stages, while keeping memory independent of the length of the recording.
+constexpr int kQueueCapacity = 16;
+
+}  // namespace
+
+std::unique_ptr<PipelinedEncoder> PipelinedEncoder::Create(
+    int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+    const ghc::filesystem::path& model_path, int num_quantizer_threads) {
+  absl::Status are_params_supported =
+      AreParamsSupported(sample_rate_hz, num_channels, model_path);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  if (num_quantizer_threads < 1) {
+    LOG(ERROR) << "The number of quantizer threads has to be positive.";
+    return nullptr;
+  }
+  const int num_quantized_bits = BitrateToNumQuantizedBits(bitrate);
+  if (num_quantized_bits < 0) {
+    LOG(ERROR) << "Bitrate " << bitrate << " bps is not supported by codec.";
+    return nullptr;
+  }
+
+  std::unique_ptr<Resampler> resampler = nullptr;
+  if (kInternalSampleRateHz != sample_rate_hz) {
+    resampler = Resampler::Create(sample_rate_hz, kInternalSampleRateHz);
+    if (resampler == nullptr) {
+      LOG(ERROR) << "Could not create Resampler.";
+      return nullptr;
+    }
+  }
+
+  auto feature_extractor = CreateFeatureExtractor(model_path);
+  if (feature_extractor == nullptr) {
+    LOG(ERROR) << "Could not create Features Extractor.";
+    return nullptr;
+  }
+
+  std::vector<std::unique_ptr<VectorQuantizerInterface>> vector_quantizers;
+  for (int i = 0; i < num_quantizer_threads; ++i) {
+    vector_quantizers.push_back(CreateQuantizer(model_path));
+    if (vector_quantizers.back() == nullptr) {
+      LOG(ERROR) << "Could not create Vector Quantizer.";
+      return nullptr;
+    }
+  }
+
+  // Created exactly as in |LyraEncoder|, so that noise detection matches.
+  std::unique_ptr<NoiseEstimatorInterface> noise_estimator = nullptr;
+  if (enable_dtx) {
+    noise_estimator = NoiseEstimator::Create(
+        sample_rate_hz, InternalProfile::kNumSamplesPerHop,
+        InternalProfile::kNumSamplesPerWindow, kNumMelBins);
+    if (noise_estimator == nullptr) {
+      LOG(ERROR) << "Could not create Noise Estimator.";
+      return nullptr;
+    }
+  }
+
+  return absl::WrapUnique(new PipelinedEncoder(
+      std::move(resampler), std::move(feature_extractor),
+      std::move(noise_estimator), std::move(vector_quantizers), sample_rate_hz,
+      num_quantized_bits));
+}
+
+PipelinedEncoder::PipelinedEncoder(
+    std::unique_ptr<ResamplerInterface> resampler,
+    std::unique_ptr<FeatureExtractorInterface> feature_extractor,
+    std::unique_ptr<NoiseEstimatorInterface> noise_estimator,
+    std::vector<std::unique_ptr<VectorQuantizerInterface>> vector_quantizers,
+    int sample_rate_hz, int num_quantized_bits)
+    : resampler_(std::move(resampler)),
+      feature_extractor_(std::move(feature_extractor)),
+      noise_estimator_(std::move(noise_estimator)),
+      vector_quantizers_(std::move(vector_quantizers)),
+      sample_rate_hz_(sample_rate_hz),
+      num_samples_per_hop_(GetNumSamplesPerHop(sample_rate_hz)),
+      num_quantized_bits_(num_quantized_bits) {}
+
+std::optional<std::vector<uint8_t>> PipelinedEncoder::Encode(
+    absl::Span<const int16_t> audio) {
+  const auto packets = EncodePackets(audio);
+  if (!packets.has_value()) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> encoded;
+  for (const auto& packet : *packets) {
+    encoded.insert(encoded.end(), packet.begin(), packet.end());
+  }
+  return encoded;
+}
+
+std::optional<std::vector<std::vector<uint8_t>>>
+PipelinedEncoder::EncodePackets(absl::Span<const int16_t> audio) {
+  const int num_hops = audio.size() / num_samples_per_hop_;
+  const int num_quantizers = num_quantizer_threads();
+
+  // Hop n travels through queues n % |num_quantizers|, so every queue has a
+  // single producer and a single consumer and the order is kept.
+  std::vector<std::unique_ptr<SpscQueue<AnalyzedHop>>> analyzed_hops;
+  std::vector<std::unique_ptr<SpscQueue<std::optional<std::vector<uint8_t>>>>>
+      packets;
+  for (int i = 0; i < num_quantizers; ++i) {
+    analyzed_hops.push_back(
+        std::make_unique<SpscQueue<AnalyzedHop>>(kQueueCapacity));
+    packets.push_back(
+        std::make_unique<SpscQueue<std::optional<std::vector<uint8_t>>>>(
+            kQueueCapacity));
+  }
+
+  std::thread analysis_thread([&]() {
+    for (int n = 0; n < num_hops; ++n) {
+      AnalyzedHop hop;
+      AnalyzeHop(audio.subspan(n * num_samples_per_hop_, num_samples_per_hop_),
+                 &hop);
+      analyzed_hops[n % num_quantizers]->Push(std::move(hop));
+    }
+  });
+  std::vector<std::thread> quantizer_threads;
+  for (int i = 0; i < num_quantizers; ++i) {
+    quantizer_threads.emplace_back([&, i]() {
+      AnalyzedHop hop;
+      for (int n = i; n < num_hops; n += num_quantizers) {
+        analyzed_hops[i]->Pop(&hop);
+        packets[i]->Push(QuantizeHop(hop, *vector_quantizers_[i]));
+      }
+    });
+  }
+
+  // Every stage processes all hops even after a failure, so that no thread
+  // is left waiting on a queue.
+  std::vector<std::vector<uint8_t>> encoded;
+  encoded.reserve(num_hops);
+  bool success = true;
+  std::optional<std::vector<uint8_t>> packet;
+  for (int n = 0; n < num_hops; ++n) {
+    packets[n % num_quantizers]->Pop(&packet);
+    if (!packet.has_value()) {
+      if (success) {
+        LOG(ERROR) << "Unable to encode hop " << n << ".";
+      }
+      success = false;
+      continue;
+    }
+    encoded.push_back(std::move(packet.value()));
+  }
+  analysis_thread.join();
+  for (auto& thread : quantizer_threads) {
+    thread.join();
+  }
+  if (!success) {
+    return std::nullopt;
+  }
+  return encoded;
+}
+
+void PipelinedEncoder::AnalyzeHop(absl::Span<const int16_t> audio,
+                                  AnalyzedHop* hop) {
+  absl::Span<const int16_t> audio_for_encoding = audio;
+  std::vector<int16_t> processed;
+  if (kInternalSampleRateHz != sample_rate_hz_) {
+    processed = resampler_->Resample(audio);
+    audio_for_encoding = absl::MakeConstSpan(processed);
+  }
+  if (audio_for_encoding.size() != InternalProfile::kNumSamplesPerHop) {
+    LOG(ERROR) << "Resampled hop has " << audio_for_encoding.size()
+               << " samples.";
+    return;
+  }
+
+  if (noise_estimator_ != nullptr) {
+    if (!noise_estimator_->ReceiveSamples(audio_for_encoding)) {
+      LOG(ERROR) << "Unable to update encoder noise estimator.";
+      return;
+    }
+    if (noise_estimator_->is_noise()) {
+      // Like |LyraEncoder|, features are not extracted from noise, which
+      // leaves the state of the feature extractor untouched.
+      hop->is_noise = true;
+      hop->ok = true;
+      return;
+    }
+  }
+
+  auto features = feature_extractor_->Extract(audio_for_encoding);
+  if (!features.has_value()) {
+    LOG(ERROR) << "Unable to extract features from audio hop.";
+    return;
+  }
+  hop->features = std::move(features.value());
+  hop->ok = true;
+}
+
+std::optional<std::vector<uint8_t>> PipelinedEncoder::QuantizeHop(
+    const AnalyzedHop& hop, const VectorQuantizerInterface& quantizer) const {
+  if (!hop.ok) {
+    return std::nullopt;
+  }
+  if (hop.is_noise) {
+    auto empty_packet = Packet<0>::Create(0, 0);
+    return empty_packet->PackQuantized(std::bitset<0>{}.to_string());
+  }
+  auto quantized_features =
+      quantizer.Quantize(hop.features, num_quantized_bits_);
+  if (!quantized_features.has_value()) {
+    LOG(ERROR) << "Unable to quantize features.";
+    return std::nullopt;
+  }
+  auto packet = CreatePacket(kNumHeaderBits, num_quantized_bits_);
+  return packet->PackQuantized(quantized_features.value());
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_PIPELINED_ENCODER_H_
+#define LYRA_PIPELINED_ENCODER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/feature_extractor_interface.h"
+#include "lyra/noise_estimator_interface.h"
+#include "lyra/resampler_interface.h"
+#include "lyra/vector_quantizer_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Encodes long recordings with the stages of |LyraEncoder| running on
+// separate threads, for offline use where throughput matters more than
+// latency.
+//
+// One analysis thread resamples, runs discontinuous transmission detection
+// and extracts features hop after hop, since all of those carry state from
+// one hop to the next. The quantizer is stateless across hops, so hops are
+// dealt round-robin to |num_quantizer_threads| threads, each with its own
+// quantizer, which quantize and pack them. The calling thread collects the
+// packets in order. Stages are connected by bounded lock-free queues, so the
+// analysis of hop n + 1 overlaps with the quantization of hop n.
+//
+// The packets are byte-identical to encoding the same audio with a
+// |LyraEncoder| one hop at a time.
+class PipelinedEncoder {
+ public:
+  // Takes the same parameters as |LyraEncoder::Create|. Returns a nullptr if
+  // they are not supported or |num_quantizer_threads| is not positive.
+  static std::unique_ptr<PipelinedEncoder> Create(
+      int sample_rate_hz, int num_channels, int bitrate, bool enable_dtx,
+      const ghc::filesystem::path& model_path, int num_quantizer_threads);
+
+  // Encodes every complete hop of |audio| and returns the concatenated
+  // packets, or a nullopt on failure. Successive calls continue the same
+  // stream, as successive calls to |LyraEncoder::Encode| would.
+  std::optional<std::vector<uint8_t>> Encode(absl::Span<const int16_t> audio);
+
+  // Like |Encode| but returns the packet of every hop separately, so that
+  // the empty packets of DTX hops can be told apart.
+  std::optional<std::vector<std::vector<uint8_t>>> EncodePackets(
+      absl::Span<const int16_t> audio);
+
+  int num_quantizer_threads() const {
+    return static_cast<int>(vector_quantizers_.size());
+  }
+
+ private:
+  // Output of the analysis thread for one hop.
+  struct AnalyzedHop {
+    bool ok = false;
+    // Noise-only hops are sent as empty packets when DTX is enabled.
+    bool is_noise = false;
+    std::vector<float> features;
+  };
+
+  PipelinedEncoder(
+      std::unique_ptr<ResamplerInterface> resampler,
+      std::unique_ptr<FeatureExtractorInterface> feature_extractor,
+      std::unique_ptr<NoiseEstimatorInterface> noise_estimator,
+      std::vector<std::unique_ptr<VectorQuantizerInterface>> vector_quantizers,
+      int sample_rate_hz, int num_quantized_bits);
+
+  void AnalyzeHop(absl::Span<const int16_t> audio, AnalyzedHop* hop);
+
+  std::optional<std::vector<uint8_t>> QuantizeHop(
+      const AnalyzedHop& hop, const VectorQuantizerInterface& quantizer) const;
+
+  const std::unique_ptr<ResamplerInterface> resampler_;
+  const std::unique_ptr<FeatureExtractorInterface> feature_extractor_;
+  const std::unique_ptr<NoiseEstimatorInterface> noise_estimator_;
+  const std::vector<std::unique_ptr<VectorQuantizerInterface>>
+      vector_quantizers_;
+  const int sample_rate_hz_;
+  const int num_samples_per_hop_;
+  const int num_quantized_bits_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_PIPELINED_ENCODER_H_
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/pipelined_encoder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Parameterized by sample rate, whether DTX is enabled, and the number of
+// quantizer threads.
+class PipelinedEncoderTest
+    : public testing::TestWithParam<std::tuple<int, bool, int>> {
+ protected:
+  PipelinedEncoderTest()
+      : sample_rate_hz_(std::get<0>(GetParam())),
+        enable_dtx_(std::get<1>(GetParam())),
+        num_quantizer_threads_(std::get<2>(GetParam())),
+        model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs") {}
+
+  // Alternates between a tone and silence, so that DTX sends both full and
+  // empty packets.
+  std::vector<int16_t> MakeAudio(int num_hops) const {
+    const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz_);
+    std::vector<int16_t> audio(num_hops * num_samples_per_hop);
+    for (int i = 0; i < audio.size(); ++i) {
+      const bool is_tone = (i / (25 * num_samples_per_hop)) % 2 == 0;
+      audio[i] = is_tone ? static_cast<int16_t>(
+                               8000 * std::sin(2 * M_PI * 440 * i /
+                                               sample_rate_hz_))
+                         : 0;
+    }
+    return audio;
+  }
+
+  const int sample_rate_hz_;
+  const bool enable_dtx_;
+  const int num_quantizer_threads_;
+  const ghc::filesystem::path model_path_;
+};
+
+TEST_P(PipelinedEncoderTest, MatchesSerialEncoder) {
+  const int bitrate = 6000;
+  auto serial_encoder = LyraEncoder::Create(sample_rate_hz_, kNumChannels,
+                                            bitrate, enable_dtx_, model_path_);
+  auto pipelined_encoder =
+      PipelinedEncoder::Create(sample_rate_hz_, kNumChannels, bitrate,
+                               enable_dtx_, model_path_,
+                               num_quantizer_threads_);
+  ASSERT_NE(serial_encoder, nullptr);
+  ASSERT_NE(pipelined_encoder, nullptr);
+
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz_);
+  const std::vector<int16_t> audio = MakeAudio(/*num_hops=*/150);
+  std::vector<uint8_t> expected;
+  for (int begin = 0; begin + num_samples_per_hop <= audio.size();
+       begin += num_samples_per_hop) {
+    auto packet = serial_encoder->Encode(
+        absl::MakeConstSpan(&audio[begin], num_samples_per_hop));
+    ASSERT_TRUE(packet.has_value());
+    expected.insert(expected.end(), packet->begin(), packet->end());
+  }
+
+  // Two calls continue the same stream.
+  const int split = 61 * num_samples_per_hop;
+  auto first = pipelined_encoder->Encode(
+      absl::MakeConstSpan(audio).subspan(0, split));
+  auto second =
+      pipelined_encoder->Encode(absl::MakeConstSpan(audio).subspan(split));
+  ASSERT_TRUE(first.has_value());
+  ASSERT_TRUE(second.has_value());
+  first->insert(first->end(), second->begin(), second->end());
+  EXPECT_EQ(first.value(), expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(SampleRatesDtxAndThreads, PipelinedEncoderTest,
+                         testing::Combine(testing::ValuesIn(
+                                              kSupportedSampleRates),
+                                          testing::Bool(),
+                                          testing::Values(1, 3)));
+
+TEST(PipelinedEncoderCreateTest, InvalidParamsReturnNullptr) {
+  const ghc::filesystem::path model_path =
+      ghc::filesystem::current_path() / "lyra/model_coeffs";
+  EXPECT_EQ(PipelinedEncoder::Create(kInternalSampleRateHz, kNumChannels, 6000,
+                                     false, model_path,
+                                     /*num_quantizer_threads=*/0),
+            nullptr);
+  EXPECT_EQ(PipelinedEncoder::Create(kInternalSampleRateHz, kNumChannels, 1234,
+                                     false, model_path, 2),
+            nullptr);
+  EXPECT_EQ(PipelinedEncoder::Create(kInternalSampleRateHz, kNumChannels, 6000,
+                                     false, "invalid/model/path", 2),
+            nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
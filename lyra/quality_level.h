@@ -0,0 +1,37 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_QUALITY_LEVEL_H_
+#define LYRA_QUALITY_LEVEL_H_
+
+namespace chromemedia {
+namespace codec {
+
+// The quality a session should run at, from most to least expensive.
+enum class QualityLevel {
+  kFull,
+  // Encode at the lowest supported bitrate, which runs the fewest quantizer
+  // stages.
+  kReducedBitrate,
+  // Additionally have the decoder play comfort noise instead of running
+  // LyraGAN, see |LyraDecoder::set_quality_level|.
+  kComfortNoise,
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_QUALITY_LEVEL_H_
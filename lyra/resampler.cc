@@ -15,8 +15,10 @@
 #include "lyra/resampler.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <memory>
+#include <numeric>
 #include <utility>
 #include <vector>
 
@@ -25,9 +27,17 @@
 #include "audio/dsp/resampler_q.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
+namespace {
+
+// Scale of int16 samples relative to unit floats.
+constexpr float kInt16Scale = 32768.f;
+
+}  // namespace
+
 std::unique_ptr<Resampler> Resampler::Create(int input_sample_rate_hz,
                                              int target_sample_rate_hz) {
   audio_dsp::QResamplerParams params;
@@ -54,18 +64,85 @@ Resampler::Resampler(audio_dsp::QResampler<float> dsp_resampler,
                      int input_sample_rate_hz, int target_sample_rate_hz)
     : input_sample_rate_hz_(input_sample_rate_hz),
       target_sample_rate_hz_(target_sample_rate_hz),
-      resampler_(std::move(dsp_resampler)) {
+      resampler_(std::move(dsp_resampler)),
+      phase_period_(input_sample_rate_hz /
+                    std::gcd(input_sample_rate_hz, target_sample_rate_hz)),
+      num_samples_to_keep_(
+          2 * static_cast<int>(std::ceil(resampler_.radius())) + 1 +
+          phase_period_),
+      num_samples_processed_(0) {
   resampler_.ResetFullyPrimed();
 }
 
 std::vector<int16_t> Resampler::Resample(absl::Span<const int16_t> audio) {
-  std::vector<float> input_floats(audio.begin(), audio.end());
-  std::vector<float> output_floats;
-  resampler_.ProcessSamples(input_floats, &output_floats);
+  latest_samples_.insert(latest_samples_.end(), audio.begin(), audio.end());
+  const std::vector<float> output_floats = Process(audio.size());
   return ClipToInt16(absl::MakeConstSpan(output_floats));
 }
 
-void Resampler::Reset() { resampler_.ResetFullyPrimed(); }
+std::vector<float> Resampler::ResampleFloat(absl::Span<const float> audio) {
+  // |resampler_| always runs in the int16 scale of |Resample|, so that its
+  // delay line stays consistent when callers switch between the two.
+  for (const float sample : audio) {
+    latest_samples_.push_back(sample * kInt16Scale);
+  }
+  std::vector<float> output = Process(audio.size());
+  for (float& sample : output) {
+    sample /= kInt16Scale;
+  }
+  return output;
+}
+
+std::vector<float> Resampler::Process(int num_samples) {
+  std::vector<float> output;
+  resampler_.ProcessSamples(
+      absl::MakeConstSpan(latest_samples_).last(num_samples), &output);
+  num_samples_processed_ += num_samples;
+  // Trims only once twice as many samples are kept, to keep the copies rare.
+  if (latest_samples_.size() > 2 * num_samples_to_keep_) {
+    latest_samples_.erase(latest_samples_.begin(),
+                          latest_samples_.end() - num_samples_to_keep_);
+  }
+  return output;
+}
+
+void Resampler::Reset() {
+  resampler_.ResetFullyPrimed();
+  latest_samples_.clear();
+  num_samples_processed_ = 0;
+}
+
+bool Resampler::SaveState(StateWriter* writer) const {
+  // Saves a number of samples congruent to the samples processed modulo
+  // |phase_period_|, so that running on them ends in the same phase. The
+  // samples already dropped leave |num_samples_dropped| % |phase_period_| of
+  // a period, which the saved samples have to complete.
+  const int64_t num_samples_dropped =
+      num_samples_processed_ - latest_samples_.size();
+  const int num_samples_to_save =
+      latest_samples_.size() -
+      (phase_period_ - num_samples_dropped % phase_period_) % phase_period_;
+  writer->WriteVector<float>(
+      absl::MakeConstSpan(latest_samples_).last(num_samples_to_save));
+  return true;
+}
+
+bool Resampler::RestoreState(StateReader* reader) {
+  std::vector<float> latest_samples;
+  if (!reader->ReadVector(&latest_samples)) {
+    return false;
+  }
+  if (latest_samples.size() > 2 * num_samples_to_keep_) {
+    LOG(ERROR) << "Expected at most " << 2 * num_samples_to_keep_
+               << " samples of resampler state, but got "
+               << latest_samples.size() << ".";
+    return false;
+  }
+  Reset();
+  latest_samples_ = std::move(latest_samples);
+  Process(latest_samples_.size());
+  return true;
+}
 
 int Resampler::input_sample_rate_hz() const { return input_sample_rate_hz_; }
 
@@ -24,6 +24,7 @@
 #include "absl/types/span.h"
 #include "audio/dsp/resampler_q.h"
 #include "lyra/resampler_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -39,6 +40,12 @@ class Resampler : public ResamplerInterface {
   // Resamples audio at |input_sample_rate_hz| to |target_sample_rate_hz|.
   std::vector<int16_t> Resample(absl::Span<const int16_t> audio) override;
 
+  // The underlying resampler is linear and works on floats, so unit floats
+  // are resampled without clipping. They are scaled to the int16 range on the
+  // way in and back on the way out, so that calls to |Resample| and
+  // |ResampleFloat| can be mixed on the same stream.
+  std::vector<float> ResampleFloat(absl::Span<const float> audio) override;
+
   void Reset() override;
 
   int input_sample_rate_hz() const override;
@@ -47,13 +54,32 @@ class Resampler : public ResamplerInterface {
 
   int samples_until_steady_state() const override;
 
+  // The state of the underlying resampler is not exposed, so the latest input
+  // is saved instead. Restoring resets the resampler and runs it on that
+  // input again, which leaves it with the same delay line and phase.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
  private:
   const int input_sample_rate_hz_;
   const int target_sample_rate_hz_;
 
   explicit Resampler(audio_dsp::QResampler<float> dsp_resampler,
                      int input_sample_rate_hz, int target_sample_rate_hz);
+
+  // Runs |resampler_| on the last |num_samples| of |latest_samples_|, which
+  // callers append the new input to, and trims them.
+  std::vector<float> Process(int num_samples);
+
   audio_dsp::QResampler<float> resampler_;
+  // Input samples after which the phase of |resampler_| repeats.
+  const int phase_period_;
+  // Enough latest input samples to fill the delay line of |resampler_| in
+  // every phase.
+  const int num_samples_to_keep_;
+  std::vector<float> latest_samples_;
+  int64_t num_samples_processed_;
 };
 
 }  // namespace codec
@@ -21,6 +21,9 @@
 #include <vector>
 
 #include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -31,6 +34,11 @@ class ResamplerInterface {
 
   virtual std::vector<int16_t> Resample(absl::Span<const int16_t> audio) = 0;
 
+  // Resamples audio in unit floats. Defaults to resampling it as int16.
+  virtual std::vector<float> ResampleFloat(absl::Span<const float> audio) {
+    return Int16ToUnit<float>(Resample(UnitToInt16(audio)));
+  }
+
   virtual void Reset() = 0;
 
   virtual int input_sample_rate_hz() const = 0;
@@ -38,6 +46,18 @@ class ResamplerInterface {
   virtual int target_sample_rate_hz() const = 0;
 
   virtual int samples_until_steady_state() const = 0;
+
+  // Saves the filter state, so that another resampler continues the output
+  // without a discontinuity. Returns false if this is not supported.
+  virtual bool SaveState(StateWriter* writer) const {
+    LOG(ERROR) << "This resampler can not save its state.";
+    return false;
+  }
+
+  virtual bool RestoreState(StateReader* reader) {
+    LOG(ERROR) << "This resampler can not restore its state.";
+    return false;
+  }
 };
 
 }  // namespace codec
@@ -23,7 +23,9 @@
 #include "absl/types/span.h"
 #include "audio/dsp/signal_vector_util.h"
 #include "gtest/gtest.h"
+#include "lyra/dsp_utils.h"
 #include "lyra/lyra_config.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -42,6 +44,34 @@ TEST_P(ResamplerSampleRateTest, ResamplingWorksAllZeros) {
   EXPECT_EQ(resampled, expected);
 }
 
+TEST_P(ResamplerSampleRateTest, ResampleFloatMatchesResample) {
+  const int input_sample_rate_hz = std::get<0>(GetParam());
+  const int output_sample_rate_hz = std::get<1>(GetParam());
+  std::vector<double> doubles_samples;
+  audio_dsp::ComputeSineWaveVector(440, input_sample_rate_hz, 0.0,
+                                   GetNumSamplesPerHop(input_sample_rate_hz),
+                                   &doubles_samples);
+  std::vector<int16_t> samples;
+  for (auto val : doubles_samples) {
+    samples.push_back(val * 10000);
+  }
+  auto int16_resampler =
+      Resampler::Create(input_sample_rate_hz, output_sample_rate_hz);
+  auto float_resampler =
+      Resampler::Create(input_sample_rate_hz, output_sample_rate_hz);
+
+  const auto expected =
+      int16_resampler->Resample(absl::MakeConstSpan(samples));
+  const auto resampled = float_resampler->ResampleFloat(
+      Int16ToUnit<float>(absl::MakeConstSpan(samples)));
+  ASSERT_EQ(resampled.size(), expected.size());
+  for (int i = 0; i < resampled.size(); ++i) {
+    // The int16 output is rounded to the nearest integer.
+    EXPECT_NEAR(resampled[i], Int16ToUnitScalar<float>(expected[i]),
+                1.f / 32768.f);
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     UpsampleAndDownsample, ResamplerSampleRateTest,
     testing::Combine(::testing::Values(kInternalSampleRateHz),
@@ -77,6 +107,86 @@ TEST(ResamplerTest, UpsampleThenDownsampleSimilar) {
   }
 }
 
+// A decoder at 48 kHz may switch between the int16 and float paths from one
+// hop to the next, which has to continue the same output.
+TEST(ResamplerTest, SwitchingBetweenInt16AndFloatContinuesOutput) {
+  constexpr int kOutputSampleRateHz = 48000;
+  constexpr int kNumHops = 6;
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  std::vector<double> doubles_samples;
+  audio_dsp::ComputeSineWaveVector(440, kInternalSampleRateHz, 0.0,
+                                   kNumHops * num_samples_per_hop,
+                                   &doubles_samples);
+  std::vector<int16_t> samples;
+  for (auto val : doubles_samples) {
+    samples.push_back(val * 10000);
+  }
+  auto int16_resampler =
+      Resampler::Create(kInternalSampleRateHz, kOutputSampleRateHz);
+  auto switching_resampler =
+      Resampler::Create(kInternalSampleRateHz, kOutputSampleRateHz);
+
+  for (int hop = 0; hop < kNumHops; ++hop) {
+    const auto hop_samples = absl::MakeConstSpan(samples).subspan(
+        hop * num_samples_per_hop, num_samples_per_hop);
+    const auto expected = int16_resampler->Resample(hop_samples);
+    std::vector<float> resampled;
+    if (hop % 2 == 0) {
+      resampled = Int16ToUnit<float>(
+          absl::MakeConstSpan(switching_resampler->Resample(hop_samples)));
+    } else {
+      resampled =
+          switching_resampler->ResampleFloat(Int16ToUnit<float>(hop_samples));
+    }
+    ASSERT_EQ(resampled.size(), expected.size());
+    for (int i = 0; i < resampled.size(); ++i) {
+      EXPECT_NEAR(resampled[i], Int16ToUnitScalar<float>(expected[i]),
+                  1.f / 32768.f)
+          << "at sample " << i << " of hop " << hop;
+    }
+  }
+}
+
+// A restored resampler has to continue exactly like the saved one, whatever
+// part of a phase period the history dropped before saving leaves behind.
+TEST(ResamplerTest, RestoredResamplerContinuesOutput) {
+  constexpr int kInputSampleRateHz = 48000;
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInputSampleRateHz);
+  std::vector<double> doubles_samples;
+  audio_dsp::ComputeSineWaveVector(440, kInputSampleRateHz, 0.0,
+                                   4 * num_samples_per_hop, &doubles_samples);
+  std::vector<int16_t> samples;
+  for (auto val : doubles_samples) {
+    samples.push_back(val * 10000);
+  }
+  const auto continuation =
+      absl::MakeConstSpan(samples).last(num_samples_per_hop);
+
+  // The phase of 48 kHz to 16 kHz repeats every 3 input samples, so these
+  // leave every remainder of dropped samples.
+  for (int num_processed = 2 * num_samples_per_hop;
+       num_processed < 2 * num_samples_per_hop + 6; ++num_processed) {
+    auto resampler =
+        Resampler::Create(kInputSampleRateHz, kInternalSampleRateHz);
+    ASSERT_NE(resampler, nullptr);
+    resampler->Resample(absl::MakeConstSpan(samples).first(num_processed));
+
+    StateWriter writer(SessionKind::kEncoder);
+    ASSERT_TRUE(resampler->SaveState(&writer));
+    auto restored_resampler =
+        Resampler::Create(kInputSampleRateHz, kInternalSampleRateHz);
+    ASSERT_NE(restored_resampler, nullptr);
+    auto reader = StateReader::Create(writer.bytes(), SessionKind::kEncoder);
+    ASSERT_NE(reader, nullptr);
+    ASSERT_TRUE(restored_resampler->RestoreState(reader.get()));
+    EXPECT_TRUE(reader->at_end());
+
+    EXPECT_EQ(restored_resampler->Resample(continuation),
+              resampler->Resample(continuation))
+        << "after " << num_processed << " samples";
+  }
+}
+
 // This test will fail without clipping, as ubsan will catch the overflow when
 // converting from float to int16_t after resampling.
 TEST(ResamplerExtremeValuesTest, AlternatingExtremeValuesTest) {
@@ -28,16 +28,29 @@
 #include "absl/memory/memory.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
+#include "lyra/model_bundle.h"
 #include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
 namespace codec {
 
 std::unique_ptr<ResidualVectorQuantizer> ResidualVectorQuantizer::Create(
-    const ghc::filesystem::path& model_path) {
-  auto quantizer_model =
-      TfLiteModelWrapper::Create(model_path / "quantizer.tflite",
-                                 /*use_xnn=*/false, /*int8_quantized=*/false);
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
+  return CreateFromModel(TfLiteModelWrapper::Create(
+      model_path / "quantizer.tflite",
+      /*use_xnn=*/precision != ModelPrecision::kFloat32, precision));
+}
+
+std::unique_ptr<ResidualVectorQuantizer> ResidualVectorQuantizer::Create(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  return CreateFromModel(TfLiteModelWrapper::Create(
+      std::move(bundle), "quantizer.tflite",
+      /*use_xnn=*/precision != ModelPrecision::kFloat32, precision));
+}
+
+std::unique_ptr<ResidualVectorQuantizer>
+ResidualVectorQuantizer::CreateFromModel(
+    std::unique_ptr<TfLiteModelWrapper> quantizer_model) {
   if (quantizer_model == nullptr) {
     LOG(ERROR) << "Unable to create the quantizer TfLite model wrapper.";
     return nullptr;
@@ -112,7 +125,20 @@ std::optional<std::string> ResidualVectorQuantizer::Quantize(
 std::optional<std::vector<float>>
 ResidualVectorQuantizer::DecodeToLossyFeatures(
     const std::string& quantized_features) const {
-  const int num_bits = quantized_features.size();
+  auto frames = DecodeFramesToLossyFeatures({quantized_features});
+  if (!frames.has_value()) {
+    return std::nullopt;
+  }
+  return std::move(frames->front());
+}
+
+std::optional<std::vector<std::vector<float>>>
+ResidualVectorQuantizer::DecodeFramesToLossyFeatures(
+    const std::vector<std::string>& quantized_frames) const {
+  if (quantized_frames.empty()) {
+    return std::vector<std::vector<float>>();
+  }
+  const int num_bits = quantized_frames.front().size();
   if (num_bits > kMaxNumQuantizedBits) {
     LOG(ERROR) << "The number of bits cannot exceed maximum ("
                << kMaxNumQuantizedBits << ").";
@@ -124,36 +150,50 @@ ResidualVectorQuantizer::DecodeToLossyFeatures(
                << bits_per_quantizer_ << ").";
     return std::nullopt;
   }
+  for (const std::string& quantized_features : quantized_frames) {
+    if (quantized_features.size() != num_bits) {
+      LOG(ERROR) << "All frames have to have the same number of bits ("
+                 << num_bits << "), but one has " << quantized_features.size()
+                 << ".";
+      return std::nullopt;
+    }
+  }
+  const int num_frames = quantized_frames.size();
   const int required_quantizers = num_bits / bits_per_quantizer_;
   const int max_num_quantizers = kMaxNumQuantizedBits / bits_per_quantizer_;
   if (decode_runner_->ResizeInputTensor(
-          "encoding_indices", {max_num_quantizers, 1, 1}) != kTfLiteOk) {
+          "encoding_indices", {max_num_quantizers, 1, num_frames}) !=
+      kTfLiteOk) {
     LOG(ERROR)
         << "Failed to resize the indices tensor to the required number of "
-        << "quantizers (" << max_num_quantizers << ").";
+        << "quantizers (" << max_num_quantizers << ") and frames ("
+        << num_frames << ").";
     return std::nullopt;
   }
   if (decode_runner_->AllocateTensors() != kTfLiteOk) {
     LOG(ERROR) << "Unable to allocate tensors.";
     return std::nullopt;
   }
-  const std::bitset<kMaxNumQuantizedBits> quantized_bits(quantized_features);
   const std::bitset<kMaxNumQuantizedBits> quantizer_mask(
       (1 << bits_per_quantizer_) - 1);
   int32_t* indices = decode_runner_->input_tensor("encoding_indices")->data.i32;
-  for (int i = 0; i < required_quantizers; ++i) {
-    // First shift the desired quantizer bits into the least significant
-    // section, then mask out any more significant bits from other quantizers
-    // and finally cast to int32.
-    // The first quantizer is expected to be in the most significant bits.
-    indices[i] = static_cast<int32_t>(
-        ((quantized_bits >>
-          ((required_quantizers - i - 1) * bits_per_quantizer_)) &
-         quantizer_mask)
-            .to_ulong());
-  }
-  for (int j = required_quantizers; j < max_num_quantizers; ++j) {
-    indices[j] = -1;
+  for (int frame = 0; frame < num_frames; ++frame) {
+    const std::bitset<kMaxNumQuantizedBits> quantized_bits(
+        quantized_frames[frame]);
+    for (int i = 0; i < required_quantizers; ++i) {
+      // First shift the desired quantizer bits into the least significant
+      // section, then mask out any more significant bits from other quantizers
+      // and finally cast to int32.
+      // The first quantizer is expected to be in the most significant bits.
+      indices[i * num_frames + frame] = static_cast<int32_t>(
+          ((quantized_bits >>
+            ((required_quantizers - i - 1) * bits_per_quantizer_)) &
+           quantizer_mask)
+              .to_ulong());
+    }
+    for (int j = required_quantizers; j < max_num_quantizers; ++j) {
+      indices[j * num_frames + frame] = -1;
+    }
   }
 
   if (decode_runner_->Invoke() != kTfLiteOk) {
@@ -163,8 +203,16 @@ ResidualVectorQuantizer::DecodeToLossyFeatures(
   const TfLiteTensor* features_tensor =
       decode_runner_->output_tensor("output_0");
   const float* features = features_tensor->data.f;
-  const int num_features = features_tensor->bytes / sizeof(features[0]);
-  return std::vector<float>(features, features + num_features);
+  const int num_features =
+      features_tensor->bytes / sizeof(features[0]) / num_frames;
+  // The features come out frame after frame.
+  std::vector<std::vector<float>> frames;
+  frames.reserve(num_frames);
+  for (int frame = 0; frame < num_frames; ++frame) {
+    frames.emplace_back(features + frame * num_features,
+                        features + (frame + 1) * num_features);
+  }
+  return frames;
 }
 
 }  // namespace codec
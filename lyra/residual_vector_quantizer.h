@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "include/ghc/filesystem.hpp"
+#include "lyra/model_bundle.h"
 #include "lyra/tflite_model_wrapper.h"
 #include "lyra/vector_quantizer_interface.h"
 
@@ -34,8 +35,16 @@ namespace codec {
 class ResidualVectorQuantizer : public VectorQuantizerInterface {
  public:
   // Returns nullptr if the TFLite model can't be built or allocated.
+  // In |ModelPrecision::kFloat32| the quantizer runs on the builtin TFLite
+  // kernels; reduced precisions run it on XNNPack.
   static std::unique_ptr<ResidualVectorQuantizer> Create(
-      const ghc::filesystem::path& model_path);
+      const ghc::filesystem::path& model_path,
+      ModelPrecision precision = ModelPrecision::kFloat32);
+
+  // Like the above, but loads the model from |bundle|.
+  static std::unique_ptr<ResidualVectorQuantizer> Create(
+      std::shared_ptr<const ModelBundle> bundle,
+      ModelPrecision precision = ModelPrecision::kFloat32);
 
   // Quantizes the features using vector quantization.
   std::optional<std::string> Quantize(const std::vector<float>& features,
@@ -45,6 +54,12 @@ class ResidualVectorQuantizer : public VectorQuantizerInterface {
   std::optional<std::vector<float>> DecodeToLossyFeatures(
       const std::string& quantized_features) const override;
 
+  // Unpacks the strings of bits of consecutive frames into features with a
+  // single invocation of the decode signature, which takes the frames stacked
+  // along the time axis of its indices.
+  std::optional<std::vector<std::vector<float>>> DecodeFramesToLossyFeatures(
+      const std::vector<std::string>& quantized_frames) const override;
+
  private:
   // LINT.IfChange
   static constexpr int kMaxNumQuantizedBits = 184;
@@ -53,6 +68,11 @@ class ResidualVectorQuantizer : public VectorQuantizerInterface {
   // lyra_config.cc,
   // )
 
+  // Returns a nullptr if |quantizer_model| is a nullptr or lacks the encode
+  // and decode signatures.
+  static std::unique_ptr<ResidualVectorQuantizer> CreateFromModel(
+      std::unique_ptr<TfLiteModelWrapper> quantizer_model);
+
   explicit ResidualVectorQuantizer(
       std::unique_ptr<TfLiteModelWrapper> quantizer_model);
 
@@ -110,6 +110,34 @@ TEST_P(ResidualVectorQuantizerTest, EncodeDecodeResultsInSimilarFeatures) {
   EXPECT_LT(FeatureDistance(decoded_features.value()), 1.11);
 }
 
+TEST_P(ResidualVectorQuantizerTest, StackedFramesDecodeLikeSingleFrames) {
+  const std::string zeros(num_quantized_bits_, '0');
+  const std::string ones(num_quantized_bits_, '1');
+  auto quantized = quantizer_->Quantize(features_, num_quantized_bits_);
+  ASSERT_TRUE(quantized.has_value());
+  const std::vector<std::string> quantized_frames = {zeros, quantized.value(),
+                                                     ones};
+
+  auto decoded_frames =
+      quantizer_->DecodeFramesToLossyFeatures(quantized_frames);
+  ASSERT_TRUE(decoded_frames.has_value());
+  ASSERT_EQ(decoded_frames->size(), quantized_frames.size());
+  for (int i = 0; i < quantized_frames.size(); ++i) {
+    auto decoded_features =
+        quantizer_->DecodeToLossyFeatures(quantized_frames[i]);
+    ASSERT_TRUE(decoded_features.has_value());
+    EXPECT_EQ(decoded_frames->at(i), decoded_features.value());
+  }
+}
+
+TEST_P(ResidualVectorQuantizerTest, StackedFramesFailWithDifferentSizes) {
+  EXPECT_FALSE(quantizer_
+                   ->DecodeFramesToLossyFeatures(
+                       {std::string(num_quantized_bits_, '0'),
+                        std::string(num_quantized_bits_ + 4, '0')})
+                   .has_value());
+}
+
 INSTANTIATE_TEST_SUITE_P(NumQuantizedBits, ResidualVectorQuantizerTest,
                          testing::ValuesIn(GetSupportedQuantizedBits()));
 
@@ -0,0 +1,233 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/rtp_payload.h"
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/lyra_config.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kRtpVersion = 2;
+constexpr int kMaxPayloadType = 127;
+
+constexpr int NumTimestampsPerHop() {
+  return InternalProfile::kNumSamplesPerHop;
+}
+
+void StoreBigEndian(uint32_t value, int num_bytes, uint8_t* bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    bytes[i] = (value >> (8 * (num_bytes - 1 - i))) & 0xFF;
+  }
+}
+
+uint32_t LoadBigEndian(const uint8_t* bytes, int num_bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+}  // namespace
+
+std::unique_ptr<LyraRtpPayloader> LyraRtpPayloader::Create(
+    int payload_type, uint32_t ssrc, int frames_per_packet,
+    uint16_t first_sequence_number, uint32_t first_timestamp) {
+  if (payload_type < 0 || payload_type > kMaxPayloadType) {
+    LOG(ERROR) << "RTP payload type " << payload_type << " is out of range.";
+    return nullptr;
+  }
+  if (frames_per_packet < 1 || frames_per_packet > kMaxFramesPerSuperframe) {
+    LOG(ERROR) << "The number of frames per RTP packet has to be between 1 and "
+               << kMaxFramesPerSuperframe << ", but is " << frames_per_packet
+               << ".";
+    return nullptr;
+  }
+  return absl::WrapUnique(new LyraRtpPayloader(payload_type, ssrc,
+                                               frames_per_packet,
+                                               first_sequence_number,
+                                               first_timestamp));
+}
+
+LyraRtpPayloader::LyraRtpPayloader(uint8_t payload_type, uint32_t ssrc,
+                                   int frames_per_packet,
+                                   uint16_t first_sequence_number,
+                                   uint32_t first_timestamp)
+    : payload_type_(payload_type),
+      ssrc_(ssrc),
+      frames_per_packet_(frames_per_packet),
+      sequence_number_(first_sequence_number),
+      next_timestamp_(first_timestamp),
+      timestamp_(first_timestamp),
+      marker_(true),
+      frames_{},
+      num_frames_(0),
+      header_{},
+      iovecs_{} {}
+
+std::optional<absl::Span<const iovec>> LyraRtpPayloader::AddFrame(
+    absl::Span<const uint8_t> frame) {
+  if (frame.empty()) {
+    // The hop was not sent, so the next packet starts after a gap.
+    const absl::Span<const iovec> packet = Flush();
+    next_timestamp_ += NumTimestampsPerHop();
+    marker_ = true;
+    return packet;
+  }
+  if (PacketSizeToNumQuantizedBits(frame.size()) < 0) {
+    LOG(ERROR) << "The packet size (" << frame.size()
+               << " bytes) is not supported.";
+    return std::nullopt;
+  }
+
+  // Frames of different bitrates can not share a payload.
+  absl::Span<const iovec> packet;
+  if (num_frames_ > 0 && frame.size() != frames_[0].size()) {
+    packet = Flush();
+  }
+  if (num_frames_ == 0) {
+    timestamp_ = next_timestamp_;
+  }
+  frames_[num_frames_++] = frame;
+  next_timestamp_ += NumTimestampsPerHop();
+  if (num_frames_ == frames_per_packet_) {
+    packet = Flush();
+  }
+  return packet;
+}
+
+absl::Span<const iovec> LyraRtpPayloader::Flush() {
+  if (num_frames_ == 0) {
+    return {};
+  }
+  header_[0] = kRtpVersion << 6;
+  header_[1] = (marker_ ? 0x80 : 0) | payload_type_;
+  StoreBigEndian(sequence_number_, 2, header_ + 2);
+  StoreBigEndian(timestamp_, 4, header_ + 4);
+  StoreBigEndian(ssrc_, 4, header_ + 8);
+  iovecs_[0] = {header_, kRtpHeaderSize};
+  for (int i = 0; i < num_frames_; ++i) {
+    // iovec is shared between reading and writing, so it is not const even
+    // though sending only reads from it.
+    iovecs_[i + 1] = {const_cast<uint8_t*>(frames_[i].data()),
+                      frames_[i].size()};
+  }
+  const int num_iovecs = num_frames_ + 1;
+  ++sequence_number_;
+  marker_ = false;
+  num_frames_ = 0;
+  return absl::MakeConstSpan(iovecs_.data(), num_iovecs);
+}
+
+std::unique_ptr<LyraRtpDepayloader> LyraRtpDepayloader::Create(
+    int payload_type) {
+  if (payload_type < 0 || payload_type > kMaxPayloadType) {
+    LOG(ERROR) << "RTP payload type " << payload_type << " is out of range.";
+    return nullptr;
+  }
+  return absl::WrapUnique(new LyraRtpDepayloader(payload_type));
+}
+
+LyraRtpDepayloader::LyraRtpDepayloader(uint8_t payload_type)
+    : payload_type_(payload_type),
+      has_previous_(false),
+      expected_sequence_number_(0),
+      expected_timestamp_(0) {}
+
+std::optional<LyraRtpFrames> LyraRtpDepayloader::Depayload(
+    absl::Span<const uint8_t> packet) {
+  if (packet.size() < kRtpHeaderSize || packet[0] >> 6 != kRtpVersion) {
+    LOG(ERROR) << "Not an RTP packet.";
+    return std::nullopt;
+  }
+  LyraRtpFrames result;
+  result.header.marker = packet[1] & 0x80;
+  result.header.payload_type = packet[1] & 0x7F;
+  result.header.sequence_number = LoadBigEndian(&packet[2], 2);
+  result.header.timestamp = LoadBigEndian(&packet[4], 4);
+  result.header.ssrc = LoadBigEndian(&packet[8], 4);
+  if (result.header.payload_type != payload_type_) {
+    LOG(ERROR) << "Unexpected RTP payload type "
+               << static_cast<int>(result.header.payload_type) << ".";
+    return std::nullopt;
+  }
+
+  const bool has_padding = packet[0] & 0x20;
+  const bool has_extension = packet[0] & 0x10;
+  const int num_csrcs = packet[0] & 0x0F;
+  int payload_begin = kRtpHeaderSize + 4 * num_csrcs;
+  if (has_extension) {
+    if (payload_begin + 4 > packet.size()) {
+      LOG(ERROR) << "RTP packet ends within its header extension.";
+      return std::nullopt;
+    }
+    payload_begin += 4 + 4 * LoadBigEndian(&packet[payload_begin + 2], 2);
+  }
+  int payload_end = packet.size();
+  if (has_padding) {
+    payload_end -= packet.back();
+  }
+  if (payload_begin > payload_end || (has_padding && packet.back() == 0)) {
+    LOG(ERROR) << "RTP packet has an invalid header extension or padding.";
+    return std::nullopt;
+  }
+
+  const absl::Span<const uint8_t> payload =
+      packet.subspan(payload_begin, payload_end - payload_begin);
+  const int num_quantized_bits =
+      SuperframeSizeToNumQuantizedBits(payload.size(), &result.num_frames);
+  if (num_quantized_bits < 0) {
+    LOG(ERROR) << "The RTP payload size (" << payload.size()
+               << " bytes) is not supported.";
+    return std::nullopt;
+  }
+  const int frame_size = GetPacketSize(num_quantized_bits);
+  for (int i = 0; i < result.num_frames; ++i) {
+    result.frames[i] = payload.subspan(i * frame_size, frame_size);
+  }
+
+  result.num_missing_hops = 0;
+  result.num_lost_packets = 0;
+  if (has_previous_) {
+    // Differences are taken modulo the field widths, so that wrapping
+    // timestamps and sequence numbers count forward.
+    result.num_missing_hops =
+        static_cast<int32_t>(result.header.timestamp - expected_timestamp_) /
+        NumTimestampsPerHop();
+    result.num_lost_packets = static_cast<int16_t>(
+        result.header.sequence_number - expected_sequence_number_);
+  }
+  // A reordered packet does not move the expectation back.
+  if (!has_previous_ || result.num_missing_hops >= 0) {
+    has_previous_ = true;
+    expected_sequence_number_ = result.header.sequence_number + 1;
+    expected_timestamp_ =
+        result.header.timestamp + result.num_frames * NumTimestampsPerHop();
+  }
+  return result;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_RTP_PAYLOAD_H_
+#define LYRA_RTP_PAYLOAD_H_
+
+#include <sys/uio.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/types/span.h"
+#include "lyra/lyra_config.h"
+
+namespace chromemedia {
+namespace codec {
+
+// RTP framing of Lyra packets.
+//
+// The payload of an RTP packet is a superframe: the packets of 1 to
+// |kMaxFramesPerSuperframe| consecutive hops of the same bitrate,
+// concatenated, so that the number of hops and the bitrate follow from the
+// payload size. The RTP timestamp is that of the first hop of the payload and
+// counts samples at |kInternalSampleRateHz|. Hops that DTX did not send are
+// not transmitted; they show up as a timestamp advancing by more than the
+// hops of the previous packet while the sequence number advances by one. The
+// marker bit is set on the first packet after such a gap, as for the first
+// packet of a talkspurt in RFC 3551.
+
+inline constexpr int kRtpHeaderSize = 12;
+
+struct RtpHeader {
+  bool marker;
+  uint8_t payload_type;
+  uint16_t sequence_number;
+  uint32_t timestamp;
+  uint32_t ssrc;
+};
+
+// Aggregates the packets of consecutive hops into RTP packets, returned as
+// scatter-gather lists for sendmsg() or writev() that point at the Lyra
+// packets instead of copying them.
+class LyraRtpPayloader {
+ public:
+  // Returns a nullptr if |payload_type| is not in [0, 127] or
+  // |frames_per_packet| is not in [1, |kMaxFramesPerSuperframe|].
+  static std::unique_ptr<LyraRtpPayloader> Create(
+      int payload_type, uint32_t ssrc, int frames_per_packet,
+      uint16_t first_sequence_number = 0, uint32_t first_timestamp = 0);
+
+  // Adds the packet of the next hop, which is empty if DTX did not send the
+  // hop. |frame| is not copied and has to stay valid until the RTP packet
+  // containing it has been sent.
+  //
+  // Returns the RTP packet as the header followed by its frames once
+  // |frames_per_packet| frames are collected, or earlier if a DTX gap or a
+  // change of bitrate ends the aggregation. Returns an empty span if no
+  // packet is complete, and a nullopt if |frame| is not a valid packet. The
+  // returned iovecs stay valid until the next call.
+  std::optional<absl::Span<const iovec>> AddFrame(
+      absl::Span<const uint8_t> frame);
+
+  // Returns the RTP packet of the frames collected so far, or an empty span
+  // if there are none. The returned iovecs stay valid until the next call.
+  absl::Span<const iovec> Flush();
+
+  uint16_t next_sequence_number() const { return sequence_number_; }
+
+ private:
+  LyraRtpPayloader(uint8_t payload_type, uint32_t ssrc, int frames_per_packet,
+                   uint16_t first_sequence_number, uint32_t first_timestamp);
+
+  const uint8_t payload_type_;
+  const uint32_t ssrc_;
+  const int frames_per_packet_;
+  uint16_t sequence_number_;
+  // Timestamp of the next hop passed to |AddFrame|.
+  uint32_t next_timestamp_;
+  // Timestamp of the first frame collected.
+  uint32_t timestamp_;
+  // Whether the next packet follows a gap.
+  bool marker_;
+  // Frames collected for the next packet.
+  std::array<absl::Span<const uint8_t>, kMaxFramesPerSuperframe> frames_;
+  int num_frames_;
+  uint8_t header_[kRtpHeaderSize];
+  std::array<iovec, 1 + kMaxFramesPerSuperframe> iovecs_;
+};
+
+// The frames of one RTP packet, pointing into the buffer that was parsed.
+struct LyraRtpFrames {
+  RtpHeader header;
+  // Hops between the previous packet and this one that were not received,
+  // whether lost or not sent by DTX. Negative if this packet arrived after a
+  // later one.
+  int num_missing_hops;
+  // Packets lost between the previous packet and this one, according to the
+  // sequence numbers. Negative like |num_missing_hops|.
+  int num_lost_packets;
+  int num_frames;
+  // Packets of the hops of this RTP packet, each ready for
+  // |LyraDecoder::SetEncodedPacket|.
+  std::array<absl::Span<const uint8_t>, kMaxFramesPerSuperframe> frames;
+};
+
+// Parses RTP packets carrying Lyra payloads and tracks the gaps between them.
+class LyraRtpDepayloader {
+ public:
+  // Returns a nullptr if |payload_type| is not in [0, 127].
+  static std::unique_ptr<LyraRtpDepayloader> Create(int payload_type);
+
+  // Parses |packet| without copying it, so the returned frames are valid as
+  // long as |packet| is. CSRCs, header extensions and padding are skipped.
+  // Returns a nullopt if |packet| is not a valid RTP packet of the payload
+  // type or its payload is not a valid superframe.
+  std::optional<LyraRtpFrames> Depayload(absl::Span<const uint8_t> packet);
+
+ private:
+  explicit LyraRtpDepayloader(uint8_t payload_type);
+
+  const uint8_t payload_type_;
+  bool has_previous_;
+  uint16_t expected_sequence_number_;
+  uint32_t expected_timestamp_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_RTP_PAYLOAD_H_
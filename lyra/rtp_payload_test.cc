@@ -0,0 +1,335 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/rtp_payload.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kPayloadType = 96;
+constexpr uint32_t kSsrc = 0x12345678;
+
+std::vector<uint8_t> Gather(absl::Span<const iovec> iovecs) {
+  std::vector<uint8_t> packet;
+  for (const iovec& vec : iovecs) {
+    const uint8_t* data = static_cast<const uint8_t*>(vec.iov_base);
+    packet.insert(packet.end(), data, data + vec.iov_len);
+  }
+  return packet;
+}
+
+// Returns a packet of |num_quantized_bits| whose bytes count up from |first|.
+std::vector<uint8_t> Frame(int num_quantized_bits, uint8_t first) {
+  std::vector<uint8_t> frame(GetPacketSize(num_quantized_bits));
+  std::iota(frame.begin(), frame.end(), first);
+  return frame;
+}
+
+class LyraRtpPayloadTest : public testing::Test {
+ protected:
+  LyraRtpPayloadTest()
+      : num_quantized_bits_(GetSupportedQuantizedBits().front()),
+        num_timestamps_per_hop_(GetNumSamplesPerHop(kInternalSampleRateHz)),
+        depayloader_(LyraRtpDepayloader::Create(kPayloadType)) {}
+
+  const int num_quantized_bits_;
+  const int num_timestamps_per_hop_;
+  std::unique_ptr<LyraRtpDepayloader> depayloader_;
+};
+
+TEST_F(LyraRtpPayloadTest, AggregatesFramesWithoutCopying) {
+  auto payloader = LyraRtpPayloader::Create(kPayloadType, kSsrc,
+                                            /*frames_per_packet=*/3,
+                                            /*first_sequence_number=*/7,
+                                            /*first_timestamp=*/1000);
+  ASSERT_NE(payloader, nullptr);
+  const std::vector<std::vector<uint8_t>> frames = {
+      Frame(num_quantized_bits_, 0), Frame(num_quantized_bits_, 10),
+      Frame(num_quantized_bits_, 20)};
+  for (int i = 0; i < 2; ++i) {
+    const auto packet = payloader->AddFrame(frames[i]);
+    ASSERT_TRUE(packet.has_value());
+    EXPECT_TRUE(packet->empty());
+  }
+  const auto packet = payloader->AddFrame(frames[2]);
+  ASSERT_TRUE(packet.has_value());
+  ASSERT_EQ(packet->size(), 1 + frames.size());
+  EXPECT_EQ((*packet)[0].iov_len, kRtpHeaderSize);
+  for (int i = 0; i < frames.size(); ++i) {
+    EXPECT_EQ((*packet)[i + 1].iov_base, frames[i].data());
+    EXPECT_EQ((*packet)[i + 1].iov_len, frames[i].size());
+  }
+
+  const std::vector<uint8_t> bytes = Gather(packet.value());
+  EXPECT_EQ(std::vector<uint8_t>(bytes.begin(), bytes.begin() + kRtpHeaderSize),
+            std::vector<uint8_t>({0x80, 0x80 | kPayloadType, 0, 7, 0, 0, 0x03,
+                                  0xE8, 0x12, 0x34, 0x56, 0x78}));
+  const auto parsed = depayloader_->Depayload(bytes);
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_TRUE(parsed->header.marker);
+  EXPECT_EQ(parsed->header.sequence_number, 7);
+  EXPECT_EQ(parsed->header.timestamp, 1000);
+  EXPECT_EQ(parsed->header.ssrc, kSsrc);
+  ASSERT_EQ(parsed->num_frames, frames.size());
+  for (int i = 0; i < frames.size(); ++i) {
+    EXPECT_EQ(std::vector<uint8_t>(parsed->frames[i].begin(),
+                                   parsed->frames[i].end()),
+              frames[i]);
+    // The frames point into the parsed buffer.
+    EXPECT_EQ(parsed->frames[i].data(),
+              bytes.data() + kRtpHeaderSize + i * frames[i].size());
+  }
+  EXPECT_TRUE(payloader->Flush().empty());
+  EXPECT_EQ(payloader->next_sequence_number(), 8);
+}
+
+TEST_F(LyraRtpPayloadTest, DtxGapEndsPacketAndAdvancesTimestamp) {
+  auto payloader = LyraRtpPayloader::Create(kPayloadType, kSsrc,
+                                            /*frames_per_packet=*/2);
+  ASSERT_NE(payloader, nullptr);
+  const std::vector<uint8_t> frame = Frame(num_quantized_bits_, 0);
+
+  std::vector<std::vector<uint8_t>> packets;
+  for (const bool is_sent : {true, true, true, false, false, true, true}) {
+    const auto packet = payloader->AddFrame(
+        is_sent ? absl::MakeConstSpan(frame) : absl::Span<const uint8_t>());
+    ASSERT_TRUE(packet.has_value());
+    if (!packet->empty()) {
+      packets.push_back(Gather(packet.value()));
+    }
+  }
+  ASSERT_EQ(packets.size(), 3);
+
+  const int kExpectedFrames[] = {2, 1, 2};
+  const uint32_t kExpectedTimestamps[] = {0, 2, 5};
+  const int kExpectedMissingHops[] = {0, 0, 2};
+  const bool kExpectedMarkers[] = {true, false, true};
+  for (int i = 0; i < packets.size(); ++i) {
+    const auto parsed = depayloader_->Depayload(packets[i]);
+    ASSERT_TRUE(parsed.has_value());
+    EXPECT_EQ(parsed->num_frames, kExpectedFrames[i]);
+    EXPECT_EQ(parsed->header.sequence_number, i);
+    EXPECT_EQ(parsed->header.timestamp,
+              kExpectedTimestamps[i] * num_timestamps_per_hop_);
+    EXPECT_EQ(parsed->header.marker, kExpectedMarkers[i]);
+    EXPECT_EQ(parsed->num_missing_hops, kExpectedMissingHops[i]);
+    EXPECT_EQ(parsed->num_lost_packets, 0);
+  }
+}
+
+TEST_F(LyraRtpPayloadTest, BitrateChangeEndsPacket) {
+  auto payloader = LyraRtpPayloader::Create(kPayloadType, kSsrc,
+                                            /*frames_per_packet=*/4);
+  ASSERT_NE(payloader, nullptr);
+  const std::vector<uint8_t> low =
+      Frame(GetSupportedQuantizedBits().front(), /*first=*/0);
+  const std::vector<uint8_t> high =
+      Frame(GetSupportedQuantizedBits().back(), /*first=*/0);
+
+  ASSERT_TRUE(payloader->AddFrame(low).has_value());
+  const auto packet = payloader->AddFrame(high);
+  ASSERT_TRUE(packet.has_value());
+  EXPECT_EQ(Gather(packet.value()).size(), kRtpHeaderSize + low.size());
+  EXPECT_EQ(Gather(payloader->Flush()).size(), kRtpHeaderSize + high.size());
+
+  EXPECT_FALSE(payloader->AddFrame(std::vector<uint8_t>(low.size() + 1))
+                   .has_value());
+}
+
+TEST_F(LyraRtpPayloadTest, DepayloaderCountsLostAndReorderedPackets) {
+  auto payloader = LyraRtpPayloader::Create(kPayloadType, kSsrc,
+                                            /*frames_per_packet=*/1,
+                                            /*first_sequence_number=*/0xFFFE,
+                                            /*first_timestamp=*/0xFFFFFFFF);
+  ASSERT_NE(payloader, nullptr);
+  const std::vector<uint8_t> frame = Frame(num_quantized_bits_, 0);
+  std::vector<std::vector<uint8_t>> packets;
+  for (int i = 0; i < 4; ++i) {
+    packets.push_back(Gather(payloader->AddFrame(frame).value()));
+  }
+
+  // Sequence numbers and timestamps wrap around after the first packet.
+  ASSERT_TRUE(depayloader_->Depayload(packets[0]).has_value());
+  const auto after_loss = depayloader_->Depayload(packets[2]);
+  ASSERT_TRUE(after_loss.has_value());
+  EXPECT_EQ(after_loss->num_lost_packets, 1);
+  EXPECT_EQ(after_loss->num_missing_hops, 1);
+  const auto late = depayloader_->Depayload(packets[1]);
+  ASSERT_TRUE(late.has_value());
+  EXPECT_EQ(late->num_lost_packets, -2);
+  EXPECT_EQ(late->num_missing_hops, -2);
+  const auto in_order = depayloader_->Depayload(packets[3]);
+  ASSERT_TRUE(in_order.has_value());
+  EXPECT_EQ(in_order->num_lost_packets, 0);
+  EXPECT_EQ(in_order->num_missing_hops, 0);
+}
+
+TEST_F(LyraRtpPayloadTest, DepayloaderSkipsCsrcsExtensionAndPadding) {
+  const std::vector<uint8_t> frame = Frame(num_quantized_bits_, 0);
+  // Version 2 with padding, an extension and one CSRC.
+  std::vector<uint8_t> packet = {0xB1, kPayloadType, 0, 1, 0, 0, 0, 2,
+                                 0,    0,            0, 3};
+  packet.insert(packet.end(), {1, 2, 3, 4});
+  packet.insert(packet.end(), {0xBE, 0xDE, 0, 1, 9, 9, 9, 9});
+  packet.insert(packet.end(), frame.begin(), frame.end());
+  packet.insert(packet.end(), {0, 0, 3});
+
+  const auto parsed = depayloader_->Depayload(packet);
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_FALSE(parsed->header.marker);
+  ASSERT_EQ(parsed->num_frames, 1);
+  EXPECT_EQ(std::vector<uint8_t>(parsed->frames[0].begin(),
+                                 parsed->frames[0].end()),
+            frame);
+}
+
+TEST_F(LyraRtpPayloadTest, RejectsInvalidPackets) {
+  EXPECT_EQ(LyraRtpPayloader::Create(128, kSsrc, 1), nullptr);
+  EXPECT_EQ(LyraRtpPayloader::Create(kPayloadType, kSsrc, 0), nullptr);
+  EXPECT_EQ(LyraRtpPayloader::Create(kPayloadType, kSsrc,
+                                     kMaxFramesPerSuperframe + 1),
+            nullptr);
+  EXPECT_EQ(LyraRtpDepayloader::Create(-1), nullptr);
+
+  auto payloader = LyraRtpPayloader::Create(kPayloadType, kSsrc, 1);
+  ASSERT_NE(payloader, nullptr);
+  const std::vector<uint8_t> frame = Frame(num_quantized_bits_, 0);
+  const std::vector<uint8_t> packet =
+      Gather(payloader->AddFrame(frame).value());
+
+  EXPECT_FALSE(depayloader_->Depayload(absl::MakeConstSpan(packet).subspan(
+                   0, kRtpHeaderSize - 1)));
+  EXPECT_FALSE(depayloader_->Depayload(absl::MakeConstSpan(packet).subspan(
+                   0, packet.size() - 1)));
+  std::vector<uint8_t> wrong_version = packet;
+  wrong_version[0] = 0x40;
+  EXPECT_FALSE(depayloader_->Depayload(wrong_version));
+  std::vector<uint8_t> wrong_payload_type = packet;
+  wrong_payload_type[1] = kPayloadType + 1;
+  EXPECT_FALSE(depayloader_->Depayload(wrong_payload_type));
+  std::vector<uint8_t> too_much_padding = packet;
+  too_much_padding[0] |= 0x20;
+  too_much_padding.back() = 0xFF;
+  EXPECT_FALSE(depayloader_->Depayload(too_much_padding));
+}
+
+// Sends the packets of a real encoder through a local UDP socket pair and
+// decodes them straight from the receive buffer.
+TEST_F(LyraRtpPayloadTest, UdpLoopback) {
+  const ghc::filesystem::path model_path =
+      ghc::filesystem::current_path() / "lyra/model_coeffs";
+  const int bitrate = GetBitrate(num_quantized_bits_);
+  auto encoder = LyraEncoder::Create(kInternalSampleRateHz, kNumChannels,
+                                     bitrate, /*enable_dtx=*/false, model_path);
+  auto decoder =
+      LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path);
+  ASSERT_NE(encoder, nullptr);
+  ASSERT_NE(decoder, nullptr);
+
+  const int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+  const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(receiver, 0);
+  ASSERT_GE(sender, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  ASSERT_EQ(bind(receiver, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)),
+            0);
+  socklen_t address_size = sizeof(address);
+  ASSERT_EQ(getsockname(receiver, reinterpret_cast<sockaddr*>(&address),
+                        &address_size),
+            0);
+  ASSERT_EQ(connect(sender, reinterpret_cast<sockaddr*>(&address),
+                    sizeof(address)),
+            0);
+
+  constexpr int kFramesPerPacket = 3;
+  constexpr int kNumPackets = 4;
+  auto payloader =
+      LyraRtpPayloader::Create(kPayloadType, kSsrc, kFramesPerPacket);
+  ASSERT_NE(payloader, nullptr);
+  std::vector<int16_t> hop(num_timestamps_per_hop_);
+  std::vector<std::vector<uint8_t>> frames;
+  // Reserved, since the payloader points into the frames until they are sent.
+  frames.reserve(kFramesPerPacket);
+  uint8_t receive_buffer[1500];
+  for (int packet_index = 0; packet_index < kNumPackets; ++packet_index) {
+    frames.clear();
+    absl::Span<const iovec> packet;
+    while (packet.empty()) {
+      for (int i = 0; i < hop.size(); ++i) {
+        hop[i] = 8000 * std::sin(0.05 * (frames.size() + i));
+      }
+      auto frame = encoder->Encode(hop);
+      ASSERT_TRUE(frame.has_value());
+      frames.push_back(std::move(frame.value()));
+      const auto added = payloader->AddFrame(frames.back());
+      ASSERT_TRUE(added.has_value());
+      packet = added.value();
+    }
+    msghdr message = {};
+    message.msg_iov = const_cast<iovec*>(packet.data());
+    message.msg_iovlen = packet.size();
+    ASSERT_EQ(sendmsg(sender, &message, 0),
+              kRtpHeaderSize + kFramesPerPacket * frames[0].size());
+
+    const ssize_t received =
+        recv(receiver, receive_buffer, sizeof(receive_buffer), 0);
+    ASSERT_GT(received, 0);
+    const auto parsed =
+        depayloader_->Depayload(absl::MakeConstSpan(receive_buffer, received));
+    ASSERT_TRUE(parsed.has_value());
+    EXPECT_EQ(parsed->header.sequence_number, packet_index);
+    EXPECT_EQ(parsed->num_missing_hops, 0);
+    ASSERT_EQ(parsed->num_frames, kFramesPerPacket);
+    for (int i = 0; i < parsed->num_frames; ++i) {
+      EXPECT_EQ(std::vector<uint8_t>(parsed->frames[i].begin(),
+                                     parsed->frames[i].end()),
+                frames[i]);
+      ASSERT_TRUE(decoder->SetEncodedPacket(parsed->frames[i]));
+    }
+    EXPECT_TRUE(decoder->DecodeSamples(kFramesPerPacket * hop.size())
+                    .has_value());
+  }
+  close(sender);
+  close(receiver);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
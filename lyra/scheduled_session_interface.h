@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SCHEDULED_SESSION_INTERFACE_H_
+#define LYRA_SCHEDULED_SESSION_INTERFACE_H_
+
+#include "lyra/quality_level.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Which sessions give up quality first when a worker is overloaded.
+enum class SessionPriority { kLow, kNormal, kHigh };
+
+// An interface for a real-time stream run by a |SessionScheduler|, typically
+// wrapping a LyraEncoder or LyraDecoder together with the queues that feed it
+// and collect its output.
+class ScheduledSessionInterface {
+ public:
+  virtual ~ScheduledSessionInterface() {}
+
+  // Processes one frame. Returns false if the session failed and should not
+  // be scheduled any more.
+  virtual bool ProcessFrame() = 0;
+
+  virtual SessionPriority priority() const { return SessionPriority::kNormal; }
+
+  // Called before every frame when the scheduler does overload control.
+  // Sessions that cannot trade quality for time may ignore it.
+  virtual void SetQualityLevel(QualityLevel quality_level) {}
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SCHEDULED_SESSION_INTERFACE_H_
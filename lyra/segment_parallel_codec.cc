@@ -0,0 +1,242 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/segment_parallel_codec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/dsp_utils.h"
+#include "lyra/log_mel_spectrogram_extractor_impl.h"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Codes the hops in [|first_hop|, |end_hop|) of segment |segment| and keeps
+// the output of the hops from |first_kept_hop| on. Returns false on failure.
+using CodeSegmentFunction = std::function<bool(
+    int segment, int first_hop, int first_kept_hop, int end_hop)>;
+
+// Splits |num_hops| hops into |num_segments| segments and runs
+// |code_segment| on each of them on its own thread. Returns false if any of
+// them failed.
+bool RunInSegments(int num_hops, int num_segments, int num_warmup_hops,
+                   const CodeSegmentFunction& code_segment) {
+  // Each thread writes only its own element, so this is not a vector<bool>.
+  std::vector<char> succeeded(num_segments, false);
+  std::vector<std::thread> threads;
+  threads.reserve(num_segments);
+  for (int segment = 0; segment < num_segments; ++segment) {
+    const int first_kept_hop =
+        static_cast<int64_t>(segment) * num_hops / num_segments;
+    const int end_hop =
+        static_cast<int64_t>(segment + 1) * num_hops / num_segments;
+    const int first_hop = std::max(0, first_kept_hop - num_warmup_hops);
+    threads.emplace_back([&, segment, first_hop, first_kept_hop, end_hop]() {
+      succeeded[segment] =
+          code_segment(segment, first_hop, first_kept_hop, end_hop);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return std::all_of(succeeded.begin(), succeeded.end(),
+                     [](char segment_succeeded) { return segment_succeeded; });
+}
+
+bool AreSegmentParamsValid(int num_segments, int num_warmup_hops) {
+  if (num_segments < 1) {
+    LOG(ERROR) << "The number of segments has to be positive.";
+    return false;
+  }
+  if (num_warmup_hops < 0) {
+    LOG(ERROR) << "The number of warm-up hops can not be negative.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::optional<std::vector<uint8_t>> EncodeInSegments(
+    absl::Span<const int16_t> audio, int sample_rate_hz, int bitrate,
+    bool enable_dtx, const ghc::filesystem::path& model_path, int num_segments,
+    int num_warmup_hops) {
+  if (!AreSegmentParamsValid(num_segments, num_warmup_hops)) {
+    return std::nullopt;
+  }
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz);
+  const int num_hops = audio.size() / num_samples_per_hop;
+  num_segments = std::max(1, std::min(num_segments, num_hops));
+
+  // Packets of noise hops are empty with DTX, so segments are collected
+  // separately instead of being written to precomputed offsets.
+  std::vector<std::vector<uint8_t>> encoded_segments(num_segments);
+  const bool success = RunInSegments(
+      num_hops, num_segments, num_warmup_hops,
+      [&](int segment, int first_hop, int first_kept_hop, int end_hop) {
+        auto encoder = LyraEncoder::Create(sample_rate_hz, kNumChannels,
+                                           bitrate, enable_dtx, model_path);
+        if (encoder == nullptr) {
+          LOG(ERROR) << "Could not create encoder for segment " << segment
+                     << ".";
+          return false;
+        }
+        for (int hop = first_hop; hop < end_hop; ++hop) {
+          const auto packet = encoder->Encode(
+              audio.subspan(hop * num_samples_per_hop, num_samples_per_hop));
+          if (!packet.has_value()) {
+            LOG(ERROR) << "Unable to encode hop " << hop << ".";
+            return false;
+          }
+          if (hop >= first_kept_hop) {
+            encoded_segments[segment].insert(encoded_segments[segment].end(),
+                                             packet->begin(), packet->end());
+          }
+        }
+        return true;
+      });
+  if (!success) {
+    return std::nullopt;
+  }
+
+  std::vector<uint8_t> encoded;
+  for (const auto& encoded_segment : encoded_segments) {
+    encoded.insert(encoded.end(), encoded_segment.begin(),
+                   encoded_segment.end());
+  }
+  return encoded;
+}
+
+std::optional<std::vector<int16_t>> DecodeInSegments(
+    absl::Span<const uint8_t> packets, int packet_size, int sample_rate_hz,
+    const ghc::filesystem::path& model_path,
+    const std::vector<bool>& is_packet_received, int num_segments,
+    int num_warmup_hops) {
+  if (!AreSegmentParamsValid(num_segments, num_warmup_hops)) {
+    return std::nullopt;
+  }
+  if (packet_size <= 0 || packets.size() % packet_size != 0) {
+    LOG(ERROR) << "Packets of " << packets.size()
+               << " bytes can not be split into packets of " << packet_size
+               << " bytes.";
+    return std::nullopt;
+  }
+  const int num_packets = packets.size() / packet_size;
+  if (!is_packet_received.empty() &&
+      is_packet_received.size() != num_packets) {
+    LOG(ERROR) << "Got " << is_packet_received.size()
+               << " packet reception flags for " << num_packets
+               << " packets.";
+    return std::nullopt;
+  }
+  num_segments = std::max(1, std::min(num_segments, num_packets));
+
+  // Every packet decodes to one hop, so segments are written in place.
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz);
+  std::vector<int16_t> decoded(num_packets * num_samples_per_hop);
+  const bool success = RunInSegments(
+      num_packets, num_segments, num_warmup_hops,
+      [&](int segment, int first_hop, int first_kept_hop, int end_hop) {
+        auto decoder =
+            LyraDecoder::Create(sample_rate_hz, kNumChannels, model_path);
+        if (decoder == nullptr) {
+          LOG(ERROR) << "Could not create decoder for segment " << segment
+                     << ".";
+          return false;
+        }
+        for (int hop = first_hop; hop < end_hop; ++hop) {
+          if ((is_packet_received.empty() || is_packet_received[hop]) &&
+              !decoder->SetEncodedPacket(
+                  packets.subspan(hop * packet_size, packet_size))) {
+            LOG(ERROR) << "Unable to set encoded packet " << hop << ".";
+            return false;
+          }
+          const auto samples = decoder->DecodeSamples(num_samples_per_hop);
+          if (!samples.has_value() ||
+              samples->size() != num_samples_per_hop) {
+            LOG(ERROR) << "Unable to decode packet " << hop << ".";
+            return false;
+          }
+          if (hop >= first_kept_hop) {
+            std::copy(samples->begin(), samples->end(),
+                      decoded.begin() + hop * num_samples_per_hop);
+          }
+        }
+        return true;
+      });
+  if (!success) {
+    return std::nullopt;
+  }
+  return decoded;
+}
+
+std::optional<float> MeanLogSpectralDistance(
+    absl::Span<const int16_t> reference, absl::Span<const int16_t> test,
+    int sample_rate_hz) {
+  if (reference.size() != test.size()) {
+    LOG(ERROR) << "Can not compare " << reference.size() << " samples with "
+               << test.size() << " samples.";
+    return std::nullopt;
+  }
+  const int num_samples_per_hop = GetNumSamplesPerHop(sample_rate_hz);
+  const int num_samples_per_window = GetNumSamplesPerWindow(sample_rate_hz);
+  // Extractors are stateful, so each signal needs its own.
+  auto reference_extractor = LogMelSpectrogramExtractorImpl::Create(
+      sample_rate_hz, num_samples_per_hop, num_samples_per_window,
+      kNumMelBins);
+  auto test_extractor = LogMelSpectrogramExtractorImpl::Create(
+      sample_rate_hz, num_samples_per_hop, num_samples_per_window,
+      kNumMelBins);
+  if (reference_extractor == nullptr || test_extractor == nullptr) {
+    LOG(ERROR) << "Could not create log mel spectrogram extractors.";
+    return std::nullopt;
+  }
+
+  float distance_sum = 0.f;
+  int num_hops = 0;
+  for (int hop_begin = 0; hop_begin + num_samples_per_hop <= reference.size();
+       hop_begin += num_samples_per_hop) {
+    const auto reference_features = reference_extractor->Extract(
+        reference.subspan(hop_begin, num_samples_per_hop));
+    const auto test_features =
+        test_extractor->Extract(test.subspan(hop_begin, num_samples_per_hop));
+    if (!reference_features.has_value() || !test_features.has_value()) {
+      return std::nullopt;
+    }
+    const auto distance =
+        LogSpectralDistance(reference_features.value(), test_features.value());
+    if (!distance.has_value()) {
+      return std::nullopt;
+    }
+    distance_sum += distance.value();
+    ++num_hops;
+  }
+  return num_hops > 0 ? distance_sum / num_hops : 0.f;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SEGMENT_PARALLEL_CODEC_H_
+#define LYRA_SEGMENT_PARALLEL_CODEC_H_
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "include/ghc/filesystem.hpp"
+
+namespace chromemedia {
+namespace codec {
+
+// Segment-parallel coding of whole recordings, for batch transcoding.
+//
+// The recording is split at hop boundaries into |num_segments| segments of
+// about equal length, and each segment is coded on its own thread by its own
+// encoder or decoder. Since those are stateful, each segment is preceded by
+// up to |num_warmup_hops| hops of the previous segment whose output is
+// discarded, so that the state has settled by the first hop that is kept.
+// The kept outputs are concatenated in order.
+//
+// The first segment is coded exactly as serially. The others differ slightly
+// around their start, since the state of the models only approximates the
+// serial one; |MeanLogSpectralDistance| measures by how much.
+
+// Long enough for the recurrent state of the models to forget that they
+// started from silence.
+inline constexpr int kDefaultNumWarmupHops = 10;
+
+// Encodes every complete hop of |audio| and returns the concatenated packets,
+// like encoding them one hop at a time with a |LyraEncoder| created from the
+// same parameters would. Returns a nullopt on failure.
+std::optional<std::vector<uint8_t>> EncodeInSegments(
+    absl::Span<const int16_t> audio, int sample_rate_hz, int bitrate,
+    bool enable_dtx, const ghc::filesystem::path& model_path, int num_segments,
+    int num_warmup_hops = kDefaultNumWarmupHops);
+
+// Decodes |packets| of |packet_size| bytes each into one hop of audio at
+// |sample_rate_hz| per packet. Packets for which |is_packet_received| is false
+// are concealed, as if they were lost; an empty |is_packet_received| means
+// that all packets were received. Returns a nullopt on failure.
+std::optional<std::vector<int16_t>> DecodeInSegments(
+    absl::Span<const uint8_t> packets, int packet_size, int sample_rate_hz,
+    const ghc::filesystem::path& model_path,
+    const std::vector<bool>& is_packet_received, int num_segments,
+    int num_warmup_hops = kDefaultNumWarmupHops);
+
+// Returns the mean log-spectral distance in dB between the log mel
+// spectrograms of |reference| and |test|, both sampled at |sample_rate_hz|,
+// or a nullopt if they differ in length.
+std::optional<float> MeanLogSpectralDistance(
+    absl::Span<const int16_t> reference, absl::Span<const int16_t> test,
+    int sample_rate_hz);
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SEGMENT_PARALLEL_CODEC_H_
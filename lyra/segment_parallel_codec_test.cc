@@ -0,0 +1,163 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/segment_parallel_codec.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/wav_utils.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kSampleRateHz = 16000;
+constexpr int kNumHops = 150;
+constexpr int kNumSegments = 3;
+
+class SegmentParallelCodecTest : public testing::Test {
+ protected:
+  SegmentParallelCodecTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs"),
+        bitrate_(GetBitrate(GetSupportedQuantizedBits().front())),
+        packet_size_(BitrateToPacketSize(bitrate_)),
+        num_samples_per_hop_(GetNumSamplesPerHop(kSampleRateHz)) {}
+
+  void SetUp() override {
+    const absl::StatusOr<ReadWavResult> wav = Read16BitWavFileToVector(
+        (ghc::filesystem::current_path() / "lyra/testdata/sample1_16kHz.wav")
+            .string());
+    ASSERT_TRUE(wav.ok());
+    ASSERT_EQ(wav->sample_rate_hz, kSampleRateHz);
+    ASSERT_GE(wav->samples.size(), kNumHops * num_samples_per_hop_);
+    audio_.assign(wav->samples.begin(),
+                  wav->samples.begin() + kNumHops * num_samples_per_hop_);
+  }
+
+  std::optional<std::vector<uint8_t>> Encode(int num_segments) {
+    return EncodeInSegments(audio_, kSampleRateHz, bitrate_,
+                            /*enable_dtx=*/false, model_path_, num_segments);
+  }
+
+  std::optional<std::vector<int16_t>> Decode(
+      const std::vector<uint8_t>& packets, int num_segments,
+      const std::vector<bool>& is_packet_received = {}) {
+    return DecodeInSegments(packets, packet_size_, kSampleRateHz, model_path_,
+                            is_packet_received, num_segments);
+  }
+
+  const ghc::filesystem::path model_path_;
+  const int bitrate_;
+  const int packet_size_;
+  const int num_samples_per_hop_;
+  std::vector<int16_t> audio_;
+};
+
+TEST_F(SegmentParallelCodecTest, FirstSegmentIsEncodedAsSerially) {
+  const auto serial = Encode(1);
+  const auto segmented = Encode(kNumSegments);
+  ASSERT_TRUE(serial.has_value());
+  ASSERT_TRUE(segmented.has_value());
+  ASSERT_EQ(serial->size(), kNumHops * packet_size_);
+  ASSERT_EQ(segmented->size(), serial->size());
+
+  const int first_segment_size = kNumHops / kNumSegments * packet_size_;
+  EXPECT_EQ(std::vector<uint8_t>(segmented->begin(),
+                                 segmented->begin() + first_segment_size),
+            std::vector<uint8_t>(serial->begin(),
+                                 serial->begin() + first_segment_size));
+}
+
+TEST_F(SegmentParallelCodecTest, DecodedAudioIsCloseToSerial) {
+  const auto packets = Encode(1);
+  ASSERT_TRUE(packets.has_value());
+  const auto serial = Decode(*packets, 1);
+  const auto segmented = Decode(*packets, kNumSegments);
+  ASSERT_TRUE(serial.has_value());
+  ASSERT_TRUE(segmented.has_value());
+  ASSERT_EQ(serial->size(), audio_.size());
+  ASSERT_EQ(segmented->size(), serial->size());
+
+  const auto distance =
+      MeanLogSpectralDistance(*serial, *segmented, kSampleRateHz);
+  ASSERT_TRUE(distance.has_value());
+  EXPECT_LT(distance.value(), 1.f);
+}
+
+TEST_F(SegmentParallelCodecTest, ConcealsLostPackets) {
+  const auto packets = Encode(kNumSegments);
+  ASSERT_TRUE(packets.has_value());
+  std::vector<bool> is_packet_received(kNumHops, true);
+  // Losses in the warm-up hops of the second segment and inside it.
+  for (int hop = 45; hop < 60; ++hop) {
+    is_packet_received[hop] = false;
+  }
+  const auto decoded = Decode(*packets, kNumSegments, is_packet_received);
+  ASSERT_TRUE(decoded.has_value());
+  EXPECT_EQ(decoded->size(), audio_.size());
+}
+
+TEST_F(SegmentParallelCodecTest, HandlesMoreSegmentsThanHops) {
+  audio_.resize(2 * num_samples_per_hop_);
+  const auto packets = Encode(kNumSegments);
+  ASSERT_TRUE(packets.has_value());
+  EXPECT_EQ(packets->size(), 2 * packet_size_);
+  const auto decoded = Decode(*packets, kNumSegments);
+  ASSERT_TRUE(decoded.has_value());
+  EXPECT_EQ(decoded->size(), audio_.size());
+}
+
+TEST_F(SegmentParallelCodecTest, RejectsInvalidParams) {
+  EXPECT_FALSE(Encode(0).has_value());
+  EXPECT_FALSE(EncodeInSegments(audio_, kSampleRateHz, bitrate_,
+                                /*enable_dtx=*/false, model_path_,
+                                kNumSegments, /*num_warmup_hops=*/-1)
+                   .has_value());
+
+  const std::vector<uint8_t> packets(2 * packet_size_);
+  EXPECT_FALSE(Decode(packets, 0).has_value());
+  EXPECT_FALSE(Decode(std::vector<uint8_t>(packets.size() + 1), kNumSegments)
+                   .has_value());
+  EXPECT_FALSE(Decode(packets, kNumSegments, std::vector<bool>(3, true))
+                   .has_value());
+}
+
+TEST(MeanLogSpectralDistanceTest, IsZeroForIdenticalAudio) {
+  std::vector<int16_t> audio(10 * GetNumSamplesPerHop(kSampleRateHz));
+  for (int i = 0; i < audio.size(); ++i) {
+    audio[i] = (i * 37) % 2000 - 1000;
+  }
+  const auto distance = MeanLogSpectralDistance(audio, audio, kSampleRateHz);
+  ASSERT_TRUE(distance.has_value());
+  EXPECT_FLOAT_EQ(distance.value(), 0.f);
+
+  EXPECT_FALSE(MeanLogSpectralDistance(
+                   audio, absl::MakeConstSpan(audio).subspan(1), kSampleRateHz)
+                   .has_value());
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,358 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/session_scheduler.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif  // __linux__
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/overload_controller.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// How often an idle worker looks for sessions to steal.
+constexpr absl::Duration kStealPollInterval = absl::Microseconds(500);
+
+class RealClock : public SessionScheduler::Clock {
+ public:
+  absl::Time Now() override { return absl::Now(); }
+
+  void WaitWithDeadline(absl::CondVar* cond_var, absl::Mutex* mutex,
+                        absl::Time deadline) override
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    cond_var->WaitWithDeadline(mutex, deadline);
+  }
+};
+
+SessionScheduler::Clock* GetRealClock() {
+  static RealClock* const real_clock = new RealClock;
+  return real_clock;
+}
+
+void PinCurrentThreadToCore(int worker_index) {
+#ifdef __linux__
+  const int num_cores =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(worker_index % num_cores, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOG(WARNING) << "Could not pin worker " << worker_index << " to a core.";
+  }
+#endif  // __linux__
+}
+
+}  // namespace
+
+struct SessionScheduler::Session {
+  int64_t id;
+  std::unique_ptr<ScheduledSessionInterface> session;
+  // Fields below are guarded by the mutex of the worker owning the session.
+  // The deadline of the current frame is |release| + the frame period.
+  absl::Time release;
+  // Running sessions are never moved to another worker.
+  bool running = false;
+  // Set by |RemoveSession()|, after which the session is neither run nor
+  // moved to another worker again.
+  bool removing = false;
+  SessionStats stats = {};
+};
+
+struct SessionScheduler::Worker {
+  absl::Mutex mutex;
+  // Signaled when sessions are added, a frame finishes, or on shutdown.
+  absl::CondVar cond_var;
+  std::vector<std::shared_ptr<Session>> sessions ABSL_GUARDED_BY(mutex);
+  bool stop ABSL_GUARDED_BY(mutex) = false;
+};
+
+std::unique_ptr<SessionScheduler> SessionScheduler::Create(
+    const Options& options) {
+  if (options.num_workers < 1) {
+    LOG(ERROR) << "The number of workers has to be positive.";
+    return nullptr;
+  }
+  if (options.frame_period <= absl::ZeroDuration()) {
+    LOG(ERROR) << "The frame period has to be positive.";
+    return nullptr;
+  }
+  if (options.enable_overload_control &&
+      OverloadController::Create(options.overload_options) == nullptr) {
+    LOG(ERROR) << "Invalid overload control options.";
+    return nullptr;
+  }
+  auto scheduler = absl::WrapUnique(new SessionScheduler(options));
+  for (int i = 0; i < options.num_workers; ++i) {
+    scheduler->threads_.emplace_back(&SessionScheduler::RunWorker,
+                                     scheduler.get(), i);
+  }
+  return scheduler;
+}
+
+SessionScheduler::SessionScheduler(const Options& options)
+    : options_(options),
+      clock_(options.clock != nullptr ? options.clock : GetRealClock()) {
+  for (int i = 0; i < options.num_workers; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+}
+
+SessionScheduler::~SessionScheduler() {
+  for (auto& worker : workers_) {
+    absl::MutexLock lock(&worker->mutex);
+    worker->stop = true;
+    worker->cond_var.SignalAll();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+int64_t SessionScheduler::AddSession(
+    std::unique_ptr<ScheduledSessionInterface> session, int worker) {
+  auto scheduled = std::make_shared<Session>();
+  {
+    absl::MutexLock lock(&id_mutex_);
+    scheduled->id = next_id_++;
+  }
+  scheduled->session = std::move(session);
+
+  if (worker < 0 || worker >= num_workers()) {
+    size_t fewest_sessions = SIZE_MAX;
+    for (int i = 0; i < num_workers(); ++i) {
+      absl::MutexLock lock(&workers_[i]->mutex);
+      if (workers_[i]->sessions.size() < fewest_sessions) {
+        fewest_sessions = workers_[i]->sessions.size();
+        worker = i;
+      }
+    }
+  }
+  absl::MutexLock lock(&workers_[worker]->mutex);
+  scheduled->release = clock_->Now();
+  scheduled->stats.worker = worker;
+  workers_[worker]->sessions.push_back(scheduled);
+  workers_[worker]->cond_var.SignalAll();
+  return scheduled->id;
+}
+
+std::optional<SessionScheduler::SessionStats> SessionScheduler::RemoveSession(
+    int64_t id) {
+  for (auto& worker : workers_) {
+    std::shared_ptr<Session> removed;
+    {
+      absl::MutexLock lock(&worker->mutex);
+      auto it = std::find_if(
+          worker->sessions.begin(), worker->sessions.end(),
+          [id](const std::shared_ptr<Session>& s) { return s->id == id; });
+      if (it == worker->sessions.end()) {
+        continue;
+      }
+      removed = *it;
+      // Waiting releases the lock, so keep the session from being run again
+      // or stolen by another worker in the meantime.
+      removed->removing = true;
+      while (removed->running) {
+        worker->cond_var.Wait(&worker->mutex);
+      }
+      // The worker may have dropped the session if its frame failed.
+      it = std::find(worker->sessions.begin(), worker->sessions.end(),
+                     removed);
+      if (it == worker->sessions.end()) {
+        return std::nullopt;
+      }
+      worker->sessions.erase(it);
+    }
+    // The session is destroyed here, outside the lock.
+    return removed->stats;
+  }
+  return std::nullopt;
+}
+
+std::optional<SessionScheduler::SessionStats> SessionScheduler::GetSessionStats(
+    int64_t id) const {
+  for (const auto& worker : workers_) {
+    absl::MutexLock lock(&worker->mutex);
+    for (const auto& session : worker->sessions) {
+      if (session->id == id) {
+        return session->stats;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+std::shared_ptr<SessionScheduler::Session> SessionScheduler::TakeReadySession(
+    Worker* worker, absl::Time now) {
+  std::shared_ptr<Session> earliest;
+  for (const auto& session : worker->sessions) {
+    if (!session->running && !session->removing && session->release <= now &&
+        (earliest == nullptr || session->release < earliest->release)) {
+      earliest = session;
+    }
+  }
+  if (earliest != nullptr) {
+    earliest->running = true;
+  }
+  return earliest;
+}
+
+std::shared_ptr<SessionScheduler::Session> SessionScheduler::StealReadySession(
+    int thief, absl::Time now) {
+  for (int offset = 1; offset < num_workers(); ++offset) {
+    const int victim = (thief + offset) % num_workers();
+    // Lock in index order to avoid deadlocks between concurrent thieves.
+    Worker* first = workers_[std::min(thief, victim)].get();
+    Worker* second = workers_[std::max(thief, victim)].get();
+    absl::MutexLock first_lock(&first->mutex);
+    absl::MutexLock second_lock(&second->mutex);
+    std::vector<std::shared_ptr<Session>>& victim_sessions =
+        workers_[victim]->sessions;
+    // A victim that is not running anything will take its ready sessions
+    // itself, and keeping them there preserves core affinity.
+    if (std::none_of(victim_sessions.begin(), victim_sessions.end(),
+                     [](const auto& s) { return s->running; })) {
+      continue;
+    }
+    std::shared_ptr<Session> stolen =
+        TakeReadySession(workers_[victim].get(), now);
+    if (stolen == nullptr) {
+      continue;
+    }
+    victim_sessions.erase(
+        std::find(victim_sessions.begin(), victim_sessions.end(), stolen));
+    stolen->stats.worker = thief;
+    workers_[thief]->sessions.push_back(stolen);
+    return stolen;
+  }
+  return nullptr;
+}
+
+void SessionScheduler::RunWorker(int worker_index) {
+  if (options_.pin_workers_to_cores) {
+    PinCurrentThreadToCore(worker_index);
+  }
+  Worker* worker = workers_[worker_index].get();
+  const bool may_steal = options_.enable_work_stealing && num_workers() > 1;
+  // Only this thread touches the controller. Stolen sessions follow the load
+  // of the worker they were moved to.
+  std::unique_ptr<OverloadController> overload_controller;
+  if (options_.enable_overload_control) {
+    overload_controller = OverloadController::Create(options_.overload_options);
+  }
+  absl::Duration busy_time;
+  absl::Duration budget;
+  while (true) {
+    std::shared_ptr<Session> session;
+    {
+      absl::MutexLock lock(&worker->mutex);
+      if (worker->stop) {
+        return;
+      }
+      session = TakeReadySession(worker, clock_->Now());
+    }
+    if (session == nullptr && may_steal) {
+      session = StealReadySession(worker_index, clock_->Now());
+    }
+    if (session == nullptr) {
+      absl::MutexLock lock(&worker->mutex);
+      absl::Time wake_up = absl::InfiniteFuture();
+      for (const auto& s : worker->sessions) {
+        if (!s->removing) {
+          wake_up = std::min(wake_up, s->release);
+        }
+      }
+      if (may_steal) {
+        wake_up = std::min(wake_up, clock_->Now() + kStealPollInterval);
+      }
+      if (!worker->stop) {
+        clock_->WaitWithDeadline(&worker->cond_var, &worker->mutex, wake_up);
+      }
+      continue;
+    }
+
+    QualityLevel quality_level = QualityLevel::kFull;
+    if (overload_controller != nullptr) {
+      quality_level =
+          overload_controller->GetQualityLevel(session->session->priority());
+      session->session->SetQualityLevel(quality_level);
+    }
+    const absl::Time start = clock_->Now();
+    const bool success = session->session->ProcessFrame();
+    const absl::Time end = clock_->Now();
+
+    // Declared before the lock, so a failed session is destroyed after the
+    // lock is released.
+    std::shared_ptr<Session> failed;
+    absl::MutexLock lock(&worker->mutex);
+    if (overload_controller != nullptr) {
+      busy_time += end - start;
+      // Every session gets an equal share of the frame period.
+      budget += options_.frame_period /
+                std::max<int64_t>(1, worker->sessions.size());
+      if (budget >= options_.frame_period) {
+        overload_controller->Update(busy_time, budget);
+        busy_time = absl::ZeroDuration();
+        budget = absl::ZeroDuration();
+      }
+    }
+    session->running = false;
+    SessionStats& stats = session->stats;
+    ++stats.num_frames;
+    stats.last_processing_time = end - start;
+    stats.quality_level = quality_level;
+    if (quality_level != QualityLevel::kFull) {
+      ++stats.num_degraded_frames;
+    }
+    const absl::Duration lateness =
+        end - (session->release + options_.frame_period);
+    if (lateness > absl::ZeroDuration()) {
+      ++stats.num_deadline_misses;
+      stats.max_lateness = std::max(stats.max_lateness, lateness);
+    }
+    // Frames keep their nominal release times, so a late session catches up
+    // on the frames it fell behind on.
+    session->release += options_.frame_period;
+    if (!success) {
+      LOG(ERROR) << "Session " << session->id << " failed; dropping it.";
+      worker->sessions.erase(std::find(worker->sessions.begin(),
+                                       worker->sessions.end(), session));
+      failed = session;
+    }
+    // Let go of the session before |RemoveSession()| can see it stopped
+    // running, so the session is destroyed by the remover rather than by
+    // this thread after the removal returned.
+    session.reset();
+    worker->cond_var.SignalAll();
+  }
+}
+
+}  // namespace codec
+}  // namespace chromemedia
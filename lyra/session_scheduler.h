@@ -0,0 +1,135 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SESSION_SCHEDULER_H_
+#define LYRA_SESSION_SCHEDULER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "lyra/overload_controller.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Runs many real-time sessions on a fixed pool of worker threads. Every
+// session is released once per frame period and has to finish its frame
+// before the next release. Each worker owns a set of sessions and always runs
+// the ready session with the earliest deadline. Idle workers steal ready
+// sessions from busy ones if work stealing is enabled. With overload control
+// each worker lowers the quality of its sessions when it runs out of time.
+class SessionScheduler {
+ public:
+  // Source of the time the scheduler releases frames and measures their
+  // processing by. Tests replace it to run the scheduler deterministically.
+  class Clock {
+   public:
+    virtual ~Clock() = default;
+
+    virtual absl::Time Now() = 0;
+
+    // Waits on |cond_var| until it is signaled or this clock reaches
+    // |deadline|. May return early.
+    virtual void WaitWithDeadline(absl::CondVar* cond_var, absl::Mutex* mutex,
+                                  absl::Time deadline)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) = 0;
+  };
+
+  struct Options {
+    int num_workers = 1;
+    absl::Duration frame_period = absl::Milliseconds(20);
+    // Pins worker i to core i modulo the number of cores, where supported.
+    bool pin_workers_to_cores = true;
+    // Stolen sessions move to the stealing worker, so with work stealing
+    // enabled sessions must not share thread-affine state such as
+    // |SharedModels| with sessions of other workers.
+    bool enable_work_stealing = true;
+    // Gives every worker an |OverloadController| fed with the time it spends
+    // processing frames, and passes its quality levels to the sessions.
+    bool enable_overload_control = false;
+    OverloadController::Options overload_options;
+    // Not owned, and has to outlive the scheduler. The real time if null.
+    Clock* clock = nullptr;
+  };
+
+  struct SessionStats {
+    int64_t num_frames;
+    int64_t num_deadline_misses;
+    absl::Duration max_lateness;
+    absl::Duration last_processing_time;
+    int worker;
+    // Quality of the last frame, and the number of frames below full quality.
+    QualityLevel quality_level;
+    int64_t num_degraded_frames;
+  };
+
+  // Returns a nullptr if |options| are invalid.
+  static std::unique_ptr<SessionScheduler> Create(const Options& options);
+
+  // Stops all workers and destroys the remaining sessions.
+  ~SessionScheduler();
+
+  // Adds |session| to |worker|, or to the worker with the fewest sessions if
+  // |worker| is negative. Its first frame is released immediately. Returns
+  // the id of the session.
+  int64_t AddSession(std::unique_ptr<ScheduledSessionInterface> session,
+                     int worker = -1);
+
+  // Stops scheduling the session and returns its final stats, or a nullopt if
+  // the id is unknown. A frame that is being processed is finished first.
+  std::optional<SessionStats> RemoveSession(int64_t id);
+
+  // Returns a nullopt if the id is unknown or the session has failed.
+  std::optional<SessionStats> GetSessionStats(int64_t id) const;
+
+  int num_workers() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  struct Session;
+  struct Worker;
+
+  explicit SessionScheduler(const Options& options);
+
+  void RunWorker(int worker_index);
+
+  // Returns the ready session with the earliest deadline of |worker|, marked
+  // as running, or a nullptr. Requires |worker->mutex|.
+  std::shared_ptr<Session> TakeReadySession(Worker* worker, absl::Time now);
+
+  // Moves the ready session with the earliest deadline of any other worker to
+  // |thief| and returns it marked as running, or returns a nullptr.
+  std::shared_ptr<Session> StealReadySession(int thief, absl::Time now);
+
+  const Options options_;
+  Clock* const clock_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+
+  absl::Mutex id_mutex_;
+  int64_t next_id_ ABSL_GUARDED_BY(id_mutex_) = 0;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SESSION_SCHEDULER_H_
@@ -0,0 +1,268 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Finds how many real-time encode+decode streams fit on each core of the
+// SessionScheduler before frames start missing their deadlines. The number
+// of streams per worker is increased step by step until the deadline miss
+// rate exceeds --max_miss_rate.
+//
+// With --benchmark_overload_control the streams are then run at loads of up
+// to twice that capacity, with and without overload control, to show how
+// shedding quality keeps the miss rate down. Every other stream has low
+// priority.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/dsp_utils.h"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+#include "lyra/overload_controller.h"
+#include "lyra/scheduled_session_interface.h"
+#include "lyra/session_scheduler.h"
+
+ABSL_FLAG(std::string, model_path, "lyra/model_coeffs",
+          "Path to directory containing TFLite files.");
+
+ABSL_FLAG(int, num_workers, 0,
+          "Number of worker threads. Uses one per core if not positive.");
+
+ABSL_FLAG(int, sample_rate_hz, 16000, "Sample rate of the streams.");
+
+ABSL_FLAG(int, bitrate, 3200, "Bitrate of the streams in bps.");
+
+ABSL_FLAG(int, max_streams_per_worker, 64,
+          "Upper bound for the number of streams per worker.");
+
+ABSL_FLAG(int, seconds_per_step, 5,
+          "How long each number of streams is run for.");
+
+ABSL_FLAG(double, max_miss_rate, 0.001,
+          "Fraction of frames allowed to miss their deadline.");
+
+ABSL_FLAG(bool, benchmark_overload_control, false,
+          "Whether to compare the miss rate with and without overload "
+          "control beyond the capacity found.");
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Encodes a frame of noise and decodes the packet, as a call leg on a media
+// server would. Under overload the encoder drops to the lowest bitrate, and
+// on comfort noise the decoder stops running LyraGAN.
+class EncodeDecodeSession : public ScheduledSessionInterface {
+ public:
+  static std::unique_ptr<EncodeDecodeSession> Create(
+      int sample_rate_hz, int bitrate, SessionPriority priority,
+      const ghc::filesystem::path& model_path) {
+    auto encoder = LyraEncoder::Create(sample_rate_hz, kNumChannels, bitrate,
+                                       /*enable_dtx=*/false, model_path);
+    auto decoder =
+        LyraDecoder::Create(sample_rate_hz, kNumChannels, model_path);
+    if (encoder == nullptr || decoder == nullptr) {
+      return nullptr;
+    }
+    return std::unique_ptr<EncodeDecodeSession>(
+        new EncodeDecodeSession(sample_rate_hz, bitrate, priority,
+                                std::move(encoder), std::move(decoder)));
+  }
+
+  bool ProcessFrame() override {
+    const auto encoded = encoder_->Encode(absl::MakeConstSpan(audio_));
+    if (!encoded.has_value()) {
+      return false;
+    }
+    if (!decoder_->SetEncodedPacket(*encoded)) {
+      return false;
+    }
+    return decoder_->DecodeSamples(audio_.size()).has_value();
+  }
+
+  SessionPriority priority() const override { return priority_; }
+
+  void SetQualityLevel(QualityLevel quality_level) override {
+    if (quality_level != quality_level_) {
+      encoder_->set_bitrate(GetBitrateForQualityLevel(quality_level, bitrate_));
+      decoder_->set_quality_level(quality_level);
+      quality_level_ = quality_level;
+    }
+  }
+
+ private:
+  EncodeDecodeSession(int sample_rate_hz, int bitrate, SessionPriority priority,
+                      std::unique_ptr<LyraEncoder> encoder,
+                      std::unique_ptr<LyraDecoder> decoder)
+      : bitrate_(bitrate),
+        priority_(priority),
+        quality_level_(QualityLevel::kFull),
+        encoder_(std::move(encoder)),
+        decoder_(std::move(decoder)),
+        audio_(GetNumSamplesPerHop(sample_rate_hz)) {
+    std::uniform_real_distribution<float> distribution(-0.5, 0.5);
+    std::default_random_engine generator;
+    std::generate(audio_.begin(), audio_.end(), [&]() {
+      return UnitToInt16Scalar(distribution(generator));
+    });
+  }
+
+  const int bitrate_;
+  const SessionPriority priority_;
+  QualityLevel quality_level_;
+  const std::unique_ptr<LyraEncoder> encoder_;
+  const std::unique_ptr<LyraDecoder> decoder_;
+  std::vector<int16_t> audio_;
+};
+
+struct StepResult {
+  int64_t num_frames = 0;
+  int64_t num_deadline_misses = 0;
+  int64_t num_degraded_frames = 0;
+  absl::Duration max_lateness;
+
+  double miss_rate() const {
+    return static_cast<double>(num_deadline_misses) /
+           std::max<int64_t>(1, num_frames);
+  }
+};
+
+// Runs |streams_per_worker| streams on each of |num_workers| workers for
+// --seconds_per_step.
+std::optional<StepResult> RunStep(int num_workers, int streams_per_worker,
+                                  bool enable_overload_control) {
+  SessionScheduler::Options options;
+  options.num_workers = num_workers;
+  options.frame_period = absl::Milliseconds(1000 / kFrameRate);
+  options.enable_overload_control = enable_overload_control;
+  auto scheduler = SessionScheduler::Create(options);
+  if (scheduler == nullptr) {
+    return std::nullopt;
+  }
+  // Sessions are created up front, so model loading is not measured.
+  std::vector<std::unique_ptr<EncodeDecodeSession>> sessions;
+  for (int i = 0; i < streams_per_worker * num_workers; ++i) {
+    sessions.push_back(EncodeDecodeSession::Create(
+        absl::GetFlag(FLAGS_sample_rate_hz), absl::GetFlag(FLAGS_bitrate),
+        i % 2 == 0 ? SessionPriority::kNormal : SessionPriority::kLow,
+        absl::GetFlag(FLAGS_model_path)));
+    if (sessions.back() == nullptr) {
+      LOG(ERROR) << "Could not create session.";
+      return std::nullopt;
+    }
+  }
+  std::vector<int64_t> ids;
+  for (auto& session : sessions) {
+    ids.push_back(scheduler->AddSession(std::move(session)));
+  }
+  absl::SleepFor(absl::Seconds(absl::GetFlag(FLAGS_seconds_per_step)));
+
+  StepResult result;
+  for (const int64_t id : ids) {
+    const std::optional<SessionScheduler::SessionStats> stats =
+        scheduler->RemoveSession(id);
+    if (!stats.has_value()) {
+      LOG(ERROR) << "Session " << id << " failed.";
+      return std::nullopt;
+    }
+    result.num_frames += stats->num_frames;
+    result.num_deadline_misses += stats->num_deadline_misses;
+    result.num_degraded_frames += stats->num_degraded_frames;
+    result.max_lateness = std::max(result.max_lateness, stats->max_lateness);
+  }
+  return result;
+}
+
+int RunLoadTest() {
+  int num_workers = absl::GetFlag(FLAGS_num_workers);
+  if (num_workers <= 0) {
+    num_workers =
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  int supported_streams_per_worker = 0;
+  for (int streams_per_worker = 1;
+       streams_per_worker <= absl::GetFlag(FLAGS_max_streams_per_worker);
+       ++streams_per_worker) {
+    const std::optional<StepResult> result =
+        RunStep(num_workers, streams_per_worker,
+                /*enable_overload_control=*/false);
+    if (!result.has_value()) {
+      return -1;
+    }
+    LOG(INFO) << streams_per_worker << " streams per worker: "
+              << result->num_frames << " frames, miss rate "
+              << result->miss_rate() << ", max lateness "
+              << result->max_lateness;
+    if (result->miss_rate() > absl::GetFlag(FLAGS_max_miss_rate)) {
+      break;
+    }
+    supported_streams_per_worker = streams_per_worker;
+  }
+  LOG(INFO) << supported_streams_per_worker
+            << " real-time streams fit per worker on " << num_workers
+            << " workers.";
+  if (!absl::GetFlag(FLAGS_benchmark_overload_control)) {
+    return 0;
+  }
+
+  // Loads are relative to the capacity found above.
+  const int capacity = std::max(1, supported_streams_per_worker);
+  for (const double load : {0.5, 1.0, 1.25, 1.5, 2.0}) {
+    const int streams_per_worker =
+        std::max(1, static_cast<int>(std::lround(load * capacity)));
+    const std::optional<StepResult> uncontrolled =
+        RunStep(num_workers, streams_per_worker,
+                /*enable_overload_control=*/false);
+    const std::optional<StepResult> controlled =
+        RunStep(num_workers, streams_per_worker,
+                /*enable_overload_control=*/true);
+    if (!uncontrolled.has_value() || !controlled.has_value()) {
+      return -1;
+    }
+    LOG(INFO) << "Load " << 100 * load << "% (" << streams_per_worker
+              << " streams per worker): miss rate "
+              << uncontrolled->miss_rate() << " without overload control, "
+              << controlled->miss_rate() << " with it, "
+              << static_cast<double>(controlled->num_degraded_frames) /
+                     std::max<int64_t>(1, controlled->num_frames)
+              << " of frames degraded.";
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(argv[0]);
+  absl::ParseCommandLine(argc, argv);
+  return chromemedia::codec::RunLoadTest();
+}
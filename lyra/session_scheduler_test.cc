@@ -0,0 +1,358 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/session_scheduler.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <set>
+#include <utility>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "lyra/scheduled_session_interface.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Time that only moves when |Advance()| is called, by the test or by sessions
+// that spend simulated processing time. Every move wakes the waiting workers,
+// which then see the new time.
+class FakeClock : public SessionScheduler::Clock {
+ public:
+  absl::Time Now() override {
+    absl::MutexLock lock(&mutex_);
+    return now_;
+  }
+
+  void WaitWithDeadline(absl::CondVar* cond_var, absl::Mutex* mutex,
+                        absl::Time deadline) override
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (now_ >= deadline) {
+        return;
+      }
+      waiters_.insert({cond_var, mutex});
+    }
+    // |Advance()| signals under |mutex|, which is held until the wait starts,
+    // so no move of the clock is missed.
+    cond_var->Wait(mutex);
+    absl::MutexLock lock(&mutex_);
+    waiters_.erase({cond_var, mutex});
+  }
+
+  void Advance(absl::Duration duration) {
+    std::set<std::pair<absl::CondVar*, absl::Mutex*>> waiters;
+    {
+      absl::MutexLock lock(&mutex_);
+      now_ += duration;
+      waiters = waiters_;
+    }
+    for (const auto& [cond_var, mutex] : waiters) {
+      absl::MutexLock lock(mutex);
+      cond_var->SignalAll();
+    }
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::Time now_ ABSL_GUARDED_BY(mutex_) = absl::UnixEpoch();
+  std::set<std::pair<absl::CondVar*, absl::Mutex*>> waiters_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Spends |work| per frame, which moves |clock| if given and sleeps otherwise.
+class FakeSession : public ScheduledSessionInterface {
+ public:
+  explicit FakeSession(absl::Duration work, bool succeed = true,
+                       FakeClock* clock = nullptr)
+      : work_(work), succeed_(succeed), clock_(clock) {}
+
+  bool ProcessFrame() override {
+    if (clock_ != nullptr) {
+      clock_->Advance(work_);
+    } else {
+      absl::SleepFor(work_);
+    }
+    return succeed_;
+  }
+
+ private:
+  const absl::Duration work_;
+  const bool succeed_;
+  FakeClock* const clock_;
+};
+
+// Counts its destruction in |num_destroyed|.
+class CountedFakeSession : public FakeSession {
+ public:
+  CountedFakeSession(absl::Duration work, std::atomic<int>* num_destroyed)
+      : FakeSession(work), num_destroyed_(num_destroyed) {}
+
+  ~CountedFakeSession() override { ++*num_destroyed_; }
+
+ private:
+  std::atomic<int>* const num_destroyed_;
+};
+
+// Blocks in its first frame until |release| is notified.
+class BlockingFakeSession : public ScheduledSessionInterface {
+ public:
+  explicit BlockingFakeSession(const absl::Notification* release)
+      : release_(release) {}
+
+  bool ProcessFrame() override {
+    {
+      absl::MutexLock lock(&mutex_);
+      thread_ = std::this_thread::get_id();
+      started_ = true;
+    }
+    release_->WaitForNotification();
+    return true;
+  }
+
+  // Waits until a frame has started and returns the thread it runs on.
+  std::thread::id WaitForFrame() {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(&started_));
+    return thread_;
+  }
+
+ private:
+  const absl::Notification* const release_;
+  absl::Mutex mutex_;
+  bool started_ ABSL_GUARDED_BY(mutex_) = false;
+  std::thread::id thread_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Needs |full_work| of |clock| per frame at full quality and |degraded_work|
+// otherwise.
+class AdaptiveFakeSession : public ScheduledSessionInterface {
+ public:
+  AdaptiveFakeSession(absl::Duration full_work, absl::Duration degraded_work,
+                      SessionPriority priority, FakeClock* clock)
+      : full_work_(full_work),
+        degraded_work_(degraded_work),
+        priority_(priority),
+        clock_(clock),
+        quality_level_(QualityLevel::kFull) {}
+
+  bool ProcessFrame() override {
+    clock_->Advance(quality_level_ == QualityLevel::kFull ? full_work_
+                                                          : degraded_work_);
+    return true;
+  }
+
+  SessionPriority priority() const override { return priority_; }
+
+  void SetQualityLevel(QualityLevel quality_level) override {
+    quality_level_ = quality_level;
+  }
+
+ private:
+  const absl::Duration full_work_;
+  const absl::Duration degraded_work_;
+  const SessionPriority priority_;
+  FakeClock* const clock_;
+  QualityLevel quality_level_;
+};
+
+// Polls until the session |id| has processed |num_frames| frames. This only
+// waits for the workers to catch up with the fake clock and bounds no time.
+void WaitForFrames(const SessionScheduler& scheduler, int64_t id,
+                   int64_t num_frames) {
+  while (true) {
+    const std::optional<SessionScheduler::SessionStats> stats =
+        scheduler.GetSessionStats(id);
+    if (stats.has_value() && stats->num_frames >= num_frames) {
+      return;
+    }
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+SessionScheduler::Options MakeOptions(int num_workers, bool work_stealing) {
+  SessionScheduler::Options options;
+  options.num_workers = num_workers;
+  options.frame_period = absl::Milliseconds(10);
+  options.pin_workers_to_cores = false;
+  options.enable_work_stealing = work_stealing;
+  return options;
+}
+
+TEST(SessionSchedulerTest, CreateFailsWithInvalidOptions) {
+  EXPECT_EQ(SessionScheduler::Create(MakeOptions(0, false)), nullptr);
+  SessionScheduler::Options options = MakeOptions(1, false);
+  options.frame_period = absl::ZeroDuration();
+  EXPECT_EQ(SessionScheduler::Create(options), nullptr);
+}
+
+TEST(SessionSchedulerTest, ProcessesOneFramePerPeriod) {
+  FakeClock clock;
+  SessionScheduler::Options options = MakeOptions(2, false);
+  options.clock = &clock;
+  auto scheduler = SessionScheduler::Create(options);
+  ASSERT_NE(scheduler, nullptr);
+  const int64_t id =
+      scheduler->AddSession(std::make_unique<FakeSession>(absl::ZeroDuration()));
+  for (int i = 1; i <= 20; ++i) {
+    WaitForFrames(*scheduler, id, i);
+    // Half a period releases no frame, the other half releases one.
+    clock.Advance(absl::Milliseconds(5));
+    clock.Advance(absl::Milliseconds(5));
+  }
+  WaitForFrames(*scheduler, id, 21);
+  const std::optional<SessionScheduler::SessionStats> stats =
+      scheduler->RemoveSession(id);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->num_frames, 21);
+  EXPECT_EQ(stats->num_deadline_misses, 0);
+  EXPECT_FALSE(scheduler->GetSessionStats(id).has_value());
+}
+
+TEST(SessionSchedulerTest, ReportsDeadlineMisses) {
+  FakeClock clock;
+  SessionScheduler::Options options = MakeOptions(1, false);
+  options.clock = &clock;
+  auto scheduler = SessionScheduler::Create(options);
+  ASSERT_NE(scheduler, nullptr);
+  // Every frame takes one and a half periods, so the session is always late.
+  const int64_t slow_id = scheduler->AddSession(std::make_unique<FakeSession>(
+      absl::Milliseconds(15), /*succeed=*/true, &clock));
+  WaitForFrames(*scheduler, slow_id, 2);
+  const std::optional<SessionScheduler::SessionStats> stats =
+      scheduler->RemoveSession(slow_id);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_GT(stats->num_deadline_misses, 0);
+  EXPECT_GE(stats->max_lateness, absl::Milliseconds(5));
+}
+
+TEST(SessionSchedulerTest, IdleWorkersStealFromOverloadedWorker) {
+  FakeClock clock;
+  SessionScheduler::Options options = MakeOptions(2, true);
+  options.clock = &clock;
+  auto scheduler = SessionScheduler::Create(options);
+  ASSERT_NE(scheduler, nullptr);
+  absl::Notification release;
+  auto first = std::make_unique<BlockingFakeSession>(&release);
+  auto second = std::make_unique<BlockingFakeSession>(&release);
+  BlockingFakeSession* const first_ptr = first.get();
+  BlockingFakeSession* const second_ptr = second.get();
+  scheduler->AddSession(std::move(first), /*worker=*/0);
+  scheduler->AddSession(std::move(second), /*worker=*/0);
+  // Worker 0 is stuck in the first session, so the second one can only run
+  // if the idle worker steals it once it looks again.
+  const std::thread::id first_thread = first_ptr->WaitForFrame();
+  clock.Advance(absl::Milliseconds(1));
+  const std::thread::id second_thread = second_ptr->WaitForFrame();
+  release.Notify();
+  EXPECT_NE(first_thread, second_thread);
+}
+
+TEST(SessionSchedulerTest, RemovesSessionsWhileTheyAreStolen) {
+  auto scheduler = SessionScheduler::Create(MakeOptions(2, true));
+  ASSERT_NE(scheduler, nullptr);
+  // The sessions need more than both workers can do, so they are always
+  // ready and keep moving between the workers. Removals regularly have to
+  // wait for a running frame while the session could be stolen.
+  std::atomic<int> num_destroyed = 0;
+  constexpr int kNumSessions = 12;
+  for (int round = 0; round < 20; ++round) {
+    std::vector<int64_t> ids;
+    for (int i = 0; i < kNumSessions; ++i) {
+      ids.push_back(scheduler->AddSession(
+          std::make_unique<CountedFakeSession>(absl::Milliseconds(2),
+                                               &num_destroyed),
+          /*worker=*/0));
+    }
+    absl::SleepFor(absl::Milliseconds(30));
+    for (const int64_t id : ids) {
+      EXPECT_TRUE(scheduler->RemoveSession(id).has_value());
+      EXPECT_FALSE(scheduler->GetSessionStats(id).has_value());
+    }
+    EXPECT_EQ(num_destroyed, (round + 1) * kNumSessions);
+  }
+}
+
+TEST(SessionSchedulerTest, DropsFailedSessions) {
+  auto scheduler = SessionScheduler::Create(MakeOptions(1, false));
+  ASSERT_NE(scheduler, nullptr);
+  const int64_t id = scheduler->AddSession(std::make_unique<FakeSession>(
+      absl::ZeroDuration(), /*succeed=*/false));
+  // The first frame fails, after which the session is gone for good.
+  while (scheduler->GetSessionStats(id).has_value()) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_FALSE(scheduler->RemoveSession(id).has_value());
+}
+
+TEST(SessionSchedulerTest, OverloadControlDegradesLowPrioritySessionsFirst) {
+  FakeClock clock;
+  SessionScheduler::Options options = MakeOptions(1, false);
+  options.clock = &clock;
+  options.enable_overload_control = true;
+  options.overload_options.num_periods_to_degrade = 2;
+  auto scheduler = SessionScheduler::Create(options);
+  ASSERT_NE(scheduler, nullptr);
+  // Together the sessions need 12 ms of every 10 ms period at full quality,
+  // but only 5 ms once the low priority one is degraded.
+  const int64_t low_id =
+      scheduler->AddSession(std::make_unique<AdaptiveFakeSession>(
+          absl::Milliseconds(8), absl::Milliseconds(1), SessionPriority::kLow,
+          &clock));
+  const int64_t high_id =
+      scheduler->AddSession(std::make_unique<AdaptiveFakeSession>(
+          absl::Milliseconds(4), absl::Milliseconds(1), SessionPriority::kHigh,
+          &clock));
+  while (true) {
+    const std::optional<SessionScheduler::SessionStats> stats =
+        scheduler->GetSessionStats(low_id);
+    ASSERT_TRUE(stats.has_value());
+    if (stats->num_degraded_frames > 0) {
+      break;
+    }
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  const std::optional<SessionScheduler::SessionStats> low_stats =
+      scheduler->RemoveSession(low_id);
+  const std::optional<SessionScheduler::SessionStats> high_stats =
+      scheduler->RemoveSession(high_id);
+  ASSERT_TRUE(low_stats.has_value());
+  ASSERT_TRUE(high_stats.has_value());
+  EXPECT_NE(low_stats->quality_level, QualityLevel::kFull);
+  EXPECT_GT(low_stats->num_degraded_frames, 0);
+  EXPECT_EQ(high_stats->quality_level, QualityLevel::kFull);
+  EXPECT_EQ(high_stats->num_degraded_frames, 0);
+}
+
+TEST(SessionSchedulerTest, CreateFailsWithInvalidOverloadOptions) {
+  SessionScheduler::Options options = MakeOptions(1, false);
+  options.enable_overload_control = true;
+  options.overload_options.recovery_utilization = 1.0;
+  EXPECT_EQ(SessionScheduler::Create(options), nullptr);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
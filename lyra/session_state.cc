@@ -0,0 +1,74 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/session_state.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr char kMagic[4] = {'L', 'Y', 'S', 'S'};
+constexpr int kHeaderSize = 6;
+
+}  // namespace
+
+StateWriter::StateWriter(SessionKind kind)
+    : bytes_(std::begin(kMagic), std::end(kMagic)) {
+  bytes_.push_back(kSessionStateVersion);
+  bytes_.push_back(static_cast<uint8_t>(kind));
+}
+
+std::unique_ptr<StateReader> StateReader::Create(
+    absl::Span<const uint8_t> state, SessionKind kind) {
+  if (state.size() < kHeaderSize ||
+      std::memcmp(state.data(), kMagic, sizeof(kMagic)) != 0) {
+    LOG(ERROR) << "The data is not a Lyra session state.";
+    return nullptr;
+  }
+  if (state[4] != kSessionStateVersion) {
+    LOG(ERROR) << "Session state version " << static_cast<int>(state[4])
+               << " is not supported, only version "
+               << static_cast<int>(kSessionStateVersion) << " is.";
+    return nullptr;
+  }
+  if (state[5] != static_cast<uint8_t>(kind)) {
+    LOG(ERROR) << "The session state is of a different kind of session.";
+    return nullptr;
+  }
+  return absl::WrapUnique(new StateReader(state, kHeaderSize));
+}
+
+StateReader::StateReader(absl::Span<const uint8_t> bytes, int offset)
+    : bytes_(bytes), offset_(offset) {}
+
+bool StateReader::at_end() const { return offset_ == bytes_.size(); }
+
+bool StateReader::HasBytes(int64_t num_bytes) const {
+  if (num_bytes > static_cast<int64_t>(bytes_.size()) - offset_) {
+    LOG(ERROR) << "The session state is truncated.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
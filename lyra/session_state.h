@@ -0,0 +1,174 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SESSION_STATE_H_
+#define LYRA_SESSION_STATE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+
+namespace chromemedia {
+namespace codec {
+
+// Binary snapshots of the state of an encoder or decoder session, to move a
+// live session to another process.
+//
+// A snapshot starts with a 6 byte header: "LYSS", the format version and the
+// kind of session. It is followed by the fields of every component of the
+// session, in a fixed order and without tags. All values are little endian,
+// floats are stored as their IEEE 754 bits, and vectors as their 32 bit size
+// followed by their elements. A snapshot can only be restored into a session
+// created with the same models and parameters.
+
+inline constexpr uint8_t kSessionStateVersion = 1;
+
+enum class SessionKind : uint8_t {
+  kEncoder = 1,
+  kDecoder = 2,
+};
+
+namespace internal {
+
+template <int kNumBytes>
+struct UnsignedOfSize;
+template <>
+struct UnsignedOfSize<1> {
+  using Type = uint8_t;
+};
+template <>
+struct UnsignedOfSize<2> {
+  using Type = uint16_t;
+};
+template <>
+struct UnsignedOfSize<4> {
+  using Type = uint32_t;
+};
+template <>
+struct UnsignedOfSize<8> {
+  using Type = uint64_t;
+};
+
+}  // namespace internal
+
+class StateWriter {
+ public:
+  // Starts a snapshot of a |kind| session with its header.
+  explicit StateWriter(SessionKind kind);
+
+  template <typename T>
+  void Write(T value) {
+    static_assert(std::is_arithmetic_v<T>, "Only numbers can be written.");
+    using Bits = typename internal::UnsignedOfSize<sizeof(T)>::Type;
+    Bits bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    for (int i = 0; i < sizeof(T); ++i) {
+      bytes_.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+    }
+  }
+
+  template <typename T>
+  void WriteVector(absl::Span<const T> values) {
+    Write<uint32_t>(values.size());
+    for (const T value : values) {
+      Write(value);
+    }
+  }
+
+  const std::vector<uint8_t>& bytes() const { return bytes_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+};
+
+// Reads the fields of a snapshot in the order they were written. Every read
+// returns false if the snapshot ends before the field does.
+class StateReader {
+ public:
+  // Returns a nullptr if |state| does not start with the header of a
+  // snapshot of a |kind| session in the current format version.
+  static std::unique_ptr<StateReader> Create(absl::Span<const uint8_t> state,
+                                             SessionKind kind);
+
+  template <typename T>
+  bool Read(T* value) {
+    static_assert(std::is_arithmetic_v<T>, "Only numbers can be read.");
+    if (!HasBytes(sizeof(T))) {
+      return false;
+    }
+    using Bits = typename internal::UnsignedOfSize<sizeof(T)>::Type;
+    Bits bits = 0;
+    for (int i = 0; i < sizeof(T); ++i) {
+      bits |= static_cast<Bits>(bytes_[offset_ + i]) << (8 * i);
+    }
+    offset_ += sizeof(T);
+    if constexpr (std::is_same_v<T, bool>) {
+      *value = bits != 0;
+    } else {
+      std::memcpy(value, &bits, sizeof(T));
+    }
+    return true;
+  }
+
+  template <typename T>
+  bool ReadVector(std::vector<T>* values) {
+    uint32_t size;
+    if (!Read(&size) || !HasBytes(static_cast<int64_t>(size) * sizeof(T))) {
+      return false;
+    }
+    values->resize(size);
+    for (T& value : *values) {
+      Read(&value);
+    }
+    return true;
+  }
+
+  // Like |ReadVector|, but also fails unless the vector has |size| elements,
+  // for state whose size is fixed by the parameters of the session.
+  template <typename T>
+  bool ReadVectorOfSize(int size, std::vector<T>* values) {
+    if (!ReadVector(values)) {
+      return false;
+    }
+    if (values->size() != size) {
+      LOG(ERROR) << "Expected " << size << " values in the session state, but "
+                 << "got " << values->size() << ".";
+      return false;
+    }
+    return true;
+  }
+
+  // Returns true once every field has been read.
+  bool at_end() const;
+
+ private:
+  StateReader(absl::Span<const uint8_t> bytes, int offset);
+
+  bool HasBytes(int64_t num_bytes) const;
+
+  const absl::Span<const uint8_t> bytes_;
+  int64_t offset_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SESSION_STATE_H_
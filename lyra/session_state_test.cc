@@ -0,0 +1,123 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/session_state.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+TEST(SessionStateTest, ValuesRoundTrip) {
+  StateWriter writer(SessionKind::kDecoder);
+  writer.Write(true);
+  writer.Write<int32_t>(-12345);
+  writer.Write(std::numeric_limits<int64_t>::min());
+  writer.Write(-0.25f);
+  writer.Write(1e300);
+  writer.WriteVector<int16_t>(std::vector<int16_t>{-32768, 0, 32767});
+  writer.WriteVector<float>(std::vector<float>{});
+
+  auto reader = StateReader::Create(writer.bytes(), SessionKind::kDecoder);
+  ASSERT_NE(reader, nullptr);
+  bool flag;
+  int32_t int32_value;
+  int64_t int64_value;
+  float float_value;
+  double double_value;
+  std::vector<int16_t> int16_values;
+  std::vector<float> float_values = {1.f};
+  ASSERT_TRUE(reader->Read(&flag));
+  ASSERT_TRUE(reader->Read(&int32_value));
+  ASSERT_TRUE(reader->Read(&int64_value));
+  ASSERT_TRUE(reader->Read(&float_value));
+  ASSERT_TRUE(reader->Read(&double_value));
+  ASSERT_TRUE(reader->ReadVectorOfSize(3, &int16_values));
+  EXPECT_FALSE(reader->at_end());
+  ASSERT_TRUE(reader->ReadVector(&float_values));
+  EXPECT_TRUE(reader->at_end());
+
+  EXPECT_TRUE(flag);
+  EXPECT_EQ(int32_value, -12345);
+  EXPECT_EQ(int64_value, std::numeric_limits<int64_t>::min());
+  EXPECT_EQ(float_value, -0.25f);
+  EXPECT_EQ(double_value, 1e300);
+  EXPECT_EQ(int16_values, (std::vector<int16_t>{-32768, 0, 32767}));
+  EXPECT_TRUE(float_values.empty());
+}
+
+TEST(SessionStateTest, ValuesAreLittleEndian) {
+  StateWriter writer(SessionKind::kEncoder);
+  writer.Write<uint32_t>(0x01020304);
+  const std::vector<uint8_t>& bytes = writer.bytes();
+  ASSERT_EQ(bytes.size(), 10);
+  EXPECT_EQ(std::vector<uint8_t>(bytes.begin(), bytes.begin() + 4),
+            (std::vector<uint8_t>{'L', 'Y', 'S', 'S'}));
+  EXPECT_EQ(bytes[4], kSessionStateVersion);
+  EXPECT_EQ(bytes[5], static_cast<uint8_t>(SessionKind::kEncoder));
+  EXPECT_EQ(std::vector<uint8_t>(bytes.begin() + 6, bytes.end()),
+            (std::vector<uint8_t>{4, 3, 2, 1}));
+}
+
+TEST(SessionStateTest, RejectsInvalidHeaders) {
+  std::vector<uint8_t> bytes = StateWriter(SessionKind::kEncoder).bytes();
+  EXPECT_NE(StateReader::Create(bytes, SessionKind::kEncoder), nullptr);
+  EXPECT_EQ(StateReader::Create(bytes, SessionKind::kDecoder), nullptr);
+  EXPECT_EQ(StateReader::Create(absl::MakeConstSpan(bytes).first(5),
+                                SessionKind::kEncoder),
+            nullptr);
+
+  std::vector<uint8_t> other_version = bytes;
+  ++other_version[4];
+  EXPECT_EQ(StateReader::Create(other_version, SessionKind::kEncoder),
+            nullptr);
+  std::vector<uint8_t> other_magic = bytes;
+  other_magic[0] = 'X';
+  EXPECT_EQ(StateReader::Create(other_magic, SessionKind::kEncoder), nullptr);
+}
+
+TEST(SessionStateTest, ReadingPastTheEndFails) {
+  StateWriter writer(SessionKind::kDecoder);
+  writer.Write<int16_t>(7);
+  writer.Write<uint32_t>(1000);
+
+  auto reader = StateReader::Create(writer.bytes(), SessionKind::kDecoder);
+  ASSERT_NE(reader, nullptr);
+  int64_t int64_value;
+  EXPECT_FALSE(reader->Read(&int64_value));
+  int16_t int16_value;
+  ASSERT_TRUE(reader->Read(&int16_value));
+  // The size of the vector exceeds what is left of the state.
+  std::vector<float> values;
+  EXPECT_FALSE(reader->ReadVector(&values));
+}
+
+TEST(SessionStateTest, ReadVectorOfSizeRejectsOtherSizes) {
+  StateWriter writer(SessionKind::kDecoder);
+  writer.WriteVector<float>(std::vector<float>{1.f, 2.f});
+
+  auto reader = StateReader::Create(writer.bytes(), SessionKind::kDecoder);
+  ASSERT_NE(reader, nullptr);
+  std::vector<float> values;
+  EXPECT_FALSE(reader->ReadVectorOfSize(3, &values));
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,125 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/shared_models.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_gan_model.h"
+#include "lyra/model_bundle.h"
+#include "lyra/residual_vector_quantizer.h"
+#include "lyra/soundstream_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+// Forwards to a quantizer owned jointly by all sessions of a worker.
+class SharedVectorQuantizer : public VectorQuantizerInterface {
+ public:
+  explicit SharedVectorQuantizer(
+      std::shared_ptr<const VectorQuantizerInterface> quantizer)
+      : quantizer_(std::move(quantizer)) {}
+
+  std::optional<std::string> Quantize(const std::vector<float>& features,
+                                      int num_bits) const override {
+    return quantizer_->Quantize(features, num_bits);
+  }
+
+  std::optional<std::vector<float>> DecodeToLossyFeatures(
+      const std::string& quantized_features) const override {
+    return quantizer_->DecodeToLossyFeatures(quantized_features);
+  }
+
+  std::optional<std::vector<std::vector<float>>> DecodeFramesToLossyFeatures(
+      const std::vector<std::string>& quantized_frames) const override {
+    return quantizer_->DecodeFramesToLossyFeatures(quantized_frames);
+  }
+
+ private:
+  const std::shared_ptr<const VectorQuantizerInterface> quantizer_;
+};
+
+}  // namespace
+
+std::unique_ptr<SharedModels> SharedModels::Create(
+    const ghc::filesystem::path& model_path) {
+  absl::Status are_params_supported =
+      AreParamsSupported(kInternalSampleRateHz, kNumChannels, model_path);
+  if (!are_params_supported.ok()) {
+    LOG(ERROR) << are_params_supported;
+    return nullptr;
+  }
+  return CreateFromModels(LyraGanModel::CreateModelWrapper(model_path),
+                          SoundStreamEncoder::CreateModelWrapper(model_path),
+                          ResidualVectorQuantizer::Create(model_path));
+}
+
+std::unique_ptr<SharedModels> SharedModels::Create(
+    std::shared_ptr<const ModelBundle> bundle) {
+  return CreateFromModels(LyraGanModel::CreateModelWrapper(bundle),
+                          SoundStreamEncoder::CreateModelWrapper(bundle),
+                          ResidualVectorQuantizer::Create(bundle));
+}
+
+std::unique_ptr<SharedModels> SharedModels::CreateFromModels(
+    std::shared_ptr<TfLiteModelWrapper> generative_model,
+    std::shared_ptr<TfLiteModelWrapper> feature_extractor_model,
+    std::shared_ptr<const VectorQuantizerInterface> quantizer) {
+  if (generative_model == nullptr || feature_extractor_model == nullptr) {
+    return nullptr;
+  }
+  if (quantizer == nullptr) {
+    LOG(ERROR) << "Could not create Vector Quantizer.";
+    return nullptr;
+  }
+  return absl::WrapUnique(new SharedModels(std::move(generative_model),
+                                           std::move(feature_extractor_model),
+                                           std::move(quantizer)));
+}
+
+SharedModels::SharedModels(
+    std::shared_ptr<TfLiteModelWrapper> generative_model,
+    std::shared_ptr<TfLiteModelWrapper> feature_extractor_model,
+    std::shared_ptr<const VectorQuantizerInterface> quantizer)
+    : generative_model_(std::move(generative_model)),
+      feature_extractor_model_(std::move(feature_extractor_model)),
+      quantizer_(std::move(quantizer)) {}
+
+std::unique_ptr<GenerativeModelInterface> SharedModels::CreateGenerativeModel(
+    int num_output_features) const {
+  return LyraGanModel::Create(generative_model_, num_output_features);
+}
+
+std::unique_ptr<FeatureExtractorInterface>
+SharedModels::CreateFeatureExtractor() const {
+  return SoundStreamEncoder::Create(feature_extractor_model_);
+}
+
+std::unique_ptr<VectorQuantizerInterface> SharedModels::CreateQuantizer()
+    const {
+  return std::make_unique<SharedVectorQuantizer>(quantizer_);
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SHARED_MODELS_H_
+#define LYRA_SHARED_MODELS_H_
+
+#include <memory>
+
+#include "include/ghc/filesystem.hpp"
+#include "lyra/feature_extractor_interface.h"
+#include "lyra/generative_model_interface.h"
+#include "lyra/model_bundle.h"
+#include "lyra/tflite_model_wrapper.h"
+#include "lyra/vector_quantizer_interface.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Holds one TFLite interpreter per model, to be shared by all the sessions
+// running on one worker thread. The components created from it only own
+// their recurrent state, so an idle session does not hold any activation
+// arena. Neither this class nor the components it creates are thread safe;
+// all of them have to be used from the same thread.
+class SharedModels {
+ public:
+  // Returns a nullptr if the models in |model_path| are not supported or can
+  // not be loaded.
+  static std::unique_ptr<SharedModels> Create(
+      const ghc::filesystem::path& model_path);
+
+  // Like the above, but loads the models from |bundle|, which the models keep
+  // alive.
+  static std::unique_ptr<SharedModels> Create(
+      std::shared_ptr<const ModelBundle> bundle);
+
+  // Each of these returns a nullptr on failure.
+  std::unique_ptr<GenerativeModelInterface> CreateGenerativeModel(
+      int num_output_features) const;
+
+  std::unique_ptr<FeatureExtractorInterface> CreateFeatureExtractor() const;
+
+  std::unique_ptr<VectorQuantizerInterface> CreateQuantizer() const;
+
+ private:
+  // Returns a nullptr if any of the models is a nullptr.
+  static std::unique_ptr<SharedModels> CreateFromModels(
+      std::shared_ptr<TfLiteModelWrapper> generative_model,
+      std::shared_ptr<TfLiteModelWrapper> feature_extractor_model,
+      std::shared_ptr<const VectorQuantizerInterface> quantizer);
+
+  SharedModels(std::shared_ptr<TfLiteModelWrapper> generative_model,
+               std::shared_ptr<TfLiteModelWrapper> feature_extractor_model,
+               std::shared_ptr<const VectorQuantizerInterface> quantizer);
+
+  const std::shared_ptr<TfLiteModelWrapper> generative_model_;
+  const std::shared_ptr<TfLiteModelWrapper> feature_extractor_model_;
+  // The quantizer has no recurrent state, so it is shared as is.
+  const std::shared_ptr<const VectorQuantizerInterface> quantizer_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SHARED_MODELS_H_
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/shared_models.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Placeholder for get runfiles header.
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+#include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/lyra_decoder.h"
+#include "lyra/lyra_encoder.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+class SharedModelsTest : public testing::Test {
+ protected:
+  SharedModelsTest()
+      : model_path_(ghc::filesystem::current_path() / "lyra/model_coeffs") {}
+
+  const ghc::filesystem::path model_path_;
+};
+
+TEST_F(SharedModelsTest, CreationFailsWithInvalidModelPath) {
+  EXPECT_EQ(SharedModels::Create("invalid/model/path"), nullptr);
+}
+
+TEST_F(SharedModelsTest, CreatesComponents) {
+  auto shared_models = SharedModels::Create(model_path_);
+  ASSERT_NE(shared_models, nullptr);
+  EXPECT_NE(shared_models->CreateGenerativeModel(kNumFeatures), nullptr);
+  EXPECT_NE(shared_models->CreateFeatureExtractor(), nullptr);
+  EXPECT_NE(shared_models->CreateQuantizer(), nullptr);
+}
+
+// Interleaves two sessions on the same shared models and checks that each one
+// produces exactly what a session with its own interpreters produces.
+TEST_F(SharedModelsTest, InterleavedSessionsMatchIndependentSessions) {
+  auto shared_models = SharedModels::Create(model_path_);
+  ASSERT_NE(shared_models, nullptr);
+  const int bitrate = 6000;
+  auto reference_encoder =
+      LyraEncoder::Create(kInternalSampleRateHz, kNumChannels, bitrate,
+                          /*enable_dtx=*/false, model_path_);
+  auto reference_decoder =
+      LyraDecoder::Create(kInternalSampleRateHz, kNumChannels, model_path_);
+  ASSERT_NE(reference_encoder, nullptr);
+  ASSERT_NE(reference_decoder, nullptr);
+
+  std::vector<std::unique_ptr<LyraEncoder>> encoders;
+  std::vector<std::unique_ptr<LyraDecoder>> decoders;
+  for (int i = 0; i < 2; ++i) {
+    encoders.push_back(LyraEncoder::Create(kInternalSampleRateHz, kNumChannels,
+                                           bitrate, /*enable_dtx=*/false,
+                                           *shared_models));
+    decoders.push_back(LyraDecoder::Create(kInternalSampleRateHz, kNumChannels,
+                                           *shared_models));
+    ASSERT_NE(encoders.back(), nullptr);
+    ASSERT_NE(decoders.back(), nullptr);
+  }
+
+  const int num_samples_per_hop = GetNumSamplesPerHop(kInternalSampleRateHz);
+  std::vector<int16_t> audio(num_samples_per_hop);
+  for (int hop = 0; hop < 10; ++hop) {
+    for (int i = 0; i < audio.size(); ++i) {
+      audio[i] = static_cast<int16_t>((hop * 131 + i * 17) % 2000 - 1000);
+    }
+    auto expected_packet =
+        reference_encoder->Encode(absl::MakeConstSpan(audio));
+    ASSERT_TRUE(expected_packet.has_value());
+    ASSERT_TRUE(reference_decoder->SetEncodedPacket(expected_packet.value()));
+    auto expected_samples =
+        reference_decoder->DecodeSamples(num_samples_per_hop);
+    ASSERT_TRUE(expected_samples.has_value());
+
+    for (int session = 0; session < encoders.size(); ++session) {
+      auto packet = encoders[session]->Encode(absl::MakeConstSpan(audio));
+      ASSERT_TRUE(packet.has_value());
+      EXPECT_EQ(packet.value(), expected_packet.value());
+      ASSERT_TRUE(decoders[session]->SetEncodedPacket(packet.value()));
+      auto samples = decoders[session]->DecodeSamples(num_samples_per_hop);
+      ASSERT_TRUE(samples.has_value());
+      EXPECT_EQ(samples.value(), expected_samples.value());
+    }
+  }
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
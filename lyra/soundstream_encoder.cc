@@ -28,34 +28,119 @@
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
 #include "lyra/dsp_utils.h"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
 #include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
 namespace codec {
 
 std::unique_ptr<SoundStreamEncoder> SoundStreamEncoder::Create(
-    const ghc::filesystem::path& model_path) {
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
+  auto model = CreateModelWrapper(model_path, precision);
+  if (model == nullptr) {
+    return nullptr;
+  }
+  return absl::WrapUnique(
+      new SoundStreamEncoder(std::move(model), std::nullopt));
+}
+
+std::unique_ptr<SoundStreamEncoder> SoundStreamEncoder::Create(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  auto model = CreateModelWrapper(std::move(bundle), precision);
+  if (model == nullptr) {
+    return nullptr;
+  }
+  return absl::WrapUnique(
+      new SoundStreamEncoder(std::move(model), std::nullopt));
+}
+
+std::unique_ptr<SoundStreamEncoder> SoundStreamEncoder::Create(
+    std::shared_ptr<TfLiteModelWrapper> shared_model) {
+  if (shared_model == nullptr) {
+    LOG(ERROR) << "Shared SoundStream encoder TFLite model wrapper is null.";
+    return nullptr;
+  }
+  auto variable_tensor_state = shared_model->CreateInitialVariableTensorState();
+  return absl::WrapUnique(new SoundStreamEncoder(
+      std::move(shared_model), std::move(variable_tensor_state)));
+}
+
+std::unique_ptr<TfLiteModelWrapper> SoundStreamEncoder::CreateModelWrapper(
+    const ghc::filesystem::path& model_path, ModelPrecision precision) {
   auto model =
       TfLiteModelWrapper::Create(model_path / "soundstream_encoder.tflite",
-                                 /*use_xnn=*/true, /*int8_quantized=*/true);
+                                 /*use_xnn=*/true, precision);
   if (model == nullptr) {
     LOG(ERROR) << "Unable to create SoundStream encoder TFLite model wrapper.";
-    return nullptr;
   }
-  return absl::WrapUnique(new SoundStreamEncoder(std::move(model)));
+  return model;
+}
+
+std::unique_ptr<TfLiteModelWrapper> SoundStreamEncoder::CreateModelWrapper(
+    std::shared_ptr<const ModelBundle> bundle, ModelPrecision precision) {
+  auto model = TfLiteModelWrapper::Create(std::move(bundle),
+                                          "soundstream_encoder.tflite",
+                                          /*use_xnn=*/true, precision);
+  if (model == nullptr) {
+    LOG(ERROR) << "Unable to create SoundStream encoder TFLite model wrapper.";
+  }
+  return model;
 }
 
 SoundStreamEncoder::SoundStreamEncoder(
-    std::unique_ptr<TfLiteModelWrapper> model)
+    std::shared_ptr<TfLiteModelWrapper> model,
+    std::optional<TfLiteModelWrapper::VariableTensorState>
+        variable_tensor_state)
     : model_(std::move(model)),
-      num_features_(model_->get_output_tensor<float>(0).size()) {}
+      num_features_(model_->get_output_tensor<float>(0).size()),
+      variable_tensor_state_(std::move(variable_tensor_state)) {}
 
 std::optional<std::vector<float>> SoundStreamEncoder::Extract(
     const absl::Span<const int16_t> audio) {
   absl::Span<float> input = model_->get_input_tensor<float>(0);
   std::transform(audio.begin(), audio.end(), input.begin(),
                  Int16ToUnitScalar<float>);
-  if (!model_->Invoke()) {
+  return Invoke();
+}
+
+std::optional<std::vector<float>> SoundStreamEncoder::ExtractFloat(
+    absl::Span<const float> audio) {
+  absl::Span<float> input = model_->get_input_tensor<float>(0);
+  std::copy(audio.begin(), audio.end(), input.begin());
+  return Invoke();
+}
+
+bool SoundStreamEncoder::SaveState(StateWriter* writer) const {
+  if (variable_tensor_state_.has_value()) {
+    variable_tensor_state_->Save(writer);
+  } else {
+    model_->GetVariableTensorState().Save(writer);
+  }
+  return true;
+}
+
+bool SoundStreamEncoder::RestoreState(StateReader* reader) {
+  TfLiteModelWrapper::VariableTensorState state =
+      variable_tensor_state_.has_value() ? variable_tensor_state_.value()
+                                         : model_->GetVariableTensorState();
+  if (!state.Restore(reader)) {
+    return false;
+  }
+  if (variable_tensor_state_.has_value()) {
+    variable_tensor_state_ = std::move(state);
+  } else {
+    model_->SetVariableTensorState(state);
+  }
+  return true;
+}
+
+std::optional<std::vector<float>> SoundStreamEncoder::Invoke() {
+  const bool invoked = variable_tensor_state_.has_value()
+                           ? model_->InvokeWithVariableTensorState(
+                                 &variable_tensor_state_.value())
+                           : model_->Invoke();
+  if (!invoked) {
     LOG(ERROR) << "Unable to invoke SoundStream encoder TFLite model wrapper.";
     return std::nullopt;
   }
@@ -25,6 +25,8 @@
 #include "absl/types/span.h"
 #include "include/ghc/filesystem.hpp"
 #include "lyra/feature_extractor_interface.h"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
 #include "lyra/tflite_model_wrapper.h"
 
 namespace chromemedia {
@@ -36,7 +38,29 @@ class SoundStreamEncoder : public FeatureExtractorInterface {
  public:
   // Returns a nullptr on failure.
   static std::unique_ptr<SoundStreamEncoder> Create(
-      const ghc::filesystem::path& model_path);
+      const ghc::filesystem::path& model_path,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  // Like the above, but loads the model from |bundle|. Returns a nullptr on
+  // failure.
+  static std::unique_ptr<SoundStreamEncoder> Create(
+      std::shared_ptr<const ModelBundle> bundle,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  // Creates a session running on |shared_model|, which may be used by other
+  // sessions on the same thread. The session only owns the variable tensors of
+  // the model. Returns a nullptr on failure.
+  static std::unique_ptr<SoundStreamEncoder> Create(
+      std::shared_ptr<TfLiteModelWrapper> shared_model);
+
+  // Loads the SoundStream encoder TFLite model. Returns a nullptr on failure.
+  static std::unique_ptr<TfLiteModelWrapper> CreateModelWrapper(
+      const ghc::filesystem::path& model_path,
+      ModelPrecision precision = ModelPrecision::kInt8);
+
+  static std::unique_ptr<TfLiteModelWrapper> CreateModelWrapper(
+      std::shared_ptr<const ModelBundle> bundle,
+      ModelPrecision precision = ModelPrecision::kInt8);
 
   ~SoundStreamEncoder() override {}
 
@@ -44,11 +68,27 @@ class SoundStreamEncoder : public FeatureExtractorInterface {
   std::optional<std::vector<float>> Extract(
       const absl::Span<const int16_t> audio) override;
 
+  // Copies the unit floats into the model input as they are.
+  std::optional<std::vector<float>> ExtractFloat(
+      absl::Span<const float> audio) override;
+
+  // Saves the variable tensors of the model.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
  private:
-  explicit SoundStreamEncoder(std::unique_ptr<TfLiteModelWrapper> model);
+  SoundStreamEncoder(std::shared_ptr<TfLiteModelWrapper> model,
+                     std::optional<TfLiteModelWrapper::VariableTensorState>
+                         variable_tensor_state);
+
+  // Runs the model on its input tensor and returns the features.
+  std::optional<std::vector<float>> Invoke();
 
-  const std::unique_ptr<TfLiteModelWrapper> model_;
+  const std::shared_ptr<TfLiteModelWrapper> model_;
   const int num_features_;
+  // Only set when |model_| is shared with other sessions.
+  std::optional<TfLiteModelWrapper::VariableTensorState> variable_tensor_state_;
 };
 
 }  // namespace codec
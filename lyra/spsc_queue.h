@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_SPSC_QUEUE_H_
+#define LYRA_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"  // IWYU pragma: keep
+
+namespace chromemedia {
+namespace codec {
+
+// A bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Elements are moved in and out of a ring of preallocated slots, so
+// element types that own buffers keep them across uses.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(int capacity) : slots_(capacity + 1) {
+    CHECK_GT(capacity, 0);
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Moves |value| into the queue and returns true, or returns false and
+  // leaves |value| untouched if the queue is full. Producer only.
+  bool TryPush(T& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next_tail = Next(tail);
+    if (next_tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next_tail, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest element into |value| and returns true, or returns false
+  // if the queue is empty. Consumer only.
+  bool TryPop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = std::move(slots_[head]);
+    head_.store(Next(head), std::memory_order_release);
+    return true;
+  }
+
+  // Waits until |value| fits into the queue.
+  void Push(T value) {
+    for (int attempt = 0; !TryPush(value); ++attempt) {
+      Wait(attempt);
+    }
+  }
+
+  // Waits until an element is available.
+  void Pop(T* value) {
+    for (int attempt = 0; !TryPop(value); ++attempt) {
+      Wait(attempt);
+    }
+  }
+
+ private:
+  // Yields for short waits, then backs off to sleeping so that waiting
+  // threads do not take time from working ones when there are more threads
+  // than cores.
+  static void Wait(int attempt) {
+    constexpr int kMaxYields = 64;
+    if (attempt < kMaxYields) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  size_t Next(size_t index) const {
+    return index + 1 == slots_.size() ? 0 : index + 1;
+  }
+
+  // One slot always stays empty to tell a full queue from an empty one.
+  std::vector<T> slots_;
+  // Only written by the consumer.
+  alignas(64) std::atomic<size_t> head_{0};
+  // Only written by the producer.
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_SPSC_QUEUE_H_
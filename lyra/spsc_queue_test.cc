@@ -0,0 +1,74 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/spsc_queue.h"
+
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+TEST(SpscQueueTest, IsBounded) {
+  SpscQueue<int> queue(2);
+  int value = 1;
+  EXPECT_TRUE(queue.TryPush(value));
+  value = 2;
+  EXPECT_TRUE(queue.TryPush(value));
+  value = 3;
+  EXPECT_FALSE(queue.TryPush(value));
+  EXPECT_EQ(value, 3);
+
+  EXPECT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_FALSE(queue.TryPop(&value));
+}
+
+TEST(SpscQueueTest, FailedPushKeepsMoveOnlyValue) {
+  SpscQueue<std::unique_ptr<int>> queue(1);
+  auto first = std::make_unique<int>(1);
+  ASSERT_TRUE(queue.TryPush(first));
+  auto second = std::make_unique<int>(2);
+  EXPECT_FALSE(queue.TryPush(second));
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(*second, 2);
+}
+
+TEST(SpscQueueTest, KeepsOrderAcrossThreads) {
+  constexpr int kNumValues = 100000;
+  SpscQueue<std::vector<int>> queue(8);
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kNumValues; ++i) {
+      queue.Push(std::vector<int>(1 + i % 4, i));
+    }
+  });
+  std::vector<int> value;
+  for (int i = 0; i < kNumValues; ++i) {
+    queue.Pop(&value);
+    ASSERT_EQ(value, std::vector<int>(1 + i % 4, i));
+  }
+  producer.join();
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -34,6 +34,9 @@ class MockFeatureExtractor : public FeatureExtractorInterface {
 
   MOCK_METHOD(std::optional<std::vector<float>>, Extract,
               (const absl::Span<const int16_t> audio), (override));
+
+  MOCK_METHOD(std::optional<std::vector<float>>, ExtractFloat,
+              (absl::Span<const float> audio), (override));
 };
 
 }  // namespace codec
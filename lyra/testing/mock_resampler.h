@@ -37,6 +37,10 @@ class MockResampler : public ResamplerInterface {
         .WillByDefault([this](absl::Span<const int16_t> audio) {
           return resampler_->Resample(audio);
         });
+    ON_CALL(*this, ResampleFloat)
+        .WillByDefault([this](absl::Span<const float> audio) {
+          return resampler_->ResampleFloat(audio);
+        });
     ON_CALL(*this, Reset).WillByDefault([this]() {
       return resampler_->Reset();
     });
@@ -56,6 +60,9 @@ class MockResampler : public ResamplerInterface {
   MOCK_METHOD(std::vector<int16_t>, Resample, (absl::Span<const int16_t> audio),
               (override));
 
+  MOCK_METHOD(std::vector<float>, ResampleFloat,
+              (absl::Span<const float> audio), (override));
+
   MOCK_METHOD(void, Reset, (), (override));
 
   MOCK_METHOD(int, input_sample_rate_hz, (), (const override));
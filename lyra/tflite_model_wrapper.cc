@@ -16,14 +16,30 @@
 
 #include "lyra/tflite_model_wrapper.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "glog/logging.h"  // IWYU pragma: keep
 #include "include/ghc/filesystem.hpp"
+#include "lyra/lyra_config.h"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
+#include "lyra/xnnpack_weights_cache.h"
+#include "tensorflow/lite/builtin_ops.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/subgraph.h"
 #include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#include "tensorflow/lite/experimental/resource/resource_base.h"
+#include "tensorflow/lite/experimental/resource/resource_variable.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/interpreter_builder.h"
 #include "tensorflow/lite/kernels/register.h"
@@ -35,14 +51,55 @@ namespace codec {
 
 std::unique_ptr<TfLiteModelWrapper> TfLiteModelWrapper::Create(
     const ghc::filesystem::path& model_file, bool use_xnn,
-    bool int8_quantized) {
+    ModelPrecision precision) {
+  // A model inside a bundle is served from the mapping of the bundle.
+  if (ModelBundle::IsBundle(model_file.parent_path())) {
+    std::shared_ptr<const ModelBundle> bundle =
+        ModelBundle::Open(model_file.parent_path());
+    if (bundle == nullptr) {
+      LOG(ERROR) << "Could not open model bundle " << model_file.parent_path();
+      return nullptr;
+    }
+    return Create(std::move(bundle), model_file.filename().string(), use_xnn,
+                  precision);
+  }
   auto model = tflite::FlatBufferModel::BuildFromFile(model_file.c_str());
   if (model == nullptr) {
     LOG(ERROR) << "Could not build TFLite FlatBufferModel for file: "
                << model_file;
     return nullptr;
   }
+  return CreateFromModel(/*bundle=*/nullptr, std::move(model),
+                         GetWeightsIdentifier(model_file.parent_path()),
+                         model_file.string(), use_xnn, precision);
+}
+
+std::unique_ptr<TfLiteModelWrapper> TfLiteModelWrapper::Create(
+    std::shared_ptr<const ModelBundle> bundle, absl::string_view section_name,
+    bool use_xnn, ModelPrecision precision) {
+  const auto section = bundle->GetSection(section_name);
+  std::unique_ptr<tflite::FlatBufferModel> model;
+  if (section.has_value()) {
+    model = tflite::FlatBufferModel::BuildFromBuffer(section->data(),
+                                                     section->size());
+  }
+  if (model == nullptr) {
+    LOG(ERROR) << "Could not build TFLite FlatBufferModel for bundle section: "
+               << section_name;
+    return nullptr;
+  }
+  const absl::StatusOr<int> weights_identifier =
+      GetWeightsIdentifier(*bundle);
+  return CreateFromModel(std::move(bundle), std::move(model),
+                         weights_identifier, std::string(section_name),
+                         use_xnn, precision);
+}
 
+std::unique_ptr<TfLiteModelWrapper> TfLiteModelWrapper::CreateFromModel(
+    std::shared_ptr<const ModelBundle> bundle,
+    std::unique_ptr<tflite::FlatBufferModel> model,
+    const absl::StatusOr<int>& weights_identifier,
+    const std::string& model_name, bool use_xnn, ModelPrecision precision) {
   // Disable any default delegate and explicitly control which delegate
   // to use below.
   tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
@@ -55,26 +112,65 @@ std::unique_ptr<TfLiteModelWrapper> TfLiteModelWrapper::Create(
 
   std::unique_ptr<tflite::Interpreter> interpreter;
   if (builder(&interpreter) != kTfLiteOk) {
-    LOG(ERROR) << "Could not build TFLite Interpreter for file: " << model_file;
+    LOG(ERROR) << "Could not build TFLite Interpreter for file: " << model_name;
     return nullptr;
   }
 
+  if (!use_xnn && precision != ModelPrecision::kFloat32) {
+    LOG(WARNING) << "Reduced precision requires XNNPack; running " << model_name
+                 << " in full precision.";
+  }
+
   // Start of XNNPack delegate creation.
+  std::shared_ptr<XnnPackWeightsCache> weights_cache;
   if (use_xnn) {
     // Enable XXNPack.
     auto options = TfLiteXNNPackDelegateOptionsDefault();
-    // TODO(b/219786261) Remove once XNNPACK is enabled by default.
-    options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_QU8;
+    switch (precision) {
+      case ModelPrecision::kFloat32:
+        options.flags &= ~(TFLITE_XNNPACK_DELEGATE_FLAG_QS8 |
+                           TFLITE_XNNPACK_DELEGATE_FLAG_QU8);
+        break;
+      case ModelPrecision::kFloat16:
+        options.flags &= ~(TFLITE_XNNPACK_DELEGATE_FLAG_QS8 |
+                           TFLITE_XNNPACK_DELEGATE_FLAG_QU8);
+        options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_FORCE_FP16;
+        break;
+      case ModelPrecision::kInt8:
+        // TODO(b/219786261) Remove QU8 once XNNPACK enables it by default.
+        options.flags |= TFLITE_XNNPACK_DELEGATE_FLAG_QS8 |
+                         TFLITE_XNNPACK_DELEGATE_FLAG_QU8;
+        break;
+    }
     options.num_threads = 1;
-    auto delegate =
-        std::unique_ptr<TfLiteDelegate, std::function<void(TfLiteDelegate*)> >(
-            TfLiteXNNPackDelegateCreate(&options),
-            &TfLiteXNNPackDelegateDelete);
-    // Allow dynamic tensors.
-    // TODO(b/204470960): Remove this flag once the bug is fixed.
-    delegate->flags |= kTfLiteDelegateFlagsAllowDynamicTensors;
-
-    auto status = interpreter->ModifyGraphWithDelegate(std::move(delegate));
+
+    // Share packed weights with other interpreters of the same model. This is
+    // only done for weights whose lyra_config.binarypb can be read, since the
+    // identifier is part of what validates the cache.
+    if (weights_identifier.ok()) {
+      const tflite::Allocation* allocation = model->allocation();
+      weights_cache = XnnPackWeightsCache::Get(
+          absl::MakeConstSpan(static_cast<const char*>(allocation->base()),
+                              allocation->bytes()),
+          *weights_identifier, options.flags);
+    } else {
+      LOG(WARNING) << "Not caching packed weights of " << model_name << ": "
+                   << weights_identifier.status();
+    }
+
+    auto modify_graph = [&](TfLiteXNNPackDelegateWeightsCache* cache) {
+      options.weights_cache = cache;
+      auto delegate = std::unique_ptr<TfLiteDelegate,
+                                      std::function<void(TfLiteDelegate*)> >(
+          TfLiteXNNPackDelegateCreate(&options), &TfLiteXNNPackDelegateDelete);
+      // Allow dynamic tensors.
+      // TODO(b/204470960): Remove this flag once the bug is fixed.
+      delegate->flags |= kTfLiteDelegateFlagsAllowDynamicTensors;
+      return interpreter->ModifyGraphWithDelegate(std::move(delegate));
+    };
+    const TfLiteStatus status = weights_cache != nullptr
+                                    ? weights_cache->ModifyGraph(modify_graph)
+                                    : modify_graph(nullptr);
     if (status == kTfLiteDelegateError) {
       LOG(WARNING) << "Failed to set delegate; continuing without.";
     } else if (status != kTfLiteOk) {
@@ -86,18 +182,30 @@ std::unique_ptr<TfLiteModelWrapper> TfLiteModelWrapper::Create(
 
   if (interpreter->AllocateTensors() != kTfLiteOk) {
     LOG(ERROR) << "Could not allocate quantize TFLite tensors for file: "
-               << model_file;
+               << model_name;
     return nullptr;
   }
 
-  return absl::WrapUnique(
-      new TfLiteModelWrapper(std::move(model), std::move(interpreter)));
+  auto wrapper = absl::WrapUnique(
+      new TfLiteModelWrapper(std::move(bundle), std::move(model),
+                             std::move(weights_cache), std::move(interpreter)));
+  if (!wrapper->InitializeState()) {
+    LOG(ERROR) << "Could not initialize the state of TFLite model: "
+               << model_name;
+    return nullptr;
+  }
+  return wrapper;
 }
 
 TfLiteModelWrapper::TfLiteModelWrapper(
+    std::shared_ptr<const ModelBundle> bundle,
     std::unique_ptr<tflite::FlatBufferModel> model,
+    std::shared_ptr<XnnPackWeightsCache> weights_cache,
     std::unique_ptr<tflite::Interpreter> interpreter)
-    : model_(std::move(model)), interpreter_(std::move(interpreter)) {}
+    : bundle_(std::move(bundle)),
+      model_(std::move(model)),
+      weights_cache_(std::move(weights_cache)),
+      interpreter_(std::move(interpreter)) {}
 
 bool TfLiteModelWrapper::Invoke() {
   return interpreter_->Invoke() == kTfLiteOk;
@@ -108,8 +216,150 @@ tflite::SignatureRunner* TfLiteModelWrapper::GetSignatureRunner(
   return interpreter_->GetSignatureRunner(signature);
 }
 
+bool TfLiteModelWrapper::InitializeState() {
+  // The CALL_ONCE operators create the resource variables on the first
+  // |Invoke()|, and would overwrite any state loaded before it, so the model
+  // is run once here on silence.
+  std::vector<int> init_subgraph_indices;
+  for (const int node_index : interpreter_->execution_plan()) {
+    const auto* node_and_registration =
+        interpreter_->node_and_registration(node_index);
+    if (node_and_registration->second.builtin_code == kTfLiteBuiltinCallOnce) {
+      init_subgraph_indices.push_back(
+          static_cast<const TfLiteCallOnceParams*>(
+              node_and_registration->first.builtin_data)
+              ->init_subgraph_index);
+    }
+  }
+  if (!init_subgraph_indices.empty()) {
+    for (const int input : interpreter_->inputs()) {
+      TfLiteTensor* tensor = interpreter_->tensor(input);
+      std::fill(tensor->data.raw, tensor->data.raw + tensor->bytes, 0);
+    }
+    if (!Invoke()) {
+      return false;
+    }
+    // Running the initialization subgraphs again returns the resource
+    // variables to their initial values.
+    for (const int init_subgraph_index : init_subgraph_indices) {
+      tflite::Subgraph* init_subgraph =
+          interpreter_->subgraph(init_subgraph_index);
+      if (init_subgraph->AllocateTensors() != kTfLiteOk ||
+          init_subgraph->Invoke() != kTfLiteOk) {
+        LOG(ERROR) << "Could not run initialization subgraph "
+                   << init_subgraph_index << ".";
+        return false;
+      }
+    }
+  }
+  if (interpreter_->ResetVariableTensors() != kTfLiteOk) {
+    return false;
+  }
+
+  for (const int variable : interpreter_->variables()) {
+    state_tensors_.push_back(interpreter_->tensor(variable));
+  }
+  // The resource map is shared by all subgraphs of the interpreter.
+  tflite::resource::ResourceMap& resources =
+      interpreter_->subgraph(0)->resources();
+  std::vector<int> resource_ids;
+  for (const auto& [resource_id, resource] : resources) {
+    if (dynamic_cast<tflite::resource::ResourceVariable*>(resource.get()) !=
+            nullptr &&
+        resource->IsInitialized()) {
+      resource_ids.push_back(resource_id);
+    }
+  }
+  std::sort(resource_ids.begin(), resource_ids.end());
+  for (const int resource_id : resource_ids) {
+    state_tensors_.push_back(
+        tflite::resource::GetResourceVariable(&resources, resource_id)
+            ->GetTensor());
+  }
+
+  initial_state_.tensors.resize(state_tensors_.size());
+  StoreVariableTensors(&initial_state_);
+  return true;
+}
+
 bool TfLiteModelWrapper::ResetVariableTensors() {
-  return interpreter_->ResetVariableTensors() == kTfLiteOk;
+  LoadVariableTensors(initial_state_);
+  return true;
+}
+
+TfLiteModelWrapper::VariableTensorState
+TfLiteModelWrapper::CreateInitialVariableTensorState() const {
+  return initial_state_;
+}
+
+TfLiteModelWrapper::VariableTensorState
+TfLiteModelWrapper::GetVariableTensorState() const {
+  VariableTensorState state;
+  state.tensors.resize(state_tensors_.size());
+  StoreVariableTensors(&state);
+  return state;
+}
+
+void TfLiteModelWrapper::SetVariableTensorState(
+    const VariableTensorState& state) {
+  LoadVariableTensors(state);
+}
+
+void TfLiteModelWrapper::VariableTensorState::Save(StateWriter* writer) const {
+  writer->Write<uint32_t>(tensors.size());
+  for (const std::vector<char>& tensor : tensors) {
+    writer->WriteVector<char>(tensor);
+  }
+}
+
+bool TfLiteModelWrapper::VariableTensorState::Restore(StateReader* reader) {
+  uint32_t num_tensors;
+  if (!reader->Read(&num_tensors)) {
+    return false;
+  }
+  if (num_tensors != tensors.size()) {
+    LOG(ERROR) << "Expected state for " << tensors.size()
+               << " variable tensors but got " << num_tensors << ".";
+    return false;
+  }
+  for (std::vector<char>& tensor : tensors) {
+    if (!reader->ReadVectorOfSize(tensor.size(), &tensor)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TfLiteModelWrapper::InvokeWithVariableTensorState(
+    VariableTensorState* state) {
+  if (state->tensors.size() != state_tensors_.size()) {
+    LOG(ERROR) << "Expected state for " << state_tensors_.size()
+               << " variable tensors but got " << state->tensors.size()
+               << ".";
+    return false;
+  }
+  LoadVariableTensors(*state);
+  if (!Invoke()) {
+    return false;
+  }
+  StoreVariableTensors(state);
+  return true;
+}
+
+void TfLiteModelWrapper::LoadVariableTensors(const VariableTensorState& state) {
+  for (int i = 0; i < state.tensors.size(); ++i) {
+    std::copy(state.tensors[i].begin(), state.tensors[i].end(),
+              state_tensors_[i]->data.raw);
+  }
+}
+
+void TfLiteModelWrapper::StoreVariableTensors(
+    VariableTensorState* state) const {
+  for (int i = 0; i < state->tensors.size(); ++i) {
+    const TfLiteTensor* tensor = state_tensors_[i];
+    state->tensors[i].assign(tensor->data.raw,
+                             tensor->data.raw + tensor->bytes);
+  }
 }
 
 int TfLiteModelWrapper::num_input_tensors() {
@@ -19,9 +19,17 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "include/ghc/filesystem.hpp"
+#include "lyra/model_bundle.h"
+#include "lyra/session_state.h"
+#include "lyra/xnnpack_weights_cache.h"
+#include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/model_builder.h"
 #include "tensorflow/lite/signature_runner.h"
@@ -29,18 +37,74 @@
 namespace chromemedia {
 namespace codec {
 
+// Numerical precision the XNNPACK delegate runs a model in. Ordered from the
+// most accurate to the cheapest.
+enum class ModelPrecision {
+  // Float operators run in single precision and quantized operators fall back
+  // to the builtin TFLite kernels.
+  kFloat32,
+  // Like |kFloat32|, but XNNPACK runs float operators in half precision. This
+  // is only faster on processors with native fp16 arithmetic.
+  kFloat16,
+  // XNNPACK also runs the int8 and uint8 quantized operators of the model.
+  kInt8,
+};
+
 class TfLiteModelWrapper {
  public:
+  // Contents of the variable tensors and the resource variables of the
+  // interpreter, i.e. the recurrent state of a streaming model. The shipped
+  // models keep all of their state in resource variables, which are created
+  // by the CALL_ONCE initialization subgraph. Several sessions can share one
+  // interpreter by each owning one of these and swapping it in and out around
+  // |Invoke()|.
+  struct VariableTensorState {
+    void Save(StateWriter* writer) const;
+
+    // Reads a state saved by |Save| in place, failing unless it has tensors
+    // of the same sizes.
+    bool Restore(StateReader* reader);
+
+    std::vector<std::vector<char>> tensors;
+  };
+
+  // |model_file| may also name a section of a |ModelBundle|, as in
+  // "path/to/models.bundle/lyragan.tflite".
   static std::unique_ptr<TfLiteModelWrapper> Create(
       const ghc::filesystem::path& model_file, bool use_xnn,
-      bool int8_quantized);
+      ModelPrecision precision);
+
+  // Builds the model from the section |section_name| of |bundle|, which the
+  // wrapper keeps alive.
+  static std::unique_ptr<TfLiteModelWrapper> Create(
+      std::shared_ptr<const ModelBundle> bundle, absl::string_view section_name,
+      bool use_xnn, ModelPrecision precision);
 
   bool Invoke();
 
   tflite::SignatureRunner* GetSignatureRunner(const char* signature);
 
+  // Returns the model state to the one right after the creation of the
+  // wrapper.
   bool ResetVariableTensors();
 
+  // Returns the model state right after the creation of the wrapper, without
+  // touching the interpreter.
+  VariableTensorState CreateInitialVariableTensorState() const;
+
+  // Copies the model state of the interpreter, for models that are not
+  // shared.
+  VariableTensorState GetVariableTensorState() const;
+
+  // Overwrites the model state of the interpreter with |state|, which has to
+  // come from |GetVariableTensorState|.
+  void SetVariableTensorState(const VariableTensorState& state);
+
+  // Copies |state| into the interpreter, runs the model and copies the
+  // updated model state back into |state|. The interpreter is not thread
+  // safe, so all sessions sharing it have to run on the same thread.
+  bool InvokeWithVariableTensorState(VariableTensorState* state);
+
   int num_input_tensors();
 
   int num_output_tensors();
@@ -59,11 +123,38 @@ class TfLiteModelWrapper {
   }
 
  private:
-  TfLiteModelWrapper(std::unique_ptr<tflite::FlatBufferModel> model,
+  // |model_name| only names the model in log messages.
+  static std::unique_ptr<TfLiteModelWrapper> CreateFromModel(
+      std::shared_ptr<const ModelBundle> bundle,
+      std::unique_ptr<tflite::FlatBufferModel> model,
+      const absl::StatusOr<int>& weights_identifier,
+      const std::string& model_name, bool use_xnn, ModelPrecision precision);
+
+  TfLiteModelWrapper(std::shared_ptr<const ModelBundle> bundle,
+                     std::unique_ptr<tflite::FlatBufferModel> model,
+                     std::shared_ptr<XnnPackWeightsCache> weights_cache,
                      std::unique_ptr<tflite::Interpreter> interpreter);
 
+  // Runs the initialization subgraphs of the CALL_ONCE operators, so that the
+  // resource variables exist, and records the tensors that hold the model
+  // state and their initial contents.
+  bool InitializeState();
+
+  void LoadVariableTensors(const VariableTensorState& state);
+
+  void StoreVariableTensors(VariableTensorState* state) const;
+
+  // Owns the memory |model_| is built from if the model is part of a bundle.
+  std::shared_ptr<const ModelBundle> bundle_;
   std::unique_ptr<tflite::FlatBufferModel> model_;
+  // Declared before |interpreter_| since the XNNPack delegate owned by the
+  // interpreter refers to it.
+  std::shared_ptr<XnnPackWeightsCache> weights_cache_;
   std::unique_ptr<tflite::Interpreter> interpreter_;
+  // The variable tensors, followed by the resource variables in the order of
+  // their ids. Owned by |interpreter_|.
+  std::vector<TfLiteTensor*> state_tensors_;
+  VariableTensorState initial_state_;
 };
 
 }  // namespace codec
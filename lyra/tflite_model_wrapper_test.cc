@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 // Placeholder for get runfiles header.
 #include "absl/types/span.h"
@@ -30,17 +31,17 @@ namespace codec {
 namespace {
 
 TEST(TfLiteModelWrapperTest, CreateFailsWithInvalidModelFile) {
-  EXPECT_EQ(TfLiteModelWrapper::Create("invalid/model/path", true, false),
+  EXPECT_EQ(TfLiteModelWrapper::Create("invalid/model/path", true,
+                                       ModelPrecision::kFloat32),
             nullptr);
 }
 
-class TfLiteModelWrapperTest : public testing::TestWithParam<bool> {};
+class TfLiteModelWrapperTest : public testing::TestWithParam<ModelPrecision> {};
 
 TEST_P(TfLiteModelWrapperTest, CreateSucceedsAndMethodsRun) {
-  const bool int8_quantized = GetParam();
   auto model_wrapper = TfLiteModelWrapper::Create(
       ghc::filesystem::current_path() / "lyra/model_coeffs/lyragan.tflite",
-      true, int8_quantized);
+      true, GetParam());
   ASSERT_NE(model_wrapper, nullptr);
   absl::Span<float> input = model_wrapper->get_input_tensor<float>(0);
   std::fill(input.begin(), input.end(), 0);
@@ -48,8 +49,89 @@ TEST_P(TfLiteModelWrapperTest, CreateSucceedsAndMethodsRun) {
   EXPECT_TRUE(model_wrapper->ResetVariableTensors());
 }
 
-INSTANTIATE_TEST_SUITE_P(Int8QuantizedOrNot, TfLiteModelWrapperTest,
-                         testing::Bool());
+TEST_P(TfLiteModelWrapperTest, InvokeWithVariableTensorStateIsolatesSessions) {
+  auto model_wrapper = TfLiteModelWrapper::Create(
+      ghc::filesystem::current_path() / "lyra/model_coeffs/lyragan.tflite",
+      true, GetParam());
+  ASSERT_NE(model_wrapper, nullptr);
+  auto first_state = model_wrapper->CreateInitialVariableTensorState();
+  auto second_state = first_state;
+
+  // Advance only the first session, then run both on the same input. The
+  // second session must behave as if the first one never ran.
+  absl::Span<float> input = model_wrapper->get_input_tensor<float>(0);
+  std::fill(input.begin(), input.end(), 0.5f);
+  ASSERT_TRUE(model_wrapper->InvokeWithVariableTensorState(&first_state));
+  ASSERT_TRUE(model_wrapper->InvokeWithVariableTensorState(&second_state));
+  auto output = model_wrapper->get_output_tensor<float>(0);
+  const std::vector<float> second_output(output.begin(), output.end());
+
+  ASSERT_TRUE(model_wrapper->ResetVariableTensors());
+  std::fill(input.begin(), input.end(), 0.5f);
+  ASSERT_TRUE(model_wrapper->Invoke());
+  output = model_wrapper->get_output_tensor<float>(0);
+  EXPECT_EQ(std::vector<float>(output.begin(), output.end()), second_output);
+}
+
+// The streaming models keep their state in resource variables rather than
+// variable tensors, and that state has to be captured for sessions to be
+// isolated.
+TEST_P(TfLiteModelWrapperTest, StateOfStreamingModelsIsCaptured) {
+  for (const char* model_name :
+       {"lyragan.tflite", "soundstream_encoder.tflite"}) {
+    SCOPED_TRACE(model_name);
+    auto model_wrapper = TfLiteModelWrapper::Create(
+        ghc::filesystem::current_path() / "lyra/model_coeffs" / model_name,
+        true, GetParam());
+    ASSERT_NE(model_wrapper, nullptr);
+    const auto initial_state =
+        model_wrapper->CreateInitialVariableTensorState();
+    EXPECT_FALSE(initial_state.tensors.empty());
+
+    absl::Span<float> input = model_wrapper->get_input_tensor<float>(0);
+    std::fill(input.begin(), input.end(), 0.5f);
+    ASSERT_TRUE(model_wrapper->Invoke());
+    EXPECT_NE(model_wrapper->GetVariableTensorState().tensors,
+              initial_state.tensors);
+
+    ASSERT_TRUE(model_wrapper->ResetVariableTensors());
+    EXPECT_EQ(model_wrapper->GetVariableTensorState().tensors,
+              initial_state.tensors);
+  }
+}
+
+TEST_P(TfLiteModelWrapperTest, InterpretersSharingPackedWeightsMatch) {
+  const ghc::filesystem::path model_file =
+      ghc::filesystem::current_path() / "lyra/model_coeffs/lyragan.tflite";
+  // The second wrapper looks up the weights packed for the first one.
+  auto first_wrapper = TfLiteModelWrapper::Create(model_file, true, GetParam());
+  auto second_wrapper =
+      TfLiteModelWrapper::Create(model_file, true, GetParam());
+  ASSERT_NE(first_wrapper, nullptr);
+  ASSERT_NE(second_wrapper, nullptr);
+
+  for (auto* wrapper : {first_wrapper.get(), second_wrapper.get()}) {
+    absl::Span<float> input = wrapper->get_input_tensor<float>(0);
+    std::fill(input.begin(), input.end(), 0.5f);
+    ASSERT_TRUE(wrapper->Invoke());
+  }
+  auto first_output = first_wrapper->get_output_tensor<float>(0);
+  auto second_output = second_wrapper->get_output_tensor<float>(0);
+  EXPECT_EQ(std::vector<float>(first_output.begin(), first_output.end()),
+            std::vector<float>(second_output.begin(), second_output.end()));
+}
+
+TEST(TfLiteModelWrapperTest, ReducedPrecisionWithoutXnnPackStillRuns) {
+  auto model_wrapper = TfLiteModelWrapper::Create(
+      ghc::filesystem::current_path() / "lyra/model_coeffs/quantizer.tflite",
+      false, ModelPrecision::kInt8);
+  EXPECT_NE(model_wrapper, nullptr);
+}
+
+INSTANTIATE_TEST_SUITE_P(Precisions, TfLiteModelWrapperTest,
+                         testing::Values(ModelPrecision::kFloat32,
+                                         ModelPrecision::kFloat16,
+                                         ModelPrecision::kInt8));
 
 }  // namespace
 }  // namespace codec
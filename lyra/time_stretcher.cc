@@ -0,0 +1,278 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/time_stretcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "lyra/dsp_utils.h"
+#include "lyra/session_state.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr float kStepSecs = 0.01f;
+constexpr float kSearchRadiusSecs = 0.008f;
+// Keeps the normalization of the similarity finite for silence.
+constexpr float kEnergyFloor = 1e-9f;
+
+}  // namespace
+
+TimeStretcher::TimeStretcher(int sample_rate_hz)
+    : num_samples_per_step_(std::round(kStepSecs * sample_rate_hz)),
+      search_radius_(std::round(kSearchRadiusSecs * sample_rate_hz)),
+      fade_in_(num_samples_per_step_),
+      rate_(1.f),
+      is_aligned_(true),
+      position_(0),
+      nominal_position_(0.0) {
+  for (int i = 0; i < num_samples_per_step_; ++i) {
+    const float sine =
+        std::sin(M_PI / 2.0 * (i + 0.5) / num_samples_per_step_);
+    fade_in_[i] = sine * sine;
+  }
+}
+
+std::optional<std::vector<int16_t>> TimeStretcher::FilterAndBuffer(
+    const std::function<std::optional<std::vector<int16_t>>(int)>&
+        sample_generator,
+    int num_samples) {
+  return FilterAndBufferOfType(sample_generator, num_samples);
+}
+
+std::optional<std::vector<float>> TimeStretcher::FilterAndBufferFloat(
+    const std::function<std::optional<std::vector<float>>(int)>&
+        sample_generator,
+    int num_samples) {
+  return FilterAndBufferOfType(sample_generator, num_samples);
+}
+
+bool TimeStretcher::set_rate(float rate) {
+  if (!(rate >= kMinRate && rate <= kMaxRate)) {
+    LOG(ERROR) << "The playout rate has to be between " << kMinRate << " and "
+               << kMaxRate << ", but is " << rate << ".";
+    return false;
+  }
+  rate_ = rate;
+  return true;
+}
+
+float TimeStretcher::rate() const { return rate_; }
+
+bool TimeStretcher::SaveState(StateWriter* writer) const {
+  writer->Write(rate_);
+  writer->Write(is_aligned_);
+  writer->WriteVector<float>(input_);
+  writer->Write<int32_t>(position_);
+  writer->Write(nominal_position_);
+  writer->WriteVector<float>(output_);
+  return true;
+}
+
+bool TimeStretcher::RestoreState(StateReader* reader) {
+  float rate;
+  bool is_aligned;
+  std::vector<float> input;
+  int32_t position;
+  double nominal_position;
+  std::vector<float> output;
+  if (!reader->Read(&rate) || !reader->Read(&is_aligned) ||
+      !reader->ReadVector(&input) || !reader->Read(&position) ||
+      !reader->Read(&nominal_position) || !reader->ReadVector(&output)) {
+    return false;
+  }
+  if (position < 0 || position > input.size() ||
+      !(nominal_position >= 0.0 && nominal_position <= input.size()) ||
+      output.size() > num_samples_per_step_) {
+    LOG(ERROR) << "Invalid time stretcher state.";
+    return false;
+  }
+  // |set_rate| also checks the rate, so it runs after every other check.
+  if (!set_rate(rate)) {
+    return false;
+  }
+  is_aligned_ = is_aligned;
+  input_ = std::move(input);
+  position_ = position;
+  nominal_position_ = nominal_position;
+  output_ = std::move(output);
+  return true;
+}
+
+template <typename T>
+std::optional<std::vector<T>> TimeStretcher::FilterAndBufferOfType(
+    const std::function<std::optional<std::vector<T>>(int)>& sample_generator,
+    int num_samples) {
+  std::vector<T> samples;
+  samples.reserve(num_samples);
+  while (samples.size() < num_samples) {
+    const int num_missing_samples = num_samples - samples.size();
+    if (!output_.empty()) {
+      const int num_output_samples =
+          std::min<int>(num_missing_samples, output_.size());
+      for (int i = 0; i < num_output_samples; ++i) {
+        if constexpr (std::is_same_v<T, float>) {
+          samples.push_back(output_[i]);
+        } else {
+          samples.push_back(UnitToInt16Scalar(output_[i]));
+        }
+      }
+      output_.erase(output_.begin(), output_.begin() + num_output_samples);
+      continue;
+    }
+    if (!is_aligned_ || rate_ != 1.f) {
+      if (!Step(sample_generator)) {
+        return std::nullopt;
+      }
+      continue;
+    }
+    // Plays out the input left over from stretching first, and then the
+    // samples of the generator as they are.
+    const int num_input_samples =
+        std::min<int>(num_missing_samples, input_.size() - position_);
+    if (num_input_samples > 0) {
+      for (int i = 0; i < num_input_samples; ++i) {
+        if constexpr (std::is_same_v<T, float>) {
+          samples.push_back(input_[position_ + i]);
+        } else {
+          samples.push_back(UnitToInt16Scalar(input_[position_ + i]));
+        }
+      }
+      position_ += num_input_samples;
+    } else {
+      if (!AppendInput(sample_generator, num_missing_samples, &samples)) {
+        return std::nullopt;
+      }
+      position_ = input_.size();
+    }
+    nominal_position_ = position_;
+    DiscardOldInput();
+  }
+  return samples;
+}
+
+template <typename T>
+bool TimeStretcher::AppendInput(
+    const std::function<std::optional<std::vector<T>>(int)>& sample_generator,
+    int num_samples, std::vector<T>* passed_through) {
+  const std::optional<std::vector<T>> generated =
+      sample_generator(num_samples);
+  if (!generated.has_value()) {
+    LOG(ERROR) << "Could not generate samples to stretch.";
+    return false;
+  }
+  if constexpr (std::is_same_v<T, float>) {
+    input_.insert(input_.end(), generated->begin(), generated->end());
+  } else {
+    for (const int16_t sample : generated.value()) {
+      input_.push_back(Int16ToUnitScalar<float>(sample));
+    }
+  }
+  if (passed_through != nullptr) {
+    passed_through->insert(passed_through->end(), generated->begin(),
+                           generated->end());
+  }
+  return true;
+}
+
+template <typename T>
+bool TimeStretcher::Step(
+    const std::function<std::optional<std::vector<T>>(int)>& sample_generator) {
+  // The segment to crossfade into starts near where the previous one would
+  // have ended at exactly |rate_| times the speed.
+  const double nominal_start =
+      nominal_position_ + (rate_ - 1.0) * num_samples_per_step_;
+  const int search_begin =
+      std::max(0, static_cast<int>(std::floor(nominal_start)) - search_radius_);
+  const int search_end =
+      std::max(search_begin,
+               static_cast<int>(std::floor(nominal_start)) + search_radius_);
+  const int num_needed_samples =
+      std::max(search_end, position_) + num_samples_per_step_;
+  if (num_needed_samples > input_.size() &&
+      !AppendInput<T>(sample_generator, num_needed_samples - input_.size(),
+                      /*passed_through=*/nullptr)) {
+    return false;
+  }
+
+  const int start = FindMostSimilarSegment(search_begin, search_end);
+  for (int i = 0; i < num_samples_per_step_; ++i) {
+    output_.push_back(input_[position_ + i] * (1.f - fade_in_[i]) +
+                      input_[start + i] * fade_in_[i]);
+  }
+  position_ = start + num_samples_per_step_;
+  if (rate_ == 1.f) {
+    // Back in sync with the input, so it can be played out as it is.
+    is_aligned_ = true;
+    nominal_position_ = position_;
+  } else {
+    is_aligned_ = false;
+    nominal_position_ = nominal_start + num_samples_per_step_;
+  }
+  DiscardOldInput();
+  return true;
+}
+
+int TimeStretcher::FindMostSimilarSegment(int begin, int end) const {
+  const float* const target = &input_[position_];
+  float target_energy = 0.f;
+  for (int i = 0; i < num_samples_per_step_; ++i) {
+    target_energy += target[i] * target[i];
+  }
+  int best_start = begin;
+  float best_similarity = -2.f;
+  for (int start = begin; start <= end; ++start) {
+    const float* const candidate = &input_[start];
+    float correlation = 0.f;
+    float energy = 0.f;
+    for (int i = 0; i < num_samples_per_step_; ++i) {
+      correlation += candidate[i] * target[i];
+      energy += candidate[i] * candidate[i];
+    }
+    const float similarity =
+        correlation / std::sqrt((energy + kEnergyFloor) *
+                                (target_energy + kEnergyFloor));
+    if (similarity > best_similarity) {
+      best_similarity = similarity;
+      best_start = start;
+    }
+  }
+  return best_start;
+}
+
+void TimeStretcher::DiscardOldInput() {
+  // The slowest rate moves the search back by half a step at most.
+  const int first_reachable_sample = std::min<int>(
+      position_, std::floor(nominal_position_) - num_samples_per_step_ -
+                     search_radius_);
+  // Erasing only once a few steps have piled up keeps the copies rare.
+  if (first_reachable_sample < 4 * num_samples_per_step_) {
+    return;
+  }
+  input_.erase(input_.begin(), input_.begin() + first_reachable_sample);
+  position_ -= first_reachable_sample;
+  nominal_position_ -= first_reachable_sample;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_TIME_STRETCHER_H_
+#define LYRA_TIME_STRETCHER_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "lyra/buffered_filter_interface.h"
+#include "lyra/session_state.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Changes the playout speed of audio without changing its pitch, with
+// waveform similarity overlap-add (WSOLA). Every step crossfades the natural
+// continuation of the previous segment into the segment of the input near the
+// nominal playout position that is most similar to it, over
+// |num_samples_per_step| samples. At a rate of 1 the samples of the generator
+// are passed through unchanged.
+class TimeStretcher : public BufferedFilterInterface {
+ public:
+  static constexpr float kMinRate = 0.5f;
+  static constexpr float kMaxRate = 2.f;
+
+  explicit TimeStretcher(int sample_rate_hz);
+
+  // Produces |num_samples| samples, played out at |rate()| times the speed of
+  // the samples from |sample_generator|. Fewer or more samples than
+  // requested may be taken from the generator, and the surplus is kept for
+  // the following calls.
+  std::optional<std::vector<int16_t>> FilterAndBuffer(
+      const std::function<std::optional<std::vector<int16_t>>(int)>&
+          sample_generator,
+      int num_samples) override;
+
+  std::optional<std::vector<float>> FilterAndBufferFloat(
+      const std::function<std::optional<std::vector<float>>(int)>&
+          sample_generator,
+      int num_samples) override;
+
+  // Sets the playout speed, for example slightly below 1 to stretch through
+  // a jitter spike, slightly above 1 to drain latency, or up to 2 to skim
+  // through a recording. Takes effect at the next step. Returns false if
+  // |rate| is not in [|kMinRate|, |kMaxRate|].
+  bool set_rate(float rate);
+
+  float rate() const;
+
+  // Saves the rate, the input that is still reachable and the stretched
+  // samples not returned yet.
+  bool SaveState(StateWriter* writer) const override;
+
+  bool RestoreState(StateReader* reader) override;
+
+ private:
+  // Shared by |FilterAndBuffer| and |FilterAndBufferFloat|.
+  template <typename T>
+  std::optional<std::vector<T>> FilterAndBufferOfType(
+      const std::function<std::optional<std::vector<T>>(int)>&
+          sample_generator,
+      int num_samples);
+
+  // Appends |num_samples| samples from |sample_generator| to |input_|, and
+  // also to |passed_through| if it is not null. Returns false on failure.
+  template <typename T>
+  bool AppendInput(const std::function<std::optional<std::vector<T>>(int)>&
+                       sample_generator,
+                   int num_samples, std::vector<T>* passed_through);
+
+  // Appends one step of stretched samples to |output_|.
+  template <typename T>
+  bool Step(const std::function<std::optional<std::vector<T>>(int)>&
+                sample_generator);
+
+  // Returns the start of the segment in [|begin|, |end|] that is most similar
+  // to the |num_samples_per_step_| samples at |position_|.
+  int FindMostSimilarSegment(int begin, int end) const;
+
+  // Drops the input that no future step can reach.
+  void DiscardOldInput();
+
+  const int num_samples_per_step_;
+  // How far from the nominal playout position a segment may start.
+  const int search_radius_;
+  // Rising half of a Hann window, of |num_samples_per_step_| samples.
+  std::vector<float> fade_in_;
+  float rate_;
+  // Whether |input_| is played out unchanged from |position_| on.
+  bool is_aligned_;
+  // Unit float input. Samples before |position_| have been played out.
+  std::vector<float> input_;
+  int position_;
+  // Where |position_| would be at exactly |rate_| times the speed.
+  double nominal_position_;
+  // Stretched samples not yet returned.
+  std::vector<float> output_;
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_TIME_STRETCHER_H_
@@ -0,0 +1,265 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/time_stretcher.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lyra/session_state.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr int kSampleRateHz = 16000;
+constexpr float kFrequencyHz = 200.f;
+constexpr float kAmplitude = 10000.f;
+
+// Generates a sine wave and counts the samples it generated.
+class SineGenerator {
+ public:
+  std::optional<std::vector<int16_t>> operator()(int num_samples) {
+    std::vector<int16_t> samples(num_samples);
+    for (int16_t& sample : samples) {
+      sample = std::round(kAmplitude * std::sin(2.0 * M_PI * kFrequencyHz *
+                                                num_generated_samples_ /
+                                                kSampleRateHz));
+      ++num_generated_samples_;
+    }
+    return samples;
+  }
+
+  int num_generated_samples() const { return num_generated_samples_; }
+
+ private:
+  int num_generated_samples_ = 0;
+};
+
+int CountZeroCrossings(const std::vector<int16_t>& samples) {
+  int num_zero_crossings = 0;
+  for (int i = 1; i < samples.size(); ++i) {
+    num_zero_crossings += (samples[i - 1] < 0) != (samples[i] < 0);
+  }
+  return num_zero_crossings;
+}
+
+TEST(TimeStretcherTest, RejectsUnsupportedRates) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  EXPECT_FALSE(time_stretcher.set_rate(0.f));
+  EXPECT_FALSE(time_stretcher.set_rate(0.49f));
+  EXPECT_FALSE(time_stretcher.set_rate(2.01f));
+  EXPECT_FALSE(time_stretcher.set_rate(std::nanf("")));
+  EXPECT_EQ(time_stretcher.rate(), 1.f);
+  EXPECT_TRUE(time_stretcher.set_rate(TimeStretcher::kMinRate));
+  EXPECT_TRUE(time_stretcher.set_rate(TimeStretcher::kMaxRate));
+  EXPECT_EQ(time_stretcher.rate(), TimeStretcher::kMaxRate);
+}
+
+TEST(TimeStretcherTest, RateOfOnePassesSamplesThrough) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  SineGenerator sine_generator;
+  SineGenerator reference_generator;
+  std::vector<int> num_requested_samples;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = [&](int num_samples) {
+        num_requested_samples.push_back(num_samples);
+        return sine_generator(num_samples);
+      };
+  for (const int num_samples : {1, 160, 320, 7, 480}) {
+    const auto samples =
+        time_stretcher.FilterAndBuffer(sample_generator, num_samples);
+    ASSERT_TRUE(samples.has_value());
+    EXPECT_EQ(samples.value(), reference_generator(num_samples).value());
+    EXPECT_EQ(num_requested_samples.back(), num_samples);
+  }
+  EXPECT_EQ(num_requested_samples.size(), 5);
+}
+
+TEST(TimeStretcherTest, FailsIfGeneratorFails) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator =
+          [](int num_samples) -> std::optional<std::vector<int16_t>> {
+    return std::nullopt;
+  };
+  EXPECT_FALSE(time_stretcher.FilterAndBuffer(sample_generator, 320));
+  ASSERT_TRUE(time_stretcher.set_rate(1.5f));
+  EXPECT_FALSE(time_stretcher.FilterAndBuffer(sample_generator, 320));
+}
+
+class TimeStretcherRateTest : public testing::TestWithParam<float> {};
+
+TEST_P(TimeStretcherRateTest, ConsumesRateTimesTheSamples) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  ASSERT_TRUE(time_stretcher.set_rate(GetParam()));
+  SineGenerator sine_generator;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = std::ref(sine_generator);
+
+  std::vector<int16_t> stretched;
+  for (int i = 0; i < 50; ++i) {
+    const auto samples = time_stretcher.FilterAndBuffer(sample_generator, 320);
+    ASSERT_TRUE(samples.has_value());
+    ASSERT_EQ(samples->size(), 320);
+    stretched.insert(stretched.end(), samples->begin(), samples->end());
+  }
+  // The stretcher looks ahead by up to a step and the search radius.
+  EXPECT_NEAR(sine_generator.num_generated_samples(),
+              GetParam() * stretched.size(), 0.04f * kSampleRateHz);
+  // The pitch is unchanged.
+  EXPECT_NEAR(CountZeroCrossings(stretched), 2.f * kFrequencyHz, 4);
+  // The segments are joined in phase, so there are no clicks.
+  const float max_sine_step =
+      kAmplitude * 2.f * M_PI * kFrequencyHz / kSampleRateHz;
+  for (int i = 1; i < stretched.size(); ++i) {
+    ASSERT_LE(std::abs(stretched[i] - stretched[i - 1]), 1.1f * max_sine_step)
+        << "at sample " << i;
+  }
+}
+
+TEST_P(TimeStretcherRateTest, FloatMatchesInt16) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  TimeStretcher float_time_stretcher(kSampleRateHz);
+  ASSERT_TRUE(time_stretcher.set_rate(GetParam()));
+  ASSERT_TRUE(float_time_stretcher.set_rate(GetParam()));
+  SineGenerator sine_generator;
+  SineGenerator float_sine_generator;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = std::ref(sine_generator);
+  const std::function<std::optional<std::vector<float>>(int)>
+      float_sample_generator = [&](int num_samples) {
+        const auto samples = float_sine_generator(num_samples);
+        std::vector<float> float_samples;
+        for (const int16_t sample : samples.value()) {
+          float_samples.push_back(sample / 32768.f);
+        }
+        return std::optional<std::vector<float>>(float_samples);
+      };
+
+  for (int i = 0; i < 10; ++i) {
+    const auto samples = time_stretcher.FilterAndBuffer(sample_generator, 320);
+    const auto float_samples =
+        float_time_stretcher.FilterAndBufferFloat(float_sample_generator, 320);
+    ASSERT_TRUE(samples.has_value());
+    ASSERT_TRUE(float_samples.has_value());
+    ASSERT_EQ(samples->size(), float_samples->size());
+    for (int j = 0; j < samples->size(); ++j) {
+      EXPECT_NEAR(samples->at(j) / 32768.f, float_samples->at(j), 1 / 32768.f);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Rates, TimeStretcherRateTest,
+                         testing::Values(0.5f, 0.8f, 1.f, 1.25f, 1.5f, 2.f));
+
+TEST(TimeStretcherTest, ReturnsToPassingSamplesThrough) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  SineGenerator sine_generator;
+  std::vector<int> num_requested_samples;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = [&](int num_samples) {
+        num_requested_samples.push_back(num_samples);
+        return sine_generator(num_samples);
+      };
+  ASSERT_TRUE(time_stretcher.set_rate(1.25f));
+  ASSERT_TRUE(time_stretcher.FilterAndBuffer(sample_generator, 320));
+  ASSERT_TRUE(time_stretcher.set_rate(1.f));
+  // Plays out the input that was looked ahead at.
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_TRUE(time_stretcher.FilterAndBuffer(sample_generator, 320));
+  }
+
+  num_requested_samples.clear();
+  const int num_generated_samples = sine_generator.num_generated_samples();
+  const auto samples = time_stretcher.FilterAndBuffer(sample_generator, 320);
+  ASSERT_TRUE(samples.has_value());
+  EXPECT_EQ(num_requested_samples, std::vector<int>{320});
+  EXPECT_EQ(sine_generator.num_generated_samples(),
+            num_generated_samples + 320);
+}
+
+TEST(TimeStretcherTest, RestoredStateContinuesTheSameOutput) {
+  TimeStretcher time_stretcher(kSampleRateHz);
+  ASSERT_TRUE(time_stretcher.set_rate(0.8f));
+  SineGenerator sine_generator;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = std::ref(sine_generator);
+  // An uneven request leaves stretched samples buffered.
+  ASSERT_TRUE(time_stretcher.FilterAndBuffer(sample_generator, 250));
+
+  StateWriter writer(SessionKind::kDecoder);
+  ASSERT_TRUE(time_stretcher.SaveState(&writer));
+  TimeStretcher restored_time_stretcher(kSampleRateHz);
+  auto reader = StateReader::Create(writer.bytes(), SessionKind::kDecoder);
+  ASSERT_NE(reader, nullptr);
+  ASSERT_TRUE(restored_time_stretcher.RestoreState(reader.get()));
+  EXPECT_TRUE(reader->at_end());
+  EXPECT_EQ(restored_time_stretcher.rate(), 0.8f);
+
+  // Both continue from the same input.
+  SineGenerator restored_sine_generator = sine_generator;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      restored_sample_generator = std::ref(restored_sine_generator);
+  for (const float rate : {0.8f, 1.5f, 1.f}) {
+    ASSERT_TRUE(time_stretcher.set_rate(rate));
+    ASSERT_TRUE(restored_time_stretcher.set_rate(rate));
+    const auto samples = time_stretcher.FilterAndBuffer(sample_generator, 320);
+    const auto restored_samples = restored_time_stretcher.FilterAndBuffer(
+        restored_sample_generator, 320);
+    ASSERT_TRUE(samples.has_value());
+    ASSERT_TRUE(restored_samples.has_value());
+    EXPECT_EQ(samples.value(), restored_samples.value());
+  }
+}
+
+TEST(TimeStretcherTest, InvalidStateLeavesTheTimeStretcherUnchanged) {
+  // A valid rate followed by a position past the end of the input.
+  StateWriter writer(SessionKind::kDecoder);
+  writer.Write(1.5f);
+  writer.Write(false);
+  writer.WriteVector<float>(std::vector<float>(10, 0.5f));
+  writer.Write<int32_t>(11);
+  writer.Write(0.0);
+  writer.WriteVector<float>(std::vector<float>());
+  auto reader = StateReader::Create(writer.bytes(), SessionKind::kDecoder);
+  ASSERT_NE(reader, nullptr);
+
+  TimeStretcher time_stretcher(kSampleRateHz);
+  EXPECT_FALSE(time_stretcher.RestoreState(reader.get()));
+  EXPECT_EQ(time_stretcher.rate(), 1.f);
+
+  TimeStretcher untouched_time_stretcher(kSampleRateHz);
+  SineGenerator sine_generator;
+  SineGenerator untouched_sine_generator;
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      sample_generator = std::ref(sine_generator);
+  const std::function<std::optional<std::vector<int16_t>>(int)>
+      untouched_sample_generator = std::ref(untouched_sine_generator);
+  const auto samples = time_stretcher.FilterAndBuffer(sample_generator, 320);
+  const auto untouched_samples = untouched_time_stretcher.FilterAndBuffer(
+      untouched_sample_generator, 320);
+  ASSERT_TRUE(samples.has_value());
+  ASSERT_TRUE(untouched_samples.has_value());
+  EXPECT_EQ(samples.value(), untouched_samples.value());
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
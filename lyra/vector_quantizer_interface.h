@@ -19,6 +19,7 @@
 
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace chromemedia {
@@ -38,6 +39,25 @@ class VectorQuantizerInterface {
   // spectrogram domain.
   virtual std::optional<std::vector<float>> DecodeToLossyFeatures(
       const std::string& quantized_features) const = 0;
+
+  // Converts the quantized bits of consecutive frames, which all have the same
+  // number of bits, back into lossy features. Implementations that can decode
+  // stacked frames in one pass override this; by default the frames are
+  // decoded one at a time.
+  virtual std::optional<std::vector<std::vector<float>>>
+  DecodeFramesToLossyFeatures(
+      const std::vector<std::string>& quantized_frames) const {
+    std::vector<std::vector<float>> frames;
+    frames.reserve(quantized_frames.size());
+    for (const std::string& quantized_features : quantized_frames) {
+      auto features = DecodeToLossyFeatures(quantized_features);
+      if (!features.has_value()) {
+        return std::nullopt;
+      }
+      frames.push_back(std::move(features.value()));
+    }
+    return frames;
+  }
 };
 
 }  // namespace codec
@@ -14,19 +14,72 @@
 
 #include "lyra/wav_utils.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "audio/dsp/portable/read_wav_file.h"
 #include "audio/dsp/portable/write_wav_file.h"
 
 namespace chromemedia::codec {
+namespace {
+
+constexpr int kBytesPerSample = 2;
+constexpr uint16_t kPcmFormat = 1;
+constexpr uint16_t kExtensibleFormat = 0xFFFE;
+// Offsets of the sizes in the canonical 44 byte header written by
+// `WavFileWriter`.
+constexpr int kRiffSizeOffset = 4;
+constexpr int kDataSizeOffset = 40;
+constexpr int kHeaderSize = 44;
+// Samples are converted to little endian through a buffer of this size.
+constexpr int kWriteBufferSamples = 1024;
+
+uint16_t LoadLittleEndian16(const uint8_t* bytes) {
+  return static_cast<uint16_t>(bytes[0] | bytes[1] << 8);
+}
+
+uint32_t LoadLittleEndian32(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) |
+         static_cast<uint32_t>(bytes[1]) << 8 |
+         static_cast<uint32_t>(bytes[2]) << 16 |
+         static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+void StoreLittleEndian16(uint16_t value, uint8_t* bytes) {
+  bytes[0] = value & 0xFF;
+  bytes[1] = value >> 8;
+}
+
+void StoreLittleEndian32(uint32_t value, uint8_t* bytes) {
+  for (int i = 0; i < 4; ++i) {
+    bytes[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+bool ReadBytes(std::ifstream& stream, uint8_t* bytes, size_t num_bytes) {
+  stream.read(reinterpret_cast<char*>(bytes), num_bytes);
+  return stream.gcount() == num_bytes;
+}
+
+bool HasId(const uint8_t* bytes, absl::string_view id) {
+  return absl::string_view(reinterpret_cast<const char*>(bytes), 4) == id;
+}
+
+}  // namespace
 
 absl::StatusOr<ReadWavResult> Read16BitWavFileToVector(
     const std::string& file_name) {
@@ -60,4 +113,180 @@ absl::Status Write16BitWavFileFromVector(const std::string& file_name,
       absl::StrCat("Failed to write to wav file at: ", file_name));
 }
 
+absl::StatusOr<std::unique_ptr<WavFileReader>> WavFileReader::Open(
+    const std::string& file_name) {
+  std::ifstream stream(file_name, std::ios_base::binary);
+  if (!stream.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open wav at path: ", file_name));
+  }
+  uint8_t riff_header[12];
+  if (!ReadBytes(stream, riff_header, sizeof(riff_header)) ||
+      !HasId(riff_header, "RIFF") || !HasId(riff_header + 8, "WAVE")) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Not a wav file: ", file_name));
+  }
+
+  // Chunks other than "fmt " and "data" are skipped. Samples start right
+  // after the header of the "data" chunk.
+  int num_channels = 0;
+  int sample_rate_hz = 0;
+  while (true) {
+    uint8_t chunk_header[8];
+    if (!ReadBytes(stream, chunk_header, sizeof(chunk_header))) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("No data chunk in wav file: ", file_name));
+    }
+    const uint32_t chunk_size = LoadLittleEndian32(chunk_header + 4);
+    if (HasId(chunk_header, "fmt ")) {
+      uint8_t format[40];
+      if (chunk_size < 16 || chunk_size > sizeof(format) ||
+          !ReadBytes(stream, format, chunk_size)) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid format chunk in wav file: ", file_name));
+      }
+      uint16_t format_tag = LoadLittleEndian16(format);
+      if (format_tag == kExtensibleFormat && chunk_size >= 26) {
+        format_tag = LoadLittleEndian16(format + 24);
+      }
+      num_channels = LoadLittleEndian16(format + 2);
+      sample_rate_hz = static_cast<int>(LoadLittleEndian32(format + 4));
+      const int bits_per_sample = LoadLittleEndian16(format + 14);
+      if (format_tag != kPcmFormat || bits_per_sample != 16 ||
+          num_channels <= 0 || sample_rate_hz <= 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Not a 16 bit PCM wav file: ", file_name));
+      }
+      stream.seekg(chunk_size % 2, std::ios_base::cur);
+    } else if (HasId(chunk_header, "data")) {
+      if (num_channels == 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Data before format in wav file: ", file_name));
+      }
+      return absl::WrapUnique(new WavFileReader(std::move(stream),
+                                                num_channels, sample_rate_hz,
+                                                chunk_size / kBytesPerSample));
+    } else {
+      // Chunks are padded to an even size.
+      stream.seekg(chunk_size + chunk_size % 2, std::ios_base::cur);
+    }
+  }
+}
+
+WavFileReader::WavFileReader(std::ifstream stream, int num_channels,
+                             int sample_rate_hz, int64_t num_samples)
+    : stream_(std::move(stream)),
+      num_channels_(num_channels),
+      sample_rate_hz_(sample_rate_hz),
+      num_samples_(num_samples),
+      num_samples_remaining_(num_samples) {}
+
+absl::StatusOr<int> WavFileReader::Read(absl::Span<int16_t> samples) {
+  const int64_t num_samples_requested =
+      std::min<int64_t>(samples.size(), num_samples_remaining_);
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(samples.data());
+  stream_.read(reinterpret_cast<char*>(bytes),
+               num_samples_requested * kBytesPerSample);
+  if (stream_.bad()) {
+    return absl::DataLossError("Failed to read from wav file.");
+  }
+  // A file cut short ends at its last complete sample.
+  const int num_samples_read = stream_.gcount() / kBytesPerSample;
+  num_samples_remaining_ = num_samples_read < num_samples_requested
+                               ? 0
+                               : num_samples_remaining_ - num_samples_read;
+  // Samples are converted in place from little endian to the host order.
+  for (int i = 0; i < num_samples_read; ++i) {
+    samples[i] = static_cast<int16_t>(
+        LoadLittleEndian16(bytes + i * kBytesPerSample));
+  }
+  return num_samples_read;
+}
+
+absl::StatusOr<std::unique_ptr<WavFileWriter>> WavFileWriter::Open(
+    const std::string& file_name, int num_channels, int sample_rate_hz) {
+  if (num_channels <= 0 ||
+      num_channels > std::numeric_limits<uint16_t>::max() ||
+      sample_rate_hz <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid wav format: ", num_channels, " channels at ",
+                     sample_rate_hz, " Hz."));
+  }
+  std::ofstream stream(file_name, std::ios_base::binary | std::ios_base::trunc);
+  if (!stream.is_open()) {
+    return absl::AbortedError(
+        absl::StrCat("Failed to open wav file at: ", file_name));
+  }
+
+  // The RIFF and data sizes are left at zero until |Close|.
+  uint8_t header[kHeaderSize] = {'R', 'I', 'F', 'F', 0,   0,   0,   0,
+                                 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '};
+  StoreLittleEndian32(16, header + 16);
+  StoreLittleEndian16(kPcmFormat, header + 20);
+  StoreLittleEndian16(num_channels, header + 22);
+  StoreLittleEndian32(sample_rate_hz, header + 24);
+  StoreLittleEndian32(sample_rate_hz * num_channels * kBytesPerSample,
+                      header + 28);
+  StoreLittleEndian16(num_channels * kBytesPerSample, header + 32);
+  StoreLittleEndian16(16, header + 34);
+  std::copy_n("data", 4, header + 36);
+  stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+  if (!stream.good()) {
+    return absl::AbortedError(
+        absl::StrCat("Failed to write to wav file at: ", file_name));
+  }
+  return absl::WrapUnique(new WavFileWriter(std::move(stream)));
+}
+
+WavFileWriter::WavFileWriter(std::ofstream stream)
+    : stream_(std::move(stream)), num_samples_written_(0) {}
+
+WavFileWriter::~WavFileWriter() {
+  if (stream_.is_open()) {
+    Close().IgnoreError();
+  }
+}
+
+absl::Status WavFileWriter::Write(absl::Span<const int16_t> samples) {
+  // The data size has to fit into the 32 bits of the header.
+  if ((num_samples_written_ + samples.size()) * kBytesPerSample + kHeaderSize >
+      std::numeric_limits<uint32_t>::max()) {
+    return absl::OutOfRangeError("Wav file would exceed 4 GiB.");
+  }
+  uint8_t bytes[kWriteBufferSamples * kBytesPerSample];
+  for (int begin = 0; begin < samples.size(); begin += kWriteBufferSamples) {
+    const int num_samples =
+        std::min<int>(kWriteBufferSamples, samples.size() - begin);
+    for (int i = 0; i < num_samples; ++i) {
+      StoreLittleEndian16(samples[begin + i], bytes + i * kBytesPerSample);
+    }
+    stream_.write(reinterpret_cast<const char*>(bytes),
+                  num_samples * kBytesPerSample);
+  }
+  if (!stream_.good()) {
+    return absl::DataLossError("Failed to write to wav file.");
+  }
+  num_samples_written_ += samples.size();
+  return absl::OkStatus();
+}
+
+absl::Status WavFileWriter::Close() {
+  if (!stream_.is_open()) {
+    return absl::FailedPreconditionError("Wav file is already closed.");
+  }
+  const uint32_t data_size = num_samples_written_ * kBytesPerSample;
+  uint8_t size[4];
+  StoreLittleEndian32(data_size + kHeaderSize - 8, size);
+  stream_.seekp(kRiffSizeOffset);
+  stream_.write(reinterpret_cast<const char*>(size), sizeof(size));
+  StoreLittleEndian32(data_size, size);
+  stream_.seekp(kDataSizeOffset);
+  stream_.write(reinterpret_cast<const char*>(size), sizeof(size));
+  stream_.close();
+  if (stream_.fail()) {
+    return absl::DataLossError("Failed to complete wav file header.");
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace chromemedia::codec
@@ -18,11 +18,14 @@
 #define LYRA_WAV_UTILS_H_
 
 #include <cstdint>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 
 namespace chromemedia::codec {
 
@@ -46,6 +49,62 @@ absl::Status Write16BitWavFileFromVector(const std::string& file_name,
                                          int num_channels, int sample_rate_hz,
                                          const std::vector<int16_t>& samples);
 
+// Reads a 16 bit PCM .wav file a chunk at a time, so that memory does not
+// grow with the length of the file.
+class WavFileReader {
+ public:
+  // Returns an error if the file can not be opened or is not a 16 bit PCM
+  // .wav file.
+  static absl::StatusOr<std::unique_ptr<WavFileReader>> Open(
+      const std::string& file_name);
+
+  // Reads up to `samples.size()` samples into `samples` and returns how many
+  // were read, which is less only at the end of the file. For a multichannel
+  // file the samples are interleaved.
+  absl::StatusOr<int> Read(absl::Span<int16_t> samples);
+
+  int num_channels() const { return num_channels_; }
+  int sample_rate_hz() const { return sample_rate_hz_; }
+
+  // Number of samples of all channels in the file, as given by its header.
+  int64_t num_samples() const { return num_samples_; }
+
+ private:
+  WavFileReader(std::ifstream stream, int num_channels, int sample_rate_hz,
+                int64_t num_samples);
+
+  std::ifstream stream_;
+  const int num_channels_;
+  const int sample_rate_hz_;
+  const int64_t num_samples_;
+  int64_t num_samples_remaining_;
+};
+
+// Writes a 16 bit PCM .wav file a chunk at a time. The sizes in the header are
+// filled in by `Close`.
+class WavFileWriter {
+ public:
+  static absl::StatusOr<std::unique_ptr<WavFileWriter>> Open(
+      const std::string& file_name, int num_channels, int sample_rate_hz);
+
+  // Closes the file if `Close` has not been called, ignoring errors.
+  ~WavFileWriter();
+
+  // Appends `samples`, which are interleaved for a multichannel file.
+  absl::Status Write(absl::Span<const int16_t> samples);
+
+  // Completes the header and closes the file.
+  absl::Status Close();
+
+  int64_t num_samples_written() const { return num_samples_written_; }
+
+ private:
+  explicit WavFileWriter(std::ofstream stream);
+
+  std::ofstream stream_;
+  int64_t num_samples_written_;
+};
+
 }  // namespace chromemedia::codec
 
 #endif  // LYRA_WAV_UTILS_H_
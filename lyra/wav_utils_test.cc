@@ -14,7 +14,9 @@
 
 #include "lyra/wav_utils.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -23,6 +25,7 @@
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "gtest/gtest.h"
 #include "include/ghc/filesystem.hpp"
 
@@ -94,5 +97,73 @@ TEST_F(WavUtilTest, WriteToBadPath) {
   EXPECT_FALSE(result.ok());
 }
 
+TEST_F(WavUtilTest, FileReaderMatchesWholeFileRead) {
+  absl::StatusOr<ReadWavResult> whole_file = ReadWav("sample1_16kHz.wav");
+  ASSERT_TRUE(whole_file.ok());
+
+  const ghc::filesystem::path wav_path =
+      ghc::filesystem::current_path() / "lyra/testdata/sample1_16kHz.wav";
+  absl::StatusOr<std::unique_ptr<WavFileReader>> reader =
+      WavFileReader::Open(wav_path.string());
+  ASSERT_TRUE(reader.ok());
+  EXPECT_EQ((*reader)->num_channels(), 1);
+  EXPECT_EQ((*reader)->sample_rate_hz(), 16000);
+  EXPECT_EQ((*reader)->num_samples(), whole_file->samples.size());
+
+  // An odd chunk size ends the file on a partial chunk.
+  std::vector<int16_t> samples;
+  std::vector<int16_t> chunk(321);
+  while (true) {
+    absl::StatusOr<int> num_read = (*reader)->Read(absl::MakeSpan(chunk));
+    ASSERT_TRUE(num_read.ok());
+    samples.insert(samples.end(), chunk.begin(), chunk.begin() + *num_read);
+    if (*num_read < chunk.size()) {
+      break;
+    }
+  }
+  EXPECT_EQ(samples, whole_file->samples);
+}
+
+TEST_F(WavUtilTest, FileReaderRejectsInvalidWav) {
+  EXPECT_FALSE(WavFileReader::Open("/should/not/exist.wav").ok());
+  const ghc::filesystem::path wav_path =
+      ghc::filesystem::current_path() / "lyra/testdata/invalid.wav";
+  EXPECT_FALSE(WavFileReader::Open(wav_path.string()).ok());
+}
+
+TEST_F(WavUtilTest, FileWriterWritesInChunks) {
+  // Interleaved stereo samples covering the whole range.
+  std::vector<int16_t> samples(2 * 3000);
+  for (int i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<int16_t>(i * 23 - 32768);
+  }
+
+  const ghc::filesystem::path output_path =
+      ghc::filesystem::path(testing::TempDir()) / "chunked_output.wav";
+  absl::StatusOr<std::unique_ptr<WavFileWriter>> writer =
+      WavFileWriter::Open(output_path.string(), 2, 48000);
+  ASSERT_TRUE(writer.ok());
+  for (int begin = 0; begin < samples.size(); begin += 1000) {
+    const int end = std::min<int>(begin + 1000, samples.size());
+    ASSERT_TRUE(
+        (*writer)
+            ->Write(absl::MakeConstSpan(samples).subspan(begin, end - begin))
+            .ok());
+  }
+  EXPECT_EQ((*writer)->num_samples_written(), samples.size());
+  ASSERT_TRUE((*writer)->Close().ok());
+  EXPECT_FALSE((*writer)->Close().ok());
+
+  absl::StatusOr<ReadWavResult> read_result = ReadWav(output_path);
+  ASSERT_TRUE(read_result.ok());
+  EXPECT_EQ(read_result->num_channels, 2);
+  EXPECT_EQ(read_result->sample_rate_hz, 48000);
+  EXPECT_EQ(read_result->samples, samples);
+}
+
+TEST_F(WavUtilTest, FileWriterToBadPath) {
+  EXPECT_FALSE(WavFileWriter::Open("/invalid/path/test", 1, 16000).ok());
+}
+
 }  // namespace
 }  // namespace chromemedia::codec
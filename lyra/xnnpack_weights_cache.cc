@@ -0,0 +1,137 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lyra/xnnpack_weights_cache.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "glog/logging.h"  // IWYU pragma: keep
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+struct Registry {
+  absl::Mutex mutex;
+  absl::flat_hash_map<std::string, std::weak_ptr<XnnPackWeightsCache>> caches
+      ABSL_GUARDED_BY(mutex);
+};
+
+Registry& GetRegistry() {
+  static Registry* const registry = new Registry;
+  return *registry;
+}
+
+// Deletes |cache| and removes its entry, unless a new cache was registered
+// under |key| between the release of the last user and this call.
+void ReleaseCache(const std::string& key, XnnPackWeightsCache* cache) {
+  delete cache;
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  const auto it = registry.caches.find(key);
+  if (it != registry.caches.end() && it->second.expired()) {
+    registry.caches.erase(it);
+  }
+}
+
+}  // namespace
+
+std::shared_ptr<XnnPackWeightsCache> XnnPackWeightsCache::Get(
+    absl::Span<const char> model_buffer, int weights_identifier,
+    uint32_t delegate_flags) {
+  const std::string key = absl::StrCat(Hash(model_buffer), "-",
+                                       model_buffer.size(), "-",
+                                       weights_identifier, "-", delegate_flags);
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  std::weak_ptr<XnnPackWeightsCache>& entry = registry.caches[key];
+  if (std::shared_ptr<XnnPackWeightsCache> cache = entry.lock()) {
+    return cache;
+  }
+  TfLiteXNNPackDelegateWeightsCache* cache =
+      TfLiteXNNPackDelegateWeightsCacheCreate();
+  if (cache == nullptr) {
+    LOG(ERROR) << "Could not create XNNPack weights cache.";
+    registry.caches.erase(key);
+    return nullptr;
+  }
+  auto weights_cache = std::shared_ptr<XnnPackWeightsCache>(
+      new XnnPackWeightsCache(cache),
+      [key](XnnPackWeightsCache* released) { ReleaseCache(key, released); });
+  entry = weights_cache;
+  return weights_cache;
+}
+
+uint64_t XnnPackWeightsCache::Hash(absl::Span<const char> buffer) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const char byte : buffer) {
+    hash ^= static_cast<uint8_t>(byte);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+int XnnPackWeightsCache::num_live_caches() {
+  Registry& registry = GetRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  return registry.caches.size();
+}
+
+XnnPackWeightsCache::XnnPackWeightsCache(
+    TfLiteXNNPackDelegateWeightsCache* cache)
+    : cache_(cache), finalized_(false) {}
+
+XnnPackWeightsCache::~XnnPackWeightsCache() {
+  TfLiteXNNPackDelegateWeightsCacheDelete(cache_);
+}
+
+TfLiteStatus XnnPackWeightsCache::ModifyGraph(
+    const std::function<TfLiteStatus(TfLiteXNNPackDelegateWeightsCache*)>&
+        modify_graph) {
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (finalized_) {
+      // A finalized cache is read only, so interpreters may look up weights
+      // concurrently.
+      return modify_graph(cache_);
+    }
+  }
+  absl::MutexLock lock(&mutex_);
+  const TfLiteStatus status = modify_graph(cache_);
+  if (status == kTfLiteOk && !finalized_) {
+    if (!TfLiteXNNPackDelegateWeightsCacheFinalizeHard(cache_)) {
+      LOG(ERROR) << "Could not finalize XNNPack weights cache.";
+      return kTfLiteError;
+    }
+    finalized_ = true;
+  }
+  return status;
+}
+
+bool XnnPackWeightsCache::finalized() const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return finalized_;
+}
+
+}  // namespace codec
+}  // namespace chromemedia
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LYRA_XNNPACK_WEIGHTS_CACHE_H_
+#define LYRA_XNNPACK_WEIGHTS_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+namespace chromemedia {
+namespace codec {
+
+// Holds the weights XNNPack packed for one model, so that only the first
+// interpreter created for it pays for packing. Caches are looked up by a key
+// derived from the model contents, the identifier of the lyra_config.binarypb
+// the model was shipped with, and the delegate flags, so that a cache is never
+// used with weights it was not built from. A cache lives as long as any
+// interpreter uses it, and is dropped from the lookup when it is released.
+class XnnPackWeightsCache {
+ public:
+  // Returns the cache for the given model, creating an empty one if no
+  // interpreter currently holds it. Returns a nullptr on failure.
+  static std::shared_ptr<XnnPackWeightsCache> Get(
+      absl::Span<const char> model_buffer, int weights_identifier,
+      uint32_t delegate_flags);
+
+  // Returns a 64 bit FNV-1a hash of |buffer|.
+  static uint64_t Hash(absl::Span<const char> buffer);
+
+  // Returns the number of caches that are currently held by interpreters.
+  static int num_live_caches();
+
+  ~XnnPackWeightsCache();
+
+  // Calls |modify_graph| with the underlying XNNPack cache, which has to be
+  // passed in the delegate options. The first successful call packs the
+  // weights and finalizes the cache, later calls only look them up.
+  TfLiteStatus ModifyGraph(
+      const std::function<TfLiteStatus(TfLiteXNNPackDelegateWeightsCache*)>&
+          modify_graph);
+
+  bool finalized() const;
+
+ private:
+  explicit XnnPackWeightsCache(TfLiteXNNPackDelegateWeightsCache* cache);
+
+  TfLiteXNNPackDelegateWeightsCache* const cache_;
+  mutable absl::Mutex mutex_;
+  bool finalized_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace codec
+}  // namespace chromemedia
+
+#endif  // LYRA_XNNPACK_WEIGHTS_CACHE_H_
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lyra/xnnpack_weights_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/types/span.h"
+#include "gtest/gtest.h"
+
+namespace chromemedia {
+namespace codec {
+namespace {
+
+constexpr char kModel[] = "model contents";
+constexpr char kOtherModel[] = "other model contents";
+
+absl::Span<const char> AsSpan(const char* contents) {
+  return absl::MakeConstSpan(contents, std::string(contents).size());
+}
+
+TEST(XnnPackWeightsCacheTest, HashIsFnv1a) {
+  EXPECT_EQ(XnnPackWeightsCache::Hash(AsSpan("")), 0xcbf29ce484222325ull);
+  EXPECT_EQ(XnnPackWeightsCache::Hash(AsSpan("a")), 0xaf63dc4c8601ec8cull);
+}
+
+TEST(XnnPackWeightsCacheTest, SameModelSharesCache) {
+  auto cache = XnnPackWeightsCache::Get(AsSpan(kModel), 3, 0);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_FALSE(cache->finalized());
+  EXPECT_EQ(XnnPackWeightsCache::Get(AsSpan(kModel), 3, 0), cache);
+}
+
+TEST(XnnPackWeightsCacheTest, MismatchedKeysGetSeparateCaches) {
+  auto cache = XnnPackWeightsCache::Get(AsSpan(kModel), 3, 0);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_NE(XnnPackWeightsCache::Get(AsSpan(kOtherModel), 3, 0), cache);
+  EXPECT_NE(XnnPackWeightsCache::Get(AsSpan(kModel), 2, 0), cache);
+  EXPECT_NE(XnnPackWeightsCache::Get(AsSpan(kModel), 3, 1), cache);
+}
+
+TEST(XnnPackWeightsCacheTest, CacheIsReleasedWithLastUser) {
+  auto cache = XnnPackWeightsCache::Get(AsSpan(kModel), 3, 0);
+  ASSERT_NE(cache, nullptr);
+  std::weak_ptr<XnnPackWeightsCache> weak_cache = cache;
+  cache.reset();
+  EXPECT_TRUE(weak_cache.expired());
+}
+
+// Released caches must not leave entries behind for every model ever loaded.
+TEST(XnnPackWeightsCacheTest, ReleasedCachesAreUnregistered) {
+  const int num_live_caches = XnnPackWeightsCache::num_live_caches();
+  for (int weights_identifier = 0; weights_identifier < 10;
+       ++weights_identifier) {
+    auto cache =
+        XnnPackWeightsCache::Get(AsSpan(kModel), weights_identifier, 0);
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(XnnPackWeightsCache::num_live_caches(), num_live_caches + 1);
+  }
+  EXPECT_EQ(XnnPackWeightsCache::num_live_caches(), num_live_caches);
+}
+
+}  // namespace
+}  // namespace codec
+}  // namespace chromemedia
@@ -21,6 +21,7 @@
 
 #include "absl/types/span.h"
 #include "lyra/feature_estimator_interface.h"
+#include "lyra/session_state.h"
 
 namespace chromemedia {
 namespace codec {
@@ -35,6 +36,11 @@ class ZeroFeatureEstimator : public FeatureEstimatorInterface {
 
   std::vector<float> Estimate() const override { return estimated_features_; }
 
+  // The estimate never changes, so there is no state to save.
+  bool SaveState(StateWriter* writer) const override { return true; }
+
+  bool RestoreState(StateReader* reader) override { return true; }
+
  private:
   ZeroFeatureEstimator() = delete;
 